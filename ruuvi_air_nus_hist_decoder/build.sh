@@ -0,0 +1,19 @@
+#!/bin/bash
+
+# Build the host-side decoder of the compressed history (NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED).
+# The frame codec is shared with the firmware (src/hist_log_codec.c).
+
+set -e
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+ROOT_DIR="$SCRIPT_DIR/.."
+
+${CC:-cc} -std=c11 -O2 -Wall -Wextra \
+    -I"$SCRIPT_DIR" \
+    -I"$ROOT_DIR/src" \
+    -I"$ROOT_DIR/include" \
+    -I"$ROOT_DIR/components/ruuvi.endpoints.c/src" \
+    -o "$SCRIPT_DIR/nus_hist_decoder" \
+    "$SCRIPT_DIR/main.c" \
+    "$SCRIPT_DIR/nus_hist_decoder.c" \
+    "$ROOT_DIR/src/hist_log_codec.c"
@@ -0,0 +1,128 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "nus_hist_decoder.h"
+#include "ruuvi_endpoints.h"
+
+#define MAX_MSG_LEN  (256U)
+#define MAX_LINE_LEN ((2U * MAX_MSG_LEN) + 16U)
+
+static nus_hist_decoder_record_t g_records[NUS_HIST_DECODER_MAX_RECORDS_IN_CHUNK];
+
+static int
+hex_to_nibble(const char ch)
+{
+    if ((ch >= '0') && (ch <= '9'))
+    {
+        return ch - '0';
+    }
+    const int lower = tolower((unsigned char)ch);
+    if ((lower >= 'a') && (lower <= 'f'))
+    {
+        return lower - 'a' + 10;
+    }
+    return -1;
+}
+
+/**
+ * @brief Convert the hex string to bytes, the whitespace between the bytes is ignored.
+ * @return Number of bytes or -1 on error.
+ */
+static int
+hex_to_bytes(const char* p_str, uint8_t* const p_buf, const size_t buf_size)
+{
+    size_t len = 0;
+    while ('\0' != *p_str)
+    {
+        if (isspace((unsigned char)*p_str))
+        {
+            p_str += 1;
+            continue;
+        }
+        const int hi = hex_to_nibble(p_str[0]);
+        const int lo = ('\0' != p_str[1]) ? hex_to_nibble(p_str[1]) : -1;
+        if ((hi < 0) || (lo < 0) || (len >= buf_size))
+        {
+            return -1;
+        }
+        p_buf[len] = (uint8_t)((hi << 4) | lo);
+        len += 1;
+        p_str += 2;
+    }
+    return (int)len;
+}
+
+/**
+ * Read the notifications of the response to NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED from stdin,
+ * one hex-encoded message per line, and print the decoded records as CSV:
+ * sequence number, timestamp, E1 payload in hex.
+ */
+int
+main(void)
+{
+    static char line[MAX_LINE_LEN];
+    uint32_t    line_num    = 0;
+    uint32_t    num_records = 0;
+    uint32_t    num_bytes   = 0;
+    uint32_t    num_errors  = 0;
+    bool        is_eof      = false;
+
+    printf("seq,timestamp,payload\n");
+    while (NULL != fgets(line, sizeof(line), stdin))
+    {
+        line_num += 1;
+        uint8_t   msg[MAX_MSG_LEN];
+        const int len = hex_to_bytes(line, msg, sizeof(msg));
+        if (len <= 0)
+        {
+            if (len < 0)
+            {
+                fprintf(stderr, "Line %u: invalid hex string\n", (unsigned)line_num);
+                num_errors += 1;
+            }
+            continue;
+        }
+        num_bytes += (uint32_t)len;
+        uint32_t                        num_records_in_chunk = 0;
+        uint32_t                        seq_last             = 0;
+        const nus_hist_decoder_status_e status
+            = nus_hist_decoder_decode(msg, (size_t)len, g_records, &num_records_in_chunk, &seq_last);
+        if (NUS_HIST_DECODER_STATUS_ERROR == status)
+        {
+            fprintf(stderr, "Line %u: malformed message, its records are lost\n", (unsigned)line_num);
+            num_errors += 1;
+            continue;
+        }
+        if (NUS_HIST_DECODER_STATUS_EOF == status)
+        {
+            fprintf(stderr, "End of data, the next request starts after seq %u\n", (unsigned)seq_last);
+            is_eof = true;
+            continue;
+        }
+        for (uint32_t i = 0; i < num_records_in_chunk; ++i)
+        {
+            const nus_hist_decoder_record_t* const p_record = &g_records[i];
+            printf("%u,%u,", (unsigned)p_record->seq, (unsigned)p_record->timestamp);
+            for (size_t j = 0; j < sizeof(p_record->data.buf); ++j)
+            {
+                printf("%02X", p_record->data.buf[j]);
+            }
+            printf("\n");
+        }
+        num_records += num_records_in_chunk;
+    }
+    fprintf(
+        stderr,
+        "%u records in %u bytes (%u bytes uncompressed), %u errors\n",
+        (unsigned)num_records,
+        (unsigned)num_bytes,
+        (unsigned)(num_records * RE_LOG_WRITE_AIRQ_RECORD_LEN),
+        (unsigned)num_errors);
+    return ((0 == num_errors) && is_eof) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,72 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "nus_hist_decoder.h"
+#include "ruuvi_endpoints.h"
+#include "hist_log_codec.h"
+#include "nus_req.h"
+#include "sys_utils.h"
+
+#define NUS_HIST_DECODER_EOF_LEN (RE_LOG_WRITE_MULTI_PAYLOAD_IDX + sizeof(uint32_t))
+
+static uint32_t
+nus_hist_decoder_unpack_uint32(const uint8_t* const p_buf)
+{
+    return ((uint32_t)p_buf[BYTE_IDX_0] << BYTE_SHIFT_3) | ((uint32_t)p_buf[BYTE_IDX_1] << BYTE_SHIFT_2)
+           | ((uint32_t)p_buf[BYTE_IDX_2] << BYTE_SHIFT_1) | ((uint32_t)p_buf[BYTE_IDX_3] << BYTE_SHIFT_0);
+}
+
+nus_hist_decoder_status_e
+nus_hist_decoder_decode(
+    const uint8_t* const             p_msg,
+    const size_t                     len,
+    nus_hist_decoder_record_t* const p_records,
+    uint32_t* const                  p_num_records,
+    uint32_t* const                  p_seq_last)
+{
+    *p_num_records = 0;
+    if ((len < RE_LOG_WRITE_MULTI_PAYLOAD_IDX)
+        || (NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED != p_msg[RE_STANDARD_OPERATION_INDEX])
+        || (NUS_REQ_COMPRESSED_FMT_VERSION != p_msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX]))
+    {
+        return NUS_HIST_DECODER_STATUS_ERROR;
+    }
+    const uint32_t num_records = p_msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX];
+    if (0 == num_records)
+    {
+        if (len != NUS_HIST_DECODER_EOF_LEN)
+        {
+            return NUS_HIST_DECODER_STATUS_ERROR;
+        }
+        *p_seq_last = nus_hist_decoder_unpack_uint32(&p_msg[RE_LOG_WRITE_MULTI_PAYLOAD_IDX]);
+        return NUS_HIST_DECODER_STATUS_EOF;
+    }
+
+    // Every chunk starts with a key frame, so the state of the previous chunk is not needed
+    hist_log_codec_state_t state = { 0 };
+    hist_log_codec_reset(&state);
+    size_t pos = RE_LOG_WRITE_MULTI_PAYLOAD_IDX;
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        nus_hist_decoder_record_t* const p_record  = &p_records[i];
+        const size_t                     frame_len = hist_log_codec_decode(
+            &state,
+            &p_msg[pos],
+            len - pos,
+            &p_record->timestamp,
+            &p_record->seq,
+            &p_record->data);
+        if (0 == frame_len)
+        {
+            return NUS_HIST_DECODER_STATUS_ERROR;
+        }
+        pos += frame_len;
+    }
+    if (pos != len)
+    {
+        return NUS_HIST_DECODER_STATUS_ERROR;
+    }
+    *p_num_records = num_records;
+    return NUS_HIST_DECODER_STATUS_OK;
+}
@@ -0,0 +1,55 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef NUS_HIST_DECODER_H
+#define NUS_HIST_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The number of records is a one-byte field of the chunk header
+#define NUS_HIST_DECODER_MAX_RECORDS_IN_CHUNK (UINT8_MAX)
+
+typedef enum nus_hist_decoder_status_e
+{
+    NUS_HIST_DECODER_STATUS_OK    = 0, //!< Chunk of records
+    NUS_HIST_DECODER_STATUS_EOF   = 1, //!< End-of-data message
+    NUS_HIST_DECODER_STATUS_ERROR = 2, //!< Not a NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED message or a malformed chunk
+} nus_hist_decoder_status_e;
+
+typedef struct nus_hist_decoder_record_t
+{
+    uint32_t               seq;
+    uint32_t               timestamp;
+    hist_log_record_data_t data; //!< E1 payload, the same as in the uncompressed record
+} nus_hist_decoder_record_t;
+
+/**
+ * @brief Decode one message of the response to NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED.
+ * @details Every chunk is decoded independently, so the messages can be passed in any order,
+ * and a lost message does not affect the following ones.
+ * @param p_msg Pointer to the message (the payload of the notification).
+ * @param len Length of the message.
+ * @param[out] p_records Pointer to the array of NUS_HIST_DECODER_MAX_RECORDS_IN_CHUNK decoded records.
+ * @param[out] p_num_records Pointer to the number of decoded records, it is 0 for the end-of-data message.
+ * @param[out] p_seq_last Pointer to the sequence number to be used in the next request, set only for EOF.
+ */
+nus_hist_decoder_status_e
+nus_hist_decoder_decode(
+    const uint8_t* const             p_msg,
+    const size_t                     len,
+    nus_hist_decoder_record_t* const p_records,
+    uint32_t* const                  p_num_records,
+    uint32_t* const                  p_seq_last);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_HIST_DECODER_H
@@ -215,7 +215,7 @@ send_data_over_nus(void)
         ble_adv_info_t* const p_adv_info = &g_ble_adv_info[i];
         if ((NULL != p_adv_info->p_conn) && nus_is_notif_enabled())
         {
-            const zephyr_api_ret_t res = bt_nus_send(
+            const zephyr_api_ret_t res = nus_send_live_data(
                 p_adv_info->p_conn,
                 &g_mfg_data_ext[BLE_MANUFACTURER_DATA_OFFSET],
                 RE_E1_OFFSET_ADDR_MSB);
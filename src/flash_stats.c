@@ -0,0 +1,534 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "flash_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include "tlog.h"
+#include "zephyr_api.h"
+
+#if IS_ENABLED(CONFIG_STATS)
+#include <zephyr/stats/stats.h>
+#endif
+
+LOG_MODULE_REGISTER(flash_stats, LOG_LEVEL_INF);
+
+#define USE_FLASH_STATS        (1 && IS_ENABLED(CONFIG_RUUVI_AIR_FLASH_STATS))
+#define USE_FLASH_STATS_MCUMGR (USE_FLASH_STATS && IS_ENABLED(CONFIG_STATS) && IS_ENABLED(CONFIG_MCUMGR_GRP_STAT))
+
+#if USE_FLASH_STATS
+
+#define FLASH_STATS_NUM_AREAS           (CONFIG_RUUVI_AIR_FLASH_STATS_NUM_AREAS)
+#define FLASH_STATS_NUM_SECTORS         (CONFIG_RUUVI_AIR_FLASH_STATS_NUM_SECTORS)
+#define FLASH_STATS_SAVE_PERIOD_MINUTES (CONFIG_RUUVI_AIR_FLASH_STATS_SAVE_PERIOD_MINUTES)
+
+// The erase counts of the flash area are saved as an array of uint32_t to "flash_stats/<flash area ID>"
+#define FLASH_STATS_SETTINGS_SUBTREE "flash_stats"
+#define FLASH_STATS_SETTINGS_KEY_LEN (sizeof(FLASH_STATS_SETTINGS_SUBTREE "/255"))
+
+#define FLASH_STATS_STATS_NAME_LEN (sizeof("flash255"))
+
+#if USE_FLASH_STATS_MCUMGR
+/* clang-format off */
+STATS_SECT_START(flash_stats)
+STATS_SECT_ENTRY32(reads)
+STATS_SECT_ENTRY32(read_bytes)
+STATS_SECT_ENTRY32(read_max_us)
+STATS_SECT_ENTRY32(writes)
+STATS_SECT_ENTRY32(write_bytes)
+STATS_SECT_ENTRY32(write_max_us)
+STATS_SECT_ENTRY32(erases)
+STATS_SECT_ENTRY32(erase_bytes)
+STATS_SECT_ENTRY32(erase_max_us)
+STATS_SECT_ENTRY32(errors)
+STATS_SECT_ENTRY32(sector_erase_max)
+STATS_SECT_END;
+
+STATS_NAME_START(flash_stats)
+STATS_NAME(flash_stats, reads)
+STATS_NAME(flash_stats, read_bytes)
+STATS_NAME(flash_stats, read_max_us)
+STATS_NAME(flash_stats, writes)
+STATS_NAME(flash_stats, write_bytes)
+STATS_NAME(flash_stats, write_max_us)
+STATS_NAME(flash_stats, erases)
+STATS_NAME(flash_stats, erase_bytes)
+STATS_NAME(flash_stats, erase_max_us)
+STATS_NAME(flash_stats, errors)
+STATS_NAME(flash_stats, sector_erase_max)
+STATS_NAME_END(flash_stats);
+/* clang-format on */
+#endif // USE_FLASH_STATS_MCUMGR
+
+typedef struct flash_stats_area_t
+{
+    const struct flash_area*  p_fa;               //!< NULL if the slot is free
+    uint32_t                  num_sectors;        //!< Number of FLASH_STATS_SECTOR_SIZE sectors in the flash area
+    uint32_t*                 p_sector_erase_cnt; //!< NULL if the pool of the per-sector counters is exhausted
+    bool                      is_erase_cnt_dirty; //!< The erase counts were changed since the last save
+    flash_stats_op_counters_t ops[FLASH_STATS_NUM_OPS];
+#if USE_FLASH_STATS_MCUMGR
+    STATS_SECT_DECL(flash_stats) stats;
+    char stats_name[FLASH_STATS_STATS_NAME_LEN];
+#endif
+} flash_stats_area_t;
+
+typedef struct flash_stats_t
+{
+    flash_stats_area_t areas[FLASH_STATS_NUM_AREAS];
+    uint32_t           num_areas;
+    uint32_t           num_sectors_used; //!< Number of the used counters in sector_erase_cnt_pool
+    uint32_t           sector_erase_cnt_pool[FLASH_STATS_NUM_SECTORS];
+} flash_stats_t;
+
+// The counters are updated by the threads of hist_log, LittleFS and mcumgr, the critical sections are short
+static struct k_spinlock g_flash_stats_lock;
+static flash_stats_t     g_flash_stats;
+
+static void
+flash_stats_save_work_handler(struct k_work* p_work);
+
+static K_WORK_DELAYABLE_DEFINE(g_flash_stats_save_work, &flash_stats_save_work_handler);
+
+static uint32_t
+flash_stats_get_latency_bucket(const uint32_t latency_us)
+{
+    if (0 == latency_us)
+    {
+        return 0;
+    }
+    const uint32_t bucket = (uint32_t)(31 - __builtin_clz(latency_us));
+    return (bucket < FLASH_STATS_NUM_LATENCY_BUCKETS) ? bucket : (FLASH_STATS_NUM_LATENCY_BUCKETS - 1);
+}
+
+/**
+ * @brief Find the flash area or allocate a slot for it.
+ * @note The caller must hold g_flash_stats_lock.
+ * @return NULL if all the slots are used.
+ */
+static flash_stats_area_t*
+flash_stats_get_area(const struct flash_area* const p_fa)
+{
+    for (uint32_t i = 0; i < g_flash_stats.num_areas; ++i)
+    {
+        flash_stats_area_t* const p_area = &g_flash_stats.areas[i];
+        if (p_area->p_fa->fa_id == p_fa->fa_id)
+        {
+            return p_area;
+        }
+    }
+    if (g_flash_stats.num_areas >= FLASH_STATS_NUM_AREAS)
+    {
+        return NULL;
+    }
+    flash_stats_area_t* const p_area = &g_flash_stats.areas[g_flash_stats.num_areas];
+    g_flash_stats.num_areas += 1;
+    memset(p_area, 0, sizeof(*p_area));
+    p_area->p_fa        = p_fa;
+    p_area->num_sectors = (uint32_t)((p_fa->fa_size + FLASH_STATS_SECTOR_SIZE - 1) / FLASH_STATS_SECTOR_SIZE);
+    if ((g_flash_stats.num_sectors_used + p_area->num_sectors) <= FLASH_STATS_NUM_SECTORS)
+    {
+        p_area->p_sector_erase_cnt = &g_flash_stats.sector_erase_cnt_pool[g_flash_stats.num_sectors_used];
+        g_flash_stats.num_sectors_used += p_area->num_sectors;
+    }
+#if USE_FLASH_STATS_MCUMGR
+    (void)snprintf(p_area->stats_name, sizeof(p_area->stats_name), "flash%u", (unsigned)p_fa->fa_id);
+    (void)stats_init_and_reg(
+        &p_area->stats.s_hdr,
+        STATS_SIZE_32,
+        (sizeof(p_area->stats) - sizeof(struct stats_hdr)) / STATS_SIZE_32,
+        STATS_NAME_INIT_PARMS(flash_stats),
+        p_area->stats_name);
+#endif
+    return p_area;
+}
+
+static void
+flash_stats_get_erase_cnt_range(
+    const flash_stats_area_t* const p_area,
+    uint32_t* const                 p_min,
+    uint32_t* const                 p_max,
+    uint32_t* const                 p_sum)
+{
+    *p_min = 0;
+    *p_max = 0;
+    *p_sum = 0;
+    if (NULL == p_area->p_sector_erase_cnt)
+    {
+        return;
+    }
+    *p_min = UINT32_MAX;
+    for (uint32_t i = 0; i < p_area->num_sectors; ++i)
+    {
+        const uint32_t erase_cnt = p_area->p_sector_erase_cnt[i];
+        *p_min                   = MIN(*p_min, erase_cnt);
+        *p_max                   = MAX(*p_max, erase_cnt);
+        *p_sum += erase_cnt;
+    }
+}
+
+#if USE_FLASH_STATS_MCUMGR
+static void
+flash_stats_update_mcumgr(flash_stats_area_t* const p_area, const flash_stats_op_e op, const size_t len, const int rc)
+{
+    const flash_stats_op_counters_t* const p_cnt = &p_area->ops[op];
+    if (0 != rc)
+    {
+        STATS_INC(p_area->stats, errors);
+        return;
+    }
+    switch (op)
+    {
+        case FLASH_STATS_OP_READ:
+            STATS_INC(p_area->stats, reads);
+            STATS_INCN(p_area->stats, read_bytes, len);
+            p_area->stats.read_max_us = p_cnt->latency_max_us;
+            break;
+        case FLASH_STATS_OP_WRITE:
+            STATS_INC(p_area->stats, writes);
+            STATS_INCN(p_area->stats, write_bytes, len);
+            p_area->stats.write_max_us = p_cnt->latency_max_us;
+            break;
+        case FLASH_STATS_OP_ERASE:
+            STATS_INC(p_area->stats, erases);
+            STATS_INCN(p_area->stats, erase_bytes, len);
+            p_area->stats.erase_max_us = p_cnt->latency_max_us;
+            break;
+        default:
+            break;
+    }
+}
+#endif // USE_FLASH_STATS_MCUMGR
+
+static int
+flash_stats_settings_load_cb(
+    const char*      key,
+    size_t           len,
+    settings_read_cb read_cb,
+    void*            cb_arg,
+    void*            param) // NOSONAR: Zephyr settings API
+{
+    ARG_UNUSED(param);
+    if (NULL == key)
+    {
+        return 0;
+    }
+    char*               p_end = NULL;
+    const unsigned long fa_id = strtoul(key, &p_end, 10);
+    if ((p_end == key) || ('\0' != *p_end) || (fa_id > UINT8_MAX))
+    {
+        TLOG_WRN("Unknown key \"%s/%s\"", FLASH_STATS_SETTINGS_SUBTREE, key);
+        return 0;
+    }
+    const struct flash_area* p_fa = NULL;
+    if (0 != flash_area_open((uint8_t)fa_id, &p_fa))
+    {
+        TLOG_WRN("Flash area %u is not found, its erase counts are discarded", (unsigned)fa_id);
+        return 0;
+    }
+    k_spinlock_key_t          key_lock = k_spin_lock(&g_flash_stats_lock);
+    flash_stats_area_t* const p_area   = flash_stats_get_area(p_fa);
+    k_spin_unlock(&g_flash_stats_lock, key_lock);
+    if ((NULL == p_area) || (NULL == p_area->p_sector_erase_cnt))
+    {
+        TLOG_WRN("No space for the erase counts of flash area %u", (unsigned)fa_id);
+        return 0;
+    }
+    if (len != (p_area->num_sectors * sizeof(uint32_t)))
+    {
+        TLOG_WRN("Erase counts of flash area %u have wrong length: %u", (unsigned)fa_id, (unsigned)len);
+        return 0;
+    }
+    if (0 != p_area->ops[FLASH_STATS_OP_ERASE].num_ops)
+    {
+        TLOG_WRN("Flash area %u was erased before flash_stats_init, the erase count is lost", (unsigned)fa_id);
+    }
+    const ssize_t rlen = read_cb(cb_arg, p_area->p_sector_erase_cnt, len);
+    if (rlen != (ssize_t)len)
+    {
+        TLOG_ERR("read_cb failed for erase counts of flash area %u: %d", (unsigned)fa_id, (int)rlen);
+        memset(p_area->p_sector_erase_cnt, 0, len);
+    }
+#if USE_FLASH_STATS_MCUMGR
+    uint32_t erase_cnt_min = 0;
+    uint32_t erase_cnt_sum = 0;
+    key_lock               = k_spin_lock(&g_flash_stats_lock);
+    flash_stats_get_erase_cnt_range(p_area, &erase_cnt_min, &p_area->stats.sector_erase_max, &erase_cnt_sum);
+    k_spin_unlock(&g_flash_stats_lock, key_lock);
+#endif
+    return 0;
+}
+
+static void
+flash_stats_save_work_handler(struct k_work* p_work)
+{
+    ARG_UNUSED(p_work);
+    (void)flash_stats_save();
+    (void)k_work_schedule(&g_flash_stats_save_work, K_MINUTES(FLASH_STATS_SAVE_PERIOD_MINUTES));
+}
+
+#endif // USE_FLASH_STATS
+
+void
+flash_stats_init(void)
+{
+#if USE_FLASH_STATS
+    const zephyr_api_ret_t rc
+        = settings_load_subtree_direct(FLASH_STATS_SETTINGS_SUBTREE, &flash_stats_settings_load_cb, NULL);
+    if (0 != rc)
+    {
+        TLOG_WRN("settings_load_subtree_direct failed for \"%s\", rc=%d", FLASH_STATS_SETTINGS_SUBTREE, rc);
+    }
+    (void)k_work_schedule(&g_flash_stats_save_work, K_MINUTES(FLASH_STATS_SAVE_PERIOD_MINUTES));
+#endif
+}
+
+void
+flash_stats_on_op(
+    const struct flash_area* const p_fa,
+    const flash_stats_op_e         op,
+    const off_t                    off,
+    const size_t                   len,
+    const uint32_t                 latency_us,
+    const int                      rc)
+{
+#if USE_FLASH_STATS
+    k_spinlock_key_t          key    = k_spin_lock(&g_flash_stats_lock);
+    flash_stats_area_t* const p_area = flash_stats_get_area(p_fa);
+    if (NULL == p_area)
+    {
+        k_spin_unlock(&g_flash_stats_lock, key);
+        return;
+    }
+    flash_stats_op_counters_t* const p_cnt = &p_area->ops[op];
+    p_cnt->num_ops += 1;
+    p_cnt->latency_hist[flash_stats_get_latency_bucket(latency_us)] += 1;
+    p_cnt->latency_max_us = MAX(p_cnt->latency_max_us, latency_us);
+    if (0 != rc)
+    {
+        p_cnt->num_errors += 1;
+    }
+    else
+    {
+        p_cnt->num_bytes += len;
+        if ((FLASH_STATS_OP_ERASE == op) && (NULL != p_area->p_sector_erase_cnt) && (0 != len))
+        {
+            const uint32_t sector_first = (uint32_t)off / FLASH_STATS_SECTOR_SIZE;
+            const uint32_t sector_last  = ((uint32_t)off + len - 1) / FLASH_STATS_SECTOR_SIZE;
+            for (uint32_t i = sector_first; (i <= sector_last) && (i < p_area->num_sectors); ++i)
+            {
+                p_area->p_sector_erase_cnt[i] += 1;
+#if USE_FLASH_STATS_MCUMGR
+                p_area->stats.sector_erase_max = MAX(p_area->stats.sector_erase_max, p_area->p_sector_erase_cnt[i]);
+#endif
+            }
+            p_area->is_erase_cnt_dirty = true;
+        }
+    }
+#if USE_FLASH_STATS_MCUMGR
+    flash_stats_update_mcumgr(p_area, op, len, rc);
+#endif
+    k_spin_unlock(&g_flash_stats_lock, key);
+#else
+    ARG_UNUSED(p_fa);
+    ARG_UNUSED(op);
+    ARG_UNUSED(off);
+    ARG_UNUSED(len);
+    ARG_UNUSED(latency_us);
+    ARG_UNUSED(rc);
+#endif
+}
+
+bool
+flash_stats_get_snapshot(const uint32_t idx, flash_stats_snapshot_t* const p_snapshot)
+{
+#if USE_FLASH_STATS
+    k_spinlock_key_t key = k_spin_lock(&g_flash_stats_lock);
+    if (idx >= g_flash_stats.num_areas)
+    {
+        k_spin_unlock(&g_flash_stats_lock, key);
+        return false;
+    }
+    const flash_stats_area_t* const p_area = &g_flash_stats.areas[idx];
+    p_snapshot->fa_id                      = p_area->p_fa->fa_id;
+    p_snapshot->num_sectors                = p_area->num_sectors;
+    p_snapshot->is_erase_cnt_tracked       = (NULL != p_area->p_sector_erase_cnt);
+    flash_stats_get_erase_cnt_range(
+        p_area,
+        &p_snapshot->sector_erase_cnt_min,
+        &p_snapshot->sector_erase_cnt_max,
+        &p_snapshot->sector_erase_cnt_sum);
+    memcpy(p_snapshot->ops, p_area->ops, sizeof(p_snapshot->ops));
+    k_spin_unlock(&g_flash_stats_lock, key);
+    return true;
+#else
+    ARG_UNUSED(idx);
+    ARG_UNUSED(p_snapshot);
+    return false;
+#endif
+}
+
+uint32_t
+flash_stats_get_sector_erase_cnt(const uint8_t fa_id, const uint32_t sector_idx)
+{
+    uint32_t erase_cnt = UINT32_MAX;
+#if USE_FLASH_STATS
+    k_spinlock_key_t key = k_spin_lock(&g_flash_stats_lock);
+    for (uint32_t i = 0; i < g_flash_stats.num_areas; ++i)
+    {
+        const flash_stats_area_t* const p_area = &g_flash_stats.areas[i];
+        if ((p_area->p_fa->fa_id == fa_id) && (NULL != p_area->p_sector_erase_cnt)
+            && (sector_idx < p_area->num_sectors))
+        {
+            erase_cnt = p_area->p_sector_erase_cnt[sector_idx];
+            break;
+        }
+    }
+    k_spin_unlock(&g_flash_stats_lock, key);
+#else
+    ARG_UNUSED(fa_id);
+    ARG_UNUSED(sector_idx);
+#endif
+    return erase_cnt;
+}
+
+bool
+flash_stats_save(void)
+{
+    bool res = true;
+#if USE_FLASH_STATS
+    for (uint32_t i = 0; i < FLASH_STATS_NUM_AREAS; ++i)
+    {
+        k_spinlock_key_t key = k_spin_lock(&g_flash_stats_lock);
+        if (i >= g_flash_stats.num_areas)
+        {
+            k_spin_unlock(&g_flash_stats_lock, key);
+            break;
+        }
+        flash_stats_area_t* const p_area   = &g_flash_stats.areas[i];
+        const bool                is_dirty = p_area->is_erase_cnt_dirty;
+        p_area->is_erase_cnt_dirty         = false;
+        k_spin_unlock(&g_flash_stats_lock, key);
+        if (!is_dirty)
+        {
+            continue;
+        }
+        char key_name[FLASH_STATS_SETTINGS_KEY_LEN];
+        (void)snprintf(
+            key_name,
+            sizeof(key_name),
+            "%s/%u",
+            FLASH_STATS_SETTINGS_SUBTREE,
+            (unsigned)p_area->p_fa->fa_id);
+        // The counters are saved without the lock, an erase which happens during the save is saved next time
+        const zephyr_api_ret_t rc
+            = settings_save_one(key_name, p_area->p_sector_erase_cnt, p_area->num_sectors * sizeof(uint32_t));
+        if (0 != rc)
+        {
+            TLOG_ERR("settings_save_one failed for \"%s\", rc=%d", key_name, rc);
+            key                        = k_spin_lock(&g_flash_stats_lock);
+            p_area->is_erase_cnt_dirty = true;
+            k_spin_unlock(&g_flash_stats_lock, key);
+            res = false;
+        }
+    }
+#endif
+    return res;
+}
+
+void
+flash_stats_reset(void)
+{
+#if USE_FLASH_STATS
+    k_spinlock_key_t key = k_spin_lock(&g_flash_stats_lock);
+    for (uint32_t i = 0; i < g_flash_stats.num_areas; ++i)
+    {
+        flash_stats_area_t* const p_area = &g_flash_stats.areas[i];
+        memset(p_area->ops, 0, sizeof(p_area->ops));
+#if USE_FLASH_STATS_MCUMGR
+        (void)stats_reset(&p_area->stats.s_hdr);
+#endif
+    }
+    k_spin_unlock(&g_flash_stats_lock, key);
+#endif
+}
+
+#if defined(TEST)
+void
+flash_stats_deinit(void)
+{
+#if USE_FLASH_STATS
+    (void)k_work_cancel_delayable(&g_flash_stats_save_work);
+    k_spinlock_key_t key = k_spin_lock(&g_flash_stats_lock);
+    memset(&g_flash_stats, 0, sizeof(g_flash_stats));
+    k_spin_unlock(&g_flash_stats_lock, key);
+#endif
+}
+#endif
+
+#if USE_FLASH_STATS
+
+/*
+ * The wrappers are linked instead of flash_area_read/write/erase/flatten with "-Wl,--wrap=...",
+ * so the operations of FCB, LittleFS and MCUboot image management are counted without changing their code.
+ */
+
+static uint32_t
+flash_stats_get_latency_us(const uint32_t cycle_start)
+{
+    return (uint32_t)k_cyc_to_us_floor64((uint64_t)(k_cycle_get_32() - cycle_start));
+}
+
+extern int
+__real_flash_area_read(const struct flash_area* p_fa, off_t off, void* p_dst, size_t len); // NOSONAR
+
+extern int
+__real_flash_area_write(const struct flash_area* p_fa, off_t off, const void* p_src, size_t len); // NOSONAR
+
+extern int
+__real_flash_area_erase(const struct flash_area* p_fa, off_t off, size_t len); // NOSONAR
+
+extern int
+__real_flash_area_flatten(const struct flash_area* p_fa, off_t off, size_t len); // NOSONAR
+
+int
+__wrap_flash_area_read(const struct flash_area* p_fa, off_t off, void* p_dst, size_t len) // NOSONAR
+{
+    const uint32_t cycle_start = k_cycle_get_32();
+    const int      rc          = __real_flash_area_read(p_fa, off, p_dst, len);
+    flash_stats_on_op(p_fa, FLASH_STATS_OP_READ, off, len, flash_stats_get_latency_us(cycle_start), rc);
+    return rc;
+}
+
+int
+__wrap_flash_area_write(const struct flash_area* p_fa, off_t off, const void* p_src, size_t len) // NOSONAR
+{
+    const uint32_t cycle_start = k_cycle_get_32();
+    const int      rc          = __real_flash_area_write(p_fa, off, p_src, len);
+    flash_stats_on_op(p_fa, FLASH_STATS_OP_WRITE, off, len, flash_stats_get_latency_us(cycle_start), rc);
+    return rc;
+}
+
+int
+__wrap_flash_area_erase(const struct flash_area* p_fa, off_t off, size_t len) // NOSONAR
+{
+    const uint32_t cycle_start = k_cycle_get_32();
+    const int      rc          = __real_flash_area_erase(p_fa, off, len);
+    flash_stats_on_op(p_fa, FLASH_STATS_OP_ERASE, off, len, flash_stats_get_latency_us(cycle_start), rc);
+    return rc;
+}
+
+int
+__wrap_flash_area_flatten(const struct flash_area* p_fa, off_t off, size_t len) // NOSONAR
+{
+    const uint32_t cycle_start = k_cycle_get_32();
+    const int      rc          = __real_flash_area_flatten(p_fa, off, len);
+    flash_stats_on_op(p_fa, FLASH_STATS_OP_ERASE, off, len, flash_stats_get_latency_us(cycle_start), rc);
+    return rc;
+}
+
+#endif // USE_FLASH_STATS
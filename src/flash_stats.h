@@ -0,0 +1,111 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef FLASH_STATS_H
+#define FLASH_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/storage/flash_map.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLASH_STATS_SECTOR_SIZE (4U * 1024U)
+
+// Bucket i counts the operations with the latency in [2^i, 2^(i+1)) us, the last bucket counts the slower ones
+#define FLASH_STATS_NUM_LATENCY_BUCKETS (18U)
+
+typedef enum flash_stats_op_e
+{
+    FLASH_STATS_OP_READ  = 0,
+    FLASH_STATS_OP_WRITE = 1,
+    FLASH_STATS_OP_ERASE = 2, //!< flash_area_erase and flash_area_flatten
+    FLASH_STATS_NUM_OPS,
+} flash_stats_op_e;
+
+typedef struct flash_stats_op_counters_t
+{
+    uint32_t num_ops;
+    uint32_t num_errors;
+    uint64_t num_bytes;
+    uint32_t latency_max_us;
+    uint32_t latency_hist[FLASH_STATS_NUM_LATENCY_BUCKETS];
+} flash_stats_op_counters_t;
+
+/**
+ * @brief Statistics of a flash area since boot, plus the erase counts of its sectors since they were first tracked.
+ */
+typedef struct flash_stats_snapshot_t
+{
+    uint8_t                   fa_id;
+    uint32_t                  num_sectors;
+    bool                      is_erase_cnt_tracked; //!< false if the pool of the per-sector counters is exhausted
+    uint32_t                  sector_erase_cnt_min;
+    uint32_t                  sector_erase_cnt_max;
+    uint32_t                  sector_erase_cnt_sum;
+    flash_stats_op_counters_t ops[FLASH_STATS_NUM_OPS];
+} flash_stats_snapshot_t;
+
+/**
+ * @brief Load the persisted per-sector erase counts and start their periodic saving.
+ * @details It must be called after settings are initialized and before the flash areas are erased,
+ * because the loaded erase counts replace the ones counted in RAM.
+ */
+void
+flash_stats_init(void);
+
+/**
+ * @brief Account a flash operation.
+ * @details It is called by the wrappers of flash_area_read/write/erase/flatten.
+ */
+void
+flash_stats_on_op(
+    const struct flash_area* const p_fa,
+    const flash_stats_op_e         op,
+    const off_t                    off,
+    const size_t                   len,
+    const uint32_t                 latency_us,
+    const int                      rc);
+
+/**
+ * @brief Get a copy of the statistics of the idx-th flash area in the order of the first access.
+ * @return false if idx is out of range.
+ */
+bool
+flash_stats_get_snapshot(const uint32_t idx, flash_stats_snapshot_t* const p_snapshot);
+
+/**
+ * @brief Get the erase count of the sector of the flash area.
+ * @return UINT32_MAX if the flash area is not tracked or the sector is out of range.
+ */
+uint32_t
+flash_stats_get_sector_erase_cnt(const uint8_t fa_id, const uint32_t sector_idx);
+
+/**
+ * @brief Save the per-sector erase counts of the flash areas erased since the previous save.
+ */
+bool
+flash_stats_save(void);
+
+/**
+ * @brief Clear the counters since boot, the per-sector erase counts are kept.
+ */
+void
+flash_stats_reset(void);
+
+#if defined(TEST)
+/**
+ * @brief Forget all the flash areas, including the erase counts in RAM, as if the device was rebooted.
+ */
+void
+flash_stats_deinit(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLASH_STATS_H
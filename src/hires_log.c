@@ -0,0 +1,357 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hires_log.h"
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include "tlog.h"
+
+LOG_MODULE_REGISTER(hires_log, LOG_LEVEL_INF);
+
+#define USE_HIRES_LOG (1 && IS_ENABLED(CONFIG_RUUVI_AIR_HIRES_LOG))
+
+#define HIRES_LOG_VARINT_MAX_LEN     (5U)
+#define HIRES_LOG_VARINT_DATA_BITS   (7U)
+#define HIRES_LOG_VARINT_DATA_MASK   (0x7FU)
+#define HIRES_LOG_VARINT_FLAG_CONT   (0x80U)
+#define HIRES_LOG_MASK_BIT_TIME_STEP (1U << HIRES_LOG_NUM_FIELDS)
+
+// Change mask, time step and the deltas of all the fields
+#define HIRES_LOG_SAMPLE_MAX_LEN ((2U + HIRES_LOG_NUM_FIELDS) * HIRES_LOG_VARINT_MAX_LEN)
+
+#define HIRES_LOG_SOUND_DB_MULTIPLIER (10.0f)
+
+#if USE_HIRES_LOG
+
+#define HIRES_LOG_NUM_BLOCKS (CONFIG_RUUVI_AIR_HIRES_LOG_SIZE / sizeof(hires_log_block_t))
+_Static_assert(HIRES_LOG_NUM_BLOCKS >= 2, "CONFIG_RUUVI_AIR_HIRES_LOG_SIZE is too small");
+
+typedef struct hires_log_t
+{
+    uint32_t           block_seq_first; //!< Sequence number of the oldest block
+    uint32_t           block_seq_end;   //!< Sequence number after the newest block
+    hires_log_sample_t prev;            //!< The last sample of the newest block, it is used to encode the next one
+    hires_log_block_t  blocks[HIRES_LOG_NUM_BLOCKS];
+} hires_log_t;
+
+static hires_log_t g_hires_log;
+
+K_MUTEX_DEFINE(g_hires_log_mutex);
+
+#endif // USE_HIRES_LOG
+
+static int32_t
+hires_log_zigzag_decode(const uint32_t val)
+{
+    return (int32_t)((val >> 1U) ^ (~(val & 1U) + 1U));
+}
+
+static bool
+hires_log_varint_decode(hires_log_decoder_t* const p_decoder, uint32_t* const p_val)
+{
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < HIRES_LOG_VARINT_MAX_LEN; ++i)
+    {
+        if (p_decoder->offset >= p_decoder->p_block->len)
+        {
+            return false;
+        }
+        const uint8_t byte = p_decoder->p_block->buf[p_decoder->offset++];
+        val |= (uint32_t)(byte & HIRES_LOG_VARINT_DATA_MASK) << (i * HIRES_LOG_VARINT_DATA_BITS);
+        if (0 == (byte & HIRES_LOG_VARINT_FLAG_CONT))
+        {
+            *p_val = val;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief The start state of the encoder/decoder of the block.
+ */
+static hires_log_sample_t
+hires_log_block_start_state(const uint32_t timestamp_first)
+{
+    hires_log_sample_t prev = { 0 };
+    prev.timestamp          = timestamp_first - 1U;
+    return prev;
+}
+
+#if USE_HIRES_LOG
+static uint32_t
+hires_log_zigzag_encode(const int32_t val)
+{
+    return ((uint32_t)val << 1U) ^ (uint32_t)(val >> 31); // NOSONAR: arithmetic shift is intended
+}
+
+static uint32_t
+hires_log_varint_encode(uint8_t* const p_buf, uint32_t val)
+{
+    uint32_t len = 0;
+    while (val > HIRES_LOG_VARINT_DATA_MASK)
+    {
+        p_buf[len++] = (uint8_t)((val & HIRES_LOG_VARINT_DATA_MASK) | HIRES_LOG_VARINT_FLAG_CONT);
+        val >>= HIRES_LOG_VARINT_DATA_BITS;
+    }
+    p_buf[len++] = (uint8_t)val;
+    return len;
+}
+
+static uint32_t
+hires_log_encode_sample(
+    uint8_t* const                  p_buf,
+    const hires_log_sample_t* const p_prev,
+    const hires_log_sample_t* const p_cur)
+{
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < HIRES_LOG_NUM_FIELDS; ++i)
+    {
+        if (p_cur->values[i] != p_prev->values[i])
+        {
+            mask |= 1U << i;
+        }
+    }
+    const int32_t time_step = (int32_t)(p_cur->timestamp - p_prev->timestamp);
+    if (1 != time_step)
+    {
+        mask |= HIRES_LOG_MASK_BIT_TIME_STEP;
+    }
+    uint32_t len = hires_log_varint_encode(p_buf, mask);
+    if (0 != (mask & HIRES_LOG_MASK_BIT_TIME_STEP))
+    {
+        len += hires_log_varint_encode(&p_buf[len], hires_log_zigzag_encode(time_step));
+    }
+    for (uint32_t i = 0; i < HIRES_LOG_NUM_FIELDS; ++i)
+    {
+        if (0 != (mask & (1U << i)))
+        {
+            // The delta is calculated modulo 2^32, so the jumps to/from HIRES_LOG_INVALID_VALUE do not overflow
+            const int32_t delta = (int32_t)((uint32_t)p_cur->values[i] - (uint32_t)p_prev->values[i]);
+            len += hires_log_varint_encode(&p_buf[len], hires_log_zigzag_encode(delta));
+        }
+    }
+    return len;
+}
+#endif // USE_HIRES_LOG
+
+static int32_t
+hires_log_conv_float(const float32_t val, const float32_t multiplier)
+{
+    if ((bool)isnan(val))
+    {
+        return HIRES_LOG_INVALID_VALUE;
+    }
+    return (int32_t)lrintf(val * multiplier);
+}
+
+hires_log_sample_t
+hires_log_conv_measurement(const uint32_t timestamp, const sensors_measurement_t* const p_measurement)
+{
+    const float32_t sound_mul = HIRES_LOG_SOUND_DB_MULTIPLIER;
+    return (hires_log_sample_t) {
+        .timestamp = timestamp,
+        .values = {
+            [HIRES_LOG_FIELD_SOUND_INST_DBA]    = hires_log_conv_float(p_measurement->sound_inst_dba, sound_mul),
+            [HIRES_LOG_FIELD_SOUND_AVG_DBA]     = hires_log_conv_float(p_measurement->sound_avg_dba, sound_mul),
+            [HIRES_LOG_FIELD_SOUND_PEAK_SPL_DB] = hires_log_conv_float(p_measurement->sound_peak_spl_db, sound_mul),
+            [HIRES_LOG_FIELD_PRESSURE]          = hires_log_conv_float(p_measurement->dps310_pressure, 1.0f),
+            [HIRES_LOG_FIELD_LUMINOSITY]        = hires_log_conv_float(p_measurement->luminosity, 1.0f),
+            [HIRES_LOG_FIELD_TEMPERATURE]       = p_measurement->sen66.ambient_temperature,
+            [HIRES_LOG_FIELD_HUMIDITY]          = p_measurement->sen66.ambient_humidity,
+            [HIRES_LOG_FIELD_CO2]               = p_measurement->sen66.co2,
+            [HIRES_LOG_FIELD_VOC]               = p_measurement->sen66.voc_index,
+            [HIRES_LOG_FIELD_NOX]               = p_measurement->sen66.nox_index,
+            [HIRES_LOG_FIELD_PM1P0]             = p_measurement->sen66.mass_concentration_pm1p0,
+            [HIRES_LOG_FIELD_PM2P5]             = p_measurement->sen66.mass_concentration_pm2p5,
+            [HIRES_LOG_FIELD_PM4P0]             = p_measurement->sen66.mass_concentration_pm4p0,
+            [HIRES_LOG_FIELD_PM10P0]            = p_measurement->sen66.mass_concentration_pm10p0,
+        },
+    };
+}
+
+void
+hires_log_init(void)
+{
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    g_hires_log.block_seq_first = 0;
+    g_hires_log.block_seq_end   = 0;
+    k_mutex_unlock(&g_hires_log_mutex);
+    TLOG_INF(
+        "hires_log: %u blocks of %u bytes",
+        (unsigned)HIRES_LOG_NUM_BLOCKS,
+        (unsigned)sizeof(hires_log_block_t));
+#endif
+}
+
+#if USE_HIRES_LOG
+static hires_log_block_t*
+hires_log_get_block(const uint32_t block_seq)
+{
+    return &g_hires_log.blocks[block_seq % HIRES_LOG_NUM_BLOCKS];
+}
+
+static hires_log_block_t*
+hires_log_start_block(const uint32_t timestamp)
+{
+    if ((g_hires_log.block_seq_end - g_hires_log.block_seq_first) >= HIRES_LOG_NUM_BLOCKS)
+    {
+        g_hires_log.block_seq_first += 1;
+    }
+    hires_log_block_t* const p_block = hires_log_get_block(g_hires_log.block_seq_end);
+    g_hires_log.block_seq_end += 1;
+    p_block->timestamp_first = timestamp;
+    p_block->num_samples     = 0;
+    p_block->len             = 0;
+    g_hires_log.prev         = hires_log_block_start_state(timestamp);
+    return p_block;
+}
+#endif
+
+void
+hires_log_append(const hires_log_sample_t* const p_sample)
+{
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    hires_log_block_t* p_block = (g_hires_log.block_seq_end != g_hires_log.block_seq_first)
+                                     ? hires_log_get_block(g_hires_log.block_seq_end - 1U)
+                                     : hires_log_start_block(p_sample->timestamp);
+    uint8_t  buf[HIRES_LOG_SAMPLE_MAX_LEN];
+    uint32_t len = hires_log_encode_sample(buf, &g_hires_log.prev, p_sample);
+    if ((p_block->len + len) > HIRES_LOG_BLOCK_SIZE)
+    {
+        p_block = hires_log_start_block(p_sample->timestamp);
+        len     = hires_log_encode_sample(buf, &g_hires_log.prev, p_sample);
+    }
+    memcpy(&p_block->buf[p_block->len], buf, len);
+    p_block->len += (uint16_t)len;
+    p_block->num_samples += 1;
+    g_hires_log.prev = *p_sample;
+    k_mutex_unlock(&g_hires_log_mutex);
+#endif
+}
+
+void
+hires_log_get_block_range(uint32_t* const p_block_seq_first, uint32_t* const p_block_seq_end)
+{
+    *p_block_seq_first = 0;
+    *p_block_seq_end   = 0;
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    *p_block_seq_first = g_hires_log.block_seq_first;
+    *p_block_seq_end   = g_hires_log.block_seq_end;
+    k_mutex_unlock(&g_hires_log_mutex);
+#endif
+}
+
+uint32_t
+hires_log_find_block(const uint32_t timestamp)
+{
+    uint32_t block_seq = 0;
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    block_seq = g_hires_log.block_seq_first;
+    for (uint32_t seq = g_hires_log.block_seq_first + 1U; seq < g_hires_log.block_seq_end; ++seq)
+    {
+        if (hires_log_get_block(seq)->timestamp_first > timestamp)
+        {
+            break;
+        }
+        block_seq = seq;
+    }
+    k_mutex_unlock(&g_hires_log_mutex);
+#endif
+    return block_seq;
+}
+
+bool
+hires_log_read_block(const uint32_t block_seq, hires_log_block_t* const p_block)
+{
+    bool res = false;
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    if ((block_seq >= g_hires_log.block_seq_first) && (block_seq < g_hires_log.block_seq_end))
+    {
+        *p_block = *hires_log_get_block(block_seq);
+        res      = true;
+    }
+    k_mutex_unlock(&g_hires_log_mutex);
+#else
+    ARG_UNUSED(block_seq);
+    ARG_UNUSED(p_block);
+#endif
+    return res;
+}
+
+void
+hires_log_decoder_init(hires_log_decoder_t* const p_decoder, const hires_log_block_t* const p_block)
+{
+    p_decoder->p_block    = p_block;
+    p_decoder->offset     = 0;
+    p_decoder->sample_idx = 0;
+    p_decoder->prev       = hires_log_block_start_state(p_block->timestamp_first);
+}
+
+bool
+hires_log_decoder_next(hires_log_decoder_t* const p_decoder, hires_log_sample_t* const p_sample)
+{
+    if (p_decoder->sample_idx >= p_decoder->p_block->num_samples)
+    {
+        return false;
+    }
+    uint32_t mask = 0;
+    if (!hires_log_varint_decode(p_decoder, &mask))
+    {
+        return false;
+    }
+    hires_log_sample_t sample = p_decoder->prev;
+    sample.timestamp += 1U;
+    if (0 != (mask & HIRES_LOG_MASK_BIT_TIME_STEP))
+    {
+        uint32_t time_step = 0;
+        if (!hires_log_varint_decode(p_decoder, &time_step))
+        {
+            return false;
+        }
+        sample.timestamp = p_decoder->prev.timestamp + (uint32_t)hires_log_zigzag_decode(time_step);
+    }
+    for (uint32_t i = 0; i < HIRES_LOG_NUM_FIELDS; ++i)
+    {
+        if (0 == (mask & (1U << i)))
+        {
+            continue;
+        }
+        uint32_t delta = 0;
+        if (!hires_log_varint_decode(p_decoder, &delta))
+        {
+            return false;
+        }
+        sample.values[i] = (int32_t)((uint32_t)sample.values[i] + (uint32_t)hires_log_zigzag_decode(delta));
+    }
+    p_decoder->prev = sample;
+    p_decoder->sample_idx += 1;
+    *p_sample = sample;
+    return true;
+}
+
+hires_log_stats_t
+hires_log_get_stats(void)
+{
+    hires_log_stats_t stats = { 0 };
+#if USE_HIRES_LOG
+    k_mutex_lock(&g_hires_log_mutex, K_FOREVER);
+    stats.num_blocks     = g_hires_log.block_seq_end - g_hires_log.block_seq_first;
+    stats.max_num_blocks = HIRES_LOG_NUM_BLOCKS;
+    for (uint32_t seq = g_hires_log.block_seq_first; seq < g_hires_log.block_seq_end; ++seq)
+    {
+        const hires_log_block_t* const p_block = hires_log_get_block(seq);
+        stats.num_samples += p_block->num_samples;
+        stats.num_bytes += p_block->len;
+    }
+    k_mutex_unlock(&g_hires_log_mutex);
+#endif
+    return stats;
+}
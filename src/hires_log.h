@@ -0,0 +1,147 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef HIRES_LOG_H
+#define HIRES_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensors.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fields of the high-resolution samples.
+ * @details The values are stored in fixed-point units: the raw units of SEN66, Pa for the pressure,
+ * lux for the luminosity and 0.1 dB for the sound levels. The order is a part of the format of the blocks
+ * sent over NUS, the fields which change most often are placed first, so that their bits in the change mask
+ * fit into the first byte of the varint.
+ */
+typedef enum hires_log_field_e
+{
+    HIRES_LOG_FIELD_SOUND_INST_DBA    = 0,
+    HIRES_LOG_FIELD_SOUND_AVG_DBA     = 1,
+    HIRES_LOG_FIELD_SOUND_PEAK_SPL_DB = 2,
+    HIRES_LOG_FIELD_PRESSURE          = 3,
+    HIRES_LOG_FIELD_LUMINOSITY        = 4,
+    HIRES_LOG_FIELD_TEMPERATURE       = 5,
+    HIRES_LOG_FIELD_HUMIDITY          = 6,
+    HIRES_LOG_FIELD_CO2               = 7,
+    HIRES_LOG_FIELD_VOC               = 8,
+    HIRES_LOG_FIELD_NOX               = 9,
+    HIRES_LOG_FIELD_PM1P0             = 10,
+    HIRES_LOG_FIELD_PM2P5             = 11,
+    HIRES_LOG_FIELD_PM4P0             = 12,
+    HIRES_LOG_FIELD_PM10P0            = 13,
+} hires_log_field_e;
+
+#define HIRES_LOG_NUM_FIELDS (14U)
+
+/**
+ * The value of the float fields (pressure, luminosity and sound) which are not available (NaN),
+ * the SEN66 fields keep their own invalid raw values.
+ */
+#define HIRES_LOG_INVALID_VALUE (INT32_MIN)
+
+/**
+ * Size of the encoded data of one block, it is chosen so that the block with its header fits into one NUS packet.
+ */
+#define HIRES_LOG_BLOCK_SIZE (232U)
+
+typedef struct hires_log_sample_t
+{
+    uint32_t timestamp;
+    int32_t  values[HIRES_LOG_NUM_FIELDS];
+} hires_log_sample_t;
+
+/**
+ * @brief Block of the delta-encoded samples.
+ * @details Every sample is encoded as the varint change mask (bit i is set if field i changed,
+ * bit HIRES_LOG_NUM_FIELDS is set if the time step is not 1 second), followed by the zigzag varint
+ * of the time step (if it is not 1 second) and the zigzag varints of the deltas of the changed fields.
+ * The first sample of the block is encoded relative to zero values and timestamp_first - 1,
+ * so every block can be decoded independently of the others.
+ */
+typedef struct hires_log_block_t
+{
+    uint32_t timestamp_first;
+    uint16_t num_samples;
+    uint16_t len;
+    uint8_t  buf[HIRES_LOG_BLOCK_SIZE];
+} hires_log_block_t;
+
+typedef struct hires_log_decoder_t
+{
+    const hires_log_block_t* p_block;
+    uint32_t                 offset;
+    uint32_t                 sample_idx;
+    hires_log_sample_t       prev;
+} hires_log_decoder_t;
+
+typedef struct hires_log_stats_t
+{
+    uint32_t num_blocks;     //!< Number of blocks in use
+    uint32_t max_num_blocks; //!< Number of blocks which fit into CONFIG_RUUVI_AIR_HIRES_LOG_SIZE
+    uint32_t num_samples;
+    uint32_t num_bytes; //!< Size of the encoded samples
+} hires_log_stats_t;
+
+void
+hires_log_init(void);
+
+/**
+ * @brief Convert the measurement to the fixed-point sample.
+ */
+hires_log_sample_t
+hires_log_conv_measurement(const uint32_t timestamp, const sensors_measurement_t* const p_measurement);
+
+/**
+ * @brief Append the sample, if the buffer is full, the oldest block is dropped.
+ */
+void
+hires_log_append(const hires_log_sample_t* const p_sample);
+
+/**
+ * @brief Get the range of the sequence numbers of the blocks in the buffer.
+ * @param[out] p_block_seq_first Sequence number of the oldest block.
+ * @param[out] p_block_seq_end Sequence number after the newest block (the newest block is still being filled).
+ */
+void
+hires_log_get_block_range(uint32_t* const p_block_seq_first, uint32_t* const p_block_seq_end);
+
+/**
+ * @brief Find the block which contains the samples starting from the timestamp.
+ * @return Sequence number of the newest block which starts at or before the timestamp,
+ * or the oldest block if the timestamp is before it.
+ */
+uint32_t
+hires_log_find_block(const uint32_t timestamp);
+
+/**
+ * @brief Copy the block.
+ * @return false if the block was already dropped or it does not exist yet.
+ */
+bool
+hires_log_read_block(const uint32_t block_seq, hires_log_block_t* const p_block);
+
+void
+hires_log_decoder_init(hires_log_decoder_t* const p_decoder, const hires_log_block_t* const p_block);
+
+/**
+ * @brief Decode the next sample of the block.
+ * @return false if there are no more samples or the block is corrupted.
+ */
+bool
+hires_log_decoder_next(hires_log_decoder_t* const p_decoder, hires_log_sample_t* const p_sample);
+
+hires_log_stats_t
+hires_log_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIRES_LOG_H
@@ -3,12 +3,17 @@
  */
 
 #include "hist_log.h"
+#include "hist_log_codec.h"
+#include "hist_log_rollup.h"
+#include "hist_log_zone_map.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/drivers/flash.h>
 #include <zephyr/fs/fcb.h>
+#include <zephyr/settings/settings.h>
 #include <zephyr/sys/crc.h>
 #include "tlog.h"
 #include "utils.h"
@@ -16,11 +21,15 @@
 #include "app_rtc.h"
 #include "sys_utils.h"
 #include "zephyr_api.h"
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_MAPPED_READ) && IS_ENABLED(CONFIG_FLASH_SIMULATOR)
+#include <zephyr/drivers/flash/flash_simulator.h>
+#endif
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_MAPPED_READ) && IS_ENABLED(CONFIG_NORDIC_QSPI_NOR)
+#include <zephyr/drivers/flash/nrf_qspi_nor.h>
+#endif
 
 LOG_MODULE_REGISTER(hist_log, LOG_LEVEL_INF);
 
-#define CRC16_CCITT_INITIAL_VALUE (0xFFFFU)
-
 #define HIST_LOG_MAX_READ_ERR_PRINT_CNT (10U)
 
 #define USE_HIST_LOG (1 && IS_ENABLED(CONFIG_RUUVI_AIR_ENABLE_HIST_LOG))
@@ -34,33 +43,605 @@ LOG_MODULE_REGISTER(hist_log, LOG_LEVEL_INF);
 #if USE_HIST_LOG
 
 #define HIST_LOG_PARTITION_LABEL hist_storage
-#define HIST_LOG_PARTITION_SIZE  PM_HIST_STORAGE_SIZE
+#if defined(PM_HIST_STORAGE_SIZE)
+#define HIST_LOG_PARTITION_SIZE PM_HIST_STORAGE_SIZE
+#else
+// Partition Manager is not used for native_sim tests, the partition is defined in the devicetree overlay
+#define HIST_LOG_PARTITION_SIZE DT_REG_SIZE(DT_NODELABEL(HIST_LOG_PARTITION_LABEL))
+#endif
 
 #define HIST_LOG_FLASH_AREA_ID     FLASH_AREA_ID(HIST_LOG_PARTITION_LABEL)
 #define HIST_LOG_FLASH_SECTOR_SIZE (4U * 1024U)
 #define HIST_LOG_NUM_SECTORS       (HIST_LOG_PARTITION_SIZE / HIST_LOG_FLASH_SECTOR_SIZE)
 
-static struct flash_sector g_hist_log_sectors[HIST_LOG_NUM_SECTORS];
+// The partition is split into the regions of the tiers, the 5-minute tier takes the remaining sectors
+#define HIST_LOG_TIER_1HOUR_NUM_SECTORS (CONFIG_RUUVI_AIR_HIST_LOG_TIER_1HOUR_NUM_SECTORS)
+#define HIST_LOG_TIER_1DAY_NUM_SECTORS  (CONFIG_RUUVI_AIR_HIST_LOG_TIER_1DAY_NUM_SECTORS)
+#define HIST_LOG_TIER_5MIN_NUM_SECTORS \
+    (HIST_LOG_NUM_SECTORS - HIST_LOG_TIER_1HOUR_NUM_SECTORS - HIST_LOG_TIER_1DAY_NUM_SECTORS)
+// FCB needs at least one sector with data and one scratch sector
+_Static_assert(HIST_LOG_TIER_5MIN_NUM_SECTORS >= 2, "Not enough sectors for the 5-minute tier");
+
+#define HIST_LOG_TIER_1HOUR_PERIOD_SECONDS (60U * 60U)
+#define HIST_LOG_TIER_1DAY_PERIOD_SECONDS  (24U * HIST_LOG_TIER_1HOUR_PERIOD_SECONDS)
+
+#define HIST_LOG_FCB_LEN_FIELD_SHORT_MAX (0x7FU)
+#define HIST_LOG_FCB_LEN_FIELD_LONG_SIZE (2U)
+#define HIST_LOG_FCB_ENDMARKER_SIZE      (1U)
+#define HIST_LOG_FCB_SECTOR_HEADER_SIZE  (8U)    // sizeof(struct fcb_disk_area)
+#define HIST_LOG_FCB_FIXED_ENDMARKER     (0xABU) // FCB_FIXED_ENDMARKER, it is used instead of CRC8
+
+#define HIST_LOG_FLASH_PAGE_SIZE (256U)
+
+#define CRC16_CCITT_INITIAL_VALUE (0xFFFFU)
+#define HIST_LOG_ENTRY_CRC_SIZE   (sizeof(uint16_t))
+
+/**
+ * FCB entry contains one or more frames followed by CRC16 of the frames.
+ * The entry with the FCB length field and the end marker fits into one flash page.
+ */
+#define HIST_LOG_ENTRY_MAX_LEN \
+    (HIST_LOG_FLASH_PAGE_SIZE - HIST_LOG_FCB_LEN_FIELD_LONG_SIZE - HIST_LOG_FCB_ENDMARKER_SIZE)
+
+#define HIST_LOG_WRITE_BACK_NUM_RECORDS (CONFIG_RUUVI_AIR_HIST_LOG_WRITE_BACK_NUM_RECORDS)
+
+#define HIST_LOG_WRITE_BACK_MAX_LEN \
+    MIN((HIST_LOG_WRITE_BACK_NUM_RECORDS * HIST_LOG_CODEC_MAX_FRAME_LEN) + HIST_LOG_ENTRY_CRC_SIZE, \
+        HIST_LOG_ENTRY_MAX_LEN)
+
+#define HIST_LOG_NUM_CURSORS (CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS)
+// Number of records decoded at once by the newest-first cursor, one hour of the 5-minute records
+#define HIST_LOG_CURSOR_BLOCK_LEN (12U)
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD)
+#define HIST_LOG_READ_AHEAD_SIZE (CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD_SIZE)
+_Static_assert(HIST_LOG_READ_AHEAD_SIZE >= HIST_LOG_FLASH_PAGE_SIZE, "FCB entry must fit into the read-ahead buffer");
+#else
+#define HIST_LOG_READ_AHEAD_SIZE (0U)
+#endif
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_MAPPED_READ)
+#define HIST_LOG_MAPPED_READ (1)
+#else
+#define HIST_LOG_MAPPED_READ (0)
+#endif
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_CHECKPOINT)
+#define HIST_LOG_CHECKPOINT (1)
+#else
+#define HIST_LOG_CHECKPOINT (0)
+#endif
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS)
+#define HIST_LOG_KEEP_ON_RTC_LOSS (1)
+#else
+#define HIST_LOG_KEEP_ON_RTC_LOSS (0)
+#endif
+
+// When the table is full, the oldest epoch is dropped and its records are read with the timestamps of its local clock
+#define HIST_LOG_MAX_EPOCHS (8U)
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_CACHE)
+#define HIST_LOG_CACHE_NUM_RECORDS (CONFIG_RUUVI_AIR_HIST_LOG_CACHE_NUM_RECORDS)
+#else
+#define HIST_LOG_CACHE_NUM_RECORDS (0U)
+#endif
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE)
+#define HIST_LOG_PRE_ERASE            (1)
+#define HIST_LOG_PRE_ERASE_STACK_SIZE (CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE_STACK_SIZE)
+#else
+#define HIST_LOG_PRE_ERASE (0)
+#endif
+
+// The oldest sector is erased in advance when the free space in the active sector is less than this number
+// of the longest entries, so the work queue has time to run before the next entries fill the sector.
+#define HIST_LOG_PRE_ERASE_NUM_ENTRIES (2U)
+
+/**
+ * Rollup record is encoded as three frames: mean, min and max, each of them is delta-encoded separately.
+ * Rollup records are written to flash immediately, one record per FCB entry.
+ */
+#define HIST_LOG_ROLLUP_NUM_CHANNELS (3U)
+#define HIST_LOG_ROLLUP_ENTRY_MAX_LEN \
+    ((HIST_LOG_ROLLUP_NUM_CHANNELS * HIST_LOG_CODEC_MAX_FRAME_LEN) + HIST_LOG_ENTRY_CRC_SIZE)
+
+typedef enum hist_log_read_status_e
+{
+    HIST_LOG_READ_STATUS_OK        = 0,
+    HIST_LOG_READ_STATUS_ERR_FLASH = 1,
+    HIST_LOG_READ_STATUS_ERR_CODEC = 2,
+} hist_log_read_status_e;
+
+/**
+ * @brief Frames of one FCB entry, which are read from flash or taken from the write-back buffer.
+ */
+typedef struct hist_log_entry_t
+{
+    uint8_t buf[HIST_LOG_ENTRY_MAX_LEN];
+    //! Frames in the memory-mapped flash, NULL if they were copied to buf, see CONFIG_RUUVI_AIR_HIST_LOG_MAPPED_READ
+    const uint8_t* p_mapped;
+    size_t         len; //!< Length of the frames without CRC16
+    size_t         pos; //!< Position of the next frame
+} hist_log_entry_t;
+
+/**
+ * @brief Sequence of the delta-encoded records.
+ * @details The first record in every sector is a key frame, so that each sector can be decoded independently
+ * and erasing the oldest sector does not break the decoding of the remaining ones.
+ */
+typedef struct hist_log_stream_t
+{
+    //! Separate state for every channel (mean, min and max of the rollup records), the 5-minute records use only one
+    hist_log_codec_state_t     codec_state[HIST_LOG_ROLLUP_NUM_CHANNELS];
+    const struct flash_sector* p_sector; //!< Sector of the last encoded or decoded record
+} hist_log_stream_t;
+
+/**
+ * @brief Entry of the in-RAM sector directory.
+ * @details The directory keeps the time range of every FCB sector,
+ * so that hist_log_read_records() can skip the sectors which contain only records older than the requested time.
+ * The range of the sensor values allows the filtered cursor to skip the sectors without matching records.
+ */
+typedef struct hist_log_sector_dir_entry_t
+{
+    uint32_t            timestamp_first; //!< Timestamp of the first valid record in the sector
+    uint32_t            timestamp_last;  //!< Timestamp of the last valid record in the sector
+    uint32_t            seq_last;        //!< Sequence number of the last valid record in the sector
+    uint16_t            num_records;     //!< Number of valid records in the sector
+    bool                is_ordered;      //!< Timestamps of the records in the sector are non-decreasing
+    hist_log_zone_map_t zone_map;        //!< Range of the sensor values of the valid records in the sector
+} hist_log_sector_dir_entry_t;
+
+/**
+ * @brief Records which are encoded, but not yet written to flash.
+ * @details The records are written as a single FCB entry, which needs 3 program operations
+ * (the length field, the data and the end marker) regardless of the number of records in it.
+ */
+typedef struct hist_log_write_back_t
+{
+    hist_log_codec_state_t start_state; //!< Encoder state before the first buffered record
+    hist_log_codec_state_t codec_state; //!< Encoder state after the last buffered record
+    uint32_t               timestamps[HIST_LOG_WRITE_BACK_NUM_RECORDS];
+    uint32_t               seq_first; //!< Sequence number of the first buffered record, the others follow it
+    uint32_t               num_records;
+    hist_log_zone_map_t    zone_map; //!< Range of the sensor values of the buffered records
+    uint8_t                buf[HIST_LOG_WRITE_BACK_MAX_LEN];
+    size_t                 len; //!< Length of the encoded frames without CRC16
+} hist_log_write_back_t;
+
+/**
+ * @brief History tier, which is stored in its own region of the partition.
+ * @details Every tier has its own FCB with a separate set of sectors, so the retention of each tier is independent.
+ */
+typedef struct hist_log_tier_t
+{
+    struct fcb        fcb;
+    const char* const p_name;
+    const uint32_t    num_channels;  //!< Number of frames per record: 1 for the 5-minute tier, 3 for the rollups
+    const uint32_t    max_entry_len; //!< Maximum length of FCB entry in this tier
+    const uint32_t    period_s;
+    bool              sector_dir_is_ordered;
+    uint32_t          seq_next; //!< Sequence number of the next record, it continues from the newest record in flash
+    hist_log_stream_t encoder; //!< Encoder state after the last record written to flash
+    hist_log_rollup_t rollup;  //!< Accumulator of the records of the previous tier, unused for the 5-minute tier
+    //! Active sector at the moment of the last saved checkpoint, the checkpoint is saved again when it changes
+    const struct flash_sector* p_checkpoint_sector;
+} hist_log_tier_t;
+
+/**
+ * @brief FCB sector header, it has the same layout as struct fcb_disk_area, which is private to the FCB module.
+ */
+typedef struct hist_log_fcb_sector_hdr_t
+{
+    uint32_t magic;
+    uint8_t  version;
+    uint8_t  reserved;
+    uint16_t id;
+} hist_log_fcb_sector_hdr_t;
+
+_Static_assert(sizeof(hist_log_fcb_sector_hdr_t) == HIST_LOG_FCB_SECTOR_HEADER_SIZE, "Wrong FCB sector header size");
+
+typedef struct hist_log_checkpoint_tier_t
+{
+    uint16_t num_sectors;
+    uint16_t active_sector_idx; //!< Index of the active sector in g_hist_log_sectors
+    uint16_t active_sector_id;  //!< FCB id of the active sector, it is changed when the sector is erased and reused
+} hist_log_checkpoint_tier_t;
+
+/**
+ * @brief Copy of the sector directory, which is saved to settings, so that it does not need to be rebuilt on boot.
+ * @details The checkpoint is saved every time the active sector of a tier changes, so the directory entries
+ * of the sectors before the active one are final. FCB erases the sectors strictly in order starting from the oldest,
+ * so if the active sector of the checkpoint is still in use, the sectors between the oldest and it are unchanged
+ * and only the sectors starting from the active sector of the checkpoint have to be decoded on boot.
+ */
+typedef struct hist_log_checkpoint_t
+{
+    uint32_t                    version; //!< HIST_LOG_FCB_FMT_VERSION
+    uint32_t                    num_sectors;
+    hist_log_checkpoint_tier_t  tiers[HIST_LOG_NUM_TIERS];
+    hist_log_sector_dir_entry_t sector_dir[HIST_LOG_NUM_SECTORS];
+} hist_log_checkpoint_t;
+
+/**
+ * @brief Period between two RTC resets, during which the records are written with the timestamps of one local clock.
+ * @details The epoch is identified by the sequence numbers of its first records, which grow across the epochs,
+ * so the record format does not depend on it.
+ */
+typedef struct hist_log_epoch_t
+{
+    uint32_t seq_first[HIST_LOG_NUM_TIERS]; //!< Sequence number of the first record of the epoch in every tier
+    int32_t  time_offset_s;                 //!< Real time minus the local time
+    bool     is_time_offset_known;          //!< false after RTC loss until a client sends the real time
+} hist_log_epoch_t;
+
+typedef struct hist_log_epochs_t
+{
+    uint32_t         version; //!< HIST_LOG_FCB_FMT_VERSION
+    uint32_t         num_epochs;
+    hist_log_epoch_t epochs[HIST_LOG_MAX_EPOCHS]; //!< Starting from the oldest one, the last one is the current epoch
+} hist_log_epochs_t;
+
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+typedef struct hist_log_cache_record_t
+{
+    uint32_t               timestamp; //!< Timestamp of the local clock, as it is stored in flash
+    uint32_t               seq;       //!< 0 if the slot is empty
+    hist_log_record_data_t data;
+} hist_log_cache_record_t;
+
+/**
+ * @brief Copy of the newest 5-minute records in RAM.
+ * @details The record with sequence number seq is kept in the slot seq % HIST_LOG_CACHE_NUM_RECORDS,
+ * so the cache contains the records with seq_first <= seq < seq_end. A slot whose seq does not match
+ * belongs to a record which was lost (e.g. due to a flash write error) and is skipped by the readers.
+ */
+typedef struct hist_log_cache_t
+{
+    bool                    is_loaded; //!< The cache is filled from flash on boot, it is not used until then
+    uint32_t                seq_first;
+    uint32_t                seq_end;
+    hist_log_cache_record_t records[HIST_LOG_CACHE_NUM_RECORDS];
+} hist_log_cache_t;
+#endif
+
+/**
+ * @brief Chunk of the sector which is loaded into RAM to parse the FCB entries without small flash reads.
+ * @details Every small read of the external SPI flash pays the overhead of the command and the address,
+ * so the entry headers, the end markers and the data are read from the buffer instead.
+ */
+typedef struct hist_log_read_ahead_t
+{
+    const struct flash_sector* p_sector; //!< Sector of the loaded chunk, NULL if the buffer is empty
+    uint32_t                   off;      //!< Offset of the loaded chunk in the sector
+    uint32_t                   len;
+    //! The chunk was loaded from the active sector, so new entries could be appended after it
+    bool           is_active;
+    uint32_t       num_flash_reads;
+    const uint8_t* p_data; //!< The loaded chunk: buf, or the whole sector in the memory-mapped flash
+#if HIST_LOG_READ_AHEAD_SIZE > 0
+    uint8_t buf[HIST_LOG_READ_AHEAD_SIZE];
+#endif
+} hist_log_read_ahead_t;
+
+/**
+ * @brief Address of hist_storage in the memory-mapped flash.
+ * @details The flash simulator keeps the flash contents in RAM. The QSPI flash is mapped only in XIP mode,
+ * which is enabled while there are readers which use the mapped flash.
+ */
+typedef struct hist_log_flash_map_t
+{
+    const uint8_t*       p_base;    //!< Address of the flash area, NULL if it is not mapped
+    const struct device* p_xip_dev; //!< The QSPI flash device, NULL if XIP does not need to be enabled
+    uint32_t             num_users;
+} hist_log_flash_map_t;
+
+/**
+ * @brief Position of the reader in the tier, it is kept between the calls, so that reading can be paused.
+ * @details The cursor holds the FCB location of the last entry read from flash and the decoder state after it.
+ * The records which were already read from the write-back buffer are skipped when the buffer is written to flash.
+ */
+typedef struct hist_log_cursor_block_record_t
+{
+    uint32_t                 timestamp;
+    uint32_t                 seq;
+    hist_log_rollup_record_t record;
+} hist_log_cursor_block_record_t;
+
+struct hist_log_cursor_t
+{
+    bool              is_open;
+    bool              is_started; //!< The first sector to read was looked up in the sector directory
+    hist_log_tier_e   tier;
+    uint32_t          timestamp_start;
+    int32_t           time_offset_s;    //!< Time offset of the current epoch when the cursor was opened
+    uint32_t          seq_start;        //!< Sequence number of the first record to read
+    uint32_t          seq_last;         //!< Sequence number of the last record returned to the reader
+    struct fcb_entry  loc;              //!< The last entry read from flash, fe_elem_off=0 before the first one
+    uint32_t          sector_erase_cnt; //!< Erase counter of loc.fe_sector, see g_hist_log_sector_erase_cnt
+    hist_log_stream_t decoder;
+    hist_log_stream_t decoder_flash;       //!< Decoder state after the last entry read from flash
+    hist_log_entry_t  entry;               //!< The entry being decoded
+    bool              is_write_back;       //!< The entry is a copy of the write-back buffer
+    uint32_t          num_write_back_read; //!< Number of records read from the write-back buffer
+    uint32_t          num_skip;            //!< Number of records at the beginning of the entry which were read
+    uint32_t          read_err_cnt;
+    uint32_t          decode_err_cnt;
+    uint32_t          num_flash_reads;
+    bool              is_filtered; //!< Only the records which match the filter are returned
+    hist_log_filter_t filter;
+    uint32_t          num_sectors_skipped;  //!< Number of sectors skipped by the zone maps of the filter
+    bool              is_aggregated;        //!< The records are aggregated into time buckets
+    hist_log_rollup_t aggregation;          //!< Accumulator of the time bucket which is being read
+    uint32_t          aggregation_seq_last; //!< Sequence number of the last record added to the accumulator
+    //! Sequence number of the next record to check in the RAM cache, 0 if the cursor reads from flash
+    uint32_t seq_cache_next;
+    //! Sector which the reader is inside, see g_hist_log_sector_num_readers
+    const struct flash_sector* p_reader_sector;
+    bool                       is_flash_map_user; //!< The cursor is counted in g_hist_log_flash_map.num_users
+    //! Newest-first reading: the records are decoded forward in blocks, which are returned in reverse order
+    bool                           is_newest_first;
+    uint32_t                       num_records_max;  //!< Max number of records to return, 0 means no limit
+    uint32_t                       num_records_read; //!< Number of records returned by the newest-first cursor
+    uint32_t                       seq_block_end;    //!< Sequence number after the last record of the current block
+    uint32_t                       block_len;        //!< Number of records in the block which are not returned yet
+    hist_log_cursor_block_record_t block[HIST_LOG_CURSOR_BLOCK_LEN];
+};
+
+static struct flash_sector         g_hist_log_sectors[HIST_LOG_NUM_SECTORS];
+static hist_log_sector_dir_entry_t g_hist_log_sector_dir[HIST_LOG_NUM_SECTORS];
+static hist_log_write_back_t       g_hist_log_write_back;
+static hist_log_read_ahead_t       g_hist_log_read_ahead;
+static hist_log_flash_map_t        g_hist_log_flash_map;
+static hist_log_cursor_t           g_hist_log_cursors[HIST_LOG_NUM_CURSORS];
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+static hist_log_cache_t g_hist_log_cache;
+#endif
+// Incremented when the sector is erased, so that the cursor detects that the sector it points into was rotated out
+static uint32_t g_hist_log_sector_erase_cnt[HIST_LOG_NUM_SECTORS];
+// Number of the readers inside the sector, the pre-erase of the oldest sector is deferred while a reader is inside it
+static uint8_t g_hist_log_sector_num_readers[HIST_LOG_NUM_SECTORS];
+#if HIST_LOG_CHECKPOINT
+static hist_log_checkpoint_t g_hist_log_checkpoint;
+static bool                  g_hist_log_checkpoint_is_loaded;
+// The checkpoint is not saved during initialization, while the directory of some tiers is not yet rebuilt
+static bool g_hist_log_checkpoint_is_save_allowed;
+#endif
+
+// The table is changed only during initialization, after that only the time offset of the current epoch is updated,
+// which is a single word, so the readers use the table without locking.
+static hist_log_epochs_t g_hist_log_epochs;
+
+// Protects the write-back buffer, the read-ahead buffer, the flash map, the RAM cache, the cursors and the statistics.
+// It is held while the buffered records are written to flash, so that the reader finds each record either in flash
+// or in the buffer.
+K_MUTEX_DEFINE(g_hist_log_mutex);
 #if HIST_LOG_TEST_FILL_ALL_STORAGE
 static bool g_hist_log_full;
 #endif
+static hist_log_stats_t g_hist_log_stats;
+
+#if HIST_LOG_PRE_ERASE
+static void
+hist_log_maintenance_work_handler(struct k_work* p_work);
+
+// The sectors are erased and the checkpoint is saved by a dedicated queue with the lowest priority,
+// so that the flash erase does not delay the system work queue and runs when the application threads are idle.
+K_THREAD_STACK_DEFINE(g_hist_log_work_q_stack, HIST_LOG_PRE_ERASE_STACK_SIZE);
+static struct k_work_q g_hist_log_work_q;
+static bool            g_hist_log_work_q_is_started;
+K_WORK_DEFINE(g_hist_log_maintenance_work, &hist_log_maintenance_work_handler);
+#endif
 
-static struct fcb g_hist_log_fcb = {
-    .f_magic       = HIST_LOG_FCB_SIGNATURE,
-    .f_version     = HIST_LOG_FCB_FMT_VERSION,
-    .f_sector_cnt  = HIST_LOG_NUM_SECTORS,
-    .f_scratch_cnt = 1,
-    .f_sectors     = g_hist_log_sectors,
-    // We're using own CRC16 as part of records for data integrity check.
-    // Automatic CRC check uses CRC8, which is not enough for our needs.
-    // Also, automatic CRC caclulation requires reading from the flash,
-    // which is less reliable compared to calculating CRC during record append.
-    .f_flags = FCB_FLAGS_CRC_DISABLED,
+// We're using own CRC16 as part of records for data integrity check.
+// Automatic CRC check uses CRC8, which is not enough for our needs.
+// Also, automatic CRC caclulation requires reading from the flash,
+// which is less reliable compared to calculating CRC during record append.
+static hist_log_tier_t g_hist_log_tiers[HIST_LOG_NUM_TIERS] = {
+    [HIST_LOG_TIER_5MIN] = {
+        .fcb = {
+            .f_magic       = HIST_LOG_FCB_SIGNATURE,
+            .f_version     = HIST_LOG_FCB_FMT_VERSION,
+            .f_sector_cnt  = HIST_LOG_TIER_5MIN_NUM_SECTORS,
+            .f_scratch_cnt = 1,
+            .f_sectors     = &g_hist_log_sectors[0],
+            .f_flags       = FCB_FLAGS_CRC_DISABLED,
+        },
+        .p_name        = "5min",
+        .num_channels  = 1,
+        .max_entry_len = HIST_LOG_WRITE_BACK_MAX_LEN,
+        .period_s      = 5U * 60U,
+    },
+    [HIST_LOG_TIER_1HOUR] = {
+        .fcb = {
+            .f_magic       = HIST_LOG_FCB_SIGNATURE_1HOUR,
+            .f_version     = HIST_LOG_FCB_FMT_VERSION,
+            .f_sector_cnt  = HIST_LOG_TIER_1HOUR_NUM_SECTORS,
+            .f_scratch_cnt = 1,
+            .f_sectors     = &g_hist_log_sectors[HIST_LOG_TIER_5MIN_NUM_SECTORS],
+            .f_flags       = FCB_FLAGS_CRC_DISABLED,
+        },
+        .p_name        = "1hour",
+        .num_channels  = HIST_LOG_ROLLUP_NUM_CHANNELS,
+        .max_entry_len = HIST_LOG_ROLLUP_ENTRY_MAX_LEN,
+        .period_s      = HIST_LOG_TIER_1HOUR_PERIOD_SECONDS,
+    },
+    [HIST_LOG_TIER_1DAY] = {
+        .fcb = {
+            .f_magic       = HIST_LOG_FCB_SIGNATURE_1DAY,
+            .f_version     = HIST_LOG_FCB_FMT_VERSION,
+            .f_sector_cnt  = HIST_LOG_TIER_1DAY_NUM_SECTORS,
+            .f_scratch_cnt = 1,
+            .f_sectors     = &g_hist_log_sectors[HIST_LOG_TIER_5MIN_NUM_SECTORS + HIST_LOG_TIER_1HOUR_NUM_SECTORS],
+            .f_flags       = FCB_FLAGS_CRC_DISABLED,
+        },
+        .p_name        = "1day",
+        .num_channels  = HIST_LOG_ROLLUP_NUM_CHANNELS,
+        .max_entry_len = HIST_LOG_ROLLUP_ENTRY_MAX_LEN,
+        .period_s      = HIST_LOG_TIER_1DAY_PERIOD_SECONDS,
+    },
 };
 
+static void
+hist_log_read_ahead_invalidate(hist_log_read_ahead_t* const p_ra)
+{
+    p_ra->p_sector = NULL;
+    p_ra->off      = 0;
+    p_ra->len      = 0;
+    p_ra->p_data   = NULL;
+}
+
+/**
+ * @brief Find the address of hist_storage in the memory-mapped flash.
+ */
+static void
+hist_log_flash_map_init(void)
+{
+#if HIST_LOG_MAPPED_READ
+    hist_log_flash_map_t* const p_map = &g_hist_log_flash_map;
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    hist_log_read_ahead_invalidate(&g_hist_log_read_ahead);
+    p_map->p_base                 = NULL;
+    p_map->p_xip_dev              = NULL;
+    const struct flash_area* p_fa = NULL;
+    if (0 == flash_area_open(HIST_LOG_FLASH_AREA_ID, &p_fa))
+    {
+        const struct device* const p_dev = flash_area_get_device(p_fa);
+#if IS_ENABLED(CONFIG_FLASH_SIMULATOR)
+        if (DEVICE_DT_GET_ONE(zephyr_sim_flash) == p_dev)
+        {
+            size_t               size  = 0;
+            const uint8_t* const p_mem = flash_simulator_get_memory(p_dev, &size);
+            if ((NULL != p_mem) && (((size_t)p_fa->fa_off + p_fa->fa_size) <= size))
+            {
+                p_map->p_base = &p_mem[p_fa->fa_off];
+            }
+        }
+#endif
+#if IS_ENABLED(CONFIG_NORDIC_QSPI_NOR)
+        if (DEVICE_DT_GET_ONE(nordic_qspi_nor) == p_dev)
+        {
+            const uintptr_t xip_addr = DT_REG_ADDR_BY_NAME(DT_NODELABEL(qspi), qspi_mm) + (uint32_t)p_fa->fa_off;
+            p_map->p_base            = (const uint8_t*)xip_addr;
+            p_map->p_xip_dev         = p_dev;
+        }
+#endif
+        flash_area_close(p_fa);
+    }
+    k_mutex_unlock(&g_hist_log_mutex);
+    TLOG_INF("hist_storage is %s", (NULL != p_map->p_base) ? "memory-mapped" : "read via flash_area_read");
+#endif
+}
+
+/**
+ * @brief Register the user of the memory-mapped flash, XIP of the QSPI flash is enabled for the first one.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static void
+hist_log_flash_map_acquire(void)
+{
+#if HIST_LOG_MAPPED_READ
+    hist_log_flash_map_t* const p_map = &g_hist_log_flash_map;
+    p_map->num_users += 1;
+#if IS_ENABLED(CONFIG_NORDIC_QSPI_NOR)
+    if ((1U == p_map->num_users) && (NULL != p_map->p_xip_dev))
+    {
+        nrf_qspi_nor_xip_enable(p_map->p_xip_dev, true);
+    }
+#endif
+#endif
+}
+
+/**
+ * @brief Unregister the user of the memory-mapped flash, XIP of the QSPI flash is disabled after the last one.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static void
+hist_log_flash_map_release(void)
+{
+#if HIST_LOG_MAPPED_READ
+    hist_log_flash_map_t* const p_map = &g_hist_log_flash_map;
+    p_map->num_users -= 1;
+#if IS_ENABLED(CONFIG_NORDIC_QSPI_NOR)
+    if ((0U == p_map->num_users) && (NULL != p_map->p_xip_dev))
+    {
+        nrf_qspi_nor_xip_enable(p_map->p_xip_dev, false);
+    }
+#endif
+#endif
+}
+
+/**
+ * @brief Get the address of the range of the sector in the memory-mapped flash.
+ * @note The caller must be registered with hist_log_flash_map_acquire().
+ * @return NULL if hist_storage is not mapped, then the range must be read from flash.
+ */
+static const uint8_t*
+hist_log_flash_map_get(const struct flash_sector* const p_sector, const uint32_t off, const uint32_t len)
+{
+#if HIST_LOG_MAPPED_READ
+    const hist_log_flash_map_t* const p_map = &g_hist_log_flash_map;
+    if ((NULL == p_map->p_base) || (0 == p_map->num_users) || ((off + len) > p_sector->fs_size))
+    {
+        return NULL;
+    }
+    return &p_map->p_base[p_sector->fs_off + off];
+#else
+    ARG_UNUSED(p_sector);
+    ARG_UNUSED(off);
+    ARG_UNUSED(len);
+    return NULL;
+#endif
+}
+
+static void
+hist_log_checkpoint_delete(void)
+{
+#if HIST_LOG_CHECKPOINT
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        g_hist_log_tiers[i].p_checkpoint_sector = NULL;
+    }
+    const zephyr_api_ret_t rc = settings_delete(HIST_LOG_CHECKPOINT_SETTINGS_KEY);
+    if (0 != rc)
+    {
+        TLOG_ERR("settings_delete failed for hist_log checkpoint, rc=%d", rc);
+    }
+#endif
+}
+
+static void
+hist_log_epochs_delete(void)
+{
+#if HIST_LOG_KEEP_ON_RTC_LOSS
+    const zephyr_api_ret_t rc = settings_delete(HIST_LOG_EPOCHS_SETTINGS_KEY);
+    if (0 != rc)
+    {
+        TLOG_ERR("settings_delete failed for hist_log epochs, rc=%d", rc);
+    }
+#endif
+}
+
+/**
+ * @brief Cancel the pending maintenance work before the FCB is erased or initialized again.
+ */
+static void
+hist_log_maintenance_cancel(void)
+{
+#if HIST_LOG_PRE_ERASE
+    struct k_work_sync sync = { 0 };
+    (void)k_work_cancel_sync(&g_hist_log_maintenance_work, &sync);
+#endif
+}
+
 static bool
 hist_log_erase_flash_storage(void)
 {
+    hist_log_maintenance_cancel();
+    // The checkpoint is deleted first, so that it is not used if erasing is interrupted
+    hist_log_checkpoint_delete();
+    hist_log_epochs_delete();
     const struct flash_area* p_fa = NULL;
     int32_t                  rc   = flash_area_open(HIST_LOG_FLASH_AREA_ID, &p_fa);
     if (0 != rc)
@@ -76,6 +657,7 @@ hist_log_erase_flash_storage(void)
             i,
             (unsigned)p_fs->fs_off,
             (unsigned)p_fs->fs_size);
+        g_hist_log_sector_erase_cnt[i] += 1;
         rc = flash_area_erase(p_fa, p_fs->fs_off, p_fs->fs_size);
         if (0 != rc)
         {
@@ -85,13 +667,14 @@ hist_log_erase_flash_storage(void)
         }
     }
     flash_area_close(p_fa);
+    hist_log_read_ahead_invalidate(&g_hist_log_read_ahead);
     return true;
 }
 
 static bool
 hist_log_check_sectors_count(void)
 {
-    size_t           sector_count = ARRAY_SIZE(g_hist_log_sectors);
+    uint32_t         sector_count = ARRAY_SIZE(g_hist_log_sectors);
     zephyr_api_ret_t rc           = flash_area_get_sectors(HIST_LOG_FLASH_AREA_ID, &sector_count, g_hist_log_sectors);
     if ((0 != rc) || (0 == sector_count))
     {
@@ -118,264 +701,2884 @@ hist_log_check_sectors_count(void)
     return true;
 }
 
+static zephyr_api_ret_t
+hist_log_fcb_init_tiers(void)
+{
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        hist_log_tier_t* const p_tier = &g_hist_log_tiers[i];
+        const zephyr_api_ret_t rc     = fcb_init(HIST_LOG_FLASH_AREA_ID, &p_tier->fcb);
+        if (0 != rc)
+        {
+            TLOG_ERR("fcb_init failed for tier %s, rc=%d", p_tier->p_name, rc);
+            return rc;
+        }
+    }
+    return 0;
+}
+
 static bool
-hist_log_fcb_init(struct fcb* const p_fcb)
+hist_log_fcb_init(void)
 {
-    zephyr_api_ret_t rc = fcb_init(HIST_LOG_FLASH_AREA_ID, p_fcb);
+    zephyr_api_ret_t rc = hist_log_fcb_init_tiers();
     if (0 != rc)
     {
         if (-ENOMSG == rc)
         {
+            // The storage area is shared by all the tiers, so all of them are initialized again after erasing
             TLOG_ERR("fcb_init failed, -ENOMSG, need to erase storage area");
             if (!hist_log_erase_flash_storage())
             {
                 TLOG_ERR("erase_flash_storage failed");
                 return false;
             }
-            rc = fcb_init(HIST_LOG_FLASH_AREA_ID, p_fcb);
+            rc = hist_log_fcb_init_tiers();
             if (0 != rc)
             {
-                TLOG_ERR("fcb_init failed, rc=%d", rc);
                 return false;
             }
         }
         else
         {
-            TLOG_ERR("fcb_init failed, rc=%d", rc);
             return false;
         }
     }
-    TLOG_INF("fcb_is_empty: %d", fcb_is_empty(p_fcb));
-    TLOG_INF("fcb_free_sector_cnt: %d", fcb_free_sector_cnt(p_fcb));
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        struct fcb* const p_fcb = &g_hist_log_tiers[i].fcb;
+        TLOG_INF(
+            "Tier %s: fcb_is_empty: %d, fcb_free_sector_cnt: %d",
+            g_hist_log_tiers[i].p_name,
+            fcb_is_empty(p_fcb),
+            fcb_free_sector_cnt(p_fcb));
+    }
     return true;
 }
 
-static bool
-hist_log_check_flash_driver(void)
+static uint32_t
+hist_log_sector_get_idx(const struct flash_sector* const p_sector)
 {
-    const struct flash_area* fa = NULL;
-    int32_t                  rc = flash_area_open(HIST_LOG_FLASH_AREA_ID, &fa);
-    if (0 != rc)
-    {
-        LOG_ERR("flash_area_open failed, rc=%d", rc);
-        return false;
-    }
-    if (flash_area_has_driver(fa) <= 0)
-    {
-        LOG_ERR("flash_area_has_driver failed");
-        return false;
-    }
+    return (uint32_t)(p_sector - &g_hist_log_sectors[0]);
+}
 
-    uint32_t block_size = flash_area_align(fa);
-    LOG_INF("flash_area_align: %d", block_size);
+static uint32_t
+hist_log_sector_get_erase_cnt(const struct flash_sector* const p_sector)
+{
+    return g_hist_log_sector_erase_cnt[hist_log_sector_get_idx(p_sector)];
+}
 
-    const struct device* p_device = flash_area_get_device(fa);
-    LOG_INF("flash_area_get_device: %p", p_device);
+/**
+ * @brief Get the logical index of the sector (0 - the oldest sector of the tier).
+ */
+static uint32_t
+hist_log_sector_dir_get_logical_idx(const struct fcb* const p_fcb, const struct flash_sector* const p_sector)
+{
+    const uint32_t oldest_idx = hist_log_sector_get_idx(p_fcb->f_oldest);
+    const uint32_t sector_idx = hist_log_sector_get_idx(p_sector);
+    return (sector_idx + p_fcb->f_sector_cnt - oldest_idx) % p_fcb->f_sector_cnt;
+}
 
-    flash_area_close(fa);
-    return true;
+/**
+ * @brief Get the number of sectors in use, from the oldest sector to the active one (inclusive).
+ */
+static uint32_t
+hist_log_sector_dir_get_num_used(const struct fcb* const p_fcb)
+{
+    return hist_log_sector_dir_get_logical_idx(p_fcb, p_fcb->f_active.fe_sector) + 1;
 }
-#endif
 
-bool
-hist_log_init(const bool is_rtc_valid)
+/**
+ * @brief Convert the logical index (0 - the oldest sector of the tier) to the physical index in g_hist_log_sectors.
+ */
+static uint32_t
+hist_log_sector_dir_conv_logical_idx(const struct fcb* const p_fcb, const uint32_t logical_idx)
 {
-#if USE_HIST_LOG
-#if HIST_LOG_TEST_FILL_ALL_STORAGE
-    g_hist_log_full = false;
-#endif
-    if (!hist_log_check_flash_driver())
-    {
-        return false;
-    }
+    const uint32_t first_idx  = hist_log_sector_get_idx(p_fcb->f_sectors);
+    const uint32_t oldest_idx = hist_log_sector_get_idx(p_fcb->f_oldest) - first_idx;
+    return first_idx + ((oldest_idx + logical_idx) % p_fcb->f_sector_cnt);
+}
 
-    if (!hist_log_check_sectors_count())
+static void
+hist_log_sector_dir_clear_entry(const struct flash_sector* const p_sector)
+{
+    g_hist_log_sector_dir[hist_log_sector_get_idx(p_sector)] = (hist_log_sector_dir_entry_t) {
+        .timestamp_first = 0,
+        .timestamp_last  = 0,
+        .seq_last        = 0,
+        .num_records     = 0,
+        .is_ordered      = true,
+    };
+    hist_log_zone_map_clear(&g_hist_log_sector_dir[hist_log_sector_get_idx(p_sector)].zone_map);
+}
+
+static void
+hist_log_sector_dir_add_record(const struct flash_sector* const p_sector, const uint32_t timestamp, const uint32_t seq)
+{
+    hist_log_sector_dir_entry_t* const p_entry = &g_hist_log_sector_dir[hist_log_sector_get_idx(p_sector)];
+    if (0 == p_entry->num_records)
     {
-        return false;
+        p_entry->timestamp_first = timestamp;
     }
-
-    if (!is_rtc_valid)
+    else if (timestamp < p_entry->timestamp_last)
     {
-        TLOG_WRN("RTC is not valid, erase flash storage");
-        if (!hist_log_erase_flash_storage())
-        {
-            TLOG_ERR("erase_flash_storage failed");
-            return false;
-        }
+        p_entry->is_ordered = false;
     }
-
-    if (!hist_log_fcb_init(&g_hist_log_fcb))
+    else
     {
-        return false;
+        // MISRA: "if ... else if" constructs should end with "else" clauses
     }
+    p_entry->timestamp_last = timestamp;
+    p_entry->seq_last       = seq;
+    p_entry->num_records += 1;
+}
+
+/**
+ * @brief Get the range of the sensor values of the sector, it is extended by the records added to the sector.
+ */
+static hist_log_zone_map_t*
+hist_log_sector_dir_get_zone_map(const struct flash_sector* const p_sector)
+{
+    return &g_hist_log_sector_dir[hist_log_sector_get_idx(p_sector)].zone_map;
+}
+
+/**
+ * @brief Check that the timestamps are non-decreasing across all the sectors in use.
+ * @details Binary search is possible only for ordered sectors. The order can be broken if the clock was set back,
+ * in this case the directory is not used until the sectors with the out-of-order records are rotated out.
+ */
+static void
+hist_log_sector_dir_update_order(hist_log_tier_t* const p_tier)
+{
+    const struct fcb* const p_fcb       = &p_tier->fcb;
+    const uint32_t          num_used    = hist_log_sector_dir_get_num_used(p_fcb);
+    bool                    is_ordered  = true;
+    bool                    flag_prev   = false;
+    uint32_t                prev_last_t = 0;
+    for (uint32_t i = 0; i < num_used; ++i)
+    {
+        const hist_log_sector_dir_entry_t* const p_entry
+            = &g_hist_log_sector_dir[hist_log_sector_dir_conv_logical_idx(p_fcb, i)];
+        if (0 == p_entry->num_records)
+        {
+            if ((i + 1) != num_used)
+            {
+                // Only the active sector can be empty, otherwise some records were lost
+                is_ordered = false;
+                break;
+            }
+            continue;
+        }
+        if ((!p_entry->is_ordered) || (flag_prev && (p_entry->timestamp_first < prev_last_t)))
+        {
+            is_ordered = false;
+            break;
+        }
+        prev_last_t = p_entry->timestamp_last;
+        flag_prev   = true;
+    }
+    if (p_tier->sector_dir_is_ordered != is_ordered)
+    {
+        TLOG_INF("Sector directory of tier %s: is_ordered=%d", p_tier->p_name, is_ordered);
+    }
+    p_tier->sector_dir_is_ordered = is_ordered;
+}
+
+/**
+ * @brief Get the directory entry of the newest sector which contains records.
+ * @return NULL if the tier is empty.
+ */
+static const hist_log_sector_dir_entry_t*
+hist_log_sector_dir_get_newest(const hist_log_tier_t* const p_tier)
+{
+    const struct fcb* const p_fcb = &p_tier->fcb;
+    for (uint32_t i = hist_log_sector_dir_get_num_used(p_fcb); i > 0; --i)
+    {
+        const hist_log_sector_dir_entry_t* const p_entry
+            = &g_hist_log_sector_dir[hist_log_sector_dir_conv_logical_idx(p_fcb, i - 1)];
+        if (0 != p_entry->num_records)
+        {
+            return p_entry;
+        }
+    }
+    return NULL;
+}
+
+#if HIST_LOG_CHECKPOINT || HIST_LOG_KEEP_ON_RTC_LOSS
+/**
+ * @brief Fixed-size value which is loaded from settings.
+ */
+typedef struct hist_log_settings_value_t
+{
+    void*  p_buf;
+    size_t len;
+    bool   is_loaded;
+} hist_log_settings_value_t;
+
+static int // NOSONAR: Zephyr API
+hist_log_settings_load_cb(const char* key, size_t len, settings_read_cb read_cb, void* cb_arg, void* param)
+{
+    hist_log_settings_value_t* const p_value = param;
+    if (len != p_value->len)
+    {
+        TLOG_WRN("hist_log settings \"%s\" has wrong length: %u", key, (unsigned)len);
+        return 0;
+    }
+    const ssize_t rlen = read_cb(cb_arg, p_value->p_buf, p_value->len);
+    if (rlen != (ssize_t)p_value->len)
+    {
+        TLOG_ERR("read_cb failed for \"%s\": %d", key, (int)rlen);
+        return 0;
+    }
+    p_value->is_loaded = true;
+    return 0;
+}
+
+/**
+ * @return false if the value is not found, has another length or could not be read.
+ */
+static bool
+hist_log_settings_load(const char* const p_key, void* const p_buf, const size_t len)
+{
+    hist_log_settings_value_t value = {
+        .p_buf     = p_buf,
+        .len       = len,
+        .is_loaded = false,
+    };
+    const zephyr_api_ret_t rc = settings_load_subtree_direct(p_key, &hist_log_settings_load_cb, &value);
+    if (0 != rc)
+    {
+        TLOG_WRN("settings_load_subtree_direct failed for \"%s\", rc=%d", p_key, rc);
+        return false;
+    }
+    return value.is_loaded;
+}
+#endif
+
+#if HIST_LOG_CHECKPOINT
+
+/**
+ * @brief Save the sector directory of all the tiers to settings.
+ */
+static void
+hist_log_checkpoint_save(void)
+{
+    const int64_t                time_start   = k_uptime_get();
+    hist_log_checkpoint_t* const p_checkpoint = &g_hist_log_checkpoint;
+    p_checkpoint->version                     = HIST_LOG_FCB_FMT_VERSION;
+    p_checkpoint->num_sectors                 = HIST_LOG_NUM_SECTORS;
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        hist_log_tier_t* const            p_tier            = &g_hist_log_tiers[i];
+        const struct fcb* const           p_fcb             = &p_tier->fcb;
+        hist_log_checkpoint_tier_t* const p_checkpoint_tier = &p_checkpoint->tiers[i];
+        p_checkpoint_tier->num_sectors       = p_fcb->f_sector_cnt;
+        p_checkpoint_tier->active_sector_idx = (uint16_t)hist_log_sector_get_idx(p_fcb->f_active.fe_sector);
+        p_checkpoint_tier->active_sector_id  = p_fcb->f_active_id;
+        p_tier->p_checkpoint_sector          = p_fcb->f_active.fe_sector;
+    }
+    memcpy(p_checkpoint->sector_dir, g_hist_log_sector_dir, sizeof(p_checkpoint->sector_dir));
+    const zephyr_api_ret_t rc
+        = settings_save_one(HIST_LOG_CHECKPOINT_SETTINGS_KEY, p_checkpoint, sizeof(*p_checkpoint));
+    if (0 != rc)
+    {
+        TLOG_ERR("settings_save_one failed for hist_log checkpoint, rc=%d", rc);
+        return;
+    }
+    TLOG_INF(
+        "hist_log checkpoint saved: %u bytes, time: %u ms",
+        (unsigned)sizeof(*p_checkpoint),
+        (unsigned)(k_uptime_get() - time_start));
+}
+#endif
+
+/**
+ * @brief Load the checkpoint of the sector directory from settings.
+ * @return false if there is no checkpoint or it was saved for another layout of the partition.
+ */
+static bool
+hist_log_checkpoint_load(void)
+{
+#if HIST_LOG_CHECKPOINT
+    hist_log_checkpoint_t* const p_checkpoint = &g_hist_log_checkpoint;
+    memset(p_checkpoint, 0, sizeof(*p_checkpoint));
+    if ((!hist_log_settings_load(HIST_LOG_CHECKPOINT_SETTINGS_KEY, p_checkpoint, sizeof(*p_checkpoint)))
+        || (HIST_LOG_FCB_FMT_VERSION != p_checkpoint->version) || (HIST_LOG_NUM_SECTORS != p_checkpoint->num_sectors))
+    {
+        TLOG_INF("hist_log checkpoint is not found");
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Check if the active sector of any tier has changed since the last checkpoint.
+ */
+static bool
+hist_log_checkpoint_is_update_needed(void)
+{
+#if HIST_LOG_CHECKPOINT
+    if (!g_hist_log_checkpoint_is_save_allowed)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        const hist_log_tier_t* const p_tier = &g_hist_log_tiers[i];
+        if (p_tier->fcb.f_active.fe_sector != p_tier->p_checkpoint_sector)
+        {
+            return true;
+        }
+    }
+#endif
+    return false;
+}
+
+/**
+ * @brief Save the checkpoint if the active sector of any tier has changed since the last checkpoint.
+ * @details It is called after writing an entry (by the work queue if CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE is enabled),
+ * so the checkpoint is saved once per sector of the 5-minute tier.
+ */
+static void
+hist_log_checkpoint_update(void)
+{
+#if HIST_LOG_CHECKPOINT
+    if (hist_log_checkpoint_is_update_needed())
+    {
+        hist_log_checkpoint_save();
+    }
+#endif
+}
+
+/**
+ * @brief Restore the directory entries of the sectors which were closed before the last checkpoint.
+ * @details The checkpoint is used only if its active sector is still in use and was not erased and reused since then,
+ * which is checked by the sector id in the FCB sector header.
+ * @return Number of sectors starting from the oldest one, whose directory entries were restored,
+ * the remaining sectors must be decoded.
+ */
+static uint32_t
+hist_log_checkpoint_restore(hist_log_tier_t* const p_tier, const hist_log_tier_e tier)
+{
+#if HIST_LOG_CHECKPOINT
+    if (!g_hist_log_checkpoint_is_loaded)
+    {
+        return 0;
+    }
+    const hist_log_checkpoint_tier_t* const p_checkpoint_tier = &g_hist_log_checkpoint.tiers[tier];
+    const struct fcb* const                 p_fcb             = &p_tier->fcb;
+    const uint32_t                          first_idx         = hist_log_sector_get_idx(p_fcb->f_sectors);
+    if ((p_checkpoint_tier->num_sectors != p_fcb->f_sector_cnt)
+        || (p_checkpoint_tier->active_sector_idx < first_idx)
+        || (p_checkpoint_tier->active_sector_idx >= (first_idx + p_fcb->f_sector_cnt)))
+    {
+        TLOG_WRN("hist_log checkpoint of tier %s does not match the layout", p_tier->p_name);
+        return 0;
+    }
+    const struct flash_sector* const p_sector     = &g_hist_log_sectors[p_checkpoint_tier->active_sector_idx];
+    const uint32_t                   num_restored = hist_log_sector_dir_get_logical_idx(p_fcb, p_sector);
+    hist_log_fcb_sector_hdr_t        hdr          = { 0 };
+    const zephyr_api_ret_t           rc           = flash_area_read(p_fcb->fap, p_sector->fs_off, &hdr, sizeof(hdr));
+    if ((0 != rc) || (num_restored >= hist_log_sector_dir_get_num_used(p_fcb)) || (p_fcb->f_magic != hdr.magic)
+        || (p_fcb->f_version != hdr.version) || (p_checkpoint_tier->active_sector_id != hdr.id))
+    {
+        TLOG_WRN("hist_log checkpoint of tier %s is stale", p_tier->p_name);
+        return 0;
+    }
+    for (uint32_t i = 0; i < num_restored; ++i)
+    {
+        const uint32_t idx        = hist_log_sector_dir_conv_logical_idx(p_fcb, i);
+        g_hist_log_sector_dir[idx] = g_hist_log_checkpoint.sector_dir[idx];
+    }
+    p_tier->p_checkpoint_sector = p_sector;
+    return num_restored;
+#else
+    ARG_UNUSED(p_tier);
+    ARG_UNUSED(tier);
+    return 0;
+#endif
+}
+
+static void
+hist_log_stream_reset(hist_log_stream_t* const p_stream)
+{
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_CHANNELS; ++i)
+    {
+        hist_log_codec_reset(&p_stream->codec_state[i]);
+    }
+    p_stream->p_sector = NULL;
+}
+
+static void
+hist_log_stream_invalidate(hist_log_stream_t* const p_stream)
+{
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_CHANNELS; ++i)
+    {
+        p_stream->codec_state[i].is_valid = false;
+    }
+}
+
+static void
+hist_log_write_back_reset(void)
+{
+    g_hist_log_write_back.num_records = 0;
+    g_hist_log_write_back.len         = 0;
+    hist_log_zone_map_clear(&g_hist_log_write_back.zone_map);
+}
+
+/**
+ * @brief Calculate the space occupied in flash by a field of the FCB entry, taking into account the write alignment.
+ */
+static uint32_t
+hist_log_fcb_len_in_flash(const struct fcb* const p_fcb, const uint32_t len)
+{
+    const uint32_t align = (p_fcb->f_align > 1) ? p_fcb->f_align : 1;
+    return ROUND_UP(len, align);
+}
+
+/**
+ * @brief Check if the range of the given length can be accessed with hist_log_read_ahead_load().
+ */
+static bool
+hist_log_read_ahead_can_load(const struct flash_sector* const p_sector, const uint32_t len)
+{
+    return (len <= HIST_LOG_READ_AHEAD_SIZE) || (NULL != hist_log_flash_map_get(p_sector, 0, len));
+}
+
+/**
+ * @brief Make sure that the range of the sector is in the read-ahead buffer.
+ * @details If the range is not in the buffer, the chunk starting from it is loaded from flash. The entries are read
+ * sequentially, so the following entries are then parsed from RAM.
+ * If the flash is memory-mapped, the whole sector is used as the chunk without reading it.
+ */
+static zephyr_api_ret_t
+hist_log_read_ahead_load(
+    hist_log_read_ahead_t* const     p_ra,
+    const struct fcb* const          p_fcb,
+    const struct flash_sector* const p_sector,
+    const uint32_t                   off,
+    const uint32_t                   len)
+{
+    if ((p_sector == p_ra->p_sector) && (off >= p_ra->off) && ((off + len) <= (p_ra->off + p_ra->len)))
+    {
+        return 0;
+    }
+    hist_log_read_ahead_invalidate(p_ra);
+    p_ra->is_active = (p_sector == p_fcb->f_active.fe_sector);
+
+    const uint8_t* const p_mapped = hist_log_flash_map_get(p_sector, 0, p_sector->fs_size);
+    if (NULL != p_mapped)
+    {
+        p_ra->p_sector = p_sector;
+        p_ra->off      = 0;
+        p_ra->len      = p_sector->fs_size;
+        p_ra->p_data   = p_mapped;
+        return 0;
+    }
+#if HIST_LOG_READ_AHEAD_SIZE > 0
+    const uint32_t chunk_len = MIN(HIST_LOG_READ_AHEAD_SIZE, p_sector->fs_size - off);
+    p_ra->num_flash_reads += 1;
+    const zephyr_api_ret_t rc = flash_area_read(p_fcb->fap, p_sector->fs_off + off, p_ra->buf, chunk_len);
+    if (0 != rc)
+    {
+        return rc;
+    }
+    p_ra->p_sector = p_sector;
+    p_ra->off      = off;
+    p_ra->len      = chunk_len;
+    p_ra->p_data   = p_ra->buf;
+    return 0;
+#else
+    return -ENOTSUP;
+#endif
+}
+
+/**
+ * @brief Read from the sector via the read-ahead buffer or the memory-mapped flash.
+ * @details If the read-ahead is disabled or the range is larger than the buffer, the data are read from flash directly.
+ */
+static zephyr_api_ret_t
+hist_log_read_ahead_read(
+    hist_log_read_ahead_t* const     p_ra,
+    const struct fcb* const          p_fcb,
+    const struct flash_sector* const p_sector,
+    const uint32_t                   off,
+    void* const                      p_dst,
+    const uint32_t                   len)
+{
+    if ((off + len) > p_sector->fs_size)
+    {
+        return -EINVAL;
+    }
+    if (hist_log_read_ahead_can_load(p_sector, len))
+    {
+        const zephyr_api_ret_t rc = hist_log_read_ahead_load(p_ra, p_fcb, p_sector, off, len);
+        if (0 != rc)
+        {
+            return rc;
+        }
+        memcpy(p_dst, &p_ra->p_data[off - p_ra->off], len);
+        return 0;
+    }
+    p_ra->num_flash_reads += 1;
+    return flash_area_read(p_fcb->fap, p_sector->fs_off + off, p_dst, len);
+}
+
+/**
+ * @brief Parse the header and check the end marker of the FCB entry at p_loc->fe_elem_off.
+ * @details This is the same as fcb_elem_info() for FCB_FLAGS_CRC_DISABLED.
+ * @return 0 on success, -ENOTSUP if there are no more entries in the sector,
+ * -EBADMSG if the entry was not finished (it is skipped), -EIO if reading failed.
+ */
+static zephyr_api_ret_t
+hist_log_read_ahead_elem_info(hist_log_read_ahead_t* const p_ra, const struct fcb* const p_fcb, struct fcb_entry* p_loc)
+{
+    uint8_t len_field[HIST_LOG_FCB_LEN_FIELD_LONG_SIZE];
+    if ((p_loc->fe_elem_off + sizeof(len_field)) > p_loc->fe_sector->fs_size)
+    {
+        return -ENOTSUP;
+    }
+    if (0 != hist_log_read_ahead_read(p_ra, p_fcb, p_loc->fe_sector, p_loc->fe_elem_off, len_field, sizeof(len_field)))
+    {
+        return -EIO;
+    }
+    // The length is stored inverted relative to the erased value of the flash, see fcb_get_len()
+    const uint8_t erase_value = p_fcb->f_erase_value;
+    const uint8_t len_byte0   = len_field[0] ^ (uint8_t)~erase_value;
+    const uint8_t len_byte1   = len_field[1] ^ (uint8_t)~erase_value;
+    uint32_t      len_size    = 1;
+    uint32_t      data_len    = len_byte0;
+    if (0 != (len_byte0 & (HIST_LOG_FCB_LEN_FIELD_SHORT_MAX + 1)))
+    {
+        if ((erase_value == len_field[0]) && (erase_value == len_field[1]))
+        {
+            return -ENOTSUP;
+        }
+        len_size = HIST_LOG_FCB_LEN_FIELD_LONG_SIZE;
+        data_len = (len_byte0 & HIST_LOG_FCB_LEN_FIELD_SHORT_MAX) | ((uint32_t)len_byte1 << 7U);
+    }
+    p_loc->fe_data_off = p_loc->fe_elem_off + hist_log_fcb_len_in_flash(p_fcb, len_size);
+    p_loc->fe_data_len = (uint16_t)data_len;
+
+    uint8_t        endmarker = 0;
+    const uint32_t off       = p_loc->fe_data_off + hist_log_fcb_len_in_flash(p_fcb, data_len);
+    if ((off + sizeof(endmarker)) > p_loc->fe_sector->fs_size)
+    {
+        return -ENOTSUP;
+    }
+    // Load the whole entry, so that its data are not split between the chunks
+    const uint32_t entry_len = (off + sizeof(endmarker)) - p_loc->fe_elem_off;
+    if (hist_log_read_ahead_can_load(p_loc->fe_sector, entry_len))
+    {
+        if (0 != hist_log_read_ahead_load(p_ra, p_fcb, p_loc->fe_sector, p_loc->fe_elem_off, entry_len))
+        {
+            return -EIO;
+        }
+    }
+    if (0 != hist_log_read_ahead_read(p_ra, p_fcb, p_loc->fe_sector, off, &endmarker, sizeof(endmarker)))
+    {
+        return -EIO;
+    }
+    return (HIST_LOG_FCB_FIXED_ENDMARKER == endmarker) ? 0 : -EBADMSG;
+}
+
+/**
+ * @brief Get the next FCB entry, this is the same as fcb_getnext(), but the FCB entries are parsed from RAM.
+ * @details fcb_getnext() reads the length field and the end marker of every entry from flash separately.
+ */
+static zephyr_api_ret_t
+hist_log_read_ahead_getnext(hist_log_read_ahead_t* const p_ra, const struct fcb* const p_fcb, struct fcb_entry* p_loc)
+{
+    if (NULL == p_loc->fe_sector)
+    {
+        p_loc->fe_sector   = p_fcb->f_oldest;
+        p_loc->fe_elem_off = 0;
+    }
+    while (true)
+    {
+        if (0 == p_loc->fe_elem_off)
+        {
+            p_loc->fe_elem_off = HIST_LOG_FCB_SECTOR_HEADER_SIZE;
+        }
+        else
+        {
+            p_loc->fe_elem_off = p_loc->fe_data_off + hist_log_fcb_len_in_flash(p_fcb, p_loc->fe_data_len)
+                                 + hist_log_fcb_len_in_flash(p_fcb, HIST_LOG_FCB_ENDMARKER_SIZE);
+        }
+        zephyr_api_ret_t rc = hist_log_read_ahead_elem_info(p_ra, p_fcb, p_loc);
+        if ((0 != rc) && (p_loc->fe_sector == p_ra->p_sector) && p_ra->is_active)
+        {
+            // The chunk was loaded from the active sector, the entry could be appended after that
+            hist_log_read_ahead_invalidate(p_ra);
+            rc = hist_log_read_ahead_elem_info(p_ra, p_fcb, p_loc);
+        }
+        if (0 == rc)
+        {
+            return 0;
+        }
+        if (-EBADMSG == rc)
+        {
+            continue;
+        }
+        if (-ENOTSUP != rc)
+        {
+            return rc;
+        }
+        if (p_loc->fe_sector == p_fcb->f_active.fe_sector)
+        {
+            return -ENOTSUP;
+        }
+        p_loc->fe_sector += 1;
+        if (p_loc->fe_sector >= &p_fcb->f_sectors[p_fcb->f_sector_cnt])
+        {
+            p_loc->fe_sector = &p_fcb->f_sectors[0];
+        }
+        p_loc->fe_elem_off = 0;
+    }
+}
+
+static const uint8_t*
+hist_log_entry_get_data(const hist_log_entry_t* const p_entry)
+{
+    return (NULL != p_entry->p_mapped) ? p_entry->p_mapped : p_entry->buf;
+}
+
+/**
+ * @brief Read the FCB entry and check its CRC16.
+ * @details The entries must be read in order, starting from the first entry in a sector.
+ * If the flash is memory-mapped, the entry is not copied, it is decoded in place.
+ */
+static hist_log_read_status_e
+hist_log_stream_read_entry(
+    hist_log_stream_t* const      p_stream,
+    hist_log_read_ahead_t* const  p_ra,
+    const struct fcb* const       p_fcb,
+    const struct fcb_entry* const p_loc,
+    hist_log_entry_t* const       p_entry)
+{
+    if (p_loc->fe_sector != p_stream->p_sector)
+    {
+        hist_log_stream_reset(p_stream);
+        p_stream->p_sector = p_loc->fe_sector;
+    }
+    p_entry->len      = 0;
+    p_entry->pos      = 0;
+    p_entry->p_mapped = NULL;
+    if ((p_loc->fe_data_len <= HIST_LOG_ENTRY_CRC_SIZE) || (p_loc->fe_data_len > sizeof(p_entry->buf)))
+    {
+        hist_log_stream_invalidate(p_stream);
+        return HIST_LOG_READ_STATUS_ERR_CODEC;
+    }
+    p_entry->p_mapped = hist_log_flash_map_get(p_loc->fe_sector, p_loc->fe_data_off, p_loc->fe_data_len);
+    if (NULL == p_entry->p_mapped)
+    {
+        const zephyr_api_ret_t rc = hist_log_read_ahead_read(
+            p_ra,
+            p_fcb,
+            p_loc->fe_sector,
+            p_loc->fe_data_off,
+            p_entry->buf,
+            p_loc->fe_data_len);
+        if (0 != rc)
+        {
+            hist_log_stream_invalidate(p_stream);
+            return HIST_LOG_READ_STATUS_ERR_FLASH;
+        }
+    }
+    const uint8_t* const p_data = hist_log_entry_get_data(p_entry);
+    LOG_HEXDUMP_DBG(p_data, p_loc->fe_data_len, "Read entry");
+    // CRC16 is appended in little-endian order, so the CRC of the whole entry is 0
+    if (0 != crc16_ccitt(CRC16_CCITT_INITIAL_VALUE, p_data, p_loc->fe_data_len))
+    {
+        hist_log_stream_invalidate(p_stream);
+        return HIST_LOG_READ_STATUS_ERR_CODEC;
+    }
+    p_entry->len = p_loc->fe_data_len - HIST_LOG_ENTRY_CRC_SIZE;
+    return HIST_LOG_READ_STATUS_OK;
+}
+
+/**
+ * @brief Decode the next record from the entry.
+ * @details The rest of the entry is skipped on error, since the frames after the corrupted one can't be located.
+ * @param num_channels Number of frames in the record, the 5-minute record is decoded into p_record->mean.
+ */
+static hist_log_read_status_e
+hist_log_stream_decode_record(
+    hist_log_stream_t* const        p_stream,
+    hist_log_entry_t* const         p_entry,
+    const uint32_t                  num_channels,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
+{
+    hist_log_record_data_t* const p_channels[HIST_LOG_ROLLUP_NUM_CHANNELS] = {
+        &p_record->mean,
+        &p_record->min,
+        &p_record->max,
+    };
+    for (uint32_t i = 0; i < num_channels; ++i)
+    {
+        uint32_t     timestamp = 0;
+        uint32_t     seq       = 0;
+        const size_t len       = hist_log_codec_decode(
+            &p_stream->codec_state[i],
+            &hist_log_entry_get_data(p_entry)[p_entry->pos],
+            p_entry->len - p_entry->pos,
+            &timestamp,
+            &seq,
+            p_channels[i]);
+        if ((0 == len) || ((0 != i) && ((timestamp != *p_timestamp) || (seq != *p_seq))))
+        {
+            hist_log_stream_invalidate(p_stream);
+            p_entry->pos = p_entry->len;
+            return HIST_LOG_READ_STATUS_ERR_CODEC;
+        }
+        *p_timestamp = timestamp;
+        *p_seq       = seq;
+        p_entry->pos += len;
+    }
+    return HIST_LOG_READ_STATUS_OK;
+}
+
+static bool
+hist_log_rollup_feed(
+    const hist_log_tier_e                 tier_first,
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record);
+
+static void
+hist_log_rollup_flush_all(void);
+
+static void
+hist_log_cache_load(void);
+
+static hist_log_cursor_t*
+hist_log_cursor_alloc(
+    const hist_log_tier_e tier,
+    const uint32_t        timestamp_start,
+    const bool            flag_after_seq,
+    const uint32_t        after_seq);
+
+/**
+ * @brief Get the sequence number of the oldest record of the tier.
+ * @details Sequence numbers can have gaps if writing failed, so it can be less than the actual one.
+ * @return The next sequence number if the tier is empty.
+ */
+static uint32_t
+hist_log_sector_dir_get_seq_first(const hist_log_tier_t* const p_tier)
+{
+    const struct fcb* const p_fcb    = &p_tier->fcb;
+    const uint32_t          num_used = hist_log_sector_dir_get_num_used(p_fcb);
+    for (uint32_t i = 0; i < num_used; ++i)
+    {
+        const hist_log_sector_dir_entry_t* const p_entry
+            = &g_hist_log_sector_dir[hist_log_sector_dir_conv_logical_idx(p_fcb, i)];
+        if (0 != p_entry->num_records)
+        {
+            return p_entry->seq_last - p_entry->num_records + 1U;
+        }
+    }
+    return p_tier->seq_next;
+}
+
+static void
+hist_log_epochs_reset(void)
+{
+    hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    memset(p_epochs, 0, sizeof(*p_epochs));
+    p_epochs->version    = HIST_LOG_FCB_FMT_VERSION;
+    p_epochs->num_epochs = 1;
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        // Sequence numbers start from 1
+        p_epochs->epochs[0].seq_first[i] = 1U;
+    }
+    // The first epoch is started with the valid RTC time
+    p_epochs->epochs[0].is_time_offset_known = true;
+}
+
+static const hist_log_epoch_t*
+hist_log_epochs_get_current(void)
+{
+    return &g_hist_log_epochs.epochs[g_hist_log_epochs.num_epochs - 1];
+}
+
+/**
+ * @brief Load the time epochs from settings, it is done before rebuilding the sector directory,
+ * because the rollup state is restored only from the records of the current epoch.
+ */
+static void
+hist_log_epochs_load(void)
+{
+#if HIST_LOG_KEEP_ON_RTC_LOSS
+    hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    if (hist_log_settings_load(HIST_LOG_EPOCHS_SETTINGS_KEY, p_epochs, sizeof(*p_epochs))
+        && (HIST_LOG_FCB_FMT_VERSION == p_epochs->version) && (0 != p_epochs->num_epochs)
+        && (p_epochs->num_epochs <= HIST_LOG_MAX_EPOCHS))
+    {
+        return;
+    }
+    TLOG_INF("hist_log epochs are not found");
+#endif
+    // Without CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS the history is erased when the RTC time is lost,
+    // so all the records are written with the same clock
+    hist_log_epochs_reset();
+}
+
+static void
+hist_log_epochs_save(void)
+{
+#if HIST_LOG_KEEP_ON_RTC_LOSS
+    const zephyr_api_ret_t rc
+        = settings_save_one(HIST_LOG_EPOCHS_SETTINGS_KEY, &g_hist_log_epochs, sizeof(g_hist_log_epochs));
+    if (0 != rc)
+    {
+        TLOG_ERR("settings_save_one failed for hist_log epochs, rc=%d", rc);
+    }
+#endif
+}
+
+/**
+ * @brief Check that the epochs match the records in flash, e.g. the storage could be erased without deleting them.
+ */
+static bool
+hist_log_epochs_is_valid(void)
+{
+    const hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    for (uint32_t i = 0; i < p_epochs->num_epochs; ++i)
+    {
+        for (uint32_t tier = 0; tier < HIST_LOG_NUM_TIERS; ++tier)
+        {
+            const uint32_t seq_first = p_epochs->epochs[i].seq_first[tier];
+            if ((seq_first > g_hist_log_tiers[tier].seq_next)
+                || ((0 != i) && (seq_first < p_epochs->epochs[i - 1].seq_first[tier])))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Check if all the records of the oldest epoch were rotated out of all the tiers.
+ */
+static bool
+hist_log_epochs_is_oldest_obsolete(void)
+{
+    const hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    if (p_epochs->num_epochs < 2)
+    {
+        return false;
+    }
+    for (uint32_t tier = 0; tier < HIST_LOG_NUM_TIERS; ++tier)
+    {
+        if (hist_log_sector_dir_get_seq_first(&g_hist_log_tiers[tier]) < p_epochs->epochs[1].seq_first[tier])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+hist_log_epochs_drop_oldest(void)
+{
+    hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    p_epochs->num_epochs -= 1;
+    memmove(&p_epochs->epochs[0], &p_epochs->epochs[1], p_epochs->num_epochs * sizeof(p_epochs->epochs[0]));
+}
+
+/**
+ * @brief Start a new time epoch after the RTC time was lost.
+ * @details The pending time buckets of the rollup tiers are completed first,
+ * so that the records of the previous epoch are not aggregated together with the records of the new one.
+ */
+static void
+hist_log_epochs_start_new(void)
+{
+    hist_log_rollup_flush_all();
+    hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    while (hist_log_epochs_is_oldest_obsolete())
+    {
+        hist_log_epochs_drop_oldest();
+    }
+    if (HIST_LOG_MAX_EPOCHS == p_epochs->num_epochs)
+    {
+        TLOG_WRN("Too many hist_log epochs, the oldest one is dropped");
+        hist_log_epochs_drop_oldest();
+    }
+    hist_log_epoch_t* const p_epoch = &p_epochs->epochs[p_epochs->num_epochs];
+    for (uint32_t tier = 0; tier < HIST_LOG_NUM_TIERS; ++tier)
+    {
+        p_epoch->seq_first[tier] = g_hist_log_tiers[tier].seq_next;
+    }
+    p_epoch->time_offset_s        = 0;
+    p_epoch->is_time_offset_known = false;
+    p_epochs->num_epochs += 1;
+}
+
+/**
+ * @brief Check the epochs loaded before rebuilding the sector directory and start a new one if the RTC was reset.
+ */
+static void
+hist_log_epochs_init(const bool is_rtc_valid)
+{
+    bool flag_save = false;
+    if (!hist_log_epochs_is_valid())
+    {
+        TLOG_WRN("hist_log epochs do not match the records in flash");
+        hist_log_epochs_reset();
+        flag_save = true;
+    }
+    if (!is_rtc_valid)
+    {
+        hist_log_epochs_start_new();
+        flag_save = true;
+    }
+    if (flag_save)
+    {
+        hist_log_epochs_save();
+    }
+    const hist_log_epoch_t* const p_epoch = hist_log_epochs_get_current();
+    TLOG_INF(
+        "hist_log epoch %u: first seq: %u/%u/%u, time offset: %d s",
+        (unsigned)g_hist_log_epochs.num_epochs,
+        (unsigned)p_epoch->seq_first[HIST_LOG_TIER_5MIN],
+        (unsigned)p_epoch->seq_first[HIST_LOG_TIER_1HOUR],
+        (unsigned)p_epoch->seq_first[HIST_LOG_TIER_1DAY],
+        (int)p_epoch->time_offset_s);
+}
+
+/**
+ * @brief Get the time offset of the epoch in which the record was written.
+ */
+static int32_t
+hist_log_epochs_get_time_offset(const hist_log_tier_e tier, const uint32_t seq)
+{
+    const hist_log_epochs_t* const p_epochs = &g_hist_log_epochs;
+    for (uint32_t i = p_epochs->num_epochs; i > 0; --i)
+    {
+        const hist_log_epoch_t* const p_epoch = &p_epochs->epochs[i - 1];
+        if (seq >= p_epoch->seq_first[tier])
+        {
+            return p_epoch->time_offset_s;
+        }
+    }
+    // The epoch of the record was dropped
+    return 0;
+}
+
+/**
+ * @brief Get the time offset of the epoch in which the record read by the cursor was written.
+ * @details The offset of the current epoch is taken when the cursor is opened: it is set when the first client
+ * sends the real time, and the records which are read after that must not jump relative to the previous ones.
+ */
+static int32_t
+hist_log_cursor_get_epoch_time_offset(const hist_log_cursor_t* const p_cursor, const uint32_t seq)
+{
+    if (seq >= hist_log_epochs_get_current()->seq_first[p_cursor->tier])
+    {
+        return p_cursor->time_offset_s;
+    }
+    return hist_log_epochs_get_time_offset(p_cursor->tier, seq);
+}
+
+/**
+ * @brief Convert the timestamp of the local clock to the real time using the offset of the epoch of the record.
+ */
+static uint32_t
+hist_log_cursor_rebase_timestamp(const hist_log_cursor_t* const p_cursor, const uint32_t seq, const uint32_t timestamp)
+{
+    return timestamp + (uint32_t)hist_log_cursor_get_epoch_time_offset(p_cursor, seq);
+}
+
+/**
+ * @brief Convert timestamp_start of the cursor to the local clock of the current epoch to search in the sectors.
+ * @return 0 if the tier contains the records of the previous epochs, their local timestamps are not comparable
+ * with the current ones, so the sectors can't be skipped by the timestamp.
+ */
+static uint32_t
+hist_log_cursor_get_local_timestamp_start(const hist_log_cursor_t* const p_cursor)
+{
+    const hist_log_epoch_t* const p_epoch = hist_log_epochs_get_current();
+    if (hist_log_sector_dir_get_seq_first(&g_hist_log_tiers[p_cursor->tier]) < p_epoch->seq_first[p_cursor->tier])
+    {
+        return 0;
+    }
+    const int64_t timestamp_local = (int64_t)p_cursor->timestamp_start - p_cursor->time_offset_s;
+    if (timestamp_local < 0)
+    {
+        return 0;
+    }
+    return (timestamp_local > UINT32_MAX) ? UINT32_MAX : (uint32_t)timestamp_local;
+}
+
+typedef struct hist_log_sector_dir_rebuild_ctx_t
+{
+    hist_log_tier_e   tier;
+    hist_log_tier_t*  p_tier;
+    hist_log_stream_t decoder;
+    hist_log_entry_t  entry;
+    uint32_t          err_cnt;
+    //! Number of sectors starting from the oldest one, whose directory entries were restored from the checkpoint
+    uint32_t num_restored;
+    //! The newest record of the next tier in the current epoch,
+    //! the records after it are aggregated again to restore the rollup state
+    bool     flag_next_tier_has_records;
+    uint32_t next_tier_timestamp_last;
+} hist_log_sector_dir_rebuild_ctx_t;
+
+/**
+ * @brief Restore the accumulator of the next tier, which is lost on reboot.
+ * @details The records which are already aggregated into the next tier are skipped,
+ * as well as the records of the previous epochs, whose time buckets were completed when the new epoch started.
+ * If the next tier missed a rollup record (e.g. due to power loss), it is written now.
+ */
+static void
+hist_log_sector_dir_rebuild_restore_rollup(
+    hist_log_sector_dir_rebuild_ctx_t* const p_ctx,
+    const uint32_t                           timestamp,
+    const uint32_t                           seq,
+    const hist_log_rollup_record_t* const    p_record)
+{
+    if (((p_ctx->tier + 1) >= HIST_LOG_NUM_TIERS) || (seq < hist_log_epochs_get_current()->seq_first[p_ctx->tier]))
+    {
+        return;
+    }
+    const hist_log_tier_e    tier_next = (hist_log_tier_e)(p_ctx->tier + 1);
+    hist_log_rollup_t* const p_rollup  = &g_hist_log_tiers[tier_next].rollup;
+    if (p_ctx->flag_next_tier_has_records
+        && (hist_log_rollup_get_bucket(p_rollup, timestamp) <= p_ctx->next_tier_timestamp_last))
+    {
+        hist_log_rollup_init(p_rollup, p_rollup->period_s);
+        return;
+    }
+    (void)hist_log_rollup_feed(tier_next, timestamp, p_record);
+}
+
+/**
+ * @brief Find the first sector to decode when the directory entries of the first num_restored sectors are restored.
+ * @details The records which are not yet aggregated into the next tier can be in the sectors before the checkpoint,
+ * so decoding starts from the sector where the time bucket after the newest record of the next tier begins,
+ * but not earlier than the first record of the current epoch.
+ * @return Logical index of the first sector to decode.
+ */
+static uint32_t
+hist_log_sector_dir_rebuild_get_first_sector(const hist_log_sector_dir_rebuild_ctx_t* const p_ctx)
+{
+    if ((p_ctx->tier + 1) >= HIST_LOG_NUM_TIERS)
+    {
+        return p_ctx->num_restored;
+    }
+    const uint32_t                 seq_first = hist_log_epochs_get_current()->seq_first[p_ctx->tier];
+    const hist_log_rollup_t* const p_rollup  = &g_hist_log_tiers[p_ctx->tier + 1].rollup;
+    const struct fcb* const        p_fcb     = &p_ctx->p_tier->fcb;
+    for (uint32_t i = p_ctx->num_restored; i > 0; --i)
+    {
+        const hist_log_sector_dir_entry_t* const p_entry
+            = &g_hist_log_sector_dir[hist_log_sector_dir_conv_logical_idx(p_fcb, i - 1)];
+        if (0 == p_entry->num_records)
+        {
+            continue;
+        }
+        if (p_entry->seq_last < seq_first)
+        {
+            return i;
+        }
+        if (p_ctx->flag_next_tier_has_records
+            && (hist_log_rollup_get_bucket(p_rollup, p_entry->timestamp_first) <= p_ctx->next_tier_timestamp_last))
+        {
+            return i - 1;
+        }
+    }
+    return 0;
+}
+
+static void
+hist_log_sector_dir_rebuild_entry(
+    hist_log_sector_dir_rebuild_ctx_t* const p_ctx,
+    hist_log_read_ahead_t* const             p_ra,
+    const struct fcb_entry* const            p_loc)
+{
+    // The records of the restored sectors are decoded only to restore the rollup state
+    const bool flag_add_to_dir
+        = hist_log_sector_dir_get_logical_idx(&p_ctx->p_tier->fcb, p_loc->fe_sector) >= p_ctx->num_restored;
+    if (HIST_LOG_READ_STATUS_OK
+        != hist_log_stream_read_entry(&p_ctx->decoder, p_ra, &p_ctx->p_tier->fcb, p_loc, &p_ctx->entry))
+    {
+        p_ctx->err_cnt += 1;
+        return;
+    }
+    while (p_ctx->entry.pos < p_ctx->entry.len)
+    {
+        uint32_t                 timestamp = 0;
+        uint32_t                 seq       = 0;
+        hist_log_rollup_record_t record    = { 0 };
+        if (HIST_LOG_READ_STATUS_OK
+            != hist_log_stream_decode_record(
+                &p_ctx->decoder,
+                &p_ctx->entry,
+                p_ctx->p_tier->num_channels,
+                &timestamp,
+                &seq,
+                &record))
+        {
+            p_ctx->err_cnt += 1;
+            break;
+        }
+        if (1 == p_ctx->p_tier->num_channels)
+        {
+            record.min = record.mean;
+            record.max = record.mean;
+        }
+        if (flag_add_to_dir)
+        {
+            hist_log_sector_dir_add_record(p_loc->fe_sector, timestamp, seq);
+            hist_log_zone_map_add(hist_log_sector_dir_get_zone_map(p_loc->fe_sector), &record);
+        }
+        hist_log_sector_dir_rebuild_restore_rollup(p_ctx, timestamp, seq, &record);
+    }
+}
+
+static void
+hist_log_sector_dir_rebuild(const hist_log_tier_e tier)
+{
+    const int64_t          time_start = k_uptime_get();
+    hist_log_tier_t* const p_tier     = &g_hist_log_tiers[tier];
+    struct fcb* const      p_fcb      = &p_tier->fcb;
+    for (uint32_t i = 0; i < p_fcb->f_sector_cnt; ++i)
+    {
+        hist_log_sector_dir_clear_entry(&p_fcb->f_sectors[i]);
+    }
+    static hist_log_sector_dir_rebuild_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.tier         = tier;
+    ctx.p_tier       = p_tier;
+    ctx.num_restored = hist_log_checkpoint_restore(p_tier, tier);
+    hist_log_stream_reset(&ctx.decoder);
+    if ((tier + 1) < HIST_LOG_NUM_TIERS)
+    {
+        const hist_log_sector_dir_entry_t* const p_newest = hist_log_sector_dir_get_newest(&g_hist_log_tiers[tier + 1]);
+        if ((NULL != p_newest) && (p_newest->seq_last >= hist_log_epochs_get_current()->seq_first[tier + 1]))
+        {
+            ctx.flag_next_tier_has_records = true;
+            ctx.next_tier_timestamp_last   = p_newest->timestamp_last;
+        }
+    }
+
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    hist_log_read_ahead_t* const p_ra = &g_hist_log_read_ahead;
+    hist_log_read_ahead_invalidate(p_ra);
+    p_ra->num_flash_reads = 0;
+    hist_log_flash_map_acquire();
+    // fe_sector=NULL means starting from the oldest sector,
+    // fe_elem_off=0 means starting from the first entry in fe_sector
+    const uint32_t   first_sector = hist_log_sector_dir_rebuild_get_first_sector(&ctx);
+    struct fcb_entry loc          = { 0 };
+    if (0 != first_sector)
+    {
+        loc.fe_sector = &g_hist_log_sectors[hist_log_sector_dir_conv_logical_idx(p_fcb, first_sector)];
+    }
+    zephyr_api_ret_t rc = 0;
+    while (true)
+    {
+        rc = hist_log_read_ahead_getnext(p_ra, p_fcb, &loc);
+        if (0 != rc)
+        {
+            break;
+        }
+        hist_log_sector_dir_rebuild_entry(&ctx, p_ra, &loc);
+    }
+    hist_log_flash_map_release();
+    const uint32_t num_flash_reads = p_ra->num_flash_reads;
+    k_mutex_unlock(&g_hist_log_mutex);
+    if (-ENOTSUP != rc)
+    {
+        TLOG_ERR("Failed to read FCB entry: %d", rc);
+    }
+    // Continue delta encoding in the active sector from the last record.
+    // If the last record in the active sector is corrupted, the next record is written as a key frame.
+    hist_log_stream_reset(&p_tier->encoder);
+    if ((-ENOTSUP == rc) && (ctx.decoder.p_sector == p_fcb->f_active.fe_sector))
+    {
+        p_tier->encoder = ctx.decoder;
+    }
+    p_tier->sector_dir_is_ordered = false;
+    hist_log_sector_dir_update_order(p_tier);
+    // Sequence numbers start from 1, so that the reader can request all the records as "after 0"
+    const hist_log_sector_dir_entry_t* const p_newest = hist_log_sector_dir_get_newest(p_tier);
+    p_tier->seq_next = (NULL != p_newest) ? (p_newest->seq_last + 1U) : 1U;
+
+    uint32_t num_records = 0;
+    for (uint32_t i = 0; i < p_fcb->f_sector_cnt; ++i)
+    {
+        num_records += g_hist_log_sector_dir[hist_log_sector_get_idx(&p_fcb->f_sectors[i])].num_records;
+    }
+    TLOG_INF(
+        "Sector directory of tier %s rebuilt: %u records, %u bad records, %u sectors in use, "
+        "%u sectors restored from checkpoint, %u sectors decoded, %u flash reads, next seq: %u, time: %u ms",
+        p_tier->p_name,
+        (unsigned)num_records,
+        (unsigned)ctx.err_cnt,
+        (unsigned)hist_log_sector_dir_get_num_used(p_fcb),
+        (unsigned)ctx.num_restored,
+        (unsigned)(hist_log_sector_dir_get_num_used(p_fcb) - first_sector),
+        (unsigned)num_flash_reads,
+        (unsigned)p_tier->seq_next,
+        (unsigned)(k_uptime_get() - time_start));
+}
+
+/**
+ * @brief Find the first sector which can contain records with timestamp >= timestamp_start and seq >= seq_start.
+ * @details Sequence numbers grow in the order of writing, so the sectors can always be skipped by seq_start,
+ * while the timestamps can be used only if the sector directory is ordered.
+ * @return Pointer to the sector or NULL if reading should start from the oldest sector.
+ */
+static struct flash_sector*
+hist_log_sector_dir_find_first_sector(
+    const hist_log_tier_t* const p_tier,
+    const uint32_t               timestamp_start,
+    const uint32_t               seq_start)
+{
+    const struct fcb* const p_fcb = &p_tier->fcb;
+    if ((!p_tier->sector_dir_is_ordered) && (0 == seq_start))
+    {
+        return NULL;
+    }
+    uint32_t idx_lo = 0;
+    uint32_t idx_hi = hist_log_sector_dir_get_num_used(p_fcb) - 1;
+    // Binary search for the first sector with timestamp_last >= timestamp_start and seq_last >= seq_start.
+    // The active sector is never skipped, it can be empty (only the active sector can be empty).
+    while (idx_lo < idx_hi)
+    {
+        const uint32_t                           idx_mid = idx_lo + ((idx_hi - idx_lo) / 2);
+        const hist_log_sector_dir_entry_t* const p_entry
+            = &g_hist_log_sector_dir[hist_log_sector_dir_conv_logical_idx(p_fcb, idx_mid)];
+        const bool is_older = (p_entry->seq_last < seq_start)
+                              || (p_tier->sector_dir_is_ordered && (p_entry->timestamp_last < timestamp_start));
+        if ((0 != p_entry->num_records) && is_older)
+        {
+            idx_lo = idx_mid + 1;
+        }
+        else
+        {
+            idx_hi = idx_mid;
+        }
+    }
+    if (0 == idx_lo)
+    {
+        return NULL;
+    }
+    TLOG_DBG("Sector directory: skip %u sectors", (unsigned)idx_lo);
+    return &g_hist_log_sectors[hist_log_sector_dir_conv_logical_idx(p_fcb, idx_lo)];
+}
+
+/**
+ * @brief Calculate the space occupied by an FCB entry in flash: the length field, the data and the end marker.
+ */
+static uint32_t
+hist_log_fcb_get_entry_size(const struct fcb* const p_fcb, const uint32_t data_len)
+{
+    const uint32_t len_field = (data_len <= HIST_LOG_FCB_LEN_FIELD_SHORT_MAX) ? 1 : HIST_LOG_FCB_LEN_FIELD_LONG_SIZE;
+    return hist_log_fcb_len_in_flash(p_fcb, len_field) + hist_log_fcb_len_in_flash(p_fcb, data_len)
+           + hist_log_fcb_len_in_flash(p_fcb, HIST_LOG_FCB_ENDMARKER_SIZE);
+}
+
+/**
+ * @brief Check if the first record of the next entry must be written as a key frame.
+ * @details fcb_append() moves to the next sector if the entry does not fit into the active one,
+ * so a key frame is used if the longest possible entry does not fit.
+ * In this case a delta frame is also guaranteed to be in the same sector as the previous record.
+ */
+static bool
+hist_log_is_key_frame_required(const hist_log_tier_t* const p_tier)
+{
+    const struct fcb* const p_fcb = &p_tier->fcb;
+    if (p_tier->encoder.p_sector != p_fcb->f_active.fe_sector)
+    {
+        return true;
+    }
+    for (uint32_t i = 0; i < p_tier->num_channels; ++i)
+    {
+        if (!p_tier->encoder.codec_state[i].is_valid)
+        {
+            return true;
+        }
+    }
+    const uint32_t entry_size = hist_log_fcb_get_entry_size(p_fcb, p_tier->max_entry_len);
+    return (p_fcb->f_active.fe_elem_off + entry_size) > p_fcb->f_active.fe_sector->fs_size;
+}
+
+/**
+ * @brief Erase the oldest sector of the tier, the records in it are lost.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static bool
+hist_log_tier_rotate(hist_log_tier_t* const p_tier)
+{
+    struct fcb* const p_fcb = &p_tier->fcb;
+#if HIST_LOG_TEST_FILL_ALL_STORAGE
+    if (p_tier == &g_hist_log_tiers[HIST_LOG_TIER_5MIN])
+    {
+        g_hist_log_full = true;
+    }
+#endif
+    const struct flash_sector* const p_erased_sector = p_fcb->f_oldest;
+
+    g_hist_log_sector_erase_cnt[hist_log_sector_get_idx(p_erased_sector)] += 1;
+    hist_log_read_ahead_invalidate(&g_hist_log_read_ahead);
+    const zephyr_api_ret_t rc = fcb_rotate(p_fcb);
+    if (0 != rc)
+    {
+        TLOG_ERR("fcb_rotate failed: %d", rc);
+        return false;
+    }
+    hist_log_sector_dir_clear_entry(p_erased_sector);
+    return true;
+}
+
+#if HIST_LOG_PRE_ERASE
+/**
+ * @brief Check if the oldest sector of the tier must be erased before the active sector is filled.
+ * @details fcb_append() fails with -ENOSPC when the entry does not fit into the active sector
+ * and only the scratch sectors are free, so the tier is rotated in advance
+ * when the active sector has space only for a few of the longest entries.
+ */
+static bool
+hist_log_tier_is_pre_erase_needed(hist_log_tier_t* const p_tier)
+{
+    struct fcb* const p_fcb = &p_tier->fcb;
+    if (fcb_free_sector_cnt(p_fcb) > p_fcb->f_scratch_cnt)
+    {
+        return false;
+    }
+    const uint32_t entry_size = hist_log_fcb_get_entry_size(p_fcb, p_tier->max_entry_len);
+    return (p_fcb->f_active.fe_elem_off + (HIST_LOG_PRE_ERASE_NUM_ENTRIES * entry_size))
+           > p_fcb->f_active.fe_sector->fs_size;
+}
+#endif
+
+/**
+ * @brief Do the maintenance after an entry is written to the tier: pre-erase and saving the checkpoint.
+ * @details Both of them may erase a flash sector (of the FCB or of the settings storage),
+ * so they are handed over to the low-priority work queue, and the append path does not wait for the erase.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static void
+hist_log_maintenance_schedule(hist_log_tier_t* const p_tier)
+{
+#if HIST_LOG_PRE_ERASE
+    if (g_hist_log_work_q_is_started)
+    {
+        if (hist_log_tier_is_pre_erase_needed(p_tier) || hist_log_checkpoint_is_update_needed())
+        {
+            (void)k_work_submit_to_queue(&g_hist_log_work_q, &g_hist_log_maintenance_work);
+        }
+        return;
+    }
+#else
+    ARG_UNUSED(p_tier);
+#endif
+    hist_log_checkpoint_update();
+}
+
+#if HIST_LOG_PRE_ERASE
+/**
+ * @brief Erase the oldest sector of every tier whose active sector is almost filled and save the checkpoint.
+ * @details The mutex is held during the erase, so a reader or an append which comes at this moment waits for it,
+ * but with the 5-minute period of the records the erase is normally finished long before the next append.
+ */
+static void
+hist_log_maintenance_work_handler(struct k_work* p_work)
+{
+    ARG_UNUSED(p_work);
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        hist_log_tier_t* const p_tier = &g_hist_log_tiers[i];
+        if (!hist_log_tier_is_pre_erase_needed(p_tier))
+        {
+            continue;
+        }
+        if (0 != g_hist_log_sector_num_readers[hist_log_sector_get_idx(p_tier->fcb.f_oldest)])
+        {
+            // The work is submitted again when the reader leaves the sector.
+            // If the sector is needed before that, the append path erases it and the reader gets INVALIDATED.
+            TLOG_INF("Pre-erase of tier %s is deferred: a reader is inside the oldest sector", p_tier->p_name);
+            g_hist_log_stats.num_pre_erases_deferred += 1;
+            continue;
+        }
+        TLOG_INF("Pre-erase the oldest sector of tier %s", p_tier->p_name);
+        if (hist_log_tier_rotate(p_tier))
+        {
+            g_hist_log_stats.num_pre_erases += 1;
+        }
+    }
+    hist_log_checkpoint_update();
+    k_mutex_unlock(&g_hist_log_mutex);
+}
+#endif
+
+/**
+ * @brief Start the work queue on the first initialization and check if any tier needs the pre-erase now.
+ */
+static void
+hist_log_maintenance_start(void)
+{
+#if HIST_LOG_PRE_ERASE
+    if (!g_hist_log_work_q_is_started)
+    {
+        const struct k_work_queue_config cfg = {
+            .name     = "hist_log_erase",
+            .no_yield = false,
+        };
+        k_work_queue_start(
+            &g_hist_log_work_q,
+            g_hist_log_work_q_stack,
+            K_THREAD_STACK_SIZEOF(g_hist_log_work_q_stack),
+            K_LOWEST_APPLICATION_THREAD_PRIO,
+            &cfg);
+        g_hist_log_work_q_is_started = true;
+    }
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        hist_log_maintenance_schedule(&g_hist_log_tiers[i]);
+    }
+#endif
+}
+
+static bool
+hist_log_check_flash_driver(void)
+{
+    const struct flash_area* fa = NULL;
+    int32_t                  rc = flash_area_open(HIST_LOG_FLASH_AREA_ID, &fa);
+    if (0 != rc)
+    {
+        LOG_ERR("flash_area_open failed, rc=%d", rc);
+        return false;
+    }
+    if (flash_area_has_driver(fa) <= 0)
+    {
+        LOG_ERR("flash_area_has_driver failed");
+        return false;
+    }
+
+    uint32_t block_size = flash_area_align(fa);
+    LOG_INF("flash_area_align: %d", block_size);
+
+    const struct device* p_device = flash_area_get_device(fa);
+    LOG_INF("flash_area_get_device: %p", p_device);
+
+    flash_area_close(fa);
+    return true;
+}
+#endif
+
+bool
+hist_log_init(const bool is_rtc_valid)
+{
+#if USE_HIST_LOG
+#if HIST_LOG_TEST_FILL_ALL_STORAGE
+    g_hist_log_full = false;
+#endif
+    if (!hist_log_check_flash_driver())
+    {
+        return false;
+    }
+    hist_log_flash_map_init();
+
+    if (!hist_log_check_sectors_count())
+    {
+        return false;
+    }
+    hist_log_maintenance_cancel();
+
+    if (!is_rtc_valid)
+    {
+#if HIST_LOG_KEEP_ON_RTC_LOSS
+        TLOG_WRN("RTC is not valid, start a new time epoch");
+#else
+        TLOG_WRN("RTC is not valid, erase flash storage");
+        if (!hist_log_erase_flash_storage())
+        {
+            TLOG_ERR("erase_flash_storage failed");
+            return false;
+        }
+#endif
+    }
+
+    const int64_t time_start = k_uptime_get();
+    if (!hist_log_fcb_init())
+    {
+        return false;
+    }
+    const int64_t time_fcb_init = k_uptime_get();
+
+    TLOG_INF("FCB initialized successfully");
+
+    hist_log_write_back_reset();
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        hist_log_rollup_init(&g_hist_log_tiers[i].rollup, g_hist_log_tiers[i].period_s);
+    }
+    const bool is_checkpoint_loaded = hist_log_checkpoint_load();
+#if HIST_LOG_CHECKPOINT
+    g_hist_log_checkpoint_is_loaded       = is_checkpoint_loaded;
+    g_hist_log_checkpoint_is_save_allowed = false;
+#endif
+    hist_log_epochs_load();
+    // The tiers are rebuilt starting from the coarsest one,
+    // so that the records which are not yet aggregated into the next tier are known.
+    hist_log_sector_dir_rebuild(HIST_LOG_TIER_1DAY);
+    hist_log_sector_dir_rebuild(HIST_LOG_TIER_1HOUR);
+    hist_log_sector_dir_rebuild(HIST_LOG_TIER_5MIN);
+    hist_log_epochs_init(is_rtc_valid);
+    const int64_t time_sector_dir = k_uptime_get();
+    hist_log_cache_load();
+    TLOG_INF(
+        "hist_log boot time: fcb_init: %u ms, sector directory: %u ms, cache: %u ms, checkpoint: %s",
+        (unsigned)(time_fcb_init - time_start),
+        (unsigned)(time_sector_dir - time_fcb_init),
+        (unsigned)(k_uptime_get() - time_sector_dir),
+        is_checkpoint_loaded ? "loaded" : "not found");
+#if HIST_LOG_CHECKPOINT
+    g_hist_log_checkpoint_is_save_allowed = true;
+#endif
+    // The checkpoint is saved now if it was not found or is stale, so that the next boot can use it
+    hist_log_checkpoint_update();
+    hist_log_maintenance_start();
+#endif
 
-    TLOG_INF("FCB initialized successfully");
-#endif
-
 #if HIST_LOG_TEST_FILL_ALL_STORAGE
 
-    uint32_t        timestamp = time(NULL);
-    re_e1_seq_cnt_t cnt       = 0;
-    TLOG_WRN("Fill hist log storage with mock records...");
-    while (!g_hist_log_full)
+    uint32_t        timestamp = time(NULL);
+    re_e1_seq_cnt_t cnt       = 0;
+    TLOG_WRN("Fill hist log storage with mock records...");
+    while (!g_hist_log_full)
+    {
+        const re_e1_data_t e1_data = re_e1_data_invalid(cnt, 0);
+        uint8_t            buffer[RE_E1_DATA_LENGTH];
+        (void)re_e1_encode(buffer, &e1_data);
+        hist_log_record_data_t record_data = { 0 };
+        memcpy(&record_data.buf, buffer, sizeof(record_data.buf));
+
+        if (!hist_log_append_record(timestamp, &record_data, false))
+        {
+            TLOG_ERR("Failed to append record");
+            break;
+        }
+        timestamp += 5 * 60;
+        struct tm tm_time = { 0 };
+        gmtime_r(&(time_t) { timestamp }, &tm_time);
+        app_rtc_set_time(&tm_time);
+        cnt += 1;
+    }
+    TLOG_WRN("Hist log storage was filled with %u mock records", cnt);
+#endif
+
+    return true;
+}
+
+bool
+hist_log_erase(void)
+{
+#if USE_HIST_LOG
+    if (!hist_log_check_sectors_count())
+    {
+        return false;
+    }
+    TLOG_WRN("Erase flash storage");
+    if (!hist_log_erase_flash_storage())
+    {
+        TLOG_ERR("erase_flash_storage failed");
+        return false;
+    }
+#endif
+    return hist_log_init(true);
+}
+
+#if USE_HIST_LOG
+/**
+ * @brief Append CRC16 of the frames to the entry.
+ * @param p_buf Pointer to the buffer, it must have space for CRC16 after the frames.
+ * @return Length of the entry with CRC16.
+ */
+static size_t
+hist_log_entry_append_crc(uint8_t* const p_buf, const size_t len)
+{
+    const uint16_t crc16 = crc16_ccitt(CRC16_CCITT_INITIAL_VALUE, p_buf, len);
+    p_buf[len]           = crc16 & BYTE_MASK;
+    p_buf[len + 1]       = (crc16 >> BYTE_SHIFT_1) & BYTE_MASK;
+    return len + HIST_LOG_ENTRY_CRC_SIZE;
+}
+
+/**
+ * @brief Write the entry to the FCB of the tier, the oldest sector is erased if the tier is full.
+ * @param[out] p_loc Pointer to the location of the written entry.
+ */
+static bool
+hist_log_tier_write_entry(
+    hist_log_tier_t* const  p_tier,
+    const uint8_t* const    p_buf,
+    const size_t            len,
+    const uint32_t          num_records,
+    const bool              flag_print_log,
+    struct fcb_entry* const p_loc)
+{
+    struct fcb* const p_fcb = &p_tier->fcb;
+
+    // Step 1: Allocate space for the new entry in FCB
+    zephyr_api_ret_t rc = fcb_append(p_fcb, len, p_loc);
+    if (0 != rc)
+    {
+        if (-ENOSPC != rc)
+        {
+            TLOG_ERR("Failed to allocate space for FCB record in tier %s: %d", p_tier->p_name, rc);
+            return false;
+        }
+        // fcb_append() returns -ENOSPC only if the entry does not fit into the active sector,
+        // so the first record in the entry is already encoded as a key frame.
+        // If the pre-erase is enabled, it happens only if the work queue did not run before the sector was filled.
+        TLOG_WRN("FCB of tier %s is full, rotate", p_tier->p_name);
+        g_hist_log_stats.num_inline_erases += 1;
+        if (!hist_log_tier_rotate(p_tier))
+        {
+            return false;
+        }
+        rc = fcb_append(p_fcb, len, p_loc);
+        if (0 != rc)
+        {
+            TLOG_ERR("fcb_append failed: %d", rc);
+            return false;
+        }
+    }
+
+    // Step 2: Write the data to flash
+    off_t write_off = p_loc->fe_sector->fs_off + p_loc->fe_data_off;
+    if (flag_print_log)
+    {
+        TLOG_INF(
+            "Write entry to tier %s: records=%u, len=%u, write_off=0x%08x, fs_off=0x%08x, fe_data_off=0x%04x",
+            p_tier->p_name,
+            (unsigned)num_records,
+            (unsigned)len,
+            (unsigned)write_off,
+            (unsigned)p_loc->fe_sector->fs_off,
+            (unsigned)p_loc->fe_data_off);
+    }
+    else
+    {
+        TLOG_DBG(
+            "Write entry to tier %s: records=%u, len=%u, write_off=0x%08x, fs_off=0x%08x, fe_data_off=0x%04x",
+            p_tier->p_name,
+            (unsigned)num_records,
+            (unsigned)len,
+            (unsigned)write_off,
+            (unsigned)p_loc->fe_sector->fs_off,
+            (unsigned)p_loc->fe_data_off);
+    }
+    LOG_HEXDUMP_DBG(p_buf, len, "Write entry");
+    rc = flash_area_write(p_fcb->fap, write_off, p_buf, len);
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_write failed: %d", rc);
+        return false;
+    }
+
+    // Step 3: Finalize the entry
+    rc = fcb_append_finish(p_fcb, p_loc);
+    if (0 != rc)
+    {
+        TLOG_ERR("fcb_append_finish failed: %d", rc);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Write the buffered records to flash as a single FCB entry.
+ * @note g_hist_log_mutex must be locked by the caller.
+ * @details The buffered records are dropped if writing fails.
+ */
+static bool
+hist_log_write_back_flush(const bool flag_print_log)
+{
+    hist_log_tier_t* const       p_tier = &g_hist_log_tiers[HIST_LOG_TIER_5MIN];
+    hist_log_write_back_t* const p_wb   = &g_hist_log_write_back;
+    if (0 == p_wb->num_records)
+    {
+        return true;
+    }
+    const size_t len = hist_log_entry_append_crc(p_wb->buf, p_wb->len);
+
+    // The encoder state is updated only after the entry is written successfully,
+    // the next record will be written as a key frame if writing fails.
+    hist_log_stream_reset(&p_tier->encoder);
+    const uint32_t            num_records = p_wb->num_records;
+    const hist_log_zone_map_t zone_map    = p_wb->zone_map;
+    hist_log_write_back_reset();
+
+    struct fcb_entry loc = { 0 };
+    if (!hist_log_tier_write_entry(p_tier, p_wb->buf, len, num_records, flag_print_log, &loc))
+    {
+        return false;
+    }
+    p_tier->encoder.codec_state[0] = p_wb->codec_state;
+    p_tier->encoder.p_sector       = loc.fe_sector;
+
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        hist_log_sector_dir_add_record(loc.fe_sector, p_wb->timestamps[i], p_wb->seq_first + i);
+    }
+    hist_log_zone_map_merge(hist_log_sector_dir_get_zone_map(loc.fe_sector), &zone_map);
+    hist_log_sector_dir_update_order(p_tier);
+    hist_log_maintenance_schedule(p_tier);
+    return true;
+}
+
+/**
+ * @brief Encode the record as the next frame of the write-back buffer.
+ * @param[in,out] p_codec_state Pointer to the encoder state, it is initialized here for the first record.
+ */
+static size_t
+hist_log_write_back_encode(
+    const uint32_t                      timestamp,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_data,
+    hist_log_codec_state_t* const       p_codec_state,
+    uint8_t* const                      p_buf)
+{
+    const hist_log_tier_t* const p_tier         = &g_hist_log_tiers[HIST_LOG_TIER_5MIN];
+    bool                         flag_key_frame = false;
+    if (0 == g_hist_log_write_back.num_records)
+    {
+        flag_key_frame = hist_log_is_key_frame_required(p_tier);
+        *p_codec_state = p_tier->encoder.codec_state[0];
+    }
+    else
+    {
+        *p_codec_state = g_hist_log_write_back.codec_state;
+    }
+    return hist_log_codec_encode(p_codec_state, timestamp, seq, p_data, flag_key_frame, p_buf);
+}
+
+/**
+ * @brief Add the newest record to the RAM cache, the oldest one is dropped if the cache is full.
+ * @note g_hist_log_mutex must be locked by the caller.
+ * @param timestamp Timestamp of the local clock.
+ */
+static void
+hist_log_cache_add(const uint32_t timestamp, const uint32_t seq, const hist_log_record_data_t* const p_data)
+{
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+    hist_log_cache_t* const p_cache = &g_hist_log_cache;
+    if (p_cache->seq_first == p_cache->seq_end)
+    {
+        p_cache->seq_first = seq;
+    }
+    p_cache->records[seq % HIST_LOG_CACHE_NUM_RECORDS] = (hist_log_cache_record_t) {
+        .timestamp = timestamp,
+        .seq       = seq,
+        .data      = *p_data,
+    };
+    p_cache->seq_end = seq + 1U;
+    if ((p_cache->seq_end - p_cache->seq_first) > HIST_LOG_CACHE_NUM_RECORDS)
+    {
+        p_cache->seq_first = p_cache->seq_end - HIST_LOG_CACHE_NUM_RECORDS;
+    }
+#else
+    ARG_UNUSED(timestamp);
+    ARG_UNUSED(seq);
+    ARG_UNUSED(p_data);
+#endif
+}
+
+/**
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static bool
+hist_log_write_back_add(const uint32_t timestamp, const hist_log_record_data_t* const p_data, const bool flag_print_log)
+{
+    hist_log_tier_t* const       p_tier = &g_hist_log_tiers[HIST_LOG_TIER_5MIN];
+    hist_log_write_back_t* const p_wb   = &g_hist_log_write_back;
+
+    bool                   res         = true;
+    const uint32_t         seq         = p_tier->seq_next;
+    hist_log_codec_state_t codec_state = { 0 };
+    uint8_t                buf[HIST_LOG_CODEC_MAX_FRAME_LEN];
+    size_t                 len = hist_log_write_back_encode(timestamp, seq, p_data, &codec_state, buf);
+    if ((p_wb->len + len + HIST_LOG_ENTRY_CRC_SIZE) > sizeof(p_wb->buf))
+    {
+        // The entry would not fit into a flash page, write the buffered records and start a new entry
+        res = hist_log_write_back_flush(flag_print_log);
+        len = hist_log_write_back_encode(timestamp, seq, p_data, &codec_state, buf);
+    }
+    if (0 == p_wb->num_records)
+    {
+        p_wb->start_state = p_tier->encoder.codec_state[0];
+        p_wb->seq_first   = seq;
+    }
+    memcpy(&p_wb->buf[p_wb->len], buf, len);
+    p_wb->len += len;
+    p_wb->timestamps[p_wb->num_records] = timestamp;
+    p_wb->num_records += 1;
+    const hist_log_rollup_record_t record = {
+        .mean = *p_data,
+        .min  = *p_data,
+        .max  = *p_data,
+    };
+    hist_log_zone_map_add(&p_wb->zone_map, &record);
+    p_wb->codec_state = codec_state;
+    p_tier->seq_next  = seq + 1U;
+    hist_log_cache_add(timestamp, seq, p_data);
+
+    if (flag_print_log)
+    {
+        TLOG_INF(
+            "Append record: seq=%u, time=%u, len=%u, buffered=%u/%u",
+            (unsigned)seq,
+            (unsigned)timestamp,
+            (unsigned)len,
+            (unsigned)p_wb->num_records,
+            (unsigned)HIST_LOG_WRITE_BACK_NUM_RECORDS);
+    }
+    else
+    {
+        TLOG_DBG(
+            "Append record: seq=%u, time=%u, len=%u, buffered=%u/%u",
+            (unsigned)seq,
+            (unsigned)timestamp,
+            (unsigned)len,
+            (unsigned)p_wb->num_records,
+            (unsigned)HIST_LOG_WRITE_BACK_NUM_RECORDS);
+    }
+    LOG_HEXDUMP_DBG(buf, len, "Append record");
+
+    if (p_wb->num_records >= HIST_LOG_WRITE_BACK_NUM_RECORDS)
+    {
+        if (!hist_log_write_back_flush(flag_print_log))
+        {
+            res = false;
+        }
+    }
+    return res;
+}
+
+/**
+ * @brief Take a copy of the write-back buffer if all the entries after p_loc have been read.
+ * @details The buffered records are delivered to the reader after the records in flash.
+ * If the buffer was written to flash while the reader was processing the previous records,
+ * the reader must continue reading from flash instead.
+ * @param p_loc Pointer to the last entry read from flash.
+ * @param[out] p_decoder Pointer to the decoder, it is set to the encoder state before the first buffered record.
+ * @param[out] p_entry Pointer to the entry to copy the buffered frames to.
+ * @return false if there are new entries in flash after p_loc.
+ */
+static bool
+hist_log_write_back_read(
+    struct fcb* const             p_fcb,
+    const struct fcb_entry* const p_loc,
+    hist_log_stream_t* const      p_decoder,
+    hist_log_entry_t* const       p_entry)
+{
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    struct fcb_entry loc = *p_loc;
+    if (0 == fcb_getnext(p_fcb, &loc))
+    {
+        k_mutex_unlock(&g_hist_log_mutex);
+        return false;
+    }
+    p_decoder->codec_state[0] = g_hist_log_write_back.start_state;
+    p_decoder->p_sector       = NULL;
+    memcpy(p_entry->buf, g_hist_log_write_back.buf, g_hist_log_write_back.len);
+    p_entry->p_mapped = NULL;
+    p_entry->len      = g_hist_log_write_back.len;
+    p_entry->pos      = 0;
+    k_mutex_unlock(&g_hist_log_mutex);
+    return true;
+}
+
+/**
+ * @brief Write the completed rollup record to flash as a separate FCB entry.
+ * @note g_hist_log_mutex must be locked by the caller (except during initialization).
+ */
+static bool
+hist_log_tier_append_rollup(
+    hist_log_tier_t* const                p_tier,
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record)
+{
+    const hist_log_record_data_t* const p_channels[HIST_LOG_ROLLUP_NUM_CHANNELS] = {
+        &p_record->mean,
+        &p_record->min,
+        &p_record->max,
+    };
+    hist_log_stream_t encoder        = p_tier->encoder;
+    const bool        flag_key_frame = hist_log_is_key_frame_required(p_tier);
+    const uint32_t    seq            = p_tier->seq_next;
+    uint8_t           buf[HIST_LOG_ROLLUP_ENTRY_MAX_LEN];
+    size_t            len = 0;
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_CHANNELS; ++i)
     {
-        const re_e1_data_t e1_data = re_e1_data_invalid(cnt, 0);
-        uint8_t            buffer[RE_E1_DATA_LENGTH];
-        (void)re_e1_encode(buffer, &e1_data);
-        hist_log_record_data_t record_data = { 0 };
-        memcpy(&record_data.buf, buffer, sizeof(record_data.buf));
+        len += hist_log_codec_encode(
+            &encoder.codec_state[i],
+            timestamp,
+            seq,
+            p_channels[i],
+            flag_key_frame,
+            &buf[len]);
+    }
+    // The sequence number is not reused even if writing fails
+    p_tier->seq_next = seq + 1U;
+    len = hist_log_entry_append_crc(buf, len);
 
-        if (!hist_log_append_record(timestamp, &record_data, false))
+    // The encoder state is updated only after the entry is written successfully
+    hist_log_stream_reset(&p_tier->encoder);
+    struct fcb_entry loc = { 0 };
+    if (!hist_log_tier_write_entry(p_tier, buf, len, 1, true, &loc))
+    {
+        return false;
+    }
+    encoder.p_sector = loc.fe_sector;
+    p_tier->encoder  = encoder;
+
+    hist_log_sector_dir_add_record(loc.fe_sector, timestamp, seq);
+    hist_log_zone_map_add(hist_log_sector_dir_get_zone_map(loc.fe_sector), p_record);
+    hist_log_sector_dir_update_order(p_tier);
+    hist_log_maintenance_schedule(p_tier);
+    return true;
+}
+
+/**
+ * @brief Aggregate the record into the rollup tier, the completed rollup records are aggregated into the next tiers.
+ */
+static bool
+hist_log_rollup_feed(
+    const hist_log_tier_e                 tier_first,
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record)
+{
+    bool                     res         = true;
+    uint32_t                 cur_time    = timestamp;
+    hist_log_rollup_record_t cur_record  = *p_record;
+    uint32_t                 next_time   = 0;
+    hist_log_rollup_record_t next_record = { 0 };
+    for (uint32_t tier = tier_first; tier < HIST_LOG_NUM_TIERS; ++tier)
+    {
+        hist_log_tier_t* const p_tier = &g_hist_log_tiers[tier];
+        if (!hist_log_rollup_add(&p_tier->rollup, cur_time, &cur_record, &next_time, &next_record))
         {
-            TLOG_ERR("Failed to append record");
             break;
         }
-        timestamp += 5 * 60;
-        struct tm tm_time = { 0 };
-        gmtime_r(&(time_t) { timestamp }, &tm_time);
-        app_rtc_set_time(&tm_time);
-        cnt += 1;
+        if (!hist_log_tier_append_rollup(p_tier, next_time, &next_record))
+        {
+            res = false;
+        }
+        cur_time   = next_time;
+        cur_record = next_record;
+    }
+    return res;
+}
+
+/**
+ * @brief Complete the pending time buckets of all the rollup tiers and write them to flash.
+ * @note g_hist_log_mutex must be locked by the caller (except during initialization).
+ */
+static void
+hist_log_rollup_flush_all(void)
+{
+    for (uint32_t tier = HIST_LOG_TIER_1HOUR; tier < HIST_LOG_NUM_TIERS; ++tier)
+    {
+        hist_log_tier_t* const   p_tier    = &g_hist_log_tiers[tier];
+        uint32_t                 timestamp = 0;
+        hist_log_rollup_record_t record    = { 0 };
+        if (!hist_log_rollup_flush(&p_tier->rollup, &timestamp, &record))
+        {
+            continue;
+        }
+        (void)hist_log_tier_append_rollup(p_tier, timestamp, &record);
+        if ((tier + 1) < HIST_LOG_NUM_TIERS)
+        {
+            (void)hist_log_rollup_feed((hist_log_tier_e)(tier + 1), timestamp, &record);
+        }
+    }
+}
+#endif
+
+bool
+hist_log_append_record(const uint32_t timestamp, const hist_log_record_data_t* const p_data, const bool flag_print_log)
+{
+#if USE_HIST_LOG
+    const hist_log_rollup_record_t record = {
+        .mean = *p_data,
+        .min  = *p_data,
+        .max  = *p_data,
+    };
+    // The waiting for the mutex is included, the append is delayed if a reader or the pre-erase holds it
+    const int64_t time_start = k_uptime_ticks();
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    bool res = hist_log_write_back_add(timestamp, p_data, flag_print_log);
+    if (!hist_log_rollup_feed(HIST_LOG_TIER_1HOUR, timestamp, &record))
+    {
+        res = false;
+    }
+    const uint32_t append_time_us = (uint32_t)k_ticks_to_us_near64((uint64_t)(k_uptime_ticks() - time_start));
+    if (append_time_us > g_hist_log_stats.append_time_max_us)
+    {
+        g_hist_log_stats.append_time_max_us = append_time_us;
+    }
+    k_mutex_unlock(&g_hist_log_mutex);
+    return res;
+#else
+    return true;
+#endif
+}
+
+bool
+hist_log_flush(void)
+{
+#if USE_HIST_LOG
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    const bool res = hist_log_write_back_flush(true);
+    // The checkpoint may be still waiting for the work queue
+    hist_log_checkpoint_update();
+    k_mutex_unlock(&g_hist_log_mutex);
+    return res;
+#else
+    return true;
+#endif
+}
+
+void
+hist_log_rebase_time(const int32_t time_offset_s)
+{
+#if USE_HIST_LOG
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    hist_log_epoch_t* const p_epoch = &g_hist_log_epochs.epochs[g_hist_log_epochs.num_epochs - 1];
+    // The offset is set once per epoch: every client has its own clock and the records must not jump between them
+    if (!p_epoch->is_time_offset_known)
+    {
+        p_epoch->time_offset_s        = time_offset_s;
+        p_epoch->is_time_offset_known = true;
+        TLOG_INF("hist_log epoch %u: time offset: %d s", (unsigned)g_hist_log_epochs.num_epochs, (int)time_offset_s);
+        hist_log_epochs_save();
+    }
+    k_mutex_unlock(&g_hist_log_mutex);
+#else
+    ARG_UNUSED(time_offset_s);
+#endif
+}
+
+int32_t
+hist_log_get_time_offset(void)
+{
+#if USE_HIST_LOG
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    const int32_t time_offset_s = hist_log_epochs_get_current()->time_offset_s;
+    k_mutex_unlock(&g_hist_log_mutex);
+    return time_offset_s;
+#else
+    return 0;
+#endif
+}
+
+#if USE_HIST_LOG
+static void
+hist_log_print_read_err(
+    const hist_log_read_status_e  status,
+    uint32_t* const               p_read_err_cnt,
+    uint32_t* const               p_decode_err_cnt,
+    const struct fcb_entry* const p_loc)
+{
+    uint32_t* const p_err_cnt = (HIST_LOG_READ_STATUS_ERR_FLASH == status) ? p_read_err_cnt : p_decode_err_cnt;
+    *p_err_cnt += 1;
+    if (*p_err_cnt < HIST_LOG_MAX_READ_ERR_PRINT_CNT)
+    {
+        TLOG_ERR(
+            "%s failed: fs_off=%x, fe_data_off=%x, fe_data_len=%u",
+            (HIST_LOG_READ_STATUS_ERR_FLASH == status) ? "flash_area_read" : "Decoding",
+            (NULL != p_loc->fe_sector) ? (unsigned)p_loc->fe_sector->fs_off : 0U,
+            (unsigned)p_loc->fe_data_off,
+            (unsigned)p_loc->fe_data_len);
+    }
+    else if (HIST_LOG_MAX_READ_ERR_PRINT_CNT == *p_err_cnt)
+    {
+        TLOG_ERR(
+            "Too many %s errors, suppressing further messages",
+            (HIST_LOG_READ_STATUS_ERR_FLASH == status) ? "read" : "decoding");
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+}
+
+/**
+ * @param seq_start Sequence number of the first record to read, 0 to read all the records.
+ */
+static void
+hist_log_cursor_init(
+    hist_log_cursor_t* const p_cursor,
+    const hist_log_tier_e    tier,
+    const uint32_t           timestamp_start,
+    const uint32_t           seq_start)
+{
+    memset(p_cursor, 0, sizeof(*p_cursor));
+    p_cursor->is_open         = true;
+    p_cursor->tier            = tier;
+    p_cursor->timestamp_start = timestamp_start;
+    p_cursor->time_offset_s   = hist_log_epochs_get_current()->time_offset_s;
+    p_cursor->seq_start       = seq_start;
+    p_cursor->seq_last        = (0 != seq_start) ? (seq_start - 1U) : 0;
+    hist_log_stream_reset(&p_cursor->decoder);
+    hist_log_stream_reset(&p_cursor->decoder_flash);
+}
+
+/**
+ * @brief Keep the flash mapped while the cursor can hold the entry in the mapped flash.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static void
+hist_log_cursor_use_flash_map(hist_log_cursor_t* const p_cursor, const bool is_used)
+{
+    if (is_used == p_cursor->is_flash_map_user)
+    {
+        return;
+    }
+    p_cursor->is_flash_map_user = is_used;
+    if (is_used)
+    {
+        hist_log_flash_map_acquire();
+    }
+    else
+    {
+        hist_log_flash_map_release();
+    }
+}
+
+/**
+ * @brief Register the sector which the cursor reads from, so that the pre-erase does not erase it under the reader.
+ * @note g_hist_log_mutex must be locked by the caller.
+ * @param p_sector Sector of the last entry read from flash, NULL if the cursor is closed or restarted.
+ */
+static void
+hist_log_cursor_set_reader_sector(hist_log_cursor_t* const p_cursor, const struct flash_sector* const p_sector)
+{
+    if (NULL == p_sector)
+    {
+        // The cursor does not hold an entry in the mapped flash
+        hist_log_cursor_use_flash_map(p_cursor, false);
+    }
+    const struct flash_sector* const p_sector_prev = p_cursor->p_reader_sector;
+    if (p_sector == p_sector_prev)
+    {
+        return;
+    }
+    if (NULL != p_sector)
+    {
+        g_hist_log_sector_num_readers[hist_log_sector_get_idx(p_sector)] += 1;
+    }
+    p_cursor->p_reader_sector = p_sector;
+    if (NULL == p_sector_prev)
+    {
+        return;
+    }
+    const uint32_t idx_prev = hist_log_sector_get_idx(p_sector_prev);
+    g_hist_log_sector_num_readers[idx_prev] -= 1;
+#if HIST_LOG_PRE_ERASE
+    if (0 != g_hist_log_sector_num_readers[idx_prev])
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        // The pre-erase could be deferred because of this reader
+        if ((g_hist_log_tiers[i].fcb.f_oldest == p_sector_prev) && g_hist_log_work_q_is_started)
+        {
+            (void)k_work_submit_to_queue(&g_hist_log_work_q, &g_hist_log_maintenance_work);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief Continue reading from the oldest record, the sector which the cursor pointed into was erased.
+ */
+static void
+hist_log_cursor_restart(hist_log_cursor_t* const p_cursor)
+{
+    // fe_sector=NULL means starting from the oldest sector
+    p_cursor->loc = (struct fcb_entry) { 0 };
+    hist_log_stream_reset(&p_cursor->decoder);
+    hist_log_stream_reset(&p_cursor->decoder_flash);
+    p_cursor->entry.p_mapped      = NULL;
+    p_cursor->entry.len           = 0;
+    p_cursor->entry.pos           = 0;
+    p_cursor->is_write_back       = false;
+    p_cursor->num_write_back_read = 0;
+    p_cursor->num_skip            = 0;
+}
+
+/**
+ * @brief Check if the sector of the entry in the memory-mapped flash was erased while the entry was decoded.
+ * @details The entry is decoded without locking the mutex. The erase counter is incremented before the sector
+ * is erased, so if it is not changed after decoding, the frames were read before erasing started.
+ */
+static bool
+hist_log_cursor_is_mapped_entry_erased(const hist_log_cursor_t* const p_cursor)
+{
+    if (NULL == p_cursor->entry.p_mapped)
+    {
+        return false;
+    }
+    compiler_barrier();
+    return p_cursor->sector_erase_cnt != hist_log_sector_get_erase_cnt(p_cursor->loc.fe_sector);
+}
+
+/**
+ * @brief Check if none of the records in the sector can match the filter of the cursor.
+ * @details The active sector is never skipped, since the records are still being added to it.
+ */
+static bool
+hist_log_cursor_is_sector_skipped(const hist_log_cursor_t* const p_cursor, const struct flash_sector* const p_sector)
+{
+    if ((!p_cursor->is_filtered) || (p_sector == g_hist_log_tiers[p_cursor->tier].fcb.f_active.fe_sector))
+    {
+        return false;
+    }
+    return !hist_log_zone_map_can_match(hist_log_sector_dir_get_zone_map(p_sector), &p_cursor->filter);
+}
+
+/**
+ * @brief Move the cursor past the sectors without matching records, if it points to the beginning of a sector.
+ * @note g_hist_log_mutex must be locked by the caller.
+ */
+static void
+hist_log_cursor_skip_sectors(hist_log_cursor_t* const p_cursor)
+{
+    const struct fcb* const p_fcb = &g_hist_log_tiers[p_cursor->tier].fcb;
+    if (p_cursor->is_write_back || (0 != p_cursor->loc.fe_elem_off))
+    {
+        return;
+    }
+    // fe_sector=NULL means starting from the oldest sector
+    struct flash_sector* p_sector = (NULL != p_cursor->loc.fe_sector) ? p_cursor->loc.fe_sector : p_fcb->f_oldest;
+    while (hist_log_cursor_is_sector_skipped(p_cursor, p_sector))
+    {
+        p_cursor->num_sectors_skipped += 1;
+        p_sector += 1;
+        if (p_sector >= &p_fcb->f_sectors[p_fcb->f_sector_cnt])
+        {
+            p_sector = &p_fcb->f_sectors[0];
+        }
+        p_cursor->loc = (struct fcb_entry) {
+            .fe_sector   = p_sector,
+            .fe_elem_off = 0,
+            .fe_data_off = 0,
+            .fe_data_len = 0,
+        };
+        p_cursor->sector_erase_cnt = hist_log_sector_get_erase_cnt(p_sector);
+    }
+}
+
+/**
+ * @brief Load the next FCB entry after the cursor position, or the copy of the write-back buffer
+ * if all the entries in flash have been read.
+ * @note g_hist_log_mutex must be locked by the caller.
+ * @return HIST_LOG_CURSOR_STATUS_OK if the entry was loaded.
+ */
+static hist_log_cursor_status_e
+hist_log_cursor_load_entry(hist_log_cursor_t* const p_cursor, hist_log_read_ahead_t* const p_ra)
+{
+    hist_log_tier_t* const p_tier = &g_hist_log_tiers[p_cursor->tier];
+    struct fcb* const      p_fcb  = &p_tier->fcb;
+    if (!p_cursor->is_started)
+    {
+        // fe_elem_off=0 means that hist_log_read_ahead_getnext() starts from the first record in fe_sector,
+        // fe_sector=NULL means starting from the oldest sector.
+        p_cursor->loc = (struct fcb_entry) {
+            .fe_sector = hist_log_sector_dir_find_first_sector(
+                p_tier,
+                hist_log_cursor_get_local_timestamp_start(p_cursor),
+                p_cursor->seq_start),
+            .fe_elem_off = 0,
+            .fe_data_off = 0,
+            .fe_data_len = 0,
+        };
+        if (NULL != p_cursor->loc.fe_sector)
+        {
+            p_cursor->sector_erase_cnt = hist_log_sector_get_erase_cnt(p_cursor->loc.fe_sector);
+        }
+        p_cursor->is_started = true;
+    }
+    else if ((NULL != p_cursor->loc.fe_sector)
+             && (p_cursor->sector_erase_cnt != hist_log_sector_get_erase_cnt(p_cursor->loc.fe_sector)))
+    {
+        TLOG_WRN(
+            "Cursor of tier %s is invalidated: sector fs_off=0x%08x was erased, continue from the oldest record",
+            p_tier->p_name,
+            (unsigned)p_cursor->loc.fe_sector->fs_off);
+        hist_log_cursor_restart(p_cursor);
+        return HIST_LOG_CURSOR_STATUS_INVALIDATED;
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+
+    while (true)
+    {
+        hist_log_cursor_skip_sectors(p_cursor);
+        // hist_log_read_ahead_getnext() can modify loc even if it fails, so the cursor position is updated on success
+        struct fcb_entry loc = p_cursor->loc;
+        if (0 == hist_log_read_ahead_getnext(p_ra, p_fcb, &loc))
+        {
+            if (loc.fe_sector != p_cursor->loc.fe_sector)
+            {
+                p_cursor->sector_erase_cnt = hist_log_sector_get_erase_cnt(loc.fe_sector);
+                if ((!p_cursor->is_write_back) && hist_log_cursor_is_sector_skipped(p_cursor, loc.fe_sector))
+                {
+                    // The cursor has moved to the next sector, it is skipped from its beginning
+                    p_cursor->loc = (struct fcb_entry) {
+                        .fe_sector   = loc.fe_sector,
+                        .fe_elem_off = 0,
+                        .fe_data_off = 0,
+                        .fe_data_len = 0,
+                    };
+                    continue;
+                }
+            }
+            p_cursor->loc = loc;
+            if (p_cursor->is_write_back)
+            {
+                // The write-back buffer was written to flash, the records which were already read from it are skipped
+                p_cursor->decoder             = p_cursor->decoder_flash;
+                p_cursor->is_write_back       = false;
+                p_cursor->num_skip            = p_cursor->num_write_back_read;
+                p_cursor->num_write_back_read = 0;
+            }
+            TLOG_DBG(
+                "Read entry: fs_off=0x%08x, fe_data_off=0x%04x, fe_data_len=%u",
+                (unsigned)loc.fe_sector->fs_off,
+                (unsigned)loc.fe_data_off,
+                (unsigned)loc.fe_data_len);
+            const hist_log_read_status_e status
+                = hist_log_stream_read_entry(&p_cursor->decoder, p_ra, p_fcb, &loc, &p_cursor->entry);
+            if (HIST_LOG_READ_STATUS_OK != status)
+            {
+                hist_log_print_read_err(status, &p_cursor->read_err_cnt, &p_cursor->decode_err_cnt, &loc);
+                p_cursor->num_skip = 0;
+                continue;
+            }
+            return HIST_LOG_CURSOR_STATUS_OK;
+        }
+        if (HIST_LOG_TIER_5MIN != p_cursor->tier)
+        {
+            // The rollup records are written to flash immediately
+            return HIST_LOG_CURSOR_STATUS_END;
+        }
+        // All the entries in flash have been read, continue with the records in the write-back buffer
+        if (!p_cursor->is_write_back)
+        {
+            p_cursor->decoder_flash = p_cursor->decoder;
+        }
+        if (!hist_log_write_back_read(p_fcb, &p_cursor->loc, &p_cursor->decoder, &p_cursor->entry))
+        {
+            // The buffered records were written to flash after the chunk was loaded
+            hist_log_read_ahead_invalidate(p_ra);
+            continue;
+        }
+        // The buffer only grows until it is written to flash, so the records which were read are still at its start
+        p_cursor->is_write_back       = true;
+        p_cursor->num_skip            = p_cursor->num_write_back_read;
+        p_cursor->num_write_back_read = 0;
+        return HIST_LOG_CURSOR_STATUS_OK;
+    }
+}
+
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+/**
+ * @brief Find the first record of the cursor in the RAM cache.
+ * @details The cache can be used only if it contains all the records the cursor is looking for:
+ * the first requested sequence number is in the cache, or the timestamps are ordered
+ * and the oldest cached record is older than the requested time (so all the records before it are older too).
+ * @note g_hist_log_mutex must be locked by the caller.
+ * @return Sequence number of the first record to check, 0 if the records must be read from flash.
+ */
+static uint32_t
+hist_log_cache_find_start(const hist_log_cursor_t* const p_cursor)
+{
+    const hist_log_cache_t* const p_cache = &g_hist_log_cache;
+    if ((HIST_LOG_TIER_5MIN != p_cursor->tier) || (!p_cache->is_loaded) || (p_cache->seq_first == p_cache->seq_end))
+    {
+        return 0;
+    }
+    if (0 != p_cursor->seq_start)
+    {
+        return (p_cursor->seq_start >= p_cache->seq_first) ? p_cursor->seq_start : 0;
+    }
+    if ((0 == p_cursor->timestamp_start) || (!g_hist_log_tiers[HIST_LOG_TIER_5MIN].sector_dir_is_ordered)
+        || (0 == hist_log_cursor_get_local_timestamp_start(p_cursor)))
+    {
+        return 0;
+    }
+    for (uint32_t seq = p_cache->seq_first; seq < p_cache->seq_end; ++seq)
+    {
+        const hist_log_cache_record_t* const p_rec = &p_cache->records[seq % HIST_LOG_CACHE_NUM_RECORDS];
+        if (p_rec->seq == seq)
+        {
+            const uint32_t timestamp = hist_log_cursor_rebase_timestamp(p_cursor, seq, p_rec->timestamp);
+            return (timestamp < p_cursor->timestamp_start) ? p_cache->seq_first : 0;
+        }
+    }
+    return 0;
+}
+#endif
+
+/**
+ * @brief Read the next record of the cursor from the RAM cache.
+ * @details The decision is made when the cursor starts reading. If the reader was paused for so long
+ * that its next record was dropped from the cache, it continues reading from flash.
+ * @return false if the cursor must read from flash.
+ */
+static bool
+hist_log_cache_read(
+    hist_log_cursor_t* const        p_cursor,
+    hist_log_cursor_status_e* const p_status,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
+{
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+    const hist_log_cache_t* const p_cache = &g_hist_log_cache;
+    if (p_cursor->is_started && (0 == p_cursor->seq_cache_next))
+    {
+        return false;
+    }
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    if (!p_cursor->is_started)
+    {
+        p_cursor->seq_cache_next = hist_log_cache_find_start(p_cursor);
+        if ((HIST_LOG_TIER_5MIN == p_cursor->tier) && p_cache->is_loaded)
+        {
+            if (0 != p_cursor->seq_cache_next)
+            {
+                g_hist_log_stats.num_cache_hits += 1;
+            }
+            else
+            {
+                g_hist_log_stats.num_cache_misses += 1;
+            }
+        }
+        if (0 == p_cursor->seq_cache_next)
+        {
+            k_mutex_unlock(&g_hist_log_mutex);
+            return false;
+        }
+        p_cursor->is_started = true;
+    }
+    else if (p_cursor->seq_cache_next < p_cache->seq_first)
+    {
+        TLOG_WRN(
+            "Cursor of tier %s: seq %u was dropped from the cache, continue reading from flash",
+            g_hist_log_tiers[p_cursor->tier].p_name,
+            (unsigned)p_cursor->seq_cache_next);
+        p_cursor->seq_start      = p_cursor->seq_cache_next;
+        p_cursor->seq_cache_next = 0;
+        p_cursor->is_started     = false;
+        k_mutex_unlock(&g_hist_log_mutex);
+        return false;
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+    *p_status = HIST_LOG_CURSOR_STATUS_END;
+    while (p_cursor->seq_cache_next < p_cache->seq_end)
+    {
+        const uint32_t                       seq   = p_cursor->seq_cache_next;
+        const hist_log_cache_record_t* const p_rec = &p_cache->records[seq % HIST_LOG_CACHE_NUM_RECORDS];
+        p_cursor->seq_cache_next += 1;
+        if (p_rec->seq != seq)
+        {
+            continue;
+        }
+        const uint32_t timestamp = hist_log_cursor_rebase_timestamp(p_cursor, seq, p_rec->timestamp);
+        if (timestamp < p_cursor->timestamp_start)
+        {
+            continue;
+        }
+        const hist_log_rollup_record_t record = {
+            .mean = p_rec->data,
+            .min  = p_rec->data,
+            .max  = p_rec->data,
+        };
+        if (p_cursor->is_filtered && (!hist_log_filter_match(&p_cursor->filter, &record)))
+        {
+            continue;
+        }
+        *p_timestamp       = timestamp;
+        *p_seq             = seq;
+        *p_record          = record;
+        p_cursor->seq_last = seq;
+        *p_status          = HIST_LOG_CURSOR_STATUS_OK;
+        break;
     }
-    TLOG_WRN("Hist log storage was filled with %u mock records", cnt);
-#endif
-
+    k_mutex_unlock(&g_hist_log_mutex);
     return true;
+#else
+    ARG_UNUSED(p_cursor);
+    ARG_UNUSED(p_status);
+    ARG_UNUSED(p_timestamp);
+    ARG_UNUSED(p_seq);
+    ARG_UNUSED(p_record);
+    return false;
+#endif
 }
 
-bool
-hist_log_append_record(const uint32_t timestamp, const hist_log_record_data_t* const p_data, const bool flag_print_log)
+static hist_log_cursor_status_e
+hist_log_cursor_read(
+    hist_log_cursor_t* const        p_cursor,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
 {
-#if USE_HIST_LOG
-    hist_log_record_t record = {
-        .timestamp = timestamp,
-        .data      = *p_data,
-        .crc16     = { 0, 0 },
-    };
-    const uint16_t crc16 = crc16_ccitt(
-        CRC16_CCITT_INITIAL_VALUE,
-        (const uint8_t*)&record,
-        offsetof(hist_log_record_t, crc16));
-    record.crc16[0] = crc16 & BYTE_MASK;
-    record.crc16[1] = (crc16 >> BYTE_SHIFT_1) & BYTE_MASK;
-
-    struct fcb_entry  loc   = { 0 };
-    struct fcb* const p_fcb = &g_hist_log_fcb;
-
-    // Step 1: Allocate space for the new record in FCB
-    zephyr_api_ret_t rc = fcb_append(p_fcb, sizeof(record), &loc);
-    if (0 != rc)
+    hist_log_cursor_status_e status_cache = HIST_LOG_CURSOR_STATUS_END;
+    if (hist_log_cache_read(p_cursor, &status_cache, p_timestamp, p_seq, p_record))
     {
-        if (-ENOSPC != rc)
+        return status_cache;
+    }
+    const uint32_t num_channels    = g_hist_log_tiers[p_cursor->tier].num_channels;
+    bool           flag_last_entry = false;
+    while (true)
+    {
+        hist_log_entry_t* const p_entry = &p_cursor->entry;
+        while (p_entry->pos < p_entry->len)
         {
-            TLOG_ERR("Failed to allocate space for FCB record: %d", rc);
-            return false;
+            const hist_log_read_status_e status = hist_log_stream_decode_record(
+                &p_cursor->decoder,
+                p_entry,
+                num_channels,
+                p_timestamp,
+                p_seq,
+                p_record);
+            if (hist_log_cursor_is_mapped_entry_erased(p_cursor))
+            {
+                TLOG_WRN(
+                    "Cursor of tier %s is invalidated: sector fs_off=0x%08x was erased while it was decoded",
+                    g_hist_log_tiers[p_cursor->tier].p_name,
+                    (unsigned)p_cursor->loc.fe_sector->fs_off);
+                hist_log_cursor_restart(p_cursor);
+                return HIST_LOG_CURSOR_STATUS_INVALIDATED;
+            }
+            if (HIST_LOG_READ_STATUS_OK != status)
+            {
+                hist_log_print_read_err(status, &p_cursor->read_err_cnt, &p_cursor->decode_err_cnt, &p_cursor->loc);
+                break;
+            }
+            *p_timestamp = hist_log_cursor_rebase_timestamp(p_cursor, *p_seq, *p_timestamp);
+            if (p_cursor->is_write_back)
+            {
+                p_cursor->num_write_back_read += 1;
+            }
+            if (0 != p_cursor->num_skip)
+            {
+                p_cursor->num_skip -= 1;
+                continue;
+            }
+            if (*p_seq < p_cursor->seq_start)
+            {
+                TLOG_DBG("Skip log record: seq=%" PRIu32 " < start=%" PRIu32, *p_seq, p_cursor->seq_start);
+                continue;
+            }
+            if (*p_timestamp < p_cursor->timestamp_start)
+            {
+                TLOG_DBG("Skip log record: time=%" PRIu32 " < start=%" PRIu32, *p_timestamp, p_cursor->timestamp_start);
+                continue;
+            }
+            TLOG_DBG("Read log record: time=%" PRIu32 " >= start=%" PRIu32, *p_timestamp, p_cursor->timestamp_start);
+            if (1 == num_channels)
+            {
+                p_record->min = p_record->mean;
+                p_record->max = p_record->mean;
+            }
+            if (p_cursor->is_filtered && (!hist_log_filter_match(&p_cursor->filter, p_record)))
+            {
+                continue;
+            }
+            p_cursor->seq_last = *p_seq;
+            return HIST_LOG_CURSOR_STATUS_OK;
         }
-        TLOG_WRN("FCB is full, rotate");
-#if HIST_LOG_TEST_FILL_ALL_STORAGE
-        g_hist_log_full = true;
-#endif
-        rc = fcb_rotate(p_fcb);
-        if (0 != rc)
+        if (flag_last_entry)
         {
-            TLOG_ERR("fcb_rotate failed: %d", rc);
-            return false;
+            // The write-back buffer is the last entry, the records appended later are read on the next call
+            return HIST_LOG_CURSOR_STATUS_END;
         }
-        rc = fcb_append(p_fcb, sizeof(record), &loc);
-        if (0 != rc)
+        k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+        hist_log_cursor_use_flash_map(p_cursor, true);
+        hist_log_read_ahead_t* const   p_ra            = &g_hist_log_read_ahead;
+        const uint32_t                 num_flash_reads = p_ra->num_flash_reads;
+        const hist_log_cursor_status_e status          = hist_log_cursor_load_entry(p_cursor, p_ra);
+        p_cursor->num_flash_reads += p_ra->num_flash_reads - num_flash_reads;
+        hist_log_cursor_set_reader_sector(p_cursor, p_cursor->loc.fe_sector);
+        k_mutex_unlock(&g_hist_log_mutex);
+        if (HIST_LOG_CURSOR_STATUS_OK != status)
         {
-            TLOG_ERR("fcb_append failed: %d", rc);
-            return false;
+            return status;
         }
+        flag_last_entry = p_cursor->is_write_back;
     }
+}
 
-    // Step 2: Write the data to flash
-    off_t write_off = loc.fe_sector->fs_off + loc.fe_data_off;
-    if (flag_print_log)
+/**
+ * @brief Decode the records of the block before seq_block_end with the forward reading.
+ * @details Delta-encoded records can be decoded only forward, so every block is decoded starting from the key frame
+ * at the beginning of its sector, the sectors before it are skipped using the sector directory.
+ * @return HIST_LOG_CURSOR_STATUS_OK if the block is not empty,
+ * HIST_LOG_CURSOR_STATUS_END if there are no older records.
+ */
+static hist_log_cursor_status_e
+hist_log_cursor_load_block(hist_log_cursor_t* const p_cursor)
+{
+    const uint32_t seq_last = p_cursor->seq_last;
+    while (p_cursor->seq_block_end > 1U)
     {
-        TLOG_INF(
-            "Append record: time=%u, write_off=0x%08x, fs_off=0x%08x, fe_data_off=0x%04x",
-            (unsigned)record.timestamp,
-            (unsigned)write_off,
-            (unsigned)loc.fe_sector->fs_off,
-            (unsigned)loc.fe_data_off);
+        const uint32_t seq_end   = p_cursor->seq_block_end;
+        const uint32_t seq_start = (seq_end > HIST_LOG_CURSOR_BLOCK_LEN) ? (seq_end - HIST_LOG_CURSOR_BLOCK_LEN) : 1U;
+        hist_log_cursor_restart(p_cursor);
+        p_cursor->is_started = false;
+        p_cursor->seq_start  = seq_start;
+        p_cursor->block_len  = 0;
+        while (true)
+        {
+            hist_log_cursor_block_record_t* const p_block_record = &p_cursor->block[p_cursor->block_len];
+            const hist_log_cursor_status_e        status         = hist_log_cursor_read(
+                p_cursor,
+                &p_block_record->timestamp,
+                &p_block_record->seq,
+                &p_block_record->record);
+            if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
+            {
+                // The reading continues from the oldest record, so the block is decoded again
+                p_cursor->block_len = 0;
+                continue;
+            }
+            if ((HIST_LOG_CURSOR_STATUS_END == status) || (p_block_record->seq >= seq_end))
+            {
+                break;
+            }
+            p_cursor->block_len += 1;
+            if (HIST_LOG_CURSOR_BLOCK_LEN == p_cursor->block_len)
+            {
+                break;
+            }
+        }
+        p_cursor->seq_block_end = seq_start;
+        if (0 != p_cursor->block_len)
+        {
+            break;
+        }
+        // The block is empty if its records were lost due to write errors or were rotated out with all the older ones
+        k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+        const uint32_t seq_first = hist_log_sector_dir_get_seq_first(&g_hist_log_tiers[p_cursor->tier]);
+        k_mutex_unlock(&g_hist_log_mutex);
+        if (seq_start <= seq_first)
+        {
+            break;
+        }
     }
-    else
+    p_cursor->seq_last = seq_last;
+    return (0 != p_cursor->block_len) ? HIST_LOG_CURSOR_STATUS_OK : HIST_LOG_CURSOR_STATUS_END;
+}
+
+static hist_log_cursor_status_e
+hist_log_cursor_read_newest_first(
+    hist_log_cursor_t* const        p_cursor,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
+{
+    if ((0 != p_cursor->num_records_max) && (p_cursor->num_records_read >= p_cursor->num_records_max))
     {
-        TLOG_DBG(
-            "Append record: time=%u, write_off=0x%08x, fs_off=0x%08x, fe_data_off=0x%04x",
-            (unsigned)record.timestamp,
-            (unsigned)write_off,
-            (unsigned)loc.fe_sector->fs_off,
-            (unsigned)loc.fe_data_off);
+        return HIST_LOG_CURSOR_STATUS_END;
     }
-    LOG_HEXDUMP_DBG(&record, sizeof(record), "Write record");
-    rc = flash_area_write(p_fcb->fap, write_off, &record, sizeof(record));
-    if (0 != rc)
+    if (0 == p_cursor->block_len)
     {
-        TLOG_ERR("flash_area_write failed: %d", rc);
-        return false;
+        const hist_log_cursor_status_e status = hist_log_cursor_load_block(p_cursor);
+        if (HIST_LOG_CURSOR_STATUS_OK != status)
+        {
+            return status;
+        }
     }
+    p_cursor->block_len -= 1;
+    const hist_log_cursor_block_record_t* const p_block_record = &p_cursor->block[p_cursor->block_len];
+    *p_timestamp                                               = p_block_record->timestamp;
+    *p_seq                                                     = p_block_record->seq;
+    *p_record                                                  = p_block_record->record;
+    p_cursor->seq_last                                         = p_block_record->seq;
+    p_cursor->num_records_read += 1;
+    return HIST_LOG_CURSOR_STATUS_OK;
+}
 
-    // Step 3: Finalize the entry
-    rc = fcb_append_finish(p_fcb, &loc);
-    if (0 != rc)
+/**
+ * @brief Read the records until the time bucket is completed by the first record of the next one.
+ * @details The bucket which is still being filled is returned after the last record,
+ * it is completed by hist_log_rollup_flush(), so the next call returns HIST_LOG_CURSOR_STATUS_END.
+ */
+static hist_log_cursor_status_e
+hist_log_cursor_read_aggregated(
+    hist_log_cursor_t* const        p_cursor,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
+{
+    while (true)
     {
-        TLOG_ERR("fcb_append_finish failed: %d", rc);
-        return false;
+        uint32_t                       timestamp = 0;
+        uint32_t                       seq       = 0;
+        hist_log_rollup_record_t       record    = { 0 };
+        const hist_log_cursor_status_e status    = hist_log_cursor_read(p_cursor, &timestamp, &seq, &record);
+        if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
+        {
+            // The records which were not read are lost, the accumulated ones are kept in the current bucket
+            return status;
+        }
+        if (HIST_LOG_CURSOR_STATUS_END == status)
+        {
+            if (!hist_log_rollup_flush(&p_cursor->aggregation, p_timestamp, p_record))
+            {
+                return HIST_LOG_CURSOR_STATUS_END;
+            }
+            *p_seq = p_cursor->aggregation_seq_last;
+            return HIST_LOG_CURSOR_STATUS_OK;
+        }
+        const uint32_t seq_prev        = p_cursor->aggregation_seq_last;
+        p_cursor->aggregation_seq_last = seq;
+        if (hist_log_rollup_add(&p_cursor->aggregation, timestamp, &record, p_timestamp, p_record))
+        {
+            *p_seq = seq_prev;
+            return HIST_LOG_CURSOR_STATUS_OK;
+        }
     }
-#endif
-    return true;
 }
 
+/**
+ * @brief Parameters of the read request, exactly one of the callbacks is set.
+ */
+typedef struct hist_log_reader_t
+{
+    hist_log_record_handler_t p_record_cb; //!< Callback for the 5-minute records
+    hist_log_rollup_handler_t p_rollup_cb; //!< Callback for the rollup records
+    void*                     p_user_data;
+    uint32_t                  timestamp_start;
+} hist_log_reader_t;
+
 static bool
-hist_log_handle_record(
-    const struct hist_log_record_t* const p_record,
-    const uint32_t                        timestamp_start,
-    hist_log_record_handler_t             p_cb,
-    void* const                           p_user_data,
-    uint32_t* const                       p_crc_err_cnt,
-    const off_t                           read_off,
-    const struct fcb_entry* const         p_loc)
+hist_log_tier_read_records(const hist_log_tier_e tier, const hist_log_reader_t* const p_reader)
 {
-    LOG_HEXDUMP_DBG(p_record, sizeof(*p_record), "Read record");
+    // The cursor is too large for the stack of the caller, so it is taken from the pool
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_alloc(tier, p_reader->timestamp_start, false, 0);
+    if (NULL == p_cursor)
+    {
+        return false;
+    }
 
-    if (0 != (crc16_ccitt(CRC16_CCITT_INITIAL_VALUE, (const uint8_t*)p_record, sizeof(*p_record))))
+    bool res = true;
+    while (true)
     {
-        *p_crc_err_cnt += 1;
-        if (*p_crc_err_cnt < HIST_LOG_MAX_READ_ERR_PRINT_CNT)
+        uint32_t                       timestamp = 0;
+        uint32_t                       seq       = 0;
+        hist_log_rollup_record_t       record    = { 0 };
+        const hist_log_cursor_status_e status    = hist_log_cursor_read(p_cursor, &timestamp, &seq, &record);
+        if (HIST_LOG_CURSOR_STATUS_END == status)
         {
-            TLOG_ERR(
-                "CRC16 check failed: read_off=%x, fs_off=%x, fe_data_off=%x",
-                (unsigned)read_off,
-                (unsigned)p_loc->fe_sector->fs_off,
-                (unsigned)p_loc->fe_data_off);
+            break;
         }
-        else if (HIST_LOG_MAX_READ_ERR_PRINT_CNT == *p_crc_err_cnt)
+        if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
         {
-            TLOG_ERR("Too many CRC16 errors, suppressing further messages");
+            // The reader was slower than the writer, the records from the erased sector are lost
+            continue;
         }
-        else
+        res = (NULL != p_reader->p_record_cb)
+                  ? p_reader->p_record_cb(timestamp, &record.mean, p_reader->p_user_data)
+                  : p_reader->p_rollup_cb(timestamp, &record, p_reader->p_user_data);
+        if (!res)
         {
-            // MISRA: "if ... else if" constructs should end with "else" clauses
+            break;
         }
     }
-    else
+    TLOG_INF(
+        "Read tier %s: %u flash reads, read-ahead buffer: %u bytes",
+        g_hist_log_tiers[tier].p_name,
+        (unsigned)p_cursor->num_flash_reads,
+        (unsigned)HIST_LOG_READ_AHEAD_SIZE);
+    hist_log_cursor_close(p_cursor);
+    return res;
+}
+
+/**
+ * @brief Fill the RAM cache with the newest records from flash.
+ */
+static void
+hist_log_cache_load(void)
+{
+#if HIST_LOG_CACHE_NUM_RECORDS > 0
+    hist_log_cache_t* const p_cache  = &g_hist_log_cache;
+    const uint32_t          seq_next = g_hist_log_tiers[HIST_LOG_TIER_5MIN].seq_next;
+
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    memset(p_cache, 0, sizeof(*p_cache));
+    p_cache->seq_first = seq_next;
+    p_cache->seq_end   = seq_next;
+    k_mutex_unlock(&g_hist_log_mutex);
+
+    // The cursor is too large for the main stack, hist_log_init() is called from main()
+    static hist_log_cursor_t cursor;
+    hist_log_cursor_init(
+        &cursor,
+        HIST_LOG_TIER_5MIN,
+        0,
+        (seq_next > HIST_LOG_CACHE_NUM_RECORDS) ? (seq_next - HIST_LOG_CACHE_NUM_RECORDS) : 1U);
+    uint32_t num_records = 0;
+    while (true)
     {
-        if (p_record->timestamp >= timestamp_start)
+        uint32_t                       timestamp = 0;
+        uint32_t                       seq       = 0;
+        hist_log_rollup_record_t       record    = { 0 };
+        const hist_log_cursor_status_e status    = hist_log_cursor_read(&cursor, &timestamp, &seq, &record);
+        if (HIST_LOG_CURSOR_STATUS_END == status)
         {
-            TLOG_DBG("Read log record: time=%" PRIu32 " > start=%" PRIu32, p_record->timestamp, timestamp_start);
-            if (!p_cb(p_record->timestamp, &p_record->data, p_user_data))
-            {
-                return false;
-            }
+            break;
         }
-        else
+        if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
         {
-            TLOG_DBG("Skip log record: time=%" PRIu32 " < start=%" PRIu32, p_record->timestamp, timestamp_start);
+            continue;
         }
+        k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+        // The cache keeps the timestamps of the local clock, they are converted to the real time when read
+        hist_log_cache_add(
+            timestamp - (uint32_t)hist_log_cursor_get_epoch_time_offset(&cursor, seq),
+            seq,
+            &record.mean);
+        k_mutex_unlock(&g_hist_log_mutex);
+        num_records += 1;
     }
-    return true;
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    hist_log_cursor_set_reader_sector(&cursor, NULL);
+    p_cache->is_loaded = true;
+    k_mutex_unlock(&g_hist_log_mutex);
+
+    TLOG_INF(
+        "hist_log cache: %u/%u records loaded, %u flash reads",
+        (unsigned)num_records,
+        (unsigned)HIST_LOG_CACHE_NUM_RECORDS,
+        (unsigned)cursor.num_flash_reads);
+#endif
 }
+#endif
 
 bool
 hist_log_read_records(hist_log_record_handler_t p_cb, void* const p_user_data, const uint32_t timestamp_start)
@@ -383,70 +3586,279 @@ hist_log_read_records(hist_log_record_handler_t p_cb, void* const p_user_data, c
 #if USE_HIST_LOG
     TLOG_DBG("read_all_records");
     assert(NULL != p_cb);
-    struct fcb_entry loc = {
-        .fe_sector   = NULL,
-        .fe_elem_off = 0,
-        .fe_data_off = 0,
-        .fe_data_len = 0,
+    const hist_log_reader_t reader = {
+        .p_record_cb     = p_cb,
+        .p_rollup_cb     = NULL,
+        .p_user_data     = p_user_data,
+        .timestamp_start = timestamp_start,
     };
-    struct fcb* const p_fcb = &g_hist_log_fcb;
+    return hist_log_tier_read_records(HIST_LOG_TIER_5MIN, &reader);
+#else
+    return true;
+#endif
+}
 
-    zephyr_api_ret_t rc = fcb_getnext(p_fcb, &loc);
-    if (0 != rc)
+bool
+hist_log_read_rollup_records(
+    const hist_log_tier_e     tier,
+    hist_log_rollup_handler_t p_cb,
+    void* const               p_user_data,
+    const uint32_t            timestamp_start)
+{
+#if USE_HIST_LOG
+    TLOG_DBG("read_rollup_records: tier=%u", (unsigned)tier);
+    assert(NULL != p_cb);
+    assert((HIST_LOG_TIER_1HOUR == tier) || (HIST_LOG_TIER_1DAY == tier));
+    const hist_log_reader_t reader = {
+        .p_record_cb     = NULL,
+        .p_rollup_cb     = p_cb,
+        .p_user_data     = p_user_data,
+        .timestamp_start = timestamp_start,
+    };
+    return hist_log_tier_read_records(tier, &reader);
+#else
+    return true;
+#endif
+}
+
+#if USE_HIST_LOG
+/**
+ * @param after_seq Read the records with seq > after_seq,
+ * all the records are read if after_seq is not less than the next sequence number of the tier.
+ */
+static hist_log_cursor_t*
+hist_log_cursor_alloc(
+    const hist_log_tier_e tier,
+    const uint32_t        timestamp_start,
+    const bool            flag_after_seq,
+    const uint32_t        after_seq)
+{
+    assert(tier < HIST_LOG_NUM_TIERS);
+    hist_log_cursor_t* p_cursor = NULL;
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    uint32_t seq_start = 0;
+    if (flag_after_seq && (after_seq < g_hist_log_tiers[tier].seq_next))
     {
-        TLOG_DBG("No records found");
-        return true;
+        seq_start = after_seq + 1U;
+    }
+    for (uint32_t i = 0; i < HIST_LOG_NUM_CURSORS; ++i)
+    {
+        if (!g_hist_log_cursors[i].is_open)
+        {
+            p_cursor = &g_hist_log_cursors[i];
+            hist_log_cursor_init(p_cursor, tier, timestamp_start, seq_start);
+            break;
+        }
     }
+    const uint32_t seq_next = g_hist_log_tiers[tier].seq_next;
+    k_mutex_unlock(&g_hist_log_mutex);
+    if (NULL == p_cursor)
+    {
+        TLOG_ERR("No free cursors, max %u", (unsigned)HIST_LOG_NUM_CURSORS);
+    }
+    else if (flag_after_seq && (0 == seq_start))
+    {
+        TLOG_WRN(
+            "Requested seq %u is not less than the next seq %u of tier %s, read all the records",
+            (unsigned)after_seq,
+            (unsigned)seq_next,
+            g_hist_log_tiers[tier].p_name);
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+    return p_cursor;
+}
+#endif
+
+hist_log_cursor_t*
+hist_log_cursor_open(const hist_log_tier_e tier, const uint32_t timestamp_start)
+{
+#if USE_HIST_LOG
+    return hist_log_cursor_alloc(tier, timestamp_start, false, 0);
+#else
+    return NULL;
+#endif
+}
+
+hist_log_cursor_t*
+hist_log_cursor_open_after_seq(const hist_log_tier_e tier, const uint32_t seq)
+{
+#if USE_HIST_LOG
+    return hist_log_cursor_alloc(tier, 0, true, seq);
+#else
+    return NULL;
+#endif
+}
 
-    uint32_t read_err_cnt = 0;
-    uint32_t crc_err_cnt  = 0;
-    while (0 == rc)
+hist_log_cursor_t*
+hist_log_cursor_open_newest_first(const hist_log_tier_e tier, const uint32_t num_records_max)
+{
+#if USE_HIST_LOG
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_alloc(tier, 0, false, 0);
+    if (NULL != p_cursor)
     {
-        const off_t read_off = loc.fe_sector->fs_off + loc.fe_data_off;
-        TLOG_DBG(
-            "flash_area_read: read_off=0x%08x, fs_off=0x%08x, fe_data_off=0x%04x",
-            (unsigned)read_off,
-            (unsigned)loc.fe_sector->fs_off,
-            (unsigned)loc.fe_data_off);
+        k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+        p_cursor->seq_block_end = g_hist_log_tiers[tier].seq_next;
+        k_mutex_unlock(&g_hist_log_mutex);
+        p_cursor->is_newest_first = true;
+        p_cursor->num_records_max = num_records_max;
+    }
+    return p_cursor;
+#else
+    return NULL;
+#endif
+}
 
-        struct hist_log_record_t record = { 0 };
+hist_log_cursor_status_e
+hist_log_cursor_next(
+    hist_log_cursor_t* const        p_cursor,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record)
+{
+#if USE_HIST_LOG
+    assert((NULL != p_cursor) && p_cursor->is_open);
+    if (p_cursor->is_newest_first)
+    {
+        return hist_log_cursor_read_newest_first(p_cursor, p_timestamp, p_seq, p_record);
+    }
+    if (p_cursor->is_aggregated)
+    {
+        return hist_log_cursor_read_aggregated(p_cursor, p_timestamp, p_seq, p_record);
+    }
+    return hist_log_cursor_read(p_cursor, p_timestamp, p_seq, p_record);
+#else
+    return HIST_LOG_CURSOR_STATUS_END;
+#endif
+}
 
-        rc = flash_area_read(p_fcb->fap, read_off, &record, sizeof(record));
-        if (0 != rc)
-        {
-            read_err_cnt += 1;
-            if (read_err_cnt < HIST_LOG_MAX_READ_ERR_PRINT_CNT)
-            {
-                TLOG_ERR("flash_area_read failed: %d", rc);
-            }
-            else if (HIST_LOG_MAX_READ_ERR_PRINT_CNT == read_err_cnt)
-            {
-                TLOG_ERR("Too many read errors, suppressing further messages");
-            }
-            else
-            {
-                // MISRA: "if ... else if" constructs should end with "else" clauses
-            }
-        }
-        else
-        {
-            if (!hist_log_handle_record(&record, timestamp_start, p_cb, p_user_data, &crc_err_cnt, read_off, &loc))
-            {
-                return false;
-            }
-        }
+uint32_t
+hist_log_cursor_get_seq_last(const hist_log_cursor_t* const p_cursor)
+{
+#if USE_HIST_LOG
+    assert(NULL != p_cursor);
+    return p_cursor->seq_last;
+#else
+    return 0;
+#endif
+}
 
-        rc = fcb_getnext(p_fcb, &loc);
+bool
+hist_log_cursor_set_filter(hist_log_cursor_t* const p_cursor, const hist_log_filter_t* const p_filter)
+{
+#if USE_HIST_LOG
+    assert(NULL != p_cursor);
+    if (NULL == p_filter)
+    {
+        p_cursor->is_filtered = false;
+        return true;
+    }
+    if (p_cursor->is_newest_first || (!hist_log_filter_is_valid(p_filter)))
+    {
+        TLOG_ERR("Invalid filter of the cursor of tier %s", g_hist_log_tiers[p_cursor->tier].p_name);
+        return false;
     }
+    p_cursor->filter      = *p_filter;
+    p_cursor->is_filtered = true;
+    return true;
+#else
+    return false;
 #endif
+}
+
+bool
+hist_log_cursor_set_aggregation(hist_log_cursor_t* const p_cursor, const uint32_t period_s)
+{
+#if USE_HIST_LOG
+    assert(NULL != p_cursor);
+    if (0 == period_s)
+    {
+        p_cursor->is_aggregated = false;
+        return true;
+    }
+    const uint32_t tier_period_s = g_hist_log_tiers[p_cursor->tier].period_s;
+    if (p_cursor->is_newest_first || (period_s < tier_period_s) || (0 != (period_s % tier_period_s)))
+    {
+        TLOG_ERR(
+            "Invalid aggregation period %" PRIu32 " s of the cursor of tier %s",
+            period_s,
+            g_hist_log_tiers[p_cursor->tier].p_name);
+        return false;
+    }
+    hist_log_rollup_init(&p_cursor->aggregation, period_s);
+    p_cursor->aggregation_seq_last = p_cursor->seq_last;
+    p_cursor->is_aggregated        = true;
     return true;
+#else
+    return false;
+#endif
+}
+
+uint32_t
+hist_log_cursor_get_num_sectors_skipped(const hist_log_cursor_t* const p_cursor)
+{
+#if USE_HIST_LOG
+    assert(NULL != p_cursor);
+    return p_cursor->num_sectors_skipped;
+#else
+    return 0;
+#endif
+}
+
+void
+hist_log_cursor_close(hist_log_cursor_t* const p_cursor)
+{
+#if USE_HIST_LOG
+    if (NULL == p_cursor)
+    {
+        return;
+    }
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    TLOG_DBG(
+        "Close cursor of tier %s: %u flash reads",
+        g_hist_log_tiers[p_cursor->tier].p_name,
+        (unsigned)p_cursor->num_flash_reads);
+    hist_log_cursor_set_reader_sector(p_cursor, NULL);
+    p_cursor->is_open = false;
+    k_mutex_unlock(&g_hist_log_mutex);
+#endif
+}
+
+void
+hist_log_get_stats(hist_log_stats_t* const p_stats)
+{
+#if USE_HIST_LOG
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    *p_stats = g_hist_log_stats;
+    k_mutex_unlock(&g_hist_log_mutex);
+#else
+    *p_stats = (hist_log_stats_t) { 0 };
+#endif
+}
+
+void
+hist_log_reset_stats(void)
+{
+#if USE_HIST_LOG
+    k_mutex_lock(&g_hist_log_mutex, K_FOREVER);
+    g_hist_log_stats = (hist_log_stats_t) { 0 };
+    k_mutex_unlock(&g_hist_log_mutex);
+#endif
 }
 
 void
 hist_log_print_free_sectors(void)
 {
 #if USE_HIST_LOG
-    TLOG_INF("fcb_free_sector_cnt: %d", fcb_free_sector_cnt(&g_hist_log_fcb));
+    for (uint32_t i = 0; i < HIST_LOG_NUM_TIERS; ++i)
+    {
+        TLOG_INF(
+            "Tier %s: fcb_free_sector_cnt: %d",
+            g_hist_log_tiers[i].p_name,
+            fcb_free_sector_cnt(&g_hist_log_tiers[i].fcb));
+    }
 #endif
 #if 0
     for (int i = 0; i < ARRAY_SIZE(g_hist_log_sectors); i++) {
@@ -13,44 +13,306 @@
 extern "C" {
 #endif
 
-#define HIST_LOG_FCB_SIGNATURE   (0x52555556) // "RUUV"
-#define HIST_LOG_FCB_FMT_VERSION (1)
+#define HIST_LOG_FCB_SIGNATURE       (0x52555556) // "RUUV"
+#define HIST_LOG_FCB_SIGNATURE_1HOUR (0x52555548) // "RUUH"
+#define HIST_LOG_FCB_SIGNATURE_1DAY  (0x52555544) // "RUUD"
+#define HIST_LOG_FCB_FMT_VERSION     (3) // v3: key frames contain the per-record sequence number, see hist_log_codec.h
+
+// Settings key of the sector directory checkpoint, see CONFIG_RUUVI_AIR_HIST_LOG_CHECKPOINT
+#define HIST_LOG_CHECKPOINT_SETTINGS_KEY "hist_log/ckpt"
+// Settings key of the time epochs, see CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS
+#define HIST_LOG_EPOCHS_SETTINGS_KEY "hist_log/epochs"
 
 typedef struct hist_log_record_data_t
 {
     uint8_t buf[RE_LOG_WRITE_AIRQ_RECORD_LEN - RE_LOG_WRITE_AIRQ_PAYLOAD_OFS];
 } hist_log_record_data_t;
 
-typedef struct hist_log_record_t
+/**
+ * @brief History tiers, each tier is stored in its own region of hist_storage with its own retention.
+ * @details The 5-minute records are appended by the application,
+ * the hourly and daily rollups are aggregated from them incrementally.
+ */
+typedef enum hist_log_tier_e
+{
+    HIST_LOG_TIER_5MIN  = 0,
+    HIST_LOG_TIER_1HOUR = 1,
+    HIST_LOG_TIER_1DAY  = 2,
+} hist_log_tier_e;
+
+#define HIST_LOG_NUM_TIERS (3U)
+
+/**
+ * @brief Aggregated record of the rollup tier, every sensor value is aggregated separately.
+ * @details The sequence counter and flags are taken from the last record in the time bucket.
+ */
+typedef struct hist_log_rollup_record_t
+{
+    hist_log_record_data_t mean;
+    hist_log_record_data_t min;
+    hist_log_record_data_t max;
+} hist_log_rollup_record_t;
+
+/**
+ * @brief Sensor values of the E1 record for which the history can be queried by value, see hist_log_filter_t.
+ * @details The values are used in the NUS request NUS_REQ_OP_LOG_MULTI_READ_FILTERED, so they must not be changed.
+ */
+typedef enum hist_log_field_e
+{
+    HIST_LOG_FIELD_TEMPERATURE = 0,
+    HIST_LOG_FIELD_HUMIDITY    = 1,
+    HIST_LOG_FIELD_PM2P5       = 2,
+    HIST_LOG_FIELD_CO2         = 3,
+    HIST_LOG_FIELD_VOC         = 4,
+    HIST_LOG_FIELD_NOX         = 5,
+    HIST_LOG_FIELD_SOUND_AVG   = 6,
+} hist_log_field_e;
+
+#define HIST_LOG_NUM_FIELDS (7U)
+
+typedef enum hist_log_filter_op_e
 {
-    uint32_t               timestamp; // Offset: 0
-    hist_log_record_data_t data;      // Offset: 4
-    uint8_t                crc16[2];  // Offset: 38
-} hist_log_record_t;
+    HIST_LOG_FILTER_OP_GT = 0, //!< The value is greater than the threshold
+    HIST_LOG_FILTER_OP_LT = 1, //!< The value is less than the threshold
+} hist_log_filter_op_e;
 
-#define HIST_LOG_EXPECTED_RECORD_SIZE (40U)
+typedef struct hist_log_filter_cond_t
+{
+    hist_log_field_e     field;
+    hist_log_filter_op_e op;
+    float                threshold; //!< In the units of re_e1_data_t (e.g. ppm for CO2, °C for temperature)
+} hist_log_filter_cond_t;
 
-_Static_assert(
-    HIST_LOG_EXPECTED_RECORD_SIZE == sizeof(hist_log_record_t),
-    "hist_log_record_t record size is not 40 bytes");
+#define HIST_LOG_FILTER_MAX_CONDS (4U)
+
+/**
+ * @brief Value predicate, the record matches if any of the conditions is true.
+ * @details Invalid (NaN) values never match. For the rollup tiers the condition "greater than" is checked
+ * against the max of the time bucket, and "less than" against the min.
+ */
+typedef struct hist_log_filter_t
+{
+    uint32_t               num_conds;
+    hist_log_filter_cond_t conds[HIST_LOG_FILTER_MAX_CONDS];
+} hist_log_filter_t;
 
 typedef bool (*hist_log_record_handler_t)(
     const uint32_t                      timestamp,
     const hist_log_record_data_t* const p_data,
     void*                               p_user_data);
 
+/**
+ * @param timestamp Start of the time bucket.
+ */
+typedef bool (*hist_log_rollup_handler_t)(
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record,
+    void*                                 p_user_data);
+
+/**
+ * @brief Initialize the history log and restore its state from flash.
+ * @param is_rtc_valid false if the RTC time was lost and the clock was restarted from RUUVI_AIR_MIN_UNIX_TIME.
+ * In this case a new time epoch is started (see hist_log_rebase_time()),
+ * or the whole history is erased if CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS is disabled.
+ */
 bool
 hist_log_init(const bool is_rtc_valid);
 
+/**
+ * @brief Erase the whole history and initialize the history log again.
+ */
+bool
+hist_log_erase(void);
+
+/**
+ * @brief Set the offset between the real time and the local clock of the current time epoch.
+ * @details The records are stored with the timestamps of the local clock, which restarts when the RTC time is lost.
+ * The timestamps of the records read from the history and the timestamp_start of the read requests
+ * are in the real time: every record is shifted by the offset of the epoch in which it was written.
+ * The records of the epochs which ended before the real time was received keep their local timestamps.
+ * The offset is set only once for the epoch which was started after RTC loss, it is ignored if it is already known,
+ * so the clocks of different clients do not shift the records which were already read by them.
+ * @param time_offset_s Real time minus the local time in seconds.
+ */
+void
+hist_log_rebase_time(const int32_t time_offset_s);
+
+/**
+ * @brief Get the offset between the real time and the local clock of the current time epoch.
+ * @return Real time minus the local time in seconds, 0 if it is not known yet.
+ */
+int32_t
+hist_log_get_time_offset(void);
+
 bool
 hist_log_append_record(const uint32_t timestamp, const hist_log_record_data_t* const p_data, const bool flag_print_log);
 
+/**
+ * @brief Write the records buffered in RAM to flash.
+ * @details Records are buffered if CONFIG_RUUVI_AIR_HIST_LOG_WRITE_BACK_NUM_RECORDS > 1,
+ * this function must be called before reboot, otherwise the buffered records are lost.
+ * The checkpoint of the sector directory, if its saving is pending, is saved as well.
+ */
+bool
+hist_log_flush(void);
+
+/**
+ * @brief Read the records with timestamp >= timestamp_start, including the records buffered in RAM.
+ */
 bool
 hist_log_read_records(hist_log_record_handler_t p_cb, void* const p_user_data, const uint32_t timestamp_start);
 
+/**
+ * @brief Read the records of the rollup tier (HIST_LOG_TIER_1HOUR or HIST_LOG_TIER_1DAY).
+ * @details Only the records with timestamp >= timestamp_start are read.
+ * The time bucket which is still being aggregated is not included.
+ */
+bool
+hist_log_read_rollup_records(
+    const hist_log_tier_e     tier,
+    hist_log_rollup_handler_t p_cb,
+    void* const               p_user_data,
+    const uint32_t            timestamp_start);
+
+typedef enum hist_log_cursor_status_e
+{
+    HIST_LOG_CURSOR_STATUS_OK  = 0, //!< The next record was read
+    HIST_LOG_CURSOR_STATUS_END = 1, //!< All the records were read, the records appended later can be read by next call
+    //! The sector which the cursor pointed into was erased by FCB rotation,
+    //! the next call continues from the oldest record (the records which were not read from that sector are lost)
+    HIST_LOG_CURSOR_STATUS_INVALIDATED = 2,
+} hist_log_cursor_status_e;
+
+/**
+ * @brief Cursor for reading the records of a tier at the reader's own pace.
+ * @details Unlike hist_log_read_records(), no lock is held between hist_log_cursor_next() calls,
+ * so the reader can be paused (e.g. to wait for the BLE TX buffers) while new records are being appended.
+ * The lock is held only while an FCB entry is copied to the cursor, so the appends are not blocked by the readers.
+ * While the cursor is inside the oldest sector, the pre-erase of this sector (CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE)
+ * is deferred. If the sector is needed for new records before the reader leaves it, it is erased anyway
+ * and the reader gets HIST_LOG_CURSOR_STATUS_INVALIDATED, so the records are returned in the order
+ * of their sequence numbers without gaps, unless the rotation is reported.
+ */
+typedef struct hist_log_cursor_t hist_log_cursor_t;
+
+/**
+ * @brief Open the cursor for reading the records of the tier with timestamp >= timestamp_start.
+ * @return Pointer to the cursor or NULL if all the cursors (CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS) are in use.
+ */
+hist_log_cursor_t*
+hist_log_cursor_open(const hist_log_tier_e tier, const uint32_t timestamp_start);
+
+/**
+ * @brief Open the cursor for reading the records of the tier with sequence number > seq.
+ * @details Every record gets a sequence number which grows by one for each record appended to the tier
+ * and does not depend on the timestamp, so a client can resume the synchronization after the last received record
+ * even if the clock was changed. Sequence numbers start from 1, seq=0 means reading all the records.
+ * The sequence numbers start again from 1 if the storage is erased,
+ * so if seq is not less than the next sequence number of the tier, all the records are read.
+ * @return Pointer to the cursor or NULL if all the cursors (CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS) are in use.
+ */
+hist_log_cursor_t*
+hist_log_cursor_open_after_seq(const hist_log_tier_e tier, const uint32_t seq);
+
+/**
+ * @brief Open the cursor for reading the records of the tier starting from the newest one.
+ * @details The client gets the most recent records first without waiting for the older ones to be read.
+ * Delta-encoded records can be decoded only forward, so the records are decoded in small blocks
+ * starting from the newest block, and every block is returned in reverse order.
+ * Reading the whole tier this way decodes every sector several times, so it is slower than the forward reading.
+ * The records appended after opening the cursor are not read.
+ * @param num_records_max Max number of records to read, 0 means reading all the records.
+ * @return Pointer to the cursor or NULL if all the cursors (CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS) are in use.
+ */
+hist_log_cursor_t*
+hist_log_cursor_open_newest_first(const hist_log_tier_e tier, const uint32_t num_records_max);
+
+/**
+ * @brief Read the next record, for the 5-minute tier mean, min and max of p_record are the same.
+ * @details The 5-minute tier includes the records buffered in RAM,
+ * each record is read once even if the buffer is written to flash between the calls.
+ * @param[out] p_timestamp Timestamp of the record (start of the time bucket for the rollup tiers).
+ * @param[out] p_seq Sequence number of the record.
+ * @param[out] p_record Pointer to the record.
+ */
+hist_log_cursor_status_e
+hist_log_cursor_next(
+    hist_log_cursor_t* const        p_cursor,
+    uint32_t* const                 p_timestamp,
+    uint32_t* const                 p_seq,
+    hist_log_rollup_record_t* const p_record);
+
+/**
+ * @brief Get the sequence number of the last record returned by hist_log_cursor_next().
+ * @details If no records were returned yet, it is the sequence number after which reading started,
+ * so the client can always request the next records after this number.
+ * For the newest-first cursor it is the oldest record returned so far, 0 if no records were returned.
+ */
+uint32_t
+hist_log_cursor_get_seq_last(const hist_log_cursor_t* const p_cursor);
+
+/**
+ * @brief Return only the records which match the filter.
+ * @details Every sector keeps the min/max of the filtered values of its records (zone map),
+ * so the sectors whose range can not match are skipped without reading them from flash.
+ * The filter must be set before the first call of hist_log_cursor_next(),
+ * it is not supported by the newest-first cursor.
+ * hist_log_cursor_get_seq_last() returns the sequence number of the last matching record.
+ * @param p_filter Pointer to the filter, it is copied to the cursor. NULL removes the filter.
+ * @return false if the filter is invalid (unknown field or operation, too many conditions).
+ */
+bool
+hist_log_cursor_set_filter(hist_log_cursor_t* const p_cursor, const hist_log_filter_t* const p_filter);
+
+/**
+ * @brief Return the records aggregated into time buckets instead of the records themselves.
+ * @details It reduces the number of records when the client needs a long period at a low resolution
+ * (e.g. a chart of two weeks with one point per hour). Every record returned by hist_log_cursor_next() contains
+ * the mean, min and max of the records in the time bucket, its timestamp is the start of the bucket
+ * and its sequence number is the one of the last record in the bucket. The bucket which is still being filled
+ * is returned after the last record, so the cursor should be closed after HIST_LOG_CURSOR_STATUS_END.
+ * The aggregation must be set before the first call of hist_log_cursor_next(),
+ * it is not supported by the newest-first cursor. If the filter is set, only the matching records are aggregated.
+ * @param period_s Length of the time bucket, a multiple of the period of the tier. 0 disables the aggregation.
+ * @return false if the period is not a multiple of the period of the tier.
+ */
+bool
+hist_log_cursor_set_aggregation(hist_log_cursor_t* const p_cursor, const uint32_t period_s);
+
+/**
+ * @brief Get the number of sectors which were skipped by the zone maps of the filter.
+ */
+uint32_t
+hist_log_cursor_get_num_sectors_skipped(const hist_log_cursor_t* const p_cursor);
+
+void
+hist_log_cursor_close(hist_log_cursor_t* const p_cursor);
+
 void
 hist_log_print_free_sectors(void);
 
+/**
+ * @brief Statistics of the append and read paths, they are reset on reboot or by hist_log_reset_stats().
+ */
+typedef struct hist_log_stats_t
+{
+    uint32_t append_time_max_us; //!< Worst-case duration of hist_log_append_record()
+    uint32_t num_pre_erases;     //!< Sectors erased in advance by the background work queue
+    //! Times the pre-erase was postponed because a reader was inside the oldest sector
+    uint32_t num_pre_erases_deferred;
+    //! Sectors erased by the append path because the tier was full, see CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE
+    uint32_t num_inline_erases;
+    //! Reads of the 5-minute tier served from RAM, see CONFIG_RUUVI_AIR_HIST_LOG_CACHE
+    uint32_t num_cache_hits;
+    uint32_t num_cache_misses; //!< Reads of the 5-minute tier which had to read flash
+} hist_log_stats_t;
+
+void
+hist_log_get_stats(hist_log_stats_t* const p_stats);
+
+void
+hist_log_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,428 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hist_log_codec.h"
+#include <string.h>
+#include "sys_utils.h"
+
+#define HIST_LOG_CODEC_HDR_FLAG_KEY_FRAME (1U << 0U)
+#define HIST_LOG_CODEC_HDR_FLAG_TIME      (1U << 1U)
+#define HIST_LOG_CODEC_HDR_FIELDS_SHIFT   (2U)
+
+#define HIST_LOG_CODEC_VARINT_DATA_MASK (0x7FU)
+#define HIST_LOG_CODEC_VARINT_FLAG_CONT (0x80U)
+#define HIST_LOG_CODEC_VARINT_SHIFT     (7U)
+#define HIST_LOG_CODEC_VARINT_MAX_LEN   (5U)
+
+#define HIST_LOG_CODEC_MAX_FIELD_SIZE (4U)
+
+typedef enum hist_log_codec_pred_e
+{
+    HIST_LOG_CODEC_PRED_PREV   = 0, //!< Value is predicted to be equal to the previous one
+    HIST_LOG_CODEC_PRED_LINEAR = 1, //!< Value is predicted to change by the same delta as the last time
+} hist_log_codec_pred_e;
+
+/**
+ * @brief Big-endian integer field of the E1 payload.
+ * @details The payload is split into fields only for compression,
+ * any payload bytes are restored exactly, so the codec does not depend on the meaning of the fields.
+ */
+typedef struct hist_log_codec_field_t
+{
+    uint8_t               offset;
+    uint8_t               size;
+    hist_log_codec_pred_e pred;
+} hist_log_codec_field_t;
+
+/**
+ * Fields which change most often come first, so that the header fits into two bytes for a typical record.
+ */
+static const hist_log_codec_field_t g_hist_log_codec_fields[HIST_LOG_CODEC_NUM_FIELDS] = {
+    { .offset = 1, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },    // Temperature
+    { .offset = 3, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },    // Humidity
+    { .offset = 5, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },    // Pressure
+    { .offset = 15, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },   // CO2
+    { .offset = 9, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },    // PM2.5
+    { .offset = 7, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },    // PM1.0
+    { .offset = 11, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },   // PM4.0
+    { .offset = 13, .size = 2, .pred = HIST_LOG_CODEC_PRED_PREV },   // PM10.0
+    { .offset = 23, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // Sound avg
+    { .offset = 24, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // Sound peak
+    { .offset = 22, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // Sound inst
+    { .offset = 19, .size = 3, .pred = HIST_LOG_CODEC_PRED_PREV },   // Luminosity
+    { .offset = 17, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // VOC
+    { .offset = 18, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // NOx
+    { .offset = 25, .size = 3, .pred = HIST_LOG_CODEC_PRED_LINEAR }, // Measurement sequence counter
+    { .offset = 28, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // Flags
+    { .offset = 0, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },    // Data format
+    { .offset = 29, .size = 4, .pred = HIST_LOG_CODEC_PRED_PREV },   // Reserved
+    { .offset = 33, .size = 1, .pred = HIST_LOG_CODEC_PRED_PREV },   // Reserved
+};
+
+typedef struct hist_log_codec_writer_t
+{
+    uint8_t* const p_buf;
+    const size_t   buf_size;
+    size_t         len;
+    bool           is_overflow;
+} hist_log_codec_writer_t;
+
+typedef struct hist_log_codec_reader_t
+{
+    const uint8_t* const p_buf;
+    const size_t         buf_size;
+    size_t               pos;
+    bool                 is_error;
+} hist_log_codec_reader_t;
+
+static uint32_t
+hist_log_codec_zigzag_encode(const int32_t val)
+{
+    return (val < 0) ? ~((uint32_t)val << 1U) : ((uint32_t)val << 1U);
+}
+
+static int32_t
+hist_log_codec_zigzag_decode(const uint32_t val)
+{
+    return (0 != (val & 1U)) ? (int32_t)~(val >> 1U) : (int32_t)(val >> 1U);
+}
+
+static void
+hist_log_codec_write_byte(hist_log_codec_writer_t* const p_writer, const uint8_t byte)
+{
+    if (p_writer->len >= p_writer->buf_size)
+    {
+        p_writer->is_overflow = true;
+        return;
+    }
+    p_writer->p_buf[p_writer->len] = byte;
+    p_writer->len += 1;
+}
+
+static void
+hist_log_codec_write_varint(hist_log_codec_writer_t* const p_writer, const uint32_t val)
+{
+    uint32_t rem = val;
+    while (rem > HIST_LOG_CODEC_VARINT_DATA_MASK)
+    {
+        hist_log_codec_write_byte(
+            p_writer,
+            (uint8_t)((rem & HIST_LOG_CODEC_VARINT_DATA_MASK) | HIST_LOG_CODEC_VARINT_FLAG_CONT));
+        rem >>= HIST_LOG_CODEC_VARINT_SHIFT;
+    }
+    hist_log_codec_write_byte(p_writer, (uint8_t)rem);
+}
+
+static uint32_t
+hist_log_codec_read_varint(hist_log_codec_reader_t* const p_reader)
+{
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < HIST_LOG_CODEC_VARINT_MAX_LEN; ++i)
+    {
+        if (p_reader->pos >= p_reader->buf_size)
+        {
+            break;
+        }
+        const uint8_t byte = p_reader->p_buf[p_reader->pos];
+        p_reader->pos += 1;
+        val |= (uint32_t)(byte & HIST_LOG_CODEC_VARINT_DATA_MASK) << (i * HIST_LOG_CODEC_VARINT_SHIFT);
+        if (0 == (byte & HIST_LOG_CODEC_VARINT_FLAG_CONT))
+        {
+            return val;
+        }
+    }
+    p_reader->is_error = true;
+    return 0;
+}
+
+static uint32_t
+hist_log_codec_field_get(const hist_log_record_data_t* const p_data, const hist_log_codec_field_t* const p_field)
+{
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < p_field->size; ++i)
+    {
+        val = (val << BYTE_SHIFT_1) | p_data->buf[p_field->offset + i];
+    }
+    return val;
+}
+
+static void
+hist_log_codec_field_set(
+    hist_log_record_data_t* const       p_data,
+    const hist_log_codec_field_t* const p_field,
+    const uint32_t                      val)
+{
+    for (uint32_t i = 0; i < p_field->size; ++i)
+    {
+        const uint32_t shift             = (p_field->size - 1 - i) * BYTE_SHIFT_1;
+        p_data->buf[p_field->offset + i] = (uint8_t)((val >> shift) & BYTE_MASK);
+    }
+}
+
+/**
+ * @brief Convert the difference of two field values to the signed delta with the smallest magnitude.
+ * @details The difference is calculated modulo the field size, so any pair of values can be restored exactly.
+ */
+static int32_t
+hist_log_codec_field_sign_extend(const hist_log_codec_field_t* const p_field, const uint32_t diff)
+{
+    if (HIST_LOG_CODEC_MAX_FIELD_SIZE == p_field->size)
+    {
+        return (int32_t)diff;
+    }
+    const uint32_t num_bits = p_field->size * BYTE_SHIFT_1;
+    const uint32_t mask     = (1U << num_bits) - 1U;
+    const uint32_t sign_bit = 1U << (num_bits - 1U);
+    const uint32_t val      = diff & mask;
+    return (0 != (val & sign_bit)) ? (int32_t)(val | ~mask) : (int32_t)val;
+}
+
+static uint32_t
+hist_log_codec_field_predict(
+    const hist_log_codec_state_t* const p_state,
+    const uint32_t                      field_idx,
+    const uint32_t                      prev_val)
+{
+    const hist_log_codec_field_t* const p_field = &g_hist_log_codec_fields[field_idx];
+    if (HIST_LOG_CODEC_PRED_LINEAR == p_field->pred)
+    {
+        return prev_val + (uint32_t)p_state->field_delta[field_idx];
+    }
+    return prev_val;
+}
+
+static void
+hist_log_codec_state_update(
+    hist_log_codec_state_t* const       p_state,
+    const uint32_t                      timestamp,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_data,
+    const bool                          flag_key_frame)
+{
+    if (flag_key_frame)
+    {
+        p_state->time_delta = 0;
+        memset(p_state->field_delta, 0, sizeof(p_state->field_delta));
+    }
+    else
+    {
+        p_state->time_delta = (int32_t)(timestamp - p_state->timestamp);
+        for (uint32_t i = 0; i < HIST_LOG_CODEC_NUM_FIELDS; ++i)
+        {
+            const hist_log_codec_field_t* const p_field = &g_hist_log_codec_fields[i];
+            p_state->field_delta[i]                     = hist_log_codec_field_sign_extend(
+                p_field,
+                hist_log_codec_field_get(p_data, p_field) - hist_log_codec_field_get(&p_state->data, p_field));
+        }
+    }
+    p_state->timestamp = timestamp;
+    p_state->seq       = seq;
+    p_state->data      = *p_data;
+    p_state->is_valid  = true;
+}
+
+static size_t
+hist_log_codec_write_uint32(uint8_t* const p_buf, const uint32_t val)
+{
+    for (uint32_t i = 0; i < sizeof(val); ++i)
+    {
+        p_buf[i] = (uint8_t)((val >> (i * BYTE_SHIFT_1)) & BYTE_MASK);
+    }
+    return sizeof(val);
+}
+
+static uint32_t
+hist_log_codec_read_uint32(const uint8_t* const p_buf)
+{
+    uint32_t val = 0;
+    for (uint32_t i = 0; i < sizeof(val); ++i)
+    {
+        val |= (uint32_t)p_buf[i] << (i * BYTE_SHIFT_1);
+    }
+    return val;
+}
+
+static size_t
+hist_log_codec_encode_key_frame(
+    const uint32_t                      timestamp,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_data,
+    uint8_t* const                      p_buf)
+{
+    size_t len = 0;
+    p_buf[len] = HIST_LOG_CODEC_HDR_FLAG_KEY_FRAME;
+    len += 1;
+    len += hist_log_codec_write_uint32(&p_buf[len], timestamp);
+    len += hist_log_codec_write_uint32(&p_buf[len], seq);
+    memcpy(&p_buf[len], p_data->buf, sizeof(p_data->buf));
+    len += sizeof(p_data->buf);
+    return len;
+}
+
+/**
+ * @return Length of the encoded frame or 0 if the delta frame would be longer than a key frame.
+ */
+static size_t
+hist_log_codec_encode_delta_frame(
+    const hist_log_codec_state_t* const p_state,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data,
+    uint8_t* const                      p_buf)
+{
+    uint32_t residuals[HIST_LOG_CODEC_NUM_FIELDS] = { 0 };
+    uint32_t hdr                                  = 0;
+
+    const int32_t time_residual = (int32_t)(timestamp - (p_state->timestamp + (uint32_t)p_state->time_delta));
+    if (0 != time_residual)
+    {
+        hdr |= HIST_LOG_CODEC_HDR_FLAG_TIME;
+    }
+    for (uint32_t i = 0; i < HIST_LOG_CODEC_NUM_FIELDS; ++i)
+    {
+        const hist_log_codec_field_t* const p_field = &g_hist_log_codec_fields[i];
+        const uint32_t prev_val = hist_log_codec_field_get(&p_state->data, p_field);
+        const uint32_t pred_val = hist_log_codec_field_predict(p_state, i, prev_val);
+        const int32_t  residual = hist_log_codec_field_sign_extend(
+            p_field,
+            hist_log_codec_field_get(p_data, p_field) - pred_val);
+        if (0 != residual)
+        {
+            hdr |= 1U << (HIST_LOG_CODEC_HDR_FIELDS_SHIFT + i);
+            residuals[i] = hist_log_codec_zigzag_encode(residual);
+        }
+    }
+
+    hist_log_codec_writer_t writer = {
+        .p_buf       = p_buf,
+        .buf_size    = HIST_LOG_CODEC_MAX_FRAME_LEN,
+        .len         = 0,
+        .is_overflow = false,
+    };
+    hist_log_codec_write_varint(&writer, hdr);
+    if (0 != time_residual)
+    {
+        hist_log_codec_write_varint(&writer, hist_log_codec_zigzag_encode(time_residual));
+    }
+    for (uint32_t i = 0; i < HIST_LOG_CODEC_NUM_FIELDS; ++i)
+    {
+        if (0 != (hdr & (1U << (HIST_LOG_CODEC_HDR_FIELDS_SHIFT + i))))
+        {
+            hist_log_codec_write_varint(&writer, residuals[i]);
+        }
+    }
+    // The delta frame of the same length as a key frame is also replaced, so the length can't overflow
+    if (writer.is_overflow || (writer.len >= HIST_LOG_CODEC_KEY_FRAME_LEN))
+    {
+        return 0;
+    }
+    return writer.len;
+}
+
+void
+hist_log_codec_reset(hist_log_codec_state_t* const p_state)
+{
+    memset(p_state, 0, sizeof(*p_state));
+    p_state->is_valid = false;
+}
+
+size_t
+hist_log_codec_encode(
+    hist_log_codec_state_t* const       p_state,
+    const uint32_t                      timestamp,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_data,
+    const bool                          flag_key_frame,
+    uint8_t* const                      p_buf)
+{
+    size_t len = 0;
+    if ((!flag_key_frame) && p_state->is_valid && (seq == (p_state->seq + 1U)))
+    {
+        len = hist_log_codec_encode_delta_frame(p_state, timestamp, p_data, p_buf);
+    }
+    const bool is_key_frame = (0 == len);
+    if (is_key_frame)
+    {
+        len = hist_log_codec_encode_key_frame(timestamp, seq, p_data, p_buf);
+    }
+    hist_log_codec_state_update(p_state, timestamp, seq, p_data, is_key_frame);
+    return len;
+}
+
+static bool
+hist_log_codec_decode_delta_frame(
+    const hist_log_codec_state_t* const p_state,
+    hist_log_codec_reader_t* const      p_reader,
+    const uint32_t                      hdr,
+    uint32_t* const                     p_timestamp,
+    hist_log_record_data_t* const       p_data)
+{
+    if (0 != (hdr >> (HIST_LOG_CODEC_HDR_FIELDS_SHIFT + HIST_LOG_CODEC_NUM_FIELDS)))
+    {
+        return false;
+    }
+    int32_t time_residual = 0;
+    if (0 != (hdr & HIST_LOG_CODEC_HDR_FLAG_TIME))
+    {
+        time_residual = hist_log_codec_zigzag_decode(hist_log_codec_read_varint(p_reader));
+    }
+    *p_timestamp = p_state->timestamp + (uint32_t)p_state->time_delta + (uint32_t)time_residual;
+    *p_data      = p_state->data;
+    for (uint32_t i = 0; i < HIST_LOG_CODEC_NUM_FIELDS; ++i)
+    {
+        const hist_log_codec_field_t* const p_field  = &g_hist_log_codec_fields[i];
+        const uint32_t                      prev_val = hist_log_codec_field_get(&p_state->data, p_field);
+        uint32_t                            val      = hist_log_codec_field_predict(p_state, i, prev_val);
+        if (0 != (hdr & (1U << (HIST_LOG_CODEC_HDR_FIELDS_SHIFT + i))))
+        {
+            val += (uint32_t)hist_log_codec_zigzag_decode(hist_log_codec_read_varint(p_reader));
+        }
+        hist_log_codec_field_set(p_data, p_field, val);
+    }
+    return !p_reader->is_error;
+}
+
+size_t
+hist_log_codec_decode(
+    hist_log_codec_state_t* const p_state,
+    const uint8_t* const          p_buf,
+    const size_t                  len,
+    uint32_t* const               p_timestamp,
+    uint32_t* const               p_seq,
+    hist_log_record_data_t* const p_data)
+{
+    hist_log_codec_reader_t reader = {
+        .p_buf    = p_buf,
+        .buf_size = len,
+        .pos      = 0,
+        .is_error = false,
+    };
+    const uint32_t hdr          = hist_log_codec_read_varint(&reader);
+    const bool     is_key_frame = (0 != (hdr & HIST_LOG_CODEC_HDR_FLAG_KEY_FRAME));
+    if (is_key_frame)
+    {
+        if ((HIST_LOG_CODEC_HDR_FLAG_KEY_FRAME != hdr) || (len < HIST_LOG_CODEC_KEY_FRAME_LEN))
+        {
+            p_state->is_valid = false;
+            return 0;
+        }
+        *p_timestamp = hist_log_codec_read_uint32(&p_buf[reader.pos]);
+        reader.pos += sizeof(uint32_t);
+        *p_seq = hist_log_codec_read_uint32(&p_buf[reader.pos]);
+        reader.pos += sizeof(uint32_t);
+        memcpy(p_data->buf, &p_buf[reader.pos], sizeof(p_data->buf));
+        reader.pos = HIST_LOG_CODEC_KEY_FRAME_LEN;
+    }
+    else if ((!p_state->is_valid) || reader.is_error
+             || (!hist_log_codec_decode_delta_frame(p_state, &reader, hdr, p_timestamp, p_data)))
+    {
+        p_state->is_valid = false;
+        return 0;
+    }
+    else
+    {
+        *p_seq = p_state->seq + 1U;
+    }
+    hist_log_codec_state_update(p_state, *p_timestamp, *p_seq, p_data, is_key_frame);
+    return reader.pos;
+}
@@ -0,0 +1,96 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef HIST_LOG_CODEC_H
+#define HIST_LOG_CODEC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of fields into which hist_log_record_data_t is split for delta encoding.
+ */
+#define HIST_LOG_CODEC_NUM_FIELDS (19U)
+
+/**
+ * Key frame: header (1 byte) + timestamp (4 bytes) + sequence number (4 bytes) + raw record data.
+ * Delta frames are never longer than a key frame, the encoder falls back to a key frame in this case.
+ * The sequence number of a delta frame is the previous one plus one, so it takes no space.
+ * Frames are self-delimiting, so several frames can be stored one after another in the same buffer.
+ */
+#define HIST_LOG_CODEC_KEY_FRAME_LEN (1U + sizeof(uint32_t) + sizeof(uint32_t) + sizeof(hist_log_record_data_t))
+
+#define HIST_LOG_CODEC_MAX_FRAME_LEN (HIST_LOG_CODEC_KEY_FRAME_LEN)
+
+/**
+ * @brief State of the encoder or decoder.
+ * @details Records are encoded as the difference to the previous record,
+ * so the decoder must process the frames in the same order as they were encoded, starting from a key frame.
+ */
+typedef struct hist_log_codec_state_t
+{
+    bool                   is_valid;   //!< The state contains the previous record (a key frame has been processed)
+    uint32_t               timestamp;  //!< Timestamp of the previous record
+    uint32_t               seq;        //!< Sequence number of the previous record
+    int32_t                time_delta; //!< Time interval between the last two records
+    hist_log_record_data_t data;       //!< Data of the previous record
+    //! Last delta of every field, it is used to predict the counters
+    int32_t field_delta[HIST_LOG_CODEC_NUM_FIELDS];
+} hist_log_codec_state_t;
+
+void
+hist_log_codec_reset(hist_log_codec_state_t* const p_state);
+
+/**
+ * @brief Encode the record as a key frame or as a delta to the previous record.
+ * @param p_state Pointer to the encoder state, it is updated with the encoded record.
+ * @param timestamp Timestamp of the record.
+ * @param seq Sequence number of the record, a key frame is used if it does not follow the previous one.
+ * @param p_data Pointer to the record data.
+ * @param flag_key_frame Force encoding as a key frame (the first record in a sector or after an error).
+ * @param p_buf Pointer to the output buffer, at least HIST_LOG_CODEC_MAX_FRAME_LEN bytes.
+ * @return Length of the encoded frame.
+ */
+size_t
+hist_log_codec_encode(
+    hist_log_codec_state_t* const       p_state,
+    const uint32_t                      timestamp,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_data,
+    const bool                          flag_key_frame,
+    uint8_t* const                      p_buf);
+
+/**
+ * @brief Decode a frame.
+ * @note The codec does not check data integrity, the caller must protect the frames with a checksum.
+ * @param p_state Pointer to the decoder state, it is updated with the decoded record.
+ *                If the frame is malformed, the state is invalidated and all the following delta frames
+ *                are rejected until the next key frame.
+ * @param p_buf Pointer to the encoded frame.
+ * @param len Number of bytes available in the buffer, the frame can be shorter.
+ * @param[out] p_timestamp Pointer to the decoded timestamp.
+ * @param[out] p_seq Pointer to the decoded sequence number.
+ * @param[out] p_data Pointer to the decoded record data.
+ * @return Length of the decoded frame or 0 on error.
+ */
+size_t
+hist_log_codec_decode(
+    hist_log_codec_state_t* const p_state,
+    const uint8_t* const          p_buf,
+    const size_t                  len,
+    uint32_t* const               p_timestamp,
+    uint32_t* const               p_seq,
+    hist_log_record_data_t* const p_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIST_LOG_CODEC_H
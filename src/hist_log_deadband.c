@@ -0,0 +1,96 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hist_log_deadband.h"
+#include <math.h>
+#include <string.h>
+#include "hist_log_zone_map.h"
+
+void
+hist_log_deadband_init(hist_log_deadband_t* const p_deadband, const hist_log_deadband_cfg_t* const p_cfg)
+{
+    memset(p_deadband, 0, sizeof(*p_deadband));
+    p_deadband->cfg          = *p_cfg;
+    p_deadband->is_ref_valid = false;
+}
+
+static bool
+hist_log_deadband_is_out_of_band(const hist_log_deadband_t* const p_deadband, const float32_t* const p_values)
+{
+    for (uint32_t i = 0; i < HIST_LOG_NUM_FIELDS; ++i)
+    {
+        const float32_t tolerance = p_deadband->cfg.tolerance[i];
+        if (tolerance <= 0.0f)
+        {
+            continue;
+        }
+        const bool is_ref_nan = (bool)isnan(p_deadband->ref[i]);
+        const bool is_val_nan = (bool)isnan(p_values[i]);
+        if (is_ref_nan || is_val_nan)
+        {
+            // The sensor became valid or invalid
+            if (is_ref_nan != is_val_nan)
+            {
+                return true;
+            }
+            continue;
+        }
+        if (fabsf(p_values[i] - p_deadband->ref[i]) > tolerance)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void
+hist_log_deadband_set_ref(
+    hist_log_deadband_t* const p_deadband,
+    const uint32_t             timestamp,
+    const float32_t* const     p_values)
+{
+    p_deadband->is_ref_valid  = true;
+    p_deadband->timestamp_ref = timestamp;
+    memcpy(p_deadband->ref, p_values, sizeof(p_deadband->ref));
+}
+
+bool
+hist_log_deadband_check_event(
+    hist_log_deadband_t* const          p_deadband,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data)
+{
+    if (!p_deadband->is_ref_valid)
+    {
+        // The first point is the average of the full window
+        return false;
+    }
+    float32_t values[HIST_LOG_NUM_FIELDS];
+    hist_log_fields_decode(p_data, values);
+    if (!hist_log_deadband_is_out_of_band(p_deadband, values))
+    {
+        return false;
+    }
+    hist_log_deadband_set_ref(p_deadband, timestamp, values);
+    return true;
+}
+
+bool
+hist_log_deadband_check_window(
+    hist_log_deadband_t* const          p_deadband,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data)
+{
+    // The band is not checked here: the full window may still contain an event which was already logged,
+    // and any change which lasts longer than the short window is detected by hist_log_deadband_check_event().
+    // If the clock was moved back, the difference is huge and the record is logged.
+    if (p_deadband->is_ref_valid && ((timestamp - p_deadband->timestamp_ref) < p_deadband->cfg.max_interval_s))
+    {
+        return false;
+    }
+    float32_t values[HIST_LOG_NUM_FIELDS];
+    hist_log_fields_decode(p_data, values);
+    hist_log_deadband_set_ref(p_deadband, timestamp, values);
+    return true;
+}
@@ -0,0 +1,67 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef HIST_LOG_DEADBAND_H
+#define HIST_LOG_DEADBAND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/dsp/types.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct hist_log_deadband_cfg_t
+{
+    //! Max deviation of every field (see hist_log_field_e) from the last logged point, 0 means the field is ignored
+    float32_t tolerance[HIST_LOG_NUM_FIELDS];
+    uint32_t  max_interval_s; //!< Max time between the logged points while the values are stable
+} hist_log_deadband_cfg_t;
+
+/**
+ * @brief State of the deadband logging.
+ * @details The values of the last logged point are used as the reference. While all the fields stay
+ * within the tolerance band around it, the average of the full window is logged only once per max_interval_s.
+ * As soon as the short-window average leaves the band, it is logged immediately and becomes the new reference,
+ * so short events (e.g. a CO2 spike when a door is opened) are not smeared out by the full-window average.
+ */
+typedef struct hist_log_deadband_t
+{
+    hist_log_deadband_cfg_t cfg;
+    bool                    is_ref_valid;
+    uint32_t                timestamp_ref;
+    float32_t               ref[HIST_LOG_NUM_FIELDS];
+} hist_log_deadband_t;
+
+void
+hist_log_deadband_init(hist_log_deadband_t* const p_deadband, const hist_log_deadband_cfg_t* const p_cfg);
+
+/**
+ * @brief Check the average of the short window (it is called more often than once per full window).
+ * @return true if any field left the tolerance band, in this case the record must be logged immediately.
+ */
+bool
+hist_log_deadband_check_event(
+    hist_log_deadband_t* const          p_deadband,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data);
+
+/**
+ * @brief Check the average of the full window.
+ * @return true if the record must be logged: it is the first record or max_interval_s elapsed
+ * since the last logged point.
+ */
+bool
+hist_log_deadband_check_window(
+    hist_log_deadband_t* const          p_deadband,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIST_LOG_DEADBAND_H
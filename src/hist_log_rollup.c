@@ -0,0 +1,177 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hist_log_rollup.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include "ruuvi_endpoint_e1.h"
+
+/**
+ * Offsets of the aggregated sensor values in re_e1_data_t.
+ * The sequence counter, flags and MAC address are not aggregated, they are taken from the last record.
+ */
+static const size_t g_hist_log_rollup_field_offsets[HIST_LOG_ROLLUP_NUM_FIELDS] = {
+    offsetof(re_e1_data_t, temperature_c),
+    offsetof(re_e1_data_t, humidity_rh),
+    offsetof(re_e1_data_t, pressure_pa),
+    offsetof(re_e1_data_t, pm1p0_ppm),
+    offsetof(re_e1_data_t, pm2p5_ppm),
+    offsetof(re_e1_data_t, pm4p0_ppm),
+    offsetof(re_e1_data_t, pm10p0_ppm),
+    offsetof(re_e1_data_t, co2),
+    offsetof(re_e1_data_t, voc),
+    offsetof(re_e1_data_t, nox),
+    offsetof(re_e1_data_t, luminosity),
+    offsetof(re_e1_data_t, sound_inst_dba),
+    offsetof(re_e1_data_t, sound_avg_dba),
+    offsetof(re_e1_data_t, sound_peak_spl_db),
+};
+
+static float32_t*
+hist_log_rollup_get_field(re_e1_data_t* const p_e1_data, const uint32_t field_idx)
+{
+    return (float32_t*)((uint8_t*)p_e1_data + g_hist_log_rollup_field_offsets[field_idx]); // NOSONAR
+}
+
+static re_e1_data_t
+hist_log_rollup_decode(const hist_log_record_data_t* const p_data)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, p_data->buf, sizeof(p_data->buf));
+    re_e1_data_t e1_data = { 0 };
+    (void)re_e1_decode(buffer, &e1_data);
+    return e1_data;
+}
+
+static hist_log_record_data_t
+hist_log_rollup_encode(const re_e1_data_t* const p_e1_data)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, p_e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+static void
+hist_log_rollup_restart(hist_log_rollup_t* const p_rollup, const uint32_t timestamp)
+{
+    p_rollup->timestamp_start = hist_log_rollup_get_bucket(p_rollup, timestamp);
+    p_rollup->num_records     = 0;
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_FIELDS; ++i)
+    {
+        p_rollup->fields[i] = (hist_log_rollup_field_t) {
+            .mean = NAN,
+            .min  = NAN,
+            .max  = NAN,
+            .cnt  = 0,
+        };
+    }
+}
+
+void
+hist_log_rollup_init(hist_log_rollup_t* const p_rollup, const uint32_t period_s)
+{
+    memset(p_rollup, 0, sizeof(*p_rollup));
+    p_rollup->period_s = period_s;
+    hist_log_rollup_restart(p_rollup, 0);
+}
+
+uint32_t
+hist_log_rollup_get_bucket(const hist_log_rollup_t* const p_rollup, const uint32_t timestamp)
+{
+    return timestamp - (timestamp % p_rollup->period_s);
+}
+
+static void
+hist_log_rollup_complete(
+    const hist_log_rollup_t* const  p_rollup,
+    uint32_t* const                 p_timestamp_out,
+    hist_log_rollup_record_t* const p_record_out)
+{
+    re_e1_data_t e1_mean = hist_log_rollup_decode(&p_rollup->last_data);
+    re_e1_data_t e1_min  = e1_mean;
+    re_e1_data_t e1_max  = e1_mean;
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_FIELDS; ++i)
+    {
+        const hist_log_rollup_field_t* const p_field = &p_rollup->fields[i];
+        *hist_log_rollup_get_field(&e1_mean, i)      = p_field->mean;
+        *hist_log_rollup_get_field(&e1_min, i)       = p_field->min;
+        *hist_log_rollup_get_field(&e1_max, i)       = p_field->max;
+    }
+    *p_timestamp_out   = p_rollup->timestamp_start;
+    p_record_out->mean = hist_log_rollup_encode(&e1_mean);
+    p_record_out->min  = hist_log_rollup_encode(&e1_min);
+    p_record_out->max  = hist_log_rollup_encode(&e1_max);
+}
+
+bool
+hist_log_rollup_add(
+    hist_log_rollup_t* const              p_rollup,
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record,
+    uint32_t* const                       p_timestamp_out,
+    hist_log_rollup_record_t* const       p_record_out)
+{
+    bool flag_completed = false;
+    if (hist_log_rollup_get_bucket(p_rollup, timestamp) != p_rollup->timestamp_start)
+    {
+        // The clock can also be set back, in this case the current bucket is completed as well
+        if (0 != p_rollup->num_records)
+        {
+            hist_log_rollup_complete(p_rollup, p_timestamp_out, p_record_out);
+            flag_completed = true;
+        }
+        hist_log_rollup_restart(p_rollup, timestamp);
+    }
+
+    re_e1_data_t e1_mean = hist_log_rollup_decode(&p_record->mean);
+    re_e1_data_t e1_min  = hist_log_rollup_decode(&p_record->min);
+    re_e1_data_t e1_max  = hist_log_rollup_decode(&p_record->max);
+    for (uint32_t i = 0; i < HIST_LOG_ROLLUP_NUM_FIELDS; ++i)
+    {
+        hist_log_rollup_field_t* const p_field = &p_rollup->fields[i];
+        const float32_t                mean    = *hist_log_rollup_get_field(&e1_mean, i);
+        const float32_t                min     = *hist_log_rollup_get_field(&e1_min, i);
+        const float32_t                max     = *hist_log_rollup_get_field(&e1_max, i);
+        if ((bool)isnan(mean))
+        {
+            continue;
+        }
+        if (0 == p_field->cnt)
+        {
+            p_field->mean = mean;
+            p_field->min  = min;
+            p_field->max  = max;
+        }
+        else
+        {
+            p_field->min = fminf(p_field->min, min);
+            p_field->max = fmaxf(p_field->max, max);
+            // Running mean, it does not lose precision for large values like the pressure in Pa
+            p_field->mean += (mean - p_field->mean) / (float32_t)(p_field->cnt + 1);
+        }
+        p_field->cnt += 1;
+    }
+    p_rollup->last_data = p_record->mean;
+    p_rollup->num_records += 1;
+    return flag_completed;
+}
+
+bool
+hist_log_rollup_flush(
+    hist_log_rollup_t* const        p_rollup,
+    uint32_t* const                 p_timestamp_out,
+    hist_log_rollup_record_t* const p_record_out)
+{
+    if (0 == p_rollup->num_records)
+    {
+        return false;
+    }
+    hist_log_rollup_complete(p_rollup, p_timestamp_out, p_record_out);
+    hist_log_rollup_restart(p_rollup, 0);
+    return true;
+}
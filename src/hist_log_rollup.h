@@ -0,0 +1,92 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef HIST_LOG_ROLLUP_H
+#define HIST_LOG_ROLLUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/dsp/types.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of the sensor values in the E1 payload which are aggregated (temperature, humidity, pressure, PM, CO2,
+ * VOC, NOx, luminosity and sound).
+ */
+#define HIST_LOG_ROLLUP_NUM_FIELDS (14U)
+
+typedef struct hist_log_rollup_field_t
+{
+    float32_t mean;
+    float32_t min;
+    float32_t max;
+    uint32_t  cnt; //!< Number of valid values
+} hist_log_rollup_field_t;
+
+/**
+ * @brief Accumulator of the records for one time bucket of the rollup tier.
+ * @details The records are aggregated incrementally, so the accumulator keeps only the running mean/min/max
+ * of every sensor value, not the records themselves.
+ */
+typedef struct hist_log_rollup_t
+{
+    uint32_t                period_s;
+    uint32_t                timestamp_start; //!< Start of the current time bucket
+    uint32_t                num_records;     //!< Number of records in the current time bucket
+    hist_log_record_data_t  last_data;       //!< The last record, its sequence counter and flags are kept as is
+    hist_log_rollup_field_t fields[HIST_LOG_ROLLUP_NUM_FIELDS];
+} hist_log_rollup_t;
+
+void
+hist_log_rollup_init(hist_log_rollup_t* const p_rollup, const uint32_t period_s);
+
+/**
+ * @brief Get the start of the time bucket which contains the timestamp.
+ */
+uint32_t
+hist_log_rollup_get_bucket(const hist_log_rollup_t* const p_rollup, const uint32_t timestamp);
+
+/**
+ * @brief Add the record to the accumulator.
+ * @details The record of the previous time bucket is completed when the first record of another bucket is added,
+ * the accumulator is then restarted with the new record.
+ * @param p_rollup Pointer to the accumulator.
+ * @param timestamp Timestamp of the record.
+ * @param p_record Pointer to the record, for the raw records mean, min and max are the same.
+ * @param[out] p_timestamp_out Pointer to the start of the completed time bucket.
+ * @param[out] p_record_out Pointer to the aggregated record of the completed time bucket.
+ * @return true if the time bucket was completed.
+ */
+bool
+hist_log_rollup_add(
+    hist_log_rollup_t* const              p_rollup,
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record,
+    uint32_t* const                       p_timestamp_out,
+    hist_log_rollup_record_t* const       p_record_out);
+
+/**
+ * @brief Complete the current time bucket even if it is not finished yet.
+ * @details It is used when the clock is reset, so that the records of the previous clock are not mixed
+ * with the records of the new one.
+ * @param p_rollup Pointer to the accumulator.
+ * @param[out] p_timestamp_out Pointer to the start of the completed time bucket.
+ * @param[out] p_record_out Pointer to the aggregated record of the completed time bucket.
+ * @return true if the accumulator contained any records.
+ */
+bool
+hist_log_rollup_flush(
+    hist_log_rollup_t* const        p_rollup,
+    uint32_t* const                 p_timestamp_out,
+    hist_log_rollup_record_t* const p_record_out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIST_LOG_ROLLUP_H
@@ -0,0 +1,206 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hist_log_zone_map.h"
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/dsp/types.h>
+#include "ruuvi_endpoint_e1.h"
+
+/**
+ * @brief Offset of the sensor value in re_e1_data_t and its scale in the zone map.
+ * @details The scale is chosen so that the full range of the E1 field fits into int16_t,
+ * CO2 above 32767 ppm is saturated, which keeps the comparisons correct.
+ */
+typedef struct hist_log_zone_map_field_t
+{
+    size_t    offset;
+    float32_t scale;
+} hist_log_zone_map_field_t;
+
+static const hist_log_zone_map_field_t g_hist_log_zone_map_fields[HIST_LOG_NUM_FIELDS] = {
+    [HIST_LOG_FIELD_TEMPERATURE] = { .offset = offsetof(re_e1_data_t, temperature_c), .scale = 100.0f },
+    [HIST_LOG_FIELD_HUMIDITY]    = { .offset = offsetof(re_e1_data_t, humidity_rh), .scale = 100.0f },
+    [HIST_LOG_FIELD_PM2P5]       = { .offset = offsetof(re_e1_data_t, pm2p5_ppm), .scale = 10.0f },
+    [HIST_LOG_FIELD_CO2]         = { .offset = offsetof(re_e1_data_t, co2), .scale = 1.0f },
+    [HIST_LOG_FIELD_VOC]         = { .offset = offsetof(re_e1_data_t, voc), .scale = 1.0f },
+    [HIST_LOG_FIELD_NOX]         = { .offset = offsetof(re_e1_data_t, nox), .scale = 1.0f },
+    [HIST_LOG_FIELD_SOUND_AVG]   = { .offset = offsetof(re_e1_data_t, sound_avg_dba), .scale = 10.0f },
+};
+
+static float32_t
+hist_log_zone_map_get_field(const re_e1_data_t* const p_e1_data, const uint32_t field_idx)
+{
+    return *(const float32_t*)((const uint8_t*)p_e1_data + g_hist_log_zone_map_fields[field_idx].offset); // NOSONAR
+}
+
+static re_e1_data_t
+hist_log_zone_map_decode(const hist_log_record_data_t* const p_data)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, p_data->buf, sizeof(p_data->buf));
+    re_e1_data_t e1_data = { 0 };
+    (void)re_e1_decode(buffer, &e1_data);
+    return e1_data;
+}
+
+void
+hist_log_fields_decode(const hist_log_record_data_t* const p_data, float32_t p_values[HIST_LOG_NUM_FIELDS])
+{
+    const re_e1_data_t e1_data = hist_log_zone_map_decode(p_data);
+    for (uint32_t i = 0; i < HIST_LOG_NUM_FIELDS; ++i)
+    {
+        p_values[i] = hist_log_zone_map_get_field(&e1_data, i);
+    }
+}
+
+/**
+ * @brief Convert the value to the zone map units with saturation.
+ * @param flag_round_up true to round up (for the max), false to round down (for the min).
+ */
+static int16_t
+hist_log_zone_map_quantize(const uint32_t field_idx, const float32_t val, const bool flag_round_up)
+{
+    const float32_t scaled  = val * g_hist_log_zone_map_fields[field_idx].scale;
+    const float32_t rounded = flag_round_up ? ceilf(scaled) : floorf(scaled);
+    if (rounded >= (float32_t)INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    if (rounded <= (float32_t)INT16_MIN)
+    {
+        return INT16_MIN;
+    }
+    return (int16_t)rounded;
+}
+
+void
+hist_log_zone_map_clear(hist_log_zone_map_t* const p_zone_map)
+{
+    for (uint32_t i = 0; i < HIST_LOG_NUM_FIELDS; ++i)
+    {
+        p_zone_map->min[i] = INT16_MAX;
+        p_zone_map->max[i] = INT16_MIN;
+    }
+}
+
+void
+hist_log_zone_map_add(hist_log_zone_map_t* const p_zone_map, const hist_log_rollup_record_t* const p_record)
+{
+    const re_e1_data_t e1_min = hist_log_zone_map_decode(&p_record->min);
+    const re_e1_data_t e1_max = hist_log_zone_map_decode(&p_record->max);
+    for (uint32_t i = 0; i < HIST_LOG_NUM_FIELDS; ++i)
+    {
+        const float32_t min = hist_log_zone_map_get_field(&e1_min, i);
+        const float32_t max = hist_log_zone_map_get_field(&e1_max, i);
+        if ((bool)isnan(min) || (bool)isnan(max))
+        {
+            continue;
+        }
+        const int16_t min_q = hist_log_zone_map_quantize(i, min, false);
+        const int16_t max_q = hist_log_zone_map_quantize(i, max, true);
+        if (min_q < p_zone_map->min[i])
+        {
+            p_zone_map->min[i] = min_q;
+        }
+        if (max_q > p_zone_map->max[i])
+        {
+            p_zone_map->max[i] = max_q;
+        }
+    }
+}
+
+void
+hist_log_zone_map_merge(hist_log_zone_map_t* const p_zone_map, const hist_log_zone_map_t* const p_other)
+{
+    for (uint32_t i = 0; i < HIST_LOG_NUM_FIELDS; ++i)
+    {
+        if (p_other->min[i] < p_zone_map->min[i])
+        {
+            p_zone_map->min[i] = p_other->min[i];
+        }
+        if (p_other->max[i] > p_zone_map->max[i])
+        {
+            p_zone_map->max[i] = p_other->max[i];
+        }
+    }
+}
+
+bool
+hist_log_zone_map_can_match(const hist_log_zone_map_t* const p_zone_map, const hist_log_filter_t* const p_filter)
+{
+    for (uint32_t i = 0; i < p_filter->num_conds; ++i)
+    {
+        const hist_log_filter_cond_t* const p_cond = &p_filter->conds[i];
+        const uint32_t                      field  = (uint32_t)p_cond->field;
+        if (p_zone_map->min[field] > p_zone_map->max[field])
+        {
+            // There are no valid values of this field
+            continue;
+        }
+        // The threshold is rounded in the opposite direction to the range, so the comparison is conservative
+        if ((HIST_LOG_FILTER_OP_GT == p_cond->op)
+            && (p_zone_map->max[field] >= hist_log_zone_map_quantize(field, p_cond->threshold, false)))
+        {
+            return true;
+        }
+        if ((HIST_LOG_FILTER_OP_LT == p_cond->op)
+            && (p_zone_map->min[field] <= hist_log_zone_map_quantize(field, p_cond->threshold, true)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+hist_log_filter_is_valid(const hist_log_filter_t* const p_filter)
+{
+    if ((0 == p_filter->num_conds) || (p_filter->num_conds > HIST_LOG_FILTER_MAX_CONDS))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < p_filter->num_conds; ++i)
+    {
+        const hist_log_filter_cond_t* const p_cond = &p_filter->conds[i];
+        if ((uint32_t)p_cond->field >= HIST_LOG_NUM_FIELDS)
+        {
+            return false;
+        }
+        if ((HIST_LOG_FILTER_OP_GT != p_cond->op) && (HIST_LOG_FILTER_OP_LT != p_cond->op))
+        {
+            return false;
+        }
+        if ((bool)isnan(p_cond->threshold))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+hist_log_filter_match(const hist_log_filter_t* const p_filter, const hist_log_rollup_record_t* const p_record)
+{
+    const re_e1_data_t e1_min = hist_log_zone_map_decode(&p_record->min);
+    const re_e1_data_t e1_max = hist_log_zone_map_decode(&p_record->max);
+    for (uint32_t i = 0; i < p_filter->num_conds; ++i)
+    {
+        const hist_log_filter_cond_t* const p_cond = &p_filter->conds[i];
+        // Comparisons with NaN are false, so the invalid values never match
+        if ((HIST_LOG_FILTER_OP_GT == p_cond->op)
+            && (hist_log_zone_map_get_field(&e1_max, p_cond->field) > p_cond->threshold))
+        {
+            return true;
+        }
+        if ((HIST_LOG_FILTER_OP_LT == p_cond->op)
+            && (hist_log_zone_map_get_field(&e1_min, p_cond->field) < p_cond->threshold))
+        {
+            return true;
+        }
+    }
+    return false;
+}
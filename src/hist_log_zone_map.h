@@ -0,0 +1,77 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef HIST_LOG_ZONE_MAP_H
+#define HIST_LOG_ZONE_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/dsp/types.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Range of the filtered sensor values (see hist_log_field_e) of the records in one sector.
+ * @details The values are stored as 16-bit integers in fixed units (e.g. 0.01 °C for the temperature),
+ * the min is rounded down and the max is rounded up, so the range always includes the actual values
+ * and the sector is never skipped by mistake. If a field has no valid values, min > max.
+ */
+typedef struct hist_log_zone_map_t
+{
+    int16_t min[HIST_LOG_NUM_FIELDS];
+    int16_t max[HIST_LOG_NUM_FIELDS];
+} hist_log_zone_map_t;
+
+/**
+ * @brief Initialize the empty zone map, which does not match any filter.
+ */
+void
+hist_log_zone_map_clear(hist_log_zone_map_t* const p_zone_map);
+
+/**
+ * @brief Extend the zone map by the record.
+ * @param p_record Pointer to the record, for the raw records mean, min and max are the same.
+ */
+void
+hist_log_zone_map_add(hist_log_zone_map_t* const p_zone_map, const hist_log_rollup_record_t* const p_record);
+
+/**
+ * @brief Extend the zone map by the range of another one.
+ */
+void
+hist_log_zone_map_merge(hist_log_zone_map_t* const p_zone_map, const hist_log_zone_map_t* const p_other);
+
+/**
+ * @brief Check if any record within the range of the zone map could match the filter.
+ */
+bool
+hist_log_zone_map_can_match(const hist_log_zone_map_t* const p_zone_map, const hist_log_filter_t* const p_filter);
+
+/**
+ * @brief Check that the filter contains only the known fields and operations.
+ */
+bool
+hist_log_filter_is_valid(const hist_log_filter_t* const p_filter);
+
+/**
+ * @brief Decode the values of the fields (see hist_log_field_e) of the record, the invalid values are NaN.
+ */
+void
+hist_log_fields_decode(const hist_log_record_data_t* const p_data, float32_t p_values[HIST_LOG_NUM_FIELDS]);
+
+/**
+ * @brief Check if the record matches the filter.
+ * @param p_record Pointer to the record, for the raw records mean, min and max are the same.
+ */
+bool
+hist_log_filter_match(const hist_log_filter_t* const p_filter, const hist_log_rollup_record_t* const p_record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIST_LOG_ZONE_MAP_H
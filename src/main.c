@@ -22,7 +22,10 @@
 #include "sensors.h"
 #include "ble_adv.h"
 #include "nfc.h"
+#include "flash_stats.h"
+#include "hires_log.h"
 #include "hist_log.h"
+#include "hist_log_deadband.h"
 #include "moving_avg.h"
 #include "tlog.h"
 #include "utils.h"
@@ -90,6 +93,23 @@ struct fs_mount_t* g_mountpoint = &lfs_storage_mnt;
 static k_tid_t g_main_thread_id;
 static bool    g_flag_rtc_valid_on_boot;
 
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND)
+static const hist_log_deadband_cfg_t g_hist_log_deadband_cfg = {
+    .tolerance = {
+        [HIST_LOG_FIELD_TEMPERATURE] = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_TEMPERATURE_X100 / 100.0f,
+        [HIST_LOG_FIELD_HUMIDITY]    = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_HUMIDITY_X100 / 100.0f,
+        [HIST_LOG_FIELD_PM2P5]       = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_PM2P5_X10 / 10.0f,
+        [HIST_LOG_FIELD_CO2]         = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_CO2,
+        [HIST_LOG_FIELD_VOC]         = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_VOC,
+        [HIST_LOG_FIELD_NOX]         = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_NOX,
+        [HIST_LOG_FIELD_SOUND_AVG]   = (float32_t)CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_SOUND_X10 / 10.0f,
+    },
+    .max_interval_s = CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND_MAX_INTERVAL_SECS,
+};
+
+static hist_log_deadband_t g_hist_log_deadband;
+#endif
+
 static bool
 mount_fs(void)
 {
@@ -263,6 +283,51 @@ check_rtc_clock(void)
     return is_rtc_valid;
 }
 
+static void
+log_hist_record(const uint32_t timestamp, const hist_log_record_data_t* const p_record)
+{
+    if (!hist_log_append_record(timestamp, p_record, true))
+    {
+        LOG_ERR("hist_log_append_record failed");
+    }
+    hist_log_print_free_sectors();
+}
+
+/**
+ * @brief Log the average of the 5-minute window, or with the deadband logging enabled,
+ * log the averages of the short (20-second) windows which leave the tolerance band.
+ */
+static void
+log_hist(const measurement_cnt_t measurement_cnt, const sensors_flags_t flags, const bool is_window_completed)
+{
+    const uint32_t timestamp = (uint32_t)time(NULL);
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND)
+    if (moving_avg_is_short_window_completed())
+    {
+        const hist_log_record_data_t record = moving_avg_get_short_accum(measurement_cnt, ble_adv_get_mac(), flags);
+        if (hist_log_deadband_check_event(&g_hist_log_deadband, timestamp, &record))
+        {
+            log_hist_record(timestamp, &record);
+            return;
+        }
+    }
+    if (is_window_completed)
+    {
+        const hist_log_record_data_t record = moving_avg_get_accum(measurement_cnt, ble_adv_get_mac(), flags);
+        if (hist_log_deadband_check_window(&g_hist_log_deadband, timestamp, &record))
+        {
+            log_hist_record(timestamp, &record);
+        }
+    }
+#else
+    if (is_window_completed)
+    {
+        const hist_log_record_data_t record = moving_avg_get_accum(measurement_cnt, ble_adv_get_mac(), flags);
+        log_hist_record(timestamp, &record);
+    }
+#endif
+}
+
 static void
 poll_sensors(void)
 {
@@ -304,20 +369,19 @@ poll_sensors(void)
     }
     measurement_cnt += 1;
 
-    const sensors_measurement_t measurement = sensors_get_measurement();
-    if (moving_avg_append(&measurement))
+    const sensors_measurement_t measurement  = sensors_get_measurement();
+    const hires_log_sample_t    hires_sample = hires_log_conv_measurement((uint32_t)cur_unix_time, &measurement);
+    hires_log_append(&hires_sample);
+
+    const bool is_window_completed = moving_avg_append(&measurement);
+    if (is_window_completed || moving_avg_is_short_window_completed())
     {
         const sensors_flags_t flags = {
             .flag_calibration_in_progress = measurement.flag_nox_calibration_in_progress,
             .flag_button_pressed          = app_button_is_pressed(),
             .flag_rtc_running_on_boot     = g_flag_rtc_valid_on_boot,
         };
-        const hist_log_record_data_t record = moving_avg_get_accum(measurement_cnt, ble_adv_get_mac(), flags);
-        if (!hist_log_append_record((uint32_t)time(NULL), &record, true))
-        {
-            LOG_ERR("hist_log_append_record failed");
-        }
-        hist_log_print_free_sectors();
+        log_hist(measurement_cnt, flags, is_window_completed);
     }
 
     if (IS_ENABLED(CONFIG_RUUVI_AIR_LED_MODE_AQI))
@@ -467,6 +531,7 @@ main(void)
     {
         LOG_ERR("app_settings_init failed");
     }
+    flash_stats_init();
 
     rgb_led_init((rgb_led_brightness_t)CONFIG_RUUVI_AIR_LED_BRIGHTNESS);
     aqi_init();
@@ -476,10 +541,14 @@ main(void)
 
     (void)mount_fs();
 
+    hires_log_init();
     if (!hist_log_init(g_flag_rtc_valid_on_boot))
     {
         LOG_ERR("hist_log_init failed");
     }
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_DEADBAND)
+    hist_log_deadband_init(&g_hist_log_deadband, &g_hist_log_deadband_cfg);
+#endif
 
     if (!sensors_init())
     {
@@ -599,6 +668,15 @@ __wrap_sys_reboot(int type) // NOSONAR
             opt_rgb_ctrl_enable_led(false);
             rgb_led_set_color_black();
         }
+        TLOG_WRN("Write buffered history records before reboot");
+        if (!hist_log_flush())
+        {
+            TLOG_ERR("hist_log_flush failed");
+        }
+        if (!flash_stats_save())
+        {
+            TLOG_ERR("flash_stats_save failed");
+        }
         bool flag_updates_available = false;
         if (app_fs_is_file_exist(RUUVI_FW_UPDATE_MOUNT_POINT "/" RUUVI_FW_MCUBOOT0_FILE_NAME))
         {
@@ -83,11 +83,15 @@ static moving_avg_arr_t g_moving_avg2 = {
     .cnt          = 0,
 };
 
+static moving_avg_data_t g_moving_avg_short_data;
+static bool              g_moving_avg_short_completed;
+
 void
 moving_avg_init(void)
 {
-    g_moving_avg1.cnt = 0;
-    g_moving_avg2.cnt = 0;
+    g_moving_avg1.cnt            = 0;
+    g_moving_avg2.cnt            = 0;
+    g_moving_avg_short_completed = false;
 }
 
 static bool
@@ -209,9 +213,12 @@ moving_avg_append(const sensors_measurement_t* const p_measurement)
         .sound_avg_dba_x100     = conv_sound_dba_float_to_x100(p_measurement->sound_avg_dba),
         .sound_peak_spl_db_x100 = conv_sound_dba_float_to_x100(p_measurement->sound_peak_spl_db),
     };
+    g_moving_avg_short_completed = false;
     if (moving_avg_data_append(&g_moving_avg1, &data))
     {
         const moving_avg_data_t data2 = moving_avg_data_get_avg(&g_moving_avg1);
+        g_moving_avg_short_data       = data2;
+        g_moving_avg_short_completed  = true;
         if (moving_avg_data_append(&g_moving_avg2, &data2))
         {
             return true;
@@ -220,29 +227,38 @@ moving_avg_append(const sensors_measurement_t* const p_measurement)
     return false;
 }
 
-hist_log_record_data_t
-moving_avg_get_accum(const measurement_cnt_t measurement_cnt, const radio_mac_t radio_mac, const sensors_flags_t flags)
+bool
+moving_avg_is_short_window_completed(void)
 {
-    const moving_avg_data_t avg_data = moving_avg_data_get_avg(&g_moving_avg2);
+    return g_moving_avg_short_completed;
+}
 
+static hist_log_record_data_t
+moving_avg_encode(
+    const moving_avg_data_t* const p_avg_data,
+    const measurement_cnt_t        measurement_cnt,
+    const radio_mac_t              radio_mac,
+    const sensors_flags_t          flags)
+{
     const sensors_measurement_t measurement_avg = {
-        .sen66.mass_concentration_pm1p0  = avg_data.mass_concentration_pm1p0,
-        .sen66.mass_concentration_pm2p5  = avg_data.mass_concentration_pm2p5,
-        .sen66.mass_concentration_pm4p0  = avg_data.mass_concentration_pm4p0,
-        .sen66.mass_concentration_pm10p0 = avg_data.mass_concentration_pm10p0,
-        .sen66.ambient_humidity          = avg_data.ambient_humidity,
-        .sen66.ambient_temperature       = avg_data.ambient_temperature,
-        .sen66.voc_index                 = avg_data.voc_index,
-        .sen66.nox_index                 = avg_data.nox_index,
-        .sen66.co2                       = avg_data.co2,
+        .sen66.mass_concentration_pm1p0  = p_avg_data->mass_concentration_pm1p0,
+        .sen66.mass_concentration_pm2p5  = p_avg_data->mass_concentration_pm2p5,
+        .sen66.mass_concentration_pm4p0  = p_avg_data->mass_concentration_pm4p0,
+        .sen66.mass_concentration_pm10p0 = p_avg_data->mass_concentration_pm10p0,
+        .sen66.ambient_humidity          = p_avg_data->ambient_humidity,
+        .sen66.ambient_temperature       = p_avg_data->ambient_temperature,
+        .sen66.voc_index                 = p_avg_data->voc_index,
+        .sen66.nox_index                 = p_avg_data->nox_index,
+        .sen66.co2                       = p_avg_data->co2,
         .dps310_temperature              = NAN,
-        .dps310_pressure                 = avg_data.ambient_pressure,
+        .dps310_pressure                 = p_avg_data->ambient_pressure,
         .shtc3_temperature               = NAN,
         .shtc3_humidity                  = NAN,
-        .luminosity        = (INVALID_LUMINOSITY == avg_data.luminosity) ? NAN : (float32_t)avg_data.luminosity,
-        .sound_inst_dba    = conv_sound_dba_x100_to_float(avg_data.sound_inst_dba_x100),
-        .sound_avg_dba     = conv_sound_dba_x100_to_float(avg_data.sound_avg_dba_x100),
-        .sound_peak_spl_db = conv_sound_dba_x100_to_float(avg_data.sound_peak_spl_db_x100),
+        .luminosity        = (INVALID_LUMINOSITY == p_avg_data->luminosity) ? NAN
+                                                                            : (float32_t)p_avg_data->luminosity,
+        .sound_inst_dba    = conv_sound_dba_x100_to_float(p_avg_data->sound_inst_dba_x100),
+        .sound_avg_dba     = conv_sound_dba_x100_to_float(p_avg_data->sound_avg_dba_x100),
+        .sound_peak_spl_db = conv_sound_dba_x100_to_float(p_avg_data->sound_peak_spl_db_x100),
     };
 
     const re_e1_data_t e1_data = data_fmt_e1_init(
@@ -260,3 +276,19 @@ moving_avg_get_accum(const measurement_cnt_t measurement_cnt, const radio_mac_t
     memcpy(&record.buf[0], buffer, sizeof(record.buf));
     return record;
 }
+
+hist_log_record_data_t
+moving_avg_get_accum(const measurement_cnt_t measurement_cnt, const radio_mac_t radio_mac, const sensors_flags_t flags)
+{
+    const moving_avg_data_t avg_data = moving_avg_data_get_avg(&g_moving_avg2);
+    return moving_avg_encode(&avg_data, measurement_cnt, radio_mac, flags);
+}
+
+hist_log_record_data_t
+moving_avg_get_short_accum(
+    const measurement_cnt_t measurement_cnt,
+    const radio_mac_t       radio_mac,
+    const sensors_flags_t   flags)
+{
+    return moving_avg_encode(&g_moving_avg_short_data, measurement_cnt, radio_mac, flags);
+}
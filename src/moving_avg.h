@@ -24,6 +24,21 @@ moving_avg_append(const sensors_measurement_t* const p_measurement);
 hist_log_record_data_t
 moving_avg_get_accum(const measurement_cnt_t measurement_cnt, const radio_mac_t radio_mac, const sensors_flags_t flags);
 
+/**
+ * @brief Check if the last call to moving_avg_append() completed the short averaging window (20 measurements).
+ */
+bool
+moving_avg_is_short_window_completed(void);
+
+/**
+ * @brief Get the average of the last completed short window, it is used for the deadband history logging.
+ */
+hist_log_record_data_t
+moving_avg_get_short_accum(
+    const measurement_cnt_t measurement_cnt,
+    const radio_mac_t       radio_mac,
+    const sensors_flags_t   flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,29 +6,151 @@
 #include <stddef.h>
 #include <time.h>
 #include <zephyr/kernel.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
 #include <zephyr/bluetooth/services/nus.h>
 #include "tlog.h"
 #include "ruuvi_endpoints.h"
+#include "hires_log.h"
 #include "hist_log.h"
+#include "hist_log_codec.h"
 #include "nus_req.h"
+#include "nus_l2cap.h"
 #include "sys_utils.h"
+#include "utils.h"
 #include "zephyr_api.h"
 
 LOG_MODULE_REGISTER(nus, LOG_LEVEL_INF);
 
 #define RUUVI_AIR_NUS_MAX_PACKET_LENGTH (244U)
 
+// Opcode and attribute handle of the ATT notification
+#define NUS_ATT_NOTIFY_HEADER_SIZE (3U)
+#define NUS_ATT_MTU_MAX            (RUUVI_AIR_NUS_MAX_PACKET_LENGTH + NUS_ATT_NOTIFY_HEADER_SIZE)
+
+#define USE_NUS_REQUEST_MTU_AND_DLE (1 && IS_ENABLED(CONFIG_RUUVI_AIR_NUS_REQUEST_MTU_AND_DLE))
+
+#if USE_NUS_REQUEST_MTU_AND_DLE
+#define NUS_MTU_EXCHANGE_TIMEOUT_MS (1000)
+#endif
+
+#define USE_NUS_TX_PIPELINE (1 && IS_ENABLED(CONFIG_RUUVI_AIR_NUS_TX_PIPELINE))
+
+#if USE_NUS_TX_PIPELINE
+#define NUS_TX_NUM_IN_FLIGHT (CONFIG_RUUVI_AIR_NUS_TX_NUM_IN_FLIGHT)
+// A credit is returned within a few connection intervals, the timeout only catches the lost sent callbacks
+#define NUS_TX_CREDIT_TIMEOUT_MS (5000)
+#endif
+
+#define USE_NUS_L2CAP (1 && IS_ENABLED(CONFIG_RUUVI_AIR_NUS_L2CAP))
+
+#if USE_NUS_L2CAP
+// The message is sent over the L2CAP channel in one SDU, which can be longer than the notification
+#define NUS_MSG_BUF_SIZE (MAX(RUUVI_AIR_NUS_MAX_PACKET_LENGTH, CONFIG_RUUVI_AIR_NUS_L2CAP_SDU_LEN))
+#else
+#define NUS_MSG_BUF_SIZE (RUUVI_AIR_NUS_MAX_PACKET_LENGTH)
+#endif
+
+// Every transfer context handles the requests of one connection, up to NUS_NUM_XFERS connections are served at once
+#define NUS_NUM_XFERS (CONFIG_RUUVI_AIR_NUS_NUM_TRANSFERS)
+
+// Delay before retrying to send the packet if there are no free TX buffers in the Bluetooth stack,
+// with CONFIG_RUUVI_AIR_NUS_TX_PIPELINE it bounds the wait for a sent callback if no notification is in flight
+#define NUS_TX_RETRY_DELAY_MS (10)
+
+// The clocks of the client and the device differ by the latency of the request, such offsets are ignored
+#define NUS_TIME_OFFSET_TOLERANCE_S (5)
+
+// Every record is prefixed with its sequence number in response to NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ,
+// NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST and NUS_REQ_OP_LOG_MULTI_READ_FILTERED (in the records mode)
+#define NUS_HIST_LOG_SEQ_SIZE (sizeof(uint32_t))
+
+// Interval of the matching records in response to NUS_REQ_OP_LOG_MULTI_READ_FILTERED (in the intervals mode)
+#define NUS_HIST_LOG_INTERVAL_TIMESTAMP_FIRST_OFS (0U)
+#define NUS_HIST_LOG_INTERVAL_TIMESTAMP_LAST_OFS  (4U)
+#define NUS_HIST_LOG_INTERVAL_NUM_RECORDS_OFS     (8U)
+#define NUS_HIST_LOG_INTERVAL_LEN                 (10U)
+
+// Time bucket in response to NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED: the E1 record with the mean values
+// followed by the E1 payloads with the min and max values
+#define NUS_HIST_LOG_AGGREGATED_MIN_OFS (RE_LOG_WRITE_AIRQ_RECORD_LEN)
+#define NUS_HIST_LOG_AGGREGATED_MAX_OFS (NUS_HIST_LOG_AGGREGATED_MIN_OFS + sizeof(hist_log_record_data_t))
+#define NUS_HIST_LOG_AGGREGATED_LEN     (NUS_HIST_LOG_AGGREGATED_MAX_OFS + sizeof(hist_log_record_data_t))
+
+// Block of the high-resolution history in response to NUS_REQ_OP_LOG_HIRES_READ
+#define NUS_HIRES_LOG_TIMESTAMP_FIRST_OFS (RE_STANDARD_PAYLOAD_START_INDEX)
+#define NUS_HIRES_LOG_NUM_SAMPLES_OFS     (RE_STANDARD_PAYLOAD_START_INDEX + 4U)
+#define NUS_HIRES_LOG_DATA_OFS            (RE_STANDARD_PAYLOAD_START_INDEX + 6U)
+
+_Static_assert(
+    (NUS_HIRES_LOG_DATA_OFS + HIRES_LOG_BLOCK_SIZE) <= RUUVI_AIR_NUS_MAX_PACKET_LENGTH,
+    "The block of hires_log must fit into one NUS packet");
+
+/**
+ * @brief Transfer context: the requests of one connection are handled one at a time by the thread of the context,
+ * the requests of the different connections are handled concurrently by the different contexts.
+ */
+typedef struct nus_xfer_t
+{
+    bool            is_bound; //!< The context is handling the requests of p_conn
+    struct bt_conn* p_conn;
+    struct k_fifo   fifo_cmd; //!< Requests of p_conn received while the context is busy
+    struct k_thread thread;
+#if USE_NUS_TX_PIPELINE
+    uint32_t     num_in_flight; //!< Notifications of this transfer queued in the Bluetooth stack
+    struct k_sem sem_sent;      //!< Given when a notification of any transfer is sent or a transfer ends
+#endif
+#if USE_NUS_REQUEST_MTU_AND_DLE
+    struct k_sem                   sem_mtu_exchanged;
+    struct bt_gatt_exchange_params mtu_exchange_params; // Must be valid until the callback is called
+#endif
+} nus_xfer_t;
+
+/**
+ * @brief State of the scheduler which shares the TX buffers of the Bluetooth stack between the transfers.
+ */
+typedef struct nus_sched_t
+{
+    uint32_t num_active; //!< Transfers which are handling a request
+#if USE_NUS_TX_PIPELINE
+    uint32_t num_in_flight; //!< Notifications of all the transfers queued in the Bluetooth stack
+#endif
+} nus_sched_t;
+
 typedef struct nus_hist_log_user_data_t
 {
+    nus_xfer_t* const       p_xfer;
     struct bt_conn* const   p_conn;
-    const uint32_t          local_time_offset_s;
     const re_type_t         req_re_type;
     const nus_req_src_idx_t src_idx;
+    const bool              is_l2cap;       //!< The messages are sent over the L2CAP channel instead of NUS
+    const uint32_t          packet_len_max; //!< Max length of the packet which fits into one notification or SDU
+    const int32_t           time_offset_s;  //!< Client's time minus the real time of the device
+    const bool              is_after_seq;
+    const bool              is_newest_first;
+    const uint32_t          num_records_max; //!< Max number of records for NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST
+    const bool              is_filtered;
+    const bool              is_intervals;
+    const hist_log_filter_t filter;
+    bool                    is_interval_open;
+    uint32_t                interval_timestamp_first;
+    uint32_t                interval_timestamp_last;
+    uint32_t                interval_seq_last;
+    uint16_t                interval_num_records;
+    const bool              is_aggregated;
+    const uint32_t          aggregation_period_s;
+    const bool              is_compressed;
+    hist_log_codec_state_t  codec_state; //!< Encoder state of the chunk for NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED
+    uint32_t                seq_last_packed; //!< Sequence number of the newest record added to msg
+    uint32_t                seq_last_sent;   //!< Sequence number of the newest record which was sent successfully
     uint32_t                records_cnt;
     uint32_t                packets_cnt;
+    uint32_t                tx_retries_cnt; //!< Number of -EAGAIN/-ENOMEM returned by the Bluetooth stack
+    uint32_t                tx_sleeps_cnt;  //!< Retries after NUS_TX_RETRY_DELAY_MS instead of a sent callback
     bool                    is_multi_packet;
-    uint8_t                 msg_offset;
-    uint8_t                 msg[RUUVI_AIR_NUS_MAX_PACKET_LENGTH];
+    uint16_t                msg_offset;
+    uint8_t                 msg[NUS_MSG_BUF_SIZE];
 } nus_hist_log_user_data_t;
 
 typedef struct nus_fifo_cmd_t
@@ -36,16 +158,74 @@ typedef struct nus_fifo_cmd_t
     void*           fifo_reserved;
     struct bt_conn* p_conn;
     nus_req_t       req;
+    uint32_t        local_time_s; //!< Local time when the request was received, it matches the client's time
 } nus_fifo_cmd_t;
 
+// The requests which are not handled yet, the first free context takes the next one
 static K_FIFO_DEFINE(g_nus_fifo_cmd);
-static int32_t g_nus_cnt_notif_enabled;
-static bool    g_nus_reading_hist_in_progress;
+static K_MUTEX_DEFINE(g_nus_xfer_mutex);
+static int32_t    g_nus_cnt_notif_enabled;
+static atomic_t   g_nus_num_hist_reads = ATOMIC_INIT(0);
+static nus_xfer_t g_nus_xfers[NUS_NUM_XFERS];
+static K_THREAD_STACK_ARRAY_DEFINE(g_nus_xfer_stacks, NUS_NUM_XFERS, CONFIG_RUUVI_AIR_NUS_THREAD_STACK_SIZE);
+static struct k_spinlock g_nus_sched_lock;
+static nus_sched_t       g_nus_sched;
+static nus_stats_t       g_nus_stats; // Protected by g_nus_sched_lock
+
+#if USE_NUS_TX_PIPELINE
+static const struct bt_uuid_128   g_nus_tx_char_uuid = BT_UUID_INIT_128(BT_UUID_NUS_TX_CHAR_VAL);
+static const struct bt_gatt_attr* g_p_nus_tx_attr;
+#endif
 
 bool
 nus_is_reading_hist_in_progress(void)
 {
-    return g_nus_reading_hist_in_progress;
+    return 0 != atomic_get(&g_nus_num_hist_reads);
+}
+
+void
+nus_get_stats(nus_stats_t* const p_stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    *p_stats             = g_nus_stats;
+    k_spin_unlock(&g_nus_sched_lock, key);
+}
+
+void
+nus_reset_stats(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    g_nus_stats          = (nus_stats_t) { 0 };
+    k_spin_unlock(&g_nus_sched_lock, key);
+}
+
+static void
+nus_stats_add_transfer(const nus_hist_log_user_data_t* const p_data)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    g_nus_stats.num_tx_retries += p_data->tx_retries_cnt;
+    g_nus_stats.num_tx_sleeps += p_data->tx_sleeps_cnt;
+    k_spin_unlock(&g_nus_sched_lock, key);
+}
+
+uint32_t
+nus_get_packet_len_max(const uint16_t att_mtu)
+{
+    if (att_mtu <= NUS_ATT_NOTIFY_HEADER_SIZE)
+    {
+        return 0;
+    }
+    return MIN((uint32_t)att_mtu - NUS_ATT_NOTIFY_HEADER_SIZE, RUUVI_AIR_NUS_MAX_PACKET_LENGTH);
+}
+
+uint32_t
+nus_get_max_num_records_in_packet(const uint32_t packet_len_max, const uint32_t record_len)
+{
+    if ((0 == record_len) || (packet_len_max < (RE_LOG_WRITE_MULTI_PAYLOAD_IDX + record_len)))
+    {
+        return 0;
+    }
+    return (packet_len_max - RE_LOG_WRITE_MULTI_PAYLOAD_IDX) / record_len;
 }
 
 static void
@@ -83,6 +263,13 @@ nus_hist_log_pack_uint32(uint8_t* const p_buf, const uint32_t val)
     p_buf[BYTE_IDX_3] = (uint8_t)((val >> BYTE_SHIFT_0) & BYTE_MASK);
 }
 
+static void
+nus_hist_log_pack_uint16(uint8_t* const p_buf, const uint16_t val)
+{
+    p_buf[BYTE_IDX_0] = (uint8_t)((val >> BYTE_SHIFT_1) & BYTE_MASK);
+    p_buf[BYTE_IDX_1] = (uint8_t)((val >> BYTE_SHIFT_0) & BYTE_MASK);
+}
+
 static void
 nus_hist_log_pack_buffer(uint8_t* const p_buf, const uint8_t* const p_data, const size_t len)
 {
@@ -107,79 +294,356 @@ nus_hist_log_pack_record(
     nus_hist_log_pack_buffer(&p_buf[RE_LOG_WRITE_AIRQ_PAYLOAD_OFS], p_hist_record->buf, sizeof(p_hist_record->buf));
 }
 
+static void
+nus_sched_join(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    g_nus_sched.num_active += 1;
+    k_spin_unlock(&g_nus_sched_lock, key);
+}
+
+#if USE_NUS_TX_PIPELINE
+static void
+nus_sched_wake_all(void)
+{
+    for (uint32_t i = 0; i < NUS_NUM_XFERS; ++i)
+    {
+        k_sem_give(&g_nus_xfers[i].sem_sent);
+    }
+}
+
+/**
+ * @brief Take a credit for one more notification of the transfer.
+ * @details The TX buffers of the Bluetooth stack are shared by all the connections, so every active transfer
+ * gets an equal share of NUS_TX_NUM_IN_FLIGHT credits. Otherwise the transfer to the client with the longest
+ * connection interval would hold all the buffers, and the other clients would get a packet only when
+ * the stack rejects one of its notifications.
+ */
 static bool
-nus_send_with_retries(nus_hist_log_user_data_t* const p_data)
+nus_sched_take_credit(nus_xfer_t* const p_xfer)
 {
-    bool res = false;
-    LOG_HEXDUMP_DBG(p_data->msg, p_data->msg_offset, "bt_nus_send");
-    while (1)
+    while (true)
     {
-        int64_t                time_start = k_uptime_get();
-        const zephyr_api_ret_t err        = bt_nus_send(p_data->p_conn, p_data->msg, p_data->msg_offset);
-        int64_t                delta_ms   = k_uptime_get() - time_start;
-        if (0 != err)
+        k_sem_reset(&p_xfer->sem_sent);
+        k_spinlock_key_t key   = k_spin_lock(&g_nus_sched_lock);
+        const uint32_t   share = MAX(1U, NUS_TX_NUM_IN_FLIGHT / MAX(1U, g_nus_sched.num_active));
+        if ((p_xfer->num_in_flight < share) && (g_nus_sched.num_in_flight < NUS_TX_NUM_IN_FLIGHT))
         {
-            TLOG_INF("bt_nus_send: err %d, delta %u ms", err, (uint32_t)delta_ms);
-            if (-EAGAIN == err)
-            {
-                TLOG_WRN("Failed to send packet to NUS, err %d (EAGAIN)", err);
-                k_msleep(10); // NOSONAR: avoid busy loop
-                continue;
-            }
-            if (-ENOMEM == err)
+            p_xfer->num_in_flight += 1;
+            g_nus_sched.num_in_flight += 1;
+            k_spin_unlock(&g_nus_sched_lock, key);
+            return true;
+        }
+        k_spin_unlock(&g_nus_sched_lock, key);
+        if (0 != k_sem_take(&p_xfer->sem_sent, K_MSEC(NUS_TX_CREDIT_TIMEOUT_MS)))
+        {
+            TLOG_ERR("No free NUS TX credit for %d ms", NUS_TX_CREDIT_TIMEOUT_MS);
+            return false;
+        }
+    }
+}
+
+static void
+nus_sched_give_credits(nus_xfer_t* const p_xfer, const uint32_t num_credits)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    // The credits are restored on the flush timeout, so the sent callback may come after that
+    const uint32_t num = MIN(num_credits, p_xfer->num_in_flight);
+    p_xfer->num_in_flight -= num;
+    g_nus_sched.num_in_flight -= num;
+    k_spin_unlock(&g_nus_sched_lock, key);
+    nus_sched_wake_all();
+}
+
+static uint32_t
+nus_sched_get_num_in_flight(const nus_xfer_t* const p_xfer)
+{
+    k_spinlock_key_t key           = k_spin_lock(&g_nus_sched_lock);
+    const uint32_t   num_in_flight = (NULL != p_xfer) ? p_xfer->num_in_flight : g_nus_sched.num_in_flight;
+    k_spin_unlock(&g_nus_sched_lock, key);
+    return num_in_flight;
+}
+#endif
+
+static void
+nus_sched_leave(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_nus_sched_lock);
+    g_nus_sched.num_active -= 1;
+    k_spin_unlock(&g_nus_sched_lock, key);
+#if USE_NUS_TX_PIPELINE
+    // The share of the remaining transfers grows
+    nus_sched_wake_all();
+#endif
+}
+
+#if USE_NUS_TX_PIPELINE
+static void
+nus_tx_on_sent(struct bt_conn* p_conn, void* p_user_data)
+{
+    ARG_UNUSED(p_conn);
+
+    nus_sched_give_credits(p_user_data, 1U);
+}
+
+/**
+ * @brief Queue the notification, wait only if the transfer has used its share of the credits
+ * or the stack has no free TX buffer.
+ * @details The data is copied to the TX buffer of the Bluetooth stack, so the message can be reused immediately.
+ */
+static zephyr_api_ret_t
+nus_tx_send(nus_hist_log_user_data_t* const p_data)
+{
+    nus_xfer_t* const p_xfer = p_data->p_xfer;
+    if (!nus_sched_take_credit(p_xfer))
+    {
+        return -ETIMEDOUT;
+    }
+    while (true)
+    {
+        struct bt_gatt_notify_params params = {
+            .attr      = g_p_nus_tx_attr,
+            .data      = p_data->msg,
+            .len       = p_data->msg_offset,
+            .func      = &nus_tx_on_sent,
+            .user_data = p_xfer,
+        };
+        k_sem_reset(&p_xfer->sem_sent);
+        const zephyr_api_ret_t err = bt_gatt_notify_cb(p_data->p_conn, &params);
+        if ((-EAGAIN != err) && (-ENOMEM != err))
+        {
+            if (0 != err)
             {
-                TLOG_ERR("Failed to send packet to NUS, err %d (ENOMEM)", err);
-                k_msleep(10); // NOSONAR: avoid busy loop
-                continue;
+                nus_sched_give_credits(p_xfer, 1U);
             }
-            TLOG_ERR("Failed to send packet to NUS, err %d", err);
-            res = false;
+            return err;
         }
-        else
+        p_data->tx_retries_cnt += 1;
+        // The TX buffers are shared with the other traffic, so they can be exhausted even if a credit is available.
+        // Wait until one more notification of any transfer or a live measurement is sent. If none of the transfers
+        // has a notification in flight, the buffers may be held by the traffic without a sent callback
+        // (e.g. ATT responses), so the wait is bounded by NUS_TX_RETRY_DELAY_MS and the notification is retried.
+        const bool     is_any_in_flight = (1U != nus_sched_get_num_in_flight(NULL));
+        const uint32_t timeout_ms       = is_any_in_flight ? NUS_TX_CREDIT_TIMEOUT_MS : NUS_TX_RETRY_DELAY_MS;
+        if (0 == k_sem_take(&p_xfer->sem_sent, K_MSEC(timeout_ms)))
+        {
+            continue;
+        }
+        if (!is_any_in_flight)
         {
-            res = true;
+            p_data->tx_sleeps_cnt += 1;
+            continue;
         }
-        break;
+        TLOG_ERR("No NUS notification was sent for %d ms", NUS_TX_CREDIT_TIMEOUT_MS);
+        nus_sched_give_credits(p_xfer, 1U);
+        return -ETIMEDOUT;
     }
-    p_data->msg_offset = 0;
-    return res;
 }
 
+/**
+ * @brief Wait until all the queued notifications of the transfer are sent.
+ * @details The sent callbacks may be lost if the connection is dropped, so the credits are restored on timeout.
+ */
 static bool
-nus_hist_log_record_handler(
-    const uint32_t                      timestamp_local,
-    const hist_log_record_data_t* const p_hist_record,
-    void*                               p_user_data)
+nus_tx_flush(nus_xfer_t* const p_xfer)
+{
+    while (true)
+    {
+        k_sem_reset(&p_xfer->sem_sent);
+        const uint32_t num_in_flight = nus_sched_get_num_in_flight(p_xfer);
+        if (0 == num_in_flight)
+        {
+            return true;
+        }
+        if (0 != k_sem_take(&p_xfer->sem_sent, K_MSEC(NUS_TX_CREDIT_TIMEOUT_MS)))
+        {
+            TLOG_WRN("NUS notifications were not sent for %d ms", NUS_TX_CREDIT_TIMEOUT_MS);
+            nus_sched_give_credits(p_xfer, num_in_flight);
+            return false;
+        }
+    }
+}
+#else
+static zephyr_api_ret_t
+nus_tx_send(nus_hist_log_user_data_t* const p_data)
 {
-    nus_hist_log_user_data_t* const p_data      = (nus_hist_log_user_data_t*)p_user_data;
-    const uint32_t                  timestamp_s = timestamp_local + p_data->local_time_offset_s;
+    while (true)
+    {
+        const zephyr_api_ret_t err = bt_nus_send(p_data->p_conn, p_data->msg, p_data->msg_offset);
+        if ((-EAGAIN != err) && (-ENOMEM != err))
+        {
+            return err;
+        }
+        TLOG_INF("bt_nus_send: err %d, retry in %d ms", err, NUS_TX_RETRY_DELAY_MS);
+        p_data->tx_retries_cnt += 1;
+        p_data->tx_sleeps_cnt += 1;
+        k_msleep(NUS_TX_RETRY_DELAY_MS); // NOSONAR: avoid busy loop
+    }
+}
 
-    const uint32_t record_led = RE_LOG_WRITE_AIRQ_RECORD_LEN;
+static bool
+nus_tx_flush(__unused nus_xfer_t* const p_xfer)
+{
+    return true;
+}
+#endif
 
-    if (0 == p_data->msg_offset)
+#if USE_NUS_TX_PIPELINE
+static void
+nus_tx_on_live_data_sent(struct bt_conn* p_conn, void* p_user_data)
+{
+    ARG_UNUSED(p_conn);
+    ARG_UNUSED(p_user_data);
+
+    // The TX buffer is freed, so the transfers which did not get one can retry
+    nus_sched_wake_all();
+}
+#endif
+
+zephyr_api_ret_t
+nus_send_live_data(struct bt_conn* p_conn, const void* const p_data, const uint16_t len)
+{
+#if USE_NUS_TX_PIPELINE
+    struct bt_gatt_notify_params params = {
+        .attr = g_p_nus_tx_attr,
+        .data = p_data,
+        .len  = len,
+        .func = &nus_tx_on_live_data_sent,
+    };
+    return bt_gatt_notify_cb(p_conn, &params);
+#else
+    return bt_nus_send(p_conn, p_data, len);
+#endif
+}
+
+static bool
+nus_flush(const nus_hist_log_user_data_t* const p_data)
+{
+#if USE_NUS_L2CAP
+    if (p_data->is_l2cap)
+    {
+        return nus_l2cap_flush();
+    }
+#endif
+    return nus_tx_flush(p_data->p_xfer);
+}
+
+/**
+ * @brief Check that the connection is still established.
+ * @details The request holds a reference to the connection object, so the object stays valid after disconnection,
+ * but it must not be used for the transfer anymore.
+ */
+static bool
+nus_is_conn_connected(const struct bt_conn* const p_conn)
+{
+    struct bt_conn_info    info = { 0 };
+    const zephyr_api_ret_t err  = bt_conn_get_info(p_conn, &info);
+    return (0 == err) && (BT_CONN_STATE_CONNECTED == info.state);
+}
+
+static bool
+nus_send_with_retries(nus_hist_log_user_data_t* const p_data)
+{
+    LOG_HEXDUMP_DBG(p_data->msg, p_data->msg_offset, "bt_nus_send");
+    if (!nus_is_conn_connected(p_data->p_conn))
+    {
+        TLOG_WRN("Connection is closed, stop the transfer");
+        p_data->msg_offset = 0;
+        return false;
+    }
+#if USE_NUS_L2CAP
+    const zephyr_api_ret_t err = p_data->is_l2cap ? nus_l2cap_send(p_data->msg, p_data->msg_offset)
+                                                  : nus_tx_send(p_data);
+#else
+    const zephyr_api_ret_t err = nus_tx_send(p_data);
+#endif
+    p_data->msg_offset = 0;
+    if (0 != err)
+    {
+        TLOG_ERR("Failed to send packet to NUS, err %d", err);
+        return false;
+    }
+    p_data->seq_last_sent = p_data->seq_last_packed;
+    return true;
+}
+
+static bool
+nus_hist_log_is_seq_prefixed(const nus_hist_log_user_data_t* const p_data)
+{
+    return p_data->is_after_seq || p_data->is_newest_first || (p_data->is_filtered && (!p_data->is_intervals));
+}
+
+static uint32_t
+nus_hist_log_get_record_len(const nus_hist_log_user_data_t* const p_data)
+{
+    if (p_data->is_compressed)
     {
-        memset(&p_data->msg[0], UINT8_MAX, sizeof(p_data->msg));
+        return HIST_LOG_CODEC_MAX_FRAME_LEN;
+    }
+    if (p_data->is_intervals)
+    {
+        return NUS_HIST_LOG_INTERVAL_LEN;
+    }
+    if (p_data->is_aggregated)
+    {
+        return NUS_HIST_LOG_AGGREGATED_LEN;
+    }
+    return nus_hist_log_is_seq_prefixed(p_data) ? (NUS_HIST_LOG_SEQ_SIZE + RE_LOG_WRITE_AIRQ_RECORD_LEN)
+                                                : RE_LOG_WRITE_AIRQ_RECORD_LEN;
+}
+
+static void
+nus_hist_log_pack_header(nus_hist_log_user_data_t* const p_data)
+{
+    memset(&p_data->msg[0], UINT8_MAX, sizeof(p_data->msg));
 
-        p_data->msg[RE_STANDARD_DESTINATION_INDEX]      = p_data->src_idx;
-        p_data->msg[RE_STANDARD_SOURCE_INDEX]           = RE_STANDARD_DESTINATION_AIRQ;
-        p_data->msg[RE_STANDARD_OPERATION_INDEX]        = p_data->is_multi_packet ? RE_STANDARD_LOG_MULTI_WRITE
-                                                                                  : RE_STANDARD_LOG_VALUE_WRITE;
-        p_data->msg_offset                              = RE_STANDARD_PAYLOAD_START_INDEX;
-        p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] = 1;
-        p_data->msg_offset += 1;
-        p_data->msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX] = record_led;
-        p_data->msg_offset += 1;
+    p_data->msg[RE_STANDARD_DESTINATION_INDEX] = p_data->src_idx;
+    p_data->msg[RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ;
+    if (p_data->is_compressed)
+    {
+        p_data->msg[RE_STANDARD_OPERATION_INDEX]       = NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED;
+        p_data->msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX] = NUS_REQ_COMPRESSED_FMT_VERSION;
     }
     else
     {
-        p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] += 1;
+        p_data->msg[RE_STANDARD_OPERATION_INDEX]       = p_data->is_multi_packet ? RE_STANDARD_LOG_MULTI_WRITE
+                                                                                 : RE_STANDARD_LOG_VALUE_WRITE;
+        p_data->msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX] = (uint8_t)nus_hist_log_get_record_len(p_data);
+    }
+    p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] = 0;
+    p_data->msg_offset                              = RE_LOG_WRITE_MULTI_PAYLOAD_IDX;
+}
+
+/**
+ * @brief Reserve space for the next record in the message, the header is initialized for the first record.
+ * @return Pointer to the record in the message.
+ */
+static uint8_t*
+nus_hist_log_alloc_record(nus_hist_log_user_data_t* const p_data)
+{
+    const uint32_t record_led = nus_hist_log_get_record_len(p_data);
+
+    if (0 == p_data->msg_offset)
+    {
+        nus_hist_log_pack_header(p_data);
     }
-    nus_hist_log_pack_record(&p_data->msg[p_data->msg_offset], timestamp_s, p_hist_record);
+    p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] += 1;
+    uint8_t* const p_record = &p_data->msg[p_data->msg_offset];
     p_data->msg_offset += record_led;
+    return p_record;
+}
+
+/**
+ * @brief Send the message if it is full (or after every record if the multi-packet mode is not used).
+ */
+static bool
+nus_hist_log_commit_record(nus_hist_log_user_data_t* const p_data)
+{
+    const uint32_t record_led = nus_hist_log_get_record_len(p_data);
+
     p_data->records_cnt += 1;
 
-    const uint32_t max_num_records_in_packet = (RUUVI_AIR_NUS_MAX_PACKET_LENGTH - RE_LOG_WRITE_MULTI_PAYLOAD_IDX)
-                                               / record_led;
+    const uint32_t max_num_records_in_packet = nus_get_max_num_records_in_packet(p_data->packet_len_max, record_led);
 
     if ((!p_data->is_multi_packet) || (max_num_records_in_packet == p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX]))
     {
@@ -194,6 +658,327 @@ nus_hist_log_record_handler(
     return true;
 }
 
+static bool
+nus_hist_log_record_handler(
+    const uint32_t                      timestamp_s,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_hist_record,
+    nus_hist_log_user_data_t* const     p_data)
+{
+    uint8_t* const p_record = nus_hist_log_alloc_record(p_data);
+    if (nus_hist_log_is_seq_prefixed(p_data))
+    {
+        nus_hist_log_pack_uint32(p_record, seq);
+        nus_hist_log_pack_record(&p_record[NUS_HIST_LOG_SEQ_SIZE], timestamp_s, p_hist_record);
+    }
+    else
+    {
+        nus_hist_log_pack_record(p_record, timestamp_s, p_hist_record);
+    }
+    // The records are sent in reverse order for NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST
+    if (seq > p_data->seq_last_packed)
+    {
+        p_data->seq_last_packed = seq;
+    }
+    return nus_hist_log_commit_record(p_data);
+}
+
+/**
+ * @brief Append the record to the chunk as a delta frame, or start the next chunk with a key frame if it does not fit.
+ * @details The sequence number of the record is updated only after the previous chunk is sent,
+ * so the end-of-data message never refers to a record which was not sent.
+ */
+static bool
+nus_hist_log_compressed_handler(
+    const uint32_t                      timestamp_s,
+    const uint32_t                      seq,
+    const hist_log_record_data_t* const p_hist_record,
+    nus_hist_log_user_data_t* const     p_data)
+{
+    uint8_t frame[HIST_LOG_CODEC_MAX_FRAME_LEN];
+    size_t  frame_len = hist_log_codec_encode(
+        &p_data->codec_state,
+        timestamp_s,
+        seq,
+        p_hist_record,
+        (0 == p_data->msg_offset),
+        frame);
+    // The number of records in the chunk is a one-byte field, it limits the chunk only if it is an SDU
+    if ((0 != p_data->msg_offset)
+        && (((p_data->msg_offset + frame_len) > p_data->packet_len_max)
+            || (UINT8_MAX == p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX])))
+    {
+        p_data->packets_cnt += 1;
+        if (!nus_send_with_retries(p_data))
+        {
+            return false;
+        }
+        frame_len = hist_log_codec_encode(&p_data->codec_state, timestamp_s, seq, p_hist_record, true, frame);
+    }
+    if (0 == p_data->msg_offset)
+    {
+        nus_hist_log_pack_header(p_data);
+    }
+    memcpy(&p_data->msg[p_data->msg_offset], frame, frame_len);
+    p_data->msg_offset += (uint16_t)frame_len;
+    p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] += 1;
+    p_data->records_cnt += 1;
+    p_data->seq_last_packed = seq;
+    return true;
+}
+
+static bool
+nus_hist_log_aggregated_handler(
+    const uint32_t                        timestamp_s,
+    const uint32_t                        seq,
+    const hist_log_rollup_record_t* const p_hist_record,
+    nus_hist_log_user_data_t* const       p_data)
+{
+    uint8_t* const p_record = nus_hist_log_alloc_record(p_data);
+    nus_hist_log_pack_record(p_record, timestamp_s, &p_hist_record->mean);
+    nus_hist_log_pack_buffer(
+        &p_record[NUS_HIST_LOG_AGGREGATED_MIN_OFS],
+        p_hist_record->min.buf,
+        sizeof(p_hist_record->min.buf));
+    nus_hist_log_pack_buffer(
+        &p_record[NUS_HIST_LOG_AGGREGATED_MAX_OFS],
+        p_hist_record->max.buf,
+        sizeof(p_hist_record->max.buf));
+    p_data->seq_last_packed = seq;
+    return nus_hist_log_commit_record(p_data);
+}
+
+static bool
+nus_hist_log_interval_close(nus_hist_log_user_data_t* const p_data)
+{
+    if (!p_data->is_interval_open)
+    {
+        return true;
+    }
+    p_data->is_interval_open = false;
+
+    uint8_t* const p_record = nus_hist_log_alloc_record(p_data);
+    nus_hist_log_pack_uint32(&p_record[NUS_HIST_LOG_INTERVAL_TIMESTAMP_FIRST_OFS], p_data->interval_timestamp_first);
+    nus_hist_log_pack_uint32(&p_record[NUS_HIST_LOG_INTERVAL_TIMESTAMP_LAST_OFS], p_data->interval_timestamp_last);
+    nus_hist_log_pack_uint16(&p_record[NUS_HIST_LOG_INTERVAL_NUM_RECORDS_OFS], p_data->interval_num_records);
+    p_data->seq_last_packed = p_data->interval_seq_last;
+    return nus_hist_log_commit_record(p_data);
+}
+
+/**
+ * @brief Merge the matching record into the current interval.
+ * @details The filtered cursor returns only the matching records, so a gap in the sequence numbers means
+ * that there were non-matching records between them and the interval is closed.
+ */
+static bool
+nus_hist_log_interval_handler(const uint32_t timestamp_s, const uint32_t seq, nus_hist_log_user_data_t* const p_data)
+{
+    if (p_data->is_interval_open && (seq == (p_data->interval_seq_last + 1U))
+        && (p_data->interval_num_records < UINT16_MAX))
+    {
+        p_data->interval_timestamp_last = timestamp_s;
+        p_data->interval_seq_last       = seq;
+        p_data->interval_num_records += 1;
+        return true;
+    }
+    if (!nus_hist_log_interval_close(p_data))
+    {
+        return false;
+    }
+    p_data->is_interval_open         = true;
+    p_data->interval_timestamp_first = timestamp_s;
+    p_data->interval_timestamp_last  = timestamp_s;
+    p_data->interval_seq_last        = seq;
+    p_data->interval_num_records     = 1;
+    return true;
+}
+
+static bool
+nus_hist_log_send_records(
+    nus_hist_log_user_data_t* const p_data,
+    const uint32_t                  start_time_s,
+    const uint32_t                  after_seq)
+{
+    const uint32_t record_len = nus_hist_log_get_record_len(p_data);
+    if (0 == nus_get_max_num_records_in_packet(p_data->packet_len_max, record_len))
+    {
+        TLOG_ERR(
+            "The record of %" PRIu32 " bytes does not fit into the packet of %" PRIu32 " bytes",
+            record_len,
+            p_data->packet_len_max);
+        return false;
+    }
+    hist_log_cursor_t* p_cursor = NULL;
+    if (p_data->is_after_seq)
+    {
+        p_cursor = hist_log_cursor_open_after_seq(HIST_LOG_TIER_5MIN, after_seq);
+    }
+    else if (p_data->is_newest_first)
+    {
+        p_cursor = hist_log_cursor_open_newest_first(HIST_LOG_TIER_5MIN, p_data->num_records_max);
+    }
+    else
+    {
+        p_cursor = hist_log_cursor_open(HIST_LOG_TIER_5MIN, start_time_s);
+    }
+    if (NULL == p_cursor)
+    {
+        TLOG_ERR("Failed to open history log cursor");
+        return false;
+    }
+    if (p_data->is_filtered && (!hist_log_cursor_set_filter(p_cursor, &p_data->filter)))
+    {
+        TLOG_ERR("Failed to set history log filter");
+        hist_log_cursor_close(p_cursor);
+        return false;
+    }
+    if (p_data->is_aggregated && (!hist_log_cursor_set_aggregation(p_cursor, p_data->aggregation_period_s)))
+    {
+        TLOG_ERR("Failed to set history log aggregation");
+        hist_log_cursor_close(p_cursor);
+        return false;
+    }
+    // If nothing is sent, the client resumes from the point where the reading started
+    p_data->seq_last_packed = hist_log_cursor_get_seq_last(p_cursor);
+    p_data->seq_last_sent   = p_data->seq_last_packed;
+    bool res                = true;
+    while (true)
+    {
+        uint32_t                       timestamp = 0;
+        uint32_t                       seq       = 0;
+        hist_log_rollup_record_t       record    = { 0 };
+        const hist_log_cursor_status_e status    = hist_log_cursor_next(p_cursor, &timestamp, &seq, &record);
+        if (HIST_LOG_CURSOR_STATUS_END == status)
+        {
+            break;
+        }
+        if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
+        {
+            TLOG_WRN("History log cursor was invalidated, the oldest records were rotated out while sending");
+            if (!nus_hist_log_interval_close(p_data))
+            {
+                res = false;
+                break;
+            }
+            continue;
+        }
+        timestamp += (uint32_t)p_data->time_offset_s;
+        // No lock is held by the cursor here, so waiting for a free TX buffer does not block appending new records
+        bool res_send = false;
+        if (p_data->is_intervals)
+        {
+            res_send = nus_hist_log_interval_handler(timestamp, seq, p_data);
+        }
+        else if (p_data->is_aggregated)
+        {
+            res_send = nus_hist_log_aggregated_handler(timestamp, seq, &record, p_data);
+        }
+        else if (p_data->is_compressed)
+        {
+            res_send = nus_hist_log_compressed_handler(timestamp, seq, &record.mean, p_data);
+        }
+        else
+        {
+            res_send = nus_hist_log_record_handler(timestamp, seq, &record.mean, p_data);
+        }
+        if (!res_send)
+        {
+            res = false;
+            break;
+        }
+    }
+    if (res && (!nus_hist_log_interval_close(p_data)))
+    {
+        res = false;
+    }
+    TLOG_INF("History log: %" PRIu32 " sectors skipped", hist_log_cursor_get_num_sectors_skipped(p_cursor));
+    hist_log_cursor_close(p_cursor);
+    return res;
+}
+
+#if USE_NUS_REQUEST_MTU_AND_DLE
+static void
+nus_on_mtu_exchanged(struct bt_conn* p_conn, uint8_t err, struct bt_gatt_exchange_params* p_params)
+{
+    nus_xfer_t* const p_xfer = CONTAINER_OF(p_params, nus_xfer_t, mtu_exchange_params);
+
+    TLOG_INF("MTU exchange: err %u, ATT MTU %u", err, bt_gatt_get_mtu(p_conn));
+    k_sem_give(&p_xfer->sem_mtu_exchanged);
+}
+
+/**
+ * @brief Request the max data length and the max ATT MTU before sending the history.
+ * @details The data length does not limit the size of the packets (the longer notifications are fragmented
+ * by the link layer), so its update is not waited for. The MTU exchange is waited for, because the packets
+ * are sized by the ATT MTU which is in effect when the reading starts.
+ */
+static void
+nus_request_mtu_and_data_len(nus_xfer_t* const p_xfer)
+{
+    struct bt_conn* const p_conn = p_xfer->p_conn;
+
+    zephyr_api_ret_t err = bt_conn_le_data_len_update(p_conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (0 != err)
+    {
+        TLOG_WRN("Data length update request failed, err %d", err);
+    }
+    if (bt_gatt_get_mtu(p_conn) >= NUS_ATT_MTU_MAX)
+    {
+        return;
+    }
+    k_sem_reset(&p_xfer->sem_mtu_exchanged);
+    p_xfer->mtu_exchange_params.func = &nus_on_mtu_exchanged;
+    err                              = bt_gatt_exchange_mtu(p_conn, &p_xfer->mtu_exchange_params);
+    if (0 != err)
+    {
+        // The MTU is exchanged only once per connection, the central may have done it already
+        TLOG_WRN("MTU exchange request failed, err %d", err);
+        return;
+    }
+    if (0 != k_sem_take(&p_xfer->sem_mtu_exchanged, K_MSEC(NUS_MTU_EXCHANGE_TIMEOUT_MS)))
+    {
+        TLOG_WRN("MTU exchange was not completed in %d ms", NUS_MTU_EXCHANGE_TIMEOUT_MS);
+    }
+}
+#endif
+
+static bool
+nus_is_l2cap_connected(const struct bt_conn* const p_conn)
+{
+#if USE_NUS_L2CAP
+    return nus_l2cap_is_connected(p_conn);
+#else
+    ARG_UNUSED(p_conn);
+    return false;
+#endif
+}
+
+/**
+ * @brief Prepare the connection for sending the history.
+ * @return Max length of the packet which fits into one notification or SDU.
+ */
+static uint32_t
+nus_prepare_conn(nus_xfer_t* const p_xfer, const bool is_l2cap)
+{
+#if USE_NUS_REQUEST_MTU_AND_DLE
+    nus_request_mtu_and_data_len(p_xfer);
+#endif
+#if USE_NUS_L2CAP
+    if (is_l2cap)
+    {
+        const uint32_t sdu_len_max = MIN(nus_l2cap_get_sdu_len_max(), NUS_MSG_BUF_SIZE);
+        TLOG_INF("L2CAP channel is used, max SDU length: %" PRIu32, sdu_len_max);
+        return sdu_len_max;
+    }
+#else
+    ARG_UNUSED(is_l2cap);
+#endif
+    const uint16_t att_mtu        = bt_gatt_get_mtu(p_xfer->p_conn);
+    const uint32_t packet_len_max = nus_get_packet_len_max(att_mtu);
+    TLOG_INF("ATT MTU: %u, max packet length: %" PRIu32, att_mtu, packet_len_max);
+    return packet_len_max;
+}
+
 static bool
 app_sensor_send_eof(__unused struct bt_conn* const p_conn, nus_hist_log_user_data_t* const p_data)
 {
@@ -206,18 +991,13 @@ app_sensor_send_eof(__unused struct bt_conn* const p_conn, nus_hist_log_user_dat
         }
     }
 
-    const uint32_t record_led = RE_LOG_WRITE_AIRQ_RECORD_LEN;
-
-    memset(&p_data->msg[0], UINT8_MAX, sizeof(p_data->msg));
-
-    p_data->msg[RE_STANDARD_DESTINATION_INDEX]      = p_data->src_idx;
-    p_data->msg[RE_STANDARD_SOURCE_INDEX]           = RE_STANDARD_DESTINATION_AIRQ;
-    p_data->msg[RE_STANDARD_OPERATION_INDEX]        = p_data->is_multi_packet ? RE_STANDARD_LOG_MULTI_WRITE
-                                                                              : RE_STANDARD_LOG_VALUE_WRITE;
-    p_data->msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX] = 0;
-    p_data->msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX]  = record_led;
-
-    p_data->msg_offset = RE_LOG_WRITE_MULTI_PAYLOAD_IDX;
+    nus_hist_log_pack_header(p_data);
+    if (nus_hist_log_is_seq_prefixed(p_data))
+    {
+        // The client stores this sequence number and sends it in the next request
+        nus_hist_log_pack_uint32(&p_data->msg[p_data->msg_offset], p_data->seq_last_sent);
+        p_data->msg_offset += NUS_HIST_LOG_SEQ_SIZE;
+    }
 
     if (!nus_send_with_retries(p_data))
     {
@@ -228,9 +1008,58 @@ app_sensor_send_eof(__unused struct bt_conn* const p_conn, nus_hist_log_user_dat
 }
 
 static bool
-app_sensor_log_read(struct bt_conn* const p_conn, const nus_req_t* const p_req)
+nus_is_client_time_valid(const uint32_t current_time_s)
+{
+    return (current_time_s >= RUUVI_AIR_MIN_UNIX_TIME) && (current_time_s <= RUUVI_AIR_MAX_UNIX_TIME);
+}
+
+/**
+ * @brief Get the offset of the client's clock relative to the real time of the device.
+ * @details The real time of the device is its local clock shifted by the offset of the current time epoch.
+ * @return 0 if the client's time is not valid or differs from the real time only by the latency of the request,
+ * so that the same record is sent with the same timestamp to all the clients.
+ */
+static int32_t
+nus_get_client_time_offset(const uint32_t current_time_s, const uint32_t local_system_time_s)
+{
+    if (!nus_is_client_time_valid(current_time_s))
+    {
+        return 0;
+    }
+    const int64_t real_time_s   = (int64_t)local_system_time_s + hist_log_get_time_offset();
+    const int64_t time_offset_s = (int64_t)current_time_s - real_time_s;
+    if ((time_offset_s <= NUS_TIME_OFFSET_TOLERANCE_S) && (time_offset_s >= -NUS_TIME_OFFSET_TOLERANCE_S))
+    {
+        return 0;
+    }
+    return (int32_t)time_offset_s;
+}
+
+/**
+ * @brief Convert the start time of the request from the client's time to the real time of the device.
+ */
+static uint32_t
+nus_get_start_time(const uint32_t start_time_s, const int32_t time_offset_s)
+{
+    if (0 == start_time_s)
+    {
+        return 0;
+    }
+    const int64_t real_start_time_s = (int64_t)start_time_s - time_offset_s;
+    if (real_start_time_s <= 0)
+    {
+        return 0;
+    }
+    return (real_start_time_s > UINT32_MAX) ? UINT32_MAX : (uint32_t)real_start_time_s;
+}
+
+/**
+ * @param local_system_time_s Local time when the request was received, it may wait in the queue for a free transfer.
+ */
+static bool
+app_sensor_log_read(nus_xfer_t* const p_xfer, const nus_req_t* const p_req, const uint32_t local_system_time_s)
 {
-    const uint32_t local_system_time_s = (uint32_t)time(NULL);
+    struct bt_conn* const p_conn = p_xfer->p_conn;
 
     TLOG_WRN(
         "Sending logged data. Current time: %" PRIu32 ", Start time: %" PRIu32 ", System time: %" PRIu32
@@ -240,28 +1069,61 @@ app_sensor_log_read(struct bt_conn* const p_conn, const nus_req_t* const p_req)
         local_system_time_s,
         local_system_time_s);
 
-    g_nus_reading_hist_in_progress = true;
+    atomic_inc(&g_nus_num_hist_reads);
 
     const int64_t time_start = k_uptime_get();
+    const bool    is_l2cap   = nus_is_l2cap_connected(p_conn);
 
-    const uint32_t local_time_offset_s = p_req->current_time_s - local_system_time_s;
-    const uint32_t local_start_time_s  = (p_req->start_time_s > local_time_offset_s)
-                                             ? (p_req->start_time_s - local_time_offset_s)
-                                             : 0;
+    // The records are stored with the timestamps of the local clock, which restarts if the RTC time is lost,
+    // hist_log converts them to the real time using the offset of the epoch in which they were written.
+    // The client's time sets the offset of the current epoch only if it is not known yet.
+    if (nus_is_client_time_valid(p_req->current_time_s))
+    {
+        hist_log_rebase_time((int32_t)(p_req->current_time_s - local_system_time_s));
+    }
+    else
+    {
+        TLOG_WRN("Invalid current time: %" PRIu32 ", the time epoch is not rebased", p_req->current_time_s);
+    }
 
     nus_hist_log_user_data_t user_data = {
-        .p_conn              = p_conn,
-        .local_time_offset_s = local_time_offset_s,
-        .req_re_type         = p_req->req_re_type,
-        .src_idx             = p_req->src_idx,
-        .records_cnt         = 0,
-        .packets_cnt         = 0,
-        .is_multi_packet     = (RE_LOG_R_MULTI == p_req->req_re_op) ? true : false,
-        .msg_offset          = 0,
+        .p_xfer                   = p_xfer,
+        .p_conn                   = p_conn,
+        .req_re_type              = p_req->req_re_type,
+        .src_idx                  = p_req->src_idx,
+        .is_l2cap                 = is_l2cap,
+        .packet_len_max           = nus_prepare_conn(p_xfer, is_l2cap),
+        .time_offset_s            = nus_get_client_time_offset(p_req->current_time_s, local_system_time_s),
+        .is_after_seq             = p_req->is_after_seq,
+        .is_newest_first          = p_req->is_newest_first,
+        .num_records_max          = p_req->num_records_max,
+        .is_filtered              = p_req->is_filtered,
+        .is_intervals             = p_req->is_filtered && p_req->is_intervals,
+        .filter                   = p_req->filter,
+        .is_interval_open         = false,
+        .interval_timestamp_first = 0,
+        .interval_timestamp_last  = 0,
+        .interval_seq_last        = 0,
+        .interval_num_records     = 0,
+        .is_aggregated            = p_req->is_aggregated,
+        .aggregation_period_s     = p_req->aggregation_period_s,
+        .is_compressed            = p_req->is_compressed,
+        .codec_state              = { 0 },
+        .seq_last_packed          = 0,
+        .seq_last_sent            = 0,
+        .records_cnt              = 0,
+        .packets_cnt              = 0,
+        .tx_retries_cnt           = 0,
+        .tx_sleeps_cnt            = 0,
+        .is_multi_packet          = (RE_LOG_R_MULTI == p_req->req_re_op) ? true : false,
+        .msg_offset               = 0,
     };
 
     bool res = true;
-    if (!hist_log_read_records(&nus_hist_log_record_handler, &user_data, local_start_time_s))
+    if (!nus_hist_log_send_records(
+            &user_data,
+            nus_get_start_time(p_req->start_time_s, user_data.time_offset_s),
+            p_req->after_seq))
     {
         TLOG_ERR("Failed to read records");
         res = false;
@@ -271,16 +1133,148 @@ app_sensor_log_read(struct bt_conn* const p_conn, const nus_req_t* const p_req)
         TLOG_ERR("Failed to send EOF");
         res = false;
     }
+    if (!nus_flush(&user_data))
+    {
+        res = false;
+    }
 
+    nus_stats_add_transfer(&user_data);
     const int64_t delta_ms = k_uptime_get() - time_start;
     TLOG_WRN(
-        "History log was sent: %" PRIu32 " records, %" PRIu32 " packets, time: %u.%03u seconds",
+        "History log was sent: %" PRIu32 " records, %" PRIu32 " packets, %" PRIu32 " retries (%" PRIu32
+        " after sleep), last seq: %" PRIu32 ", time: %u.%03u seconds",
         user_data.records_cnt,
         user_data.packets_cnt,
+        user_data.tx_retries_cnt,
+        user_data.tx_sleeps_cnt,
+        user_data.seq_last_sent,
         (uint32_t)(delta_ms / 1000),
         (uint32_t)(delta_ms % 1000));
 
-    g_nus_reading_hist_in_progress = false;
+    atomic_dec(&g_nus_num_hist_reads);
+
+    return res;
+}
+
+static void
+nus_hires_log_pack_header(nus_hist_log_user_data_t* const p_data)
+{
+    memset(&p_data->msg[0], UINT8_MAX, sizeof(p_data->msg));
+
+    p_data->msg[RE_STANDARD_DESTINATION_INDEX] = p_data->src_idx;
+    p_data->msg[RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ;
+    p_data->msg[RE_STANDARD_OPERATION_INDEX]   = NUS_REQ_OP_LOG_HIRES_READ;
+    p_data->msg_offset                         = RE_STANDARD_PAYLOAD_START_INDEX;
+}
+
+/**
+ * @brief Send the blocks of the high-resolution history, one block per packet.
+ * @details The samples are delta-encoded relative to the first timestamp of the block,
+ * so only it needs to be converted to the client's time.
+ */
+static bool
+nus_hires_log_send_blocks(
+    nus_hist_log_user_data_t* const p_data,
+    const uint32_t                  max_age_s,
+    const int32_t                   time_offset_s)
+{
+    uint32_t block_seq_first = 0;
+    uint32_t block_seq_end   = 0;
+    hires_log_get_block_range(&block_seq_first, &block_seq_end);
+    if (0 != max_age_s)
+    {
+        block_seq_first = hires_log_find_block((uint32_t)time(NULL) - max_age_s);
+    }
+    for (uint32_t block_seq = block_seq_first; block_seq < block_seq_end; ++block_seq)
+    {
+        hires_log_block_t block = { 0 };
+        if (!hires_log_read_block(block_seq, &block))
+        {
+            TLOG_WRN("hires_log: block %" PRIu32 " was dropped while sending", block_seq);
+            continue;
+        }
+        if ((NUS_HIRES_LOG_DATA_OFS + block.len) > p_data->packet_len_max)
+        {
+            TLOG_ERR(
+                "hires_log: block of %u bytes does not fit into the packet of %" PRIu32 " bytes",
+                (unsigned)block.len,
+                p_data->packet_len_max);
+            return false;
+        }
+        nus_hires_log_pack_header(p_data);
+        nus_hist_log_pack_uint32(
+            &p_data->msg[NUS_HIRES_LOG_TIMESTAMP_FIRST_OFS],
+            (uint32_t)((int32_t)block.timestamp_first + time_offset_s));
+        nus_hist_log_pack_uint16(&p_data->msg[NUS_HIRES_LOG_NUM_SAMPLES_OFS], block.num_samples);
+        nus_hist_log_pack_buffer(&p_data->msg[NUS_HIRES_LOG_DATA_OFS], block.buf, block.len);
+        p_data->msg_offset = (uint16_t)(NUS_HIRES_LOG_DATA_OFS + block.len);
+
+        p_data->records_cnt += block.num_samples;
+        p_data->packets_cnt += 1;
+        if (!nus_send_with_retries(p_data))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool
+app_sensor_hires_log_read(nus_xfer_t* const p_xfer, const nus_req_t* const p_req, const uint32_t local_system_time_s)
+{
+    struct bt_conn* const p_conn = p_xfer->p_conn;
+
+    TLOG_WRN(
+        "Sending high-resolution log. Current time: %" PRIu32 ", Max age: %" PRIu32 ", System time: %" PRIu32,
+        p_req->current_time_s,
+        p_req->hires_max_age_s,
+        local_system_time_s);
+
+    const int64_t time_start = k_uptime_get();
+    const bool    is_l2cap   = nus_is_l2cap_connected(p_conn);
+
+    nus_hist_log_user_data_t user_data = {
+        .p_xfer         = p_xfer,
+        .p_conn         = p_conn,
+        .req_re_type    = p_req->req_re_type,
+        .src_idx        = p_req->src_idx,
+        .is_l2cap       = is_l2cap,
+        .packet_len_max = nus_prepare_conn(p_xfer, is_l2cap),
+        .msg_offset     = 0,
+    };
+
+    bool res = true;
+    if (!nus_hires_log_send_blocks(
+            &user_data,
+            p_req->hires_max_age_s,
+            (int32_t)(p_req->current_time_s - local_system_time_s)))
+    {
+        TLOG_ERR("Failed to send high-resolution log");
+        res = false;
+    }
+    // End-of-data: the header without the payload
+    nus_hires_log_pack_header(&user_data);
+    if (!nus_send_with_retries(&user_data))
+    {
+        TLOG_ERR("Failed to send EOF");
+        res = false;
+    }
+    if (!nus_flush(&user_data))
+    {
+        res = false;
+    }
+
+    nus_stats_add_transfer(&user_data);
+    const int64_t delta_ms = k_uptime_get() - time_start;
+    TLOG_WRN(
+        "High-resolution log was sent: %" PRIu32 " samples, %" PRIu32 " packets, %" PRIu32 " retries (%" PRIu32
+        " after sleep), time: %u.%03u seconds",
+        user_data.records_cnt,
+        user_data.packets_cnt,
+        user_data.tx_retries_cnt,
+        user_data.tx_sleeps_cnt,
+        (uint32_t)(delta_ms / 1000),
+        (uint32_t)(delta_ms % 1000));
 
     return res;
 }
@@ -305,8 +1299,17 @@ nus_handle_req_env_air(struct bt_conn* const p_conn, const nus_req_t* const p_re
         return false;
     }
     memset(p_cmd, 0, sizeof(*p_cmd));
-    p_cmd->p_conn = p_conn;
-    p_cmd->req    = *p_req;
+    // The connection object is reused for the next connection after it is released,
+    // so the request keeps it until the transfer context is unbound from it.
+    p_cmd->p_conn = bt_conn_ref(p_conn);
+    if (NULL == p_cmd->p_conn)
+    {
+        TLOG_ERR("Connection is being released");
+        k_free(p_cmd);
+        return false;
+    }
+    p_cmd->req          = *p_req;
+    p_cmd->local_time_s = (uint32_t)time(NULL);
     k_fifo_put(&g_nus_fifo_cmd, p_cmd);
 
     return true;
@@ -371,46 +1374,153 @@ struct bt_nus_cb g_nus_listener = {
     .received      = &nus_cb_on_received,
 };
 
-bool
-nus_init(void)
+/**
+ * @brief Bind the context to the connection of the request.
+ * @return false if the request was passed to the context which is handling the same connection.
+ */
+static bool
+nus_xfer_bind(nus_xfer_t* const p_xfer, nus_fifo_cmd_t* const p_cmd)
 {
-    g_nus_cnt_notif_enabled = 0;
-    zephyr_api_ret_t err    = bt_nus_cb_register(&g_nus_listener, NULL);
-    if (0 != err)
+    k_mutex_lock(&g_nus_xfer_mutex, K_FOREVER);
+    for (uint32_t i = 0; i < NUS_NUM_XFERS; ++i)
     {
-        TLOG_ERR("Failed to register NUS callback: %d", err);
-        return false;
+        nus_xfer_t* const p_other = &g_nus_xfers[i];
+        if (p_other->is_bound && (p_other->p_conn == p_cmd->p_conn))
+        {
+            // The requests of the connection are handled in order
+            k_fifo_put(&p_other->fifo_cmd, p_cmd);
+            k_mutex_unlock(&g_nus_xfer_mutex);
+            return false;
+        }
     }
-    TLOG_INF("NUS service successfully registered");
+    p_xfer->is_bound = true;
+    p_xfer->p_conn   = p_cmd->p_conn;
+    k_mutex_unlock(&g_nus_xfer_mutex);
     return true;
 }
 
+/**
+ * @brief Get the next request of the connection, or unbind the context if there are none.
+ */
+static nus_fifo_cmd_t*
+nus_xfer_get_next_cmd(nus_xfer_t* const p_xfer)
+{
+    k_mutex_lock(&g_nus_xfer_mutex, K_FOREVER);
+    nus_fifo_cmd_t* const p_cmd = k_fifo_get(&p_xfer->fifo_cmd, K_NO_WAIT);
+    if (NULL == p_cmd)
+    {
+        p_xfer->is_bound = false;
+        p_xfer->p_conn   = NULL;
+    }
+    k_mutex_unlock(&g_nus_xfer_mutex);
+    return p_cmd;
+}
+
+static void
+nus_xfer_free_cmd(nus_fifo_cmd_t* const p_cmd)
+{
+    bt_conn_unref(p_cmd->p_conn);
+    k_free(p_cmd);
+}
+
 static void
-nus_thread(__unused void* p1, __unused void* p2, __unused void* p3)
+nus_xfer_handle_cmd(nus_xfer_t* const p_xfer, const nus_fifo_cmd_t* const p_cmd)
 {
+    if (!nus_is_conn_connected(p_cmd->p_conn))
+    {
+        TLOG_WRN("Connection is closed, drop the request");
+        return;
+    }
+    nus_sched_join();
+    const bool res = p_cmd->req.is_hires ? app_sensor_hires_log_read(p_xfer, &p_cmd->req, p_cmd->local_time_s)
+                                         : app_sensor_log_read(p_xfer, &p_cmd->req, p_cmd->local_time_s);
+    nus_sched_leave();
+    if (!res)
+    {
+        TLOG_ERR("Failed to read log");
+    }
+}
+
+static void
+nus_xfer_thread(void* p1, __unused void* p2, __unused void* p3)
+{
+    nus_xfer_t* const p_xfer = p1;
     while (1)
     {
-        struct nus_fifo_cmd_t* p_cmd = k_fifo_get(&g_nus_fifo_cmd, K_FOREVER);
+        nus_fifo_cmd_t* p_cmd = k_fifo_get(&g_nus_fifo_cmd, K_FOREVER);
         if (NULL == p_cmd)
         {
             TLOG_ERR("Failed to get command from FIFO");
             continue;
         }
-        if (!app_sensor_log_read(p_cmd->p_conn, &p_cmd->req))
+        if (!nus_xfer_bind(p_xfer, p_cmd))
         {
-            TLOG_ERR("Failed to read log");
+            continue;
         }
-        k_free(p_cmd);
+        while (NULL != p_cmd)
+        {
+            nus_xfer_handle_cmd(p_xfer, p_cmd);
+            nus_fifo_cmd_t* const p_next = nus_xfer_get_next_cmd(p_xfer);
+            // The reference is released after unbinding, so a new connection cannot get the same object while bound
+            nus_xfer_free_cmd(p_cmd);
+            p_cmd = p_next;
+        }
+    }
+}
+
+static void
+nus_xfer_start_threads(void)
+{
+    for (uint32_t i = 0; i < NUS_NUM_XFERS; ++i)
+    {
+        nus_xfer_t* const p_xfer = &g_nus_xfers[i];
+        k_fifo_init(&p_xfer->fifo_cmd);
+#if USE_NUS_TX_PIPELINE
+        k_sem_init(&p_xfer->sem_sent, 0, 1);
+#endif
+#if USE_NUS_REQUEST_MTU_AND_DLE
+        k_sem_init(&p_xfer->sem_mtu_exchanged, 0, 1);
+#endif
+        const k_tid_t tid = k_thread_create(
+            &p_xfer->thread,
+            g_nus_xfer_stacks[i],
+            K_THREAD_STACK_SIZEOF(g_nus_xfer_stacks[i]),
+            &nus_xfer_thread,
+            p_xfer,
+            NULL,
+            NULL,
+            CONFIG_RUUVI_AIR_NUS_THREAD_PRIORITY,
+            0,
+            K_NO_WAIT);
+        (void)k_thread_name_set(tid, "nus_xfer");
     }
 }
 
-K_THREAD_DEFINE(
-    nus_tid,
-    CONFIG_RUUVI_AIR_NUS_THREAD_STACK_SIZE,
-    &nus_thread,
-    NULL,
-    NULL,
-    NULL,
-    CONFIG_RUUVI_AIR_NUS_THREAD_PRIORITY,
-    0,
-    0);
+bool
+nus_init(void)
+{
+    g_nus_cnt_notif_enabled = 0;
+    zephyr_api_ret_t err    = bt_nus_cb_register(&g_nus_listener, NULL);
+    if (0 != err)
+    {
+        TLOG_ERR("Failed to register NUS callback: %d", err);
+        return false;
+    }
+#if USE_NUS_TX_PIPELINE
+    g_p_nus_tx_attr = bt_gatt_find_by_uuid(NULL, 0, &g_nus_tx_char_uuid.uuid);
+    if (NULL == g_p_nus_tx_attr)
+    {
+        TLOG_ERR("NUS TX characteristic not found");
+        return false;
+    }
+#endif
+#if USE_NUS_L2CAP
+    if (!nus_l2cap_init())
+    {
+        return false;
+    }
+#endif
+    nus_xfer_start_threads();
+    TLOG_INF("NUS service successfully registered");
+    return true;
+}
@@ -6,6 +6,8 @@
 #define RUUVI_AIR_NUS_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "zephyr_api.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +22,49 @@ nus_is_notif_enabled(void);
 bool
 nus_is_reading_hist_in_progress(void);
 
+struct bt_conn;
+
+/**
+ * @brief Send the live measurement to the client over NUS.
+ * @details With CONFIG_RUUVI_AIR_NUS_TX_PIPELINE the sent callback of the notification wakes up the history
+ * transfers which wait for a free TX buffer of the Bluetooth stack.
+ */
+zephyr_api_ret_t
+nus_send_live_data(struct bt_conn* p_conn, const void* const p_data, const uint16_t len);
+
+/**
+ * @brief Get the max length of the NUS packet which fits into one notification.
+ * @param att_mtu ATT MTU of the connection.
+ * @return 0 if the ATT MTU is invalid.
+ */
+uint32_t
+nus_get_packet_len_max(const uint16_t att_mtu);
+
+/**
+ * @brief Get the max number of the history records which fit into one NUS packet after the header.
+ * @return 0 if even one record does not fit.
+ */
+uint32_t
+nus_get_max_num_records_in_packet(const uint32_t packet_len_max, const uint32_t record_len);
+
+/**
+ * @brief Statistics of the history transfers, they are reset on reboot or by nus_reset_stats().
+ */
+typedef struct nus_stats_t
+{
+    uint32_t num_tx_retries; //!< Notifications rejected by the Bluetooth stack with -EAGAIN/-ENOMEM and retried
+    //! Retries after a sleep instead of the sent callback of a notification: every retry with sleep-and-retry,
+    //! and with CONFIG_RUUVI_AIR_NUS_TX_PIPELINE the waits which timed out because the TX buffers were held
+    //! by the traffic without a sent callback (e.g. ATT responses)
+    uint32_t num_tx_sleeps;
+} nus_stats_t;
+
+void
+nus_get_stats(nus_stats_t* const p_stats);
+
+void
+nus_reset_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,167 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "nus_l2cap.h"
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include "tlog.h"
+
+LOG_MODULE_REGISTER(nus_l2cap, LOG_LEVEL_INF);
+
+#define NUS_L2CAP_PSM           (CONFIG_RUUVI_AIR_NUS_L2CAP_PSM)
+#define NUS_L2CAP_SDU_LEN       (CONFIG_RUUVI_AIR_NUS_L2CAP_SDU_LEN)
+#define NUS_L2CAP_NUM_TX_SDUS   (CONFIG_RUUVI_AIR_NUS_L2CAP_NUM_TX_SDUS)
+#define NUS_L2CAP_TX_TIMEOUT_MS (5000)
+
+// The buffers are used only for sending, the stack keeps its metadata in the user data of the buffer
+#define NUS_L2CAP_BUF_USER_DATA_SIZE (8U)
+
+typedef struct nus_l2cap_t
+{
+    struct bt_l2cap_le_chan le_chan;
+    bool                    is_connected;
+} nus_l2cap_t;
+
+NET_BUF_POOL_FIXED_DEFINE(
+    g_nus_l2cap_tx_pool,
+    NUS_L2CAP_NUM_TX_SDUS,
+    BT_L2CAP_SDU_BUF_SIZE(NUS_L2CAP_SDU_LEN),
+    NUS_L2CAP_BUF_USER_DATA_SIZE,
+    NULL);
+
+static nus_l2cap_t g_nus_l2cap;
+
+static void
+nus_l2cap_on_connected(struct bt_l2cap_chan* p_chan)
+{
+    const struct bt_l2cap_le_chan* const p_le_chan = BT_L2CAP_LE_CHAN(p_chan);
+    TLOG_INF("L2CAP channel connected: MTU %u, MPS %u", p_le_chan->tx.mtu, p_le_chan->tx.mps);
+    g_nus_l2cap.is_connected = true;
+}
+
+static void
+nus_l2cap_on_disconnected(struct bt_l2cap_chan* p_chan)
+{
+    ARG_UNUSED(p_chan);
+    TLOG_INF("L2CAP channel disconnected");
+    g_nus_l2cap.is_connected = false;
+}
+
+static int
+nus_l2cap_on_recv(struct bt_l2cap_chan* p_chan, struct net_buf* p_buf)
+{
+    ARG_UNUSED(p_chan);
+    // The requests are received over NUS, the channel is used only for the responses
+    TLOG_WRN("L2CAP: %u bytes received and ignored", p_buf->len);
+    return 0;
+}
+
+static const struct bt_l2cap_chan_ops g_nus_l2cap_chan_ops = {
+    .connected    = &nus_l2cap_on_connected,
+    .disconnected = &nus_l2cap_on_disconnected,
+    .recv         = &nus_l2cap_on_recv,
+};
+
+static int
+nus_l2cap_accept(struct bt_conn* p_conn, struct bt_l2cap_server* p_server, struct bt_l2cap_chan** pp_chan)
+{
+    ARG_UNUSED(p_conn);
+    ARG_UNUSED(p_server);
+    // The history is sent to one client at a time
+    if (g_nus_l2cap.is_connected)
+    {
+        TLOG_WRN("L2CAP channel is already in use");
+        return -ENOMEM;
+    }
+    memset(&g_nus_l2cap.le_chan, 0, sizeof(g_nus_l2cap.le_chan));
+    g_nus_l2cap.le_chan.chan.ops = &g_nus_l2cap_chan_ops;
+    *pp_chan                     = &g_nus_l2cap.le_chan.chan;
+    return 0;
+}
+
+static struct bt_l2cap_server g_nus_l2cap_server = {
+    .psm       = NUS_L2CAP_PSM,
+    .sec_level = BT_SECURITY_L1,
+    .accept    = &nus_l2cap_accept,
+};
+
+bool
+nus_l2cap_init(void)
+{
+    const zephyr_api_ret_t err = bt_l2cap_server_register(&g_nus_l2cap_server);
+    if (0 != err)
+    {
+        TLOG_ERR("Failed to register L2CAP server: %d", err);
+        return false;
+    }
+    TLOG_INF("L2CAP server registered, PSM 0x%02x", NUS_L2CAP_PSM);
+    return true;
+}
+
+bool
+nus_l2cap_is_connected(const struct bt_conn* const p_conn)
+{
+    return g_nus_l2cap.is_connected && (p_conn == g_nus_l2cap.le_chan.chan.conn);
+}
+
+uint32_t
+nus_l2cap_get_sdu_len_max(void)
+{
+    if (!g_nus_l2cap.is_connected)
+    {
+        return 0;
+    }
+    return MIN(g_nus_l2cap.le_chan.tx.mtu, NUS_L2CAP_SDU_LEN);
+}
+
+zephyr_api_ret_t
+nus_l2cap_send(const uint8_t* const p_data, const uint16_t len)
+{
+    if (!g_nus_l2cap.is_connected)
+    {
+        return -ENOTCONN;
+    }
+    struct net_buf* const p_buf = net_buf_alloc(&g_nus_l2cap_tx_pool, K_MSEC(NUS_L2CAP_TX_TIMEOUT_MS));
+    if (NULL == p_buf)
+    {
+        TLOG_ERR("No free L2CAP TX buffer for %d ms", NUS_L2CAP_TX_TIMEOUT_MS);
+        return -ETIMEDOUT;
+    }
+    net_buf_reserve(p_buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+    net_buf_add_mem(p_buf, p_data, len);
+    // On success the buffer is owned by the stack and it is freed when the SDU is sent or the channel is closed
+    const zephyr_api_ret_t err = bt_l2cap_chan_send(&g_nus_l2cap.le_chan.chan, p_buf);
+    if (0 != err)
+    {
+        net_buf_unref(p_buf);
+    }
+    return err;
+}
+
+bool
+nus_l2cap_flush(void)
+{
+    // All the SDUs are sent when all the buffers are back in the pool
+    struct net_buf* bufs[NUS_L2CAP_NUM_TX_SDUS] = { 0 };
+    bool            res                         = true;
+    for (uint32_t i = 0; i < NUS_L2CAP_NUM_TX_SDUS; ++i)
+    {
+        bufs[i] = net_buf_alloc(&g_nus_l2cap_tx_pool, K_MSEC(NUS_L2CAP_TX_TIMEOUT_MS));
+        if (NULL == bufs[i])
+        {
+            TLOG_WRN("L2CAP SDUs were not sent for %d ms", NUS_L2CAP_TX_TIMEOUT_MS);
+            res = false;
+            break;
+        }
+    }
+    for (uint32_t i = 0; i < NUS_L2CAP_NUM_TX_SDUS; ++i)
+    {
+        if (NULL != bufs[i])
+        {
+            net_buf_unref(bufs[i]);
+        }
+    }
+    return res;
+}
@@ -0,0 +1,59 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#ifndef NUS_L2CAP_H
+#define NUS_L2CAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/bluetooth/conn.h>
+#include "zephyr_api.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Register the L2CAP server for the bulk transfer of the history.
+ * @details The client connects the LE credit-based channel to CONFIG_RUUVI_AIR_NUS_L2CAP_PSM before sending
+ * the history request over NUS. While the channel is connected, the responses to the history requests
+ * of this connection are sent over it as SDUs instead of the NUS notifications, one message per SDU,
+ * in the same format. The requests are still sent over NUS.
+ */
+bool
+nus_l2cap_init(void);
+
+/**
+ * @brief Check if the channel of the connection is connected.
+ */
+bool
+nus_l2cap_is_connected(const struct bt_conn* const p_conn);
+
+/**
+ * @brief Get the max length of the message which fits into one SDU.
+ * @return Min of the MTU of the client and CONFIG_RUUVI_AIR_NUS_L2CAP_SDU_LEN, 0 if the channel is not connected.
+ */
+uint32_t
+nus_l2cap_get_sdu_len_max(void);
+
+/**
+ * @brief Queue the message for sending as one SDU.
+ * @details The data is copied to one of CONFIG_RUUVI_AIR_NUS_L2CAP_NUM_TX_SDUS buffers, the call waits
+ * for a free buffer if all of them are queued. The Bluetooth stack segments the SDU into PDUs and sends them
+ * as the client gives the credits, the buffer is freed when the whole SDU is sent.
+ */
+zephyr_api_ret_t
+nus_l2cap_send(const uint8_t* const p_data, const uint16_t len);
+
+/**
+ * @brief Wait until all the queued SDUs are sent.
+ */
+bool
+nus_l2cap_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NUS_L2CAP_H
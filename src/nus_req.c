@@ -4,10 +4,25 @@
 
 #include "nus_req.h"
 #include "ruuvi_endpoints.h"
+#include "sys_utils.h"
 #include "tlog.h"
 
 LOG_MODULE_DECLARE(nus, LOG_LEVEL_INF);
 
+#define NUS_REQ_FILTER_MODE_IDX      (RE_STANDARD_MESSAGE_LENGTH)
+#define NUS_REQ_FILTER_NUM_CONDS_IDX (RE_STANDARD_MESSAGE_LENGTH + 1U)
+#define NUS_REQ_FILTER_CONDS_IDX     (RE_STANDARD_MESSAGE_LENGTH + 2U)
+
+#define NUS_REQ_FILTER_COND_FIELD_OFS     (0U)
+#define NUS_REQ_FILTER_COND_OP_OFS        (1U)
+#define NUS_REQ_FILTER_COND_THRESHOLD_OFS (2U)
+#define NUS_REQ_FILTER_COND_LEN           (6U)
+
+#define NUS_REQ_FILTER_THRESHOLD_SCALE (100.0f)
+
+#define NUS_REQ_AGGREGATION_PERIOD_IDX (RE_STANDARD_MESSAGE_LENGTH)
+#define NUS_REQ_AGGREGATION_LEN        (RE_STANDARD_MESSAGE_LENGTH + 4U)
+
 static bool
 nus_req_parse_type(const uint8_t raw_req_type, re_type_t* const p_req_type)
 {
@@ -87,6 +102,24 @@ nus_req_parse_op(const uint8_t raw_req_op, re_op_t* const p_req_op)
         case RE_STANDARD_LOG_MULTI_READ:
             *p_req_op = RE_LOG_R_MULTI;
             break;
+        case NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
+        case NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
+        case NUS_REQ_OP_LOG_MULTI_READ_FILTERED:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
+        case NUS_REQ_OP_LOG_HIRES_READ:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
+        case NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
+        case NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED:
+            *p_req_op = RE_LOG_R_MULTI;
+            break;
         default:
             TLOG_ERR("Unknown request operation: %d", raw_req_op);
             return false;
@@ -94,6 +127,69 @@ nus_req_parse_op(const uint8_t raw_req_op, re_op_t* const p_req_op)
     return true;
 }
 
+static int32_t
+nus_req_unpack_int32(const uint8_t* const p_buf)
+{
+    return (int32_t)(((uint32_t)p_buf[BYTE_IDX_0] << BYTE_SHIFT_3) | ((uint32_t)p_buf[BYTE_IDX_1] << BYTE_SHIFT_2)
+                     | ((uint32_t)p_buf[BYTE_IDX_2] << BYTE_SHIFT_1) | ((uint32_t)p_buf[BYTE_IDX_3] << BYTE_SHIFT_0));
+}
+
+static bool
+nus_req_parse_filter(const uint8_t* const p_raw_message, const uint16_t len, nus_req_t* const p_req)
+{
+    const uint8_t mode      = p_raw_message[NUS_REQ_FILTER_MODE_IDX];
+    const uint8_t num_conds = p_raw_message[NUS_REQ_FILTER_NUM_CONDS_IDX];
+    if ((NUS_REQ_FILTER_MODE_RECORDS != mode) && (NUS_REQ_FILTER_MODE_INTERVALS != mode))
+    {
+        TLOG_ERR("Unknown filter mode: %d", mode);
+        return false;
+    }
+    if ((0 == num_conds) || (num_conds > HIST_LOG_FILTER_MAX_CONDS))
+    {
+        TLOG_ERR("Invalid number of filter conditions: %d", num_conds);
+        return false;
+    }
+    if (len != (NUS_REQ_FILTER_CONDS_IDX + (num_conds * NUS_REQ_FILTER_COND_LEN)))
+    {
+        TLOG_ERR("Invalid message length: %d for %d filter conditions", len, num_conds);
+        return false;
+    }
+    p_req->is_intervals     = (NUS_REQ_FILTER_MODE_INTERVALS == mode);
+    p_req->filter.num_conds = num_conds;
+    for (uint32_t i = 0; i < num_conds; ++i)
+    {
+        const uint8_t* const p_raw_cond = &p_raw_message[NUS_REQ_FILTER_CONDS_IDX + (i * NUS_REQ_FILTER_COND_LEN)];
+        const uint8_t        field      = p_raw_cond[NUS_REQ_FILTER_COND_FIELD_OFS];
+        const uint8_t        op         = p_raw_cond[NUS_REQ_FILTER_COND_OP_OFS];
+        if ((field >= HIST_LOG_NUM_FIELDS) || (op > (uint8_t)HIST_LOG_FILTER_OP_LT))
+        {
+            TLOG_ERR("Invalid filter condition: field %d, op %d", field, op);
+            return false;
+        }
+        const int32_t threshold = nus_req_unpack_int32(&p_raw_cond[NUS_REQ_FILTER_COND_THRESHOLD_OFS]);
+        p_req->filter.conds[i]  = (hist_log_filter_cond_t) {
+            .field     = (hist_log_field_e)field,
+            .op        = (hist_log_filter_op_e)op,
+            .threshold = (float)threshold / NUS_REQ_FILTER_THRESHOLD_SCALE,
+        };
+    }
+    return true;
+}
+
+static bool
+nus_req_parse_aggregation(const uint8_t* const p_raw_message, nus_req_t* const p_req)
+{
+    const uint32_t period_s = (uint32_t)nus_req_unpack_int32(&p_raw_message[NUS_REQ_AGGREGATION_PERIOD_IDX]);
+    if ((0 == period_s) || (0 != (period_s % NUS_REQ_AGGREGATION_PERIOD_STEP_S))
+        || (period_s > NUS_REQ_AGGREGATION_PERIOD_MAX_S))
+    {
+        TLOG_ERR("Invalid aggregation period: %" PRIu32 " s", period_s);
+        return false;
+    }
+    p_req->aggregation_period_s = period_s;
+    return true;
+}
+
 bool
 nus_req_parse(const uint8_t* const p_raw_message, const uint16_t len, nus_req_t* const p_req)
 {
@@ -102,7 +198,22 @@ nus_req_parse(const uint8_t* const p_raw_message, const uint16_t len, nus_req_t*
         TLOG_ERR("NULL message");
         return false;
     }
-    if (len != RE_STANDARD_MESSAGE_LENGTH)
+    const bool is_filtered   = (len > RE_STANDARD_OPERATION_INDEX)
+                               && (NUS_REQ_OP_LOG_MULTI_READ_FILTERED == p_raw_message[RE_STANDARD_OPERATION_INDEX]);
+    const bool is_aggregated = (len > RE_STANDARD_OPERATION_INDEX)
+                               && (NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED == p_raw_message[RE_STANDARD_OPERATION_INDEX]);
+    if (is_aggregated && (len != NUS_REQ_AGGREGATION_LEN))
+    {
+        TLOG_ERR("Invalid message legnth: %d (expected %d)", len, NUS_REQ_AGGREGATION_LEN);
+        return false;
+    }
+    // The standard fields are read before the filter, so the length of its header is checked first
+    if (is_filtered && (len < NUS_REQ_FILTER_CONDS_IDX))
+    {
+        TLOG_ERR("Invalid message length: %d (expected at least %d)", len, NUS_REQ_FILTER_CONDS_IDX);
+        return false;
+    }
+    if ((!is_filtered) && (!is_aggregated) && (len != RE_STANDARD_MESSAGE_LENGTH))
     {
         TLOG_ERR("Invalid message legnth: %d (expected %d)", len, RE_STANDARD_MESSAGE_LENGTH);
         return false;
@@ -119,14 +230,55 @@ nus_req_parse(const uint8_t* const p_raw_message, const uint16_t len, nus_req_t*
         return false;
     }
 
-    p_req->current_time_s = re_std_log_current_time(p_raw_message);
-    p_req->start_time_s   = re_std_log_start_time(p_raw_message);
+    const uint8_t raw_req_op    = p_raw_message[RE_STANDARD_OPERATION_INDEX];
+    p_req->current_time_s       = re_std_log_current_time(p_raw_message);
+    p_req->start_time_s         = re_std_log_start_time(p_raw_message);
+    p_req->is_compressed        = (NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED == raw_req_op);
+    p_req->is_after_seq         = (NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ == raw_req_op) || p_req->is_compressed;
+    p_req->after_seq            = 0;
+    p_req->is_newest_first      = (NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST == raw_req_op);
+    p_req->num_records_max      = 0;
+    p_req->is_filtered          = is_filtered;
+    p_req->is_intervals         = false;
+    p_req->filter               = (hist_log_filter_t) { 0 };
+    p_req->is_hires             = (NUS_REQ_OP_LOG_HIRES_READ == raw_req_op);
+    p_req->hires_max_age_s      = 0;
+    p_req->is_aggregated        = is_aggregated;
+    p_req->aggregation_period_s = 0;
+
+    if (p_req->is_after_seq)
+    {
+        // The start time field contains the sequence number, the current time is still used to convert timestamps
+        p_req->after_seq    = p_req->start_time_s;
+        p_req->start_time_s = 0;
+        return true;
+    }
+    if (p_req->is_newest_first)
+    {
+        p_req->num_records_max = p_req->start_time_s;
+        p_req->start_time_s    = 0;
+        return true;
+    }
+    if (p_req->is_hires)
+    {
+        p_req->hires_max_age_s = p_req->start_time_s;
+        p_req->start_time_s    = 0;
+        return true;
+    }
 
     if (p_req->current_time_s <= p_req->start_time_s)
     {
         TLOG_ERR("Invalid start time: %" PRIu32 " >= %" PRIu32, p_req->start_time_s, p_req->current_time_s);
         return false;
     }
+    if (p_req->is_filtered && (!nus_req_parse_filter(p_raw_message, len, p_req)))
+    {
+        return false;
+    }
+    if (p_req->is_aggregated && (!nus_req_parse_aggregation(p_raw_message, p_req)))
+    {
+        return false;
+    }
 
     return true;
 }
@@ -8,11 +8,85 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "ruuvi_endpoints.h"
+#include "hist_log.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Extension of RE_STANDARD_LOG_MULTI_READ for resumable synchronization.
+ * @details The message has the same layout, but the start time field contains the sequence number
+ * of the last record received by the client, and only the records after it are sent.
+ * Every record in the response is prefixed with its 4-byte sequence number (big-endian),
+ * the end-of-data message contains the sequence number to be used in the next request.
+ */
+#define NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ (0x22U)
+
+/**
+ * @brief Extension of RE_STANDARD_LOG_MULTI_READ for reading the newest records first.
+ * @details The message has the same layout, but the start time field contains the max number of records to send
+ * (0 means all the records). The records are sent starting from the newest one, so the client can show
+ * the recent history immediately. Every record is prefixed with its sequence number as for
+ * NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ, the end-of-data message contains the sequence number of the newest record,
+ * which can be used in the next NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ request.
+ */
+#define NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST (0x23U)
+
+/**
+ * @brief Extension of RE_STANDARD_LOG_MULTI_READ for reading only the records which match a filter.
+ * @details The standard message (the start time is used as usual) is followed by:
+ * - the response mode: NUS_REQ_FILTER_MODE_RECORDS or NUS_REQ_FILTER_MODE_INTERVALS,
+ * - the number of conditions (1..HIST_LOG_FILTER_MAX_CONDS),
+ * - for every condition: the field (hist_log_field_e), the operation (hist_log_filter_op_e)
+ *   and the threshold in units of 0.01 (int32_t, big-endian).
+ * A record matches if any of the conditions matches. In the records mode every matching record is sent
+ * prefixed with its sequence number as for NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ. In the intervals mode
+ * the consecutive matching records are merged, and every interval is sent as
+ * [timestamp of the first record (4 bytes)][timestamp of the last record (4 bytes)][number of records (2 bytes)].
+ */
+#define NUS_REQ_OP_LOG_MULTI_READ_FILTERED (0x24U)
+
+/**
+ * @brief Request for the high-resolution (1-second) history kept in RAM (see hires_log.h).
+ * @details The message has the same layout as RE_STANDARD_LOG_MULTI_READ, but the start time field contains
+ * the max age of the samples in seconds (0 means all the samples). Every block of the buffer is sent
+ * in one message: [timestamp of the first sample (4 bytes)][number of samples (2 bytes)][encoded samples],
+ * the end-of-data message contains only the 3-byte header.
+ */
+#define NUS_REQ_OP_LOG_HIRES_READ (0x25U)
+
+/**
+ * @brief Extension of RE_STANDARD_LOG_MULTI_READ for reading the history at a lower resolution.
+ * @details The standard message (the start time is used as usual) is followed by the aggregation period
+ * in seconds (uint32_t, big-endian), which must be a multiple of 5 minutes (NUS_REQ_AGGREGATION_PERIOD_STEP_S).
+ * The records are aggregated into time buckets of this length, and every bucket is sent as one record:
+ * [start of the bucket (4 bytes)][E1 payload with the mean values][E1 payload with the min values]
+ * [E1 payload with the max values]. The sequence counter and flags are taken from the last record in the bucket.
+ */
+#define NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED (0x26U)
+
+/**
+ * @brief Extension of NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ for reading the history compressed.
+ * @details The message has the same layout as NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ, and the same records are sent,
+ * but every packet is a chunk of frames of hist_log_codec (see hist_log_codec.h):
+ * [number of records (1 byte)][NUS_REQ_COMPRESSED_FMT_VERSION (1 byte)][key frame][delta frames].
+ * Every chunk starts with a key frame, so it can be decoded without the previous ones, and a lost chunk
+ * loses only its own records. The frames contain the timestamps and the sequence numbers of the records.
+ * The end-of-data message has no frames and contains the sequence number to be used in the next request,
+ * as for NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ. All the messages use this operation code,
+ * so the client never mixes them up with the uncompressed records.
+ */
+#define NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED (0x27U)
+
+#define NUS_REQ_COMPRESSED_FMT_VERSION (1U)
+
+#define NUS_REQ_AGGREGATION_PERIOD_STEP_S (5U * 60U)
+#define NUS_REQ_AGGREGATION_PERIOD_MAX_S  (7U * 24U * 60U * 60U)
+
+#define NUS_REQ_FILTER_MODE_RECORDS   (0U)
+#define NUS_REQ_FILTER_MODE_INTERVALS (1U)
+
 typedef uint8_t nus_req_src_idx_t;
 
 typedef uint32_t nus_req_time_t;
@@ -24,6 +98,19 @@ typedef struct nus_req_t
     re_op_t           req_re_op;
     nus_req_time_t    current_time_s;
     nus_req_time_t    start_time_s;
+    bool              is_after_seq;    //!< Request NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ
+    uint32_t          after_seq;       //!< Sequence number of the last record received by the client
+    bool              is_newest_first; //!< Request NUS_REQ_OP_LOG_MULTI_READ_NEWEST_FIRST
+    uint32_t          num_records_max; //!< Max number of the newest records to send, 0 means all the records
+    bool              is_filtered;     //!< Request NUS_REQ_OP_LOG_MULTI_READ_FILTERED
+    bool              is_intervals;    //!< Send the intervals of the matching records instead of the records
+    hist_log_filter_t filter;
+    bool              is_hires;        //!< Request NUS_REQ_OP_LOG_HIRES_READ
+    uint32_t          hires_max_age_s; //!< Max age of the high-resolution samples to send, 0 means all the samples
+    bool              is_aggregated;   //!< Request NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED
+    //! Length of the time bucket for NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED
+    uint32_t aggregation_period_s;
+    bool     is_compressed; //!< Request NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, is_after_seq is set as well
 } nus_req_t;
 
 bool
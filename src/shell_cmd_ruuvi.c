@@ -15,6 +15,7 @@
 #include "aqi.h"
 #include "fw_img_hw_rev.h"
 #include "app_fw_ver.h"
+#include "flash_stats.h"
 
 LOG_MODULE_REGISTER(shell_cmd_ruuvi, LOG_LEVEL_INF);
 
@@ -408,6 +409,79 @@ cmd_ruuvi_version_info(const struct shell* sh, size_t argc, char** argv)
 }
 #endif // CONFIG_BOOTLOADER_MCUBOOT
 
+#if IS_ENABLED(CONFIG_RUUVI_AIR_FLASH_STATS)
+static void
+print_flash_stats_op(const struct shell* sh, const char* const p_op_name, const flash_stats_op_counters_t* const p_cnt)
+{
+    shell_print(
+        sh,
+        "  %-5s ops=%u, errors=%u, bytes=%llu, max=%u us",
+        p_op_name,
+        (unsigned)p_cnt->num_ops,
+        (unsigned)p_cnt->num_errors,
+        (unsigned long long)p_cnt->num_bytes,
+        (unsigned)p_cnt->latency_max_us);
+    if (0 == p_cnt->num_ops)
+    {
+        return;
+    }
+    shell_fprintf(sh, SHELL_NORMAL, "        latency:");
+    for (uint32_t i = 0; i < FLASH_STATS_NUM_LATENCY_BUCKETS; ++i)
+    {
+        if (0 != p_cnt->latency_hist[i])
+        {
+            shell_fprintf(sh, SHELL_NORMAL, " >=%luus:%u", 1UL << i, (unsigned)p_cnt->latency_hist[i]);
+        }
+    }
+    shell_fprintf(sh, SHELL_NORMAL, "\n");
+}
+
+static int // NOSONAR: Zephyr shell command handler API
+cmd_ruuvi_flash_stats(const struct shell* sh, size_t argc, char** argv)
+{
+    log_args(argc, argv);
+
+    flash_stats_snapshot_t snapshot = { 0 };
+    for (uint32_t idx = 0; flash_stats_get_snapshot(idx, &snapshot); ++idx)
+    {
+        shell_print(sh, "Flash area %u: %u sectors", (unsigned)snapshot.fa_id, (unsigned)snapshot.num_sectors);
+        print_flash_stats_op(sh, "read", &snapshot.ops[FLASH_STATS_OP_READ]);
+        print_flash_stats_op(sh, "write", &snapshot.ops[FLASH_STATS_OP_WRITE]);
+        print_flash_stats_op(sh, "erase", &snapshot.ops[FLASH_STATS_OP_ERASE]);
+        if (snapshot.is_erase_cnt_tracked)
+        {
+            shell_print(
+                sh,
+                "  sector erases: min=%u, max=%u, total=%u",
+                (unsigned)snapshot.sector_erase_cnt_min,
+                (unsigned)snapshot.sector_erase_cnt_max,
+                (unsigned)snapshot.sector_erase_cnt_sum);
+        }
+        else
+        {
+            shell_print(sh, "  sector erases: not tracked");
+        }
+    }
+    return 0;
+}
+
+static int // NOSONAR: Zephyr shell command handler API
+cmd_ruuvi_flash_stats_reset(const struct shell* sh, size_t argc, char** argv)
+{
+    log_args(argc, argv);
+
+    flash_stats_reset();
+    shell_print(sh, "Flash statistics are cleared, the sector erase counts are kept");
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    sub_ruuvi_flash,
+    SHELL_CMD_ARG(stats, NULL, "stats", cmd_ruuvi_flash_stats, 1, 0),
+    SHELL_CMD_ARG(stats_reset, NULL, "stats_reset", cmd_ruuvi_flash_stats_reset, 1, 0),
+    SHELL_SUBCMD_SET_END);
+#endif // CONFIG_RUUVI_AIR_FLASH_STATS
+
 /* Add command to the set of 'ruuvi' subcommands, see `SHELL_SUBCMD_ADD` */
 #define RUUVI_CMD_ARG_ADD(_syntax, _subcmd, _help, _handler, _mand, _opt) /* NOSONAR */ \
     SHELL_SUBCMD_ADD((ruuvi), _syntax, _subcmd, _help, _handler, _mand, _opt);
@@ -455,5 +529,9 @@ RUUVI_CMD_ARG_ADD(
 RUUVI_CMD_ARG_ADD(version_info, NULL, "version_info", cmd_ruuvi_version_info, 1, 0);
 #endif // CONFIG_BOOTLOADER_MCUBOOT
 
+#if IS_ENABLED(CONFIG_RUUVI_AIR_FLASH_STATS)
+RUUVI_CMD_ARG_ADD(flash, &sub_ruuvi_flash, "flash <stats|stats_reset>", NULL, 1, 0);
+#endif // CONFIG_RUUVI_AIR_FLASH_STATS
+
 SHELL_SUBCMD_SET_CREATE(ruuvi_cmds, (ruuvi));
 SHELL_CMD_REGISTER(ruuvi, &ruuvi_cmds, "Ruuvi commands", NULL);
@@ -0,0 +1,243 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/settings/settings.h>
+#include "flash_stats.h"
+#include "zassert.h"
+
+#define TEST_FLASH_STATS_AREA_ID     FIXED_PARTITION_ID(flash_stats_test)
+#define TEST_FLASH_STATS_NUM_SECTORS (16U)
+#define TEST_FLASH_STATS_BUF_SIZE    (256U)
+
+// The erase counts are not tracked if the partition does not fit into the pool of the counters
+#define TEST_FLASH_STATS_IS_ERASE_CNT_TRACKED (CONFIG_RUUVI_AIR_FLASH_STATS_NUM_SECTORS >= TEST_FLASH_STATS_NUM_SECTORS)
+
+// Erase of a 4 KiB sector takes at least CONFIG_FLASH_SIMULATOR_MIN_ERASE_TIME_US = 45 ms
+#define TEST_FLASH_STATS_ERASE_LATENCY_BUCKET_MIN (15U)
+
+static void*
+test_setup(void);
+
+static void
+test_suite_before(void* f);
+
+ZTEST_SUITE(test_suite_flash_stats, NULL, &test_setup, &test_suite_before, NULL, NULL);
+
+static void*
+test_setup(void)
+{
+    // The erase counts are saved to settings
+    const int rc = settings_subsys_init();
+    assert(0 == rc);
+    return NULL;
+}
+
+static void
+test_suite_before(void* f)
+{
+    ARG_UNUSED(f);
+    char key[32];
+    (void)snprintf(key, sizeof(key), "flash_stats/%u", (unsigned)TEST_FLASH_STATS_AREA_ID);
+    zassert_true(0 == settings_delete(key));
+    // Every test starts as after the first boot
+    flash_stats_deinit();
+    flash_stats_init();
+}
+
+static const struct flash_area*
+test_flash_stats_open(void)
+{
+    const struct flash_area* p_fa = NULL;
+    zassert_true(0 == flash_area_open(TEST_FLASH_STATS_AREA_ID, &p_fa));
+    return p_fa;
+}
+
+static bool
+test_flash_stats_get(const uint8_t fa_id, flash_stats_snapshot_t* const p_snapshot)
+{
+    for (uint32_t idx = 0; flash_stats_get_snapshot(idx, p_snapshot); ++idx)
+    {
+        if (fa_id == p_snapshot->fa_id)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t
+test_flash_stats_get_num_slow_ops(const flash_stats_op_counters_t* const p_cnt, const uint32_t bucket_min)
+{
+    uint32_t num_ops = 0;
+    for (uint32_t i = bucket_min; i < FLASH_STATS_NUM_LATENCY_BUCKETS; ++i)
+    {
+        num_ops += p_cnt->latency_hist[i];
+    }
+    return num_ops;
+}
+
+ZTEST(test_suite_flash_stats, test_no_ops)
+{
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_false(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    ZASSERT_EQ_INT(UINT32_MAX, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 0));
+}
+
+ZTEST(test_suite_flash_stats, test_read_write_erase)
+{
+    const struct flash_area* const p_fa                           = test_flash_stats_open();
+    uint8_t                        buf[TEST_FLASH_STATS_BUF_SIZE] = { 0 };
+    memset(buf, 0xA5, sizeof(buf));
+
+    zassert_true(0 == flash_area_erase(p_fa, 0, 2U * FLASH_STATS_SECTOR_SIZE));
+    zassert_true(0 == flash_area_write(p_fa, 0, buf, sizeof(buf)));
+    zassert_true(0 == flash_area_write(p_fa, FLASH_STATS_SECTOR_SIZE, buf, sizeof(buf)));
+    zassert_true(0 == flash_area_read(p_fa, 0, buf, sizeof(buf)));
+    zassert_true(0 != flash_area_read(p_fa, (off_t)p_fa->fa_size, buf, sizeof(buf)));
+    flash_area_close(p_fa);
+
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_true(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    ZASSERT_EQ_INT(TEST_FLASH_STATS_NUM_SECTORS, snapshot.num_sectors);
+
+    const flash_stats_op_counters_t* const p_read = &snapshot.ops[FLASH_STATS_OP_READ];
+    ZASSERT_EQ_INT(2, p_read->num_ops);
+    ZASSERT_EQ_INT(1, p_read->num_errors);
+    ZASSERT_EQ_INT(TEST_FLASH_STATS_BUF_SIZE, (int)p_read->num_bytes);
+
+    const flash_stats_op_counters_t* const p_write = &snapshot.ops[FLASH_STATS_OP_WRITE];
+    ZASSERT_EQ_INT(2, p_write->num_ops);
+    ZASSERT_EQ_INT(0, p_write->num_errors);
+    ZASSERT_EQ_INT(2 * TEST_FLASH_STATS_BUF_SIZE, (int)p_write->num_bytes);
+
+    const flash_stats_op_counters_t* const p_erase = &snapshot.ops[FLASH_STATS_OP_ERASE];
+    ZASSERT_EQ_INT(1, p_erase->num_ops);
+    ZASSERT_EQ_INT(0, p_erase->num_errors);
+    ZASSERT_EQ_INT(2 * FLASH_STATS_SECTOR_SIZE, (int)p_erase->num_bytes);
+
+    // Every operation is put into one of the latency buckets, the erase is the slowest one
+    for (uint32_t op = 0; op < FLASH_STATS_NUM_OPS; ++op)
+    {
+        const flash_stats_op_counters_t* const p_cnt = &snapshot.ops[op];
+        ZASSERT_EQ_INT(p_cnt->num_ops, test_flash_stats_get_num_slow_ops(p_cnt, 0));
+    }
+    ZASSERT_EQ_INT(1, test_flash_stats_get_num_slow_ops(p_erase, TEST_FLASH_STATS_ERASE_LATENCY_BUCKET_MIN));
+    zassert_true(p_erase->latency_max_us >= (1U << TEST_FLASH_STATS_ERASE_LATENCY_BUCKET_MIN));
+    zassert_true(p_erase->latency_max_us > p_write->latency_max_us);
+    zassert_true(p_write->latency_max_us > p_read->latency_max_us);
+}
+
+ZTEST(test_suite_flash_stats, test_sector_erase_cnt)
+{
+    if (!TEST_FLASH_STATS_IS_ERASE_CNT_TRACKED)
+    {
+        ztest_test_skip();
+    }
+    const struct flash_area* const p_fa = test_flash_stats_open();
+    zassert_true(0 == flash_area_erase(p_fa, 0, 2U * FLASH_STATS_SECTOR_SIZE));
+    zassert_true(0 == flash_area_erase(p_fa, FLASH_STATS_SECTOR_SIZE, FLASH_STATS_SECTOR_SIZE));
+    zassert_true(0 == flash_area_flatten(p_fa, 5U * FLASH_STATS_SECTOR_SIZE, FLASH_STATS_SECTOR_SIZE));
+    flash_area_close(p_fa);
+
+    ZASSERT_EQ_INT(1, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 0));
+    ZASSERT_EQ_INT(2, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 1));
+    ZASSERT_EQ_INT(0, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 2));
+    ZASSERT_EQ_INT(1, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 5));
+    ZASSERT_EQ_INT(
+        UINT32_MAX,
+        flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, TEST_FLASH_STATS_NUM_SECTORS));
+
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_true(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    zassert_true(snapshot.is_erase_cnt_tracked);
+    ZASSERT_EQ_INT(0, snapshot.sector_erase_cnt_min);
+    ZASSERT_EQ_INT(2, snapshot.sector_erase_cnt_max);
+    ZASSERT_EQ_INT(4, snapshot.sector_erase_cnt_sum);
+    ZASSERT_EQ_INT(3, snapshot.ops[FLASH_STATS_OP_ERASE].num_ops);
+}
+
+ZTEST(test_suite_flash_stats, test_sector_erase_cnt_not_tracked)
+{
+    if (TEST_FLASH_STATS_IS_ERASE_CNT_TRACKED)
+    {
+        ztest_test_skip();
+    }
+    const struct flash_area* const p_fa = test_flash_stats_open();
+    zassert_true(0 == flash_area_erase(p_fa, 0, FLASH_STATS_SECTOR_SIZE));
+    flash_area_close(p_fa);
+
+    ZASSERT_EQ_INT(UINT32_MAX, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 0));
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_true(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    zassert_false(snapshot.is_erase_cnt_tracked);
+    ZASSERT_EQ_INT(1, snapshot.ops[FLASH_STATS_OP_ERASE].num_ops);
+    zassert_true(flash_stats_save());
+}
+
+ZTEST(test_suite_flash_stats, test_reset)
+{
+    const struct flash_area* const p_fa = test_flash_stats_open();
+    zassert_true(0 == flash_area_erase(p_fa, 0, FLASH_STATS_SECTOR_SIZE));
+    flash_area_close(p_fa);
+
+    flash_stats_reset();
+
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_true(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    for (uint32_t op = 0; op < FLASH_STATS_NUM_OPS; ++op)
+    {
+        ZASSERT_EQ_INT(0, snapshot.ops[op].num_ops);
+        ZASSERT_EQ_INT(0, test_flash_stats_get_num_slow_ops(&snapshot.ops[op], 0));
+    }
+    // The erase counts are the lifetime statistics, they are not cleared
+    if (TEST_FLASH_STATS_IS_ERASE_CNT_TRACKED)
+    {
+        ZASSERT_EQ_INT(1, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 0));
+    }
+}
+
+ZTEST(test_suite_flash_stats, test_erase_cnt_persisted)
+{
+    if (!TEST_FLASH_STATS_IS_ERASE_CNT_TRACKED)
+    {
+        ztest_test_skip();
+    }
+    const struct flash_area* const p_fa = test_flash_stats_open();
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        zassert_true(0 == flash_area_erase(p_fa, 3U * FLASH_STATS_SECTOR_SIZE, FLASH_STATS_SECTOR_SIZE));
+    }
+    zassert_true(flash_stats_save());
+
+    // The erases after the last save are lost on power loss
+    zassert_true(0 == flash_area_erase(p_fa, 4U * FLASH_STATS_SECTOR_SIZE, FLASH_STATS_SECTOR_SIZE));
+    ZASSERT_EQ_INT(1, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 4));
+
+    // Reboot
+    flash_stats_deinit();
+    ZASSERT_EQ_INT(UINT32_MAX, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 3));
+    flash_stats_init();
+
+    ZASSERT_EQ_INT(3, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 3));
+    ZASSERT_EQ_INT(0, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 4));
+
+    // The counters since boot are not persisted
+    flash_stats_snapshot_t snapshot = { 0 };
+    zassert_true(test_flash_stats_get(TEST_FLASH_STATS_AREA_ID, &snapshot));
+    ZASSERT_EQ_INT(0, snapshot.ops[FLASH_STATS_OP_ERASE].num_ops);
+
+    // The loaded counts are continued and saved again
+    zassert_true(0 == flash_area_erase(p_fa, 3U * FLASH_STATS_SECTOR_SIZE, FLASH_STATS_SECTOR_SIZE));
+    zassert_true(flash_stats_save());
+    flash_area_close(p_fa);
+    flash_stats_deinit();
+    flash_stats_init();
+    ZASSERT_EQ_INT(4, flash_stats_get_sector_erase_cnt(TEST_FLASH_STATS_AREA_ID, 3));
+}
@@ -0,0 +1,362 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "hires_log.h"
+#include "zassert.h"
+
+#define TEST_TIMESTAMP_START (1735689600U) // 2025-01-01 00:00:00
+
+/**
+ * NUS packet of the high-resolution history: 3-byte header, timestamp_first, num_samples and the encoded data.
+ */
+#define TEST_NUS_PACKET_OVERHEAD (3U + sizeof(uint32_t) + sizeof(uint16_t))
+
+static void*
+test_setup(void);
+
+static void
+test_suite_before(void* f);
+
+static void
+test_suite_after(void* f);
+
+static void
+test_teardown(void* f);
+
+ZTEST_SUITE(test_suite_hires_log, NULL, &test_setup, &test_suite_before, &test_suite_after, &test_teardown);
+
+typedef struct test_suite_hires_log_fixture
+{
+    uint32_t rand_state;
+} test_suite_hires_log_fixture_t;
+
+static void*
+test_setup(void)
+{
+    test_suite_hires_log_fixture_t* p_fixture = calloc(1, sizeof(*p_fixture));
+    assert(NULL != p_fixture);
+    return p_fixture;
+}
+
+static void
+test_suite_before(void* f)
+{
+    test_suite_hires_log_fixture_t* p_fixture = f;
+    memset(p_fixture, 0, sizeof(*p_fixture));
+    p_fixture->rand_state = 12345;
+    hires_log_init();
+}
+
+static void
+test_suite_after(void* f)
+{
+}
+
+static void
+test_teardown(void* f)
+{
+    if (NULL != f)
+    {
+        free(f);
+    }
+}
+
+static int32_t
+test_rand(test_suite_hires_log_fixture_t* const p_fixture, const int32_t min, const int32_t max)
+{
+    p_fixture->rand_state = p_fixture->rand_state * 1103515245U + 12345U;
+    return min + (int32_t)((p_fixture->rand_state >> 16U) % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Generate a 1-second sample of a typical office: the sound levels change every second,
+ * the pressure fluctuates by a couple of Pa, SEN66 values drift slowly.
+ */
+static void
+test_gen_sample(
+    test_suite_hires_log_fixture_t* const p_fixture,
+    const uint32_t                        timestamp,
+    hires_log_sample_t* const             p_prev,
+    hires_log_sample_t* const             p_sample)
+{
+    const int32_t* const        p_val       = p_prev->values;
+    const sensors_measurement_t measurement = {
+        .sen66 = {
+            .mass_concentration_pm1p0  = (uint16_t)(p_val[HIRES_LOG_FIELD_PM1P0] + test_rand(p_fixture, -1, 1)),
+            .mass_concentration_pm2p5  = (uint16_t)(p_val[HIRES_LOG_FIELD_PM2P5] + test_rand(p_fixture, -1, 1)),
+            .mass_concentration_pm4p0  = (uint16_t)p_val[HIRES_LOG_FIELD_PM4P0],
+            .mass_concentration_pm10p0 = (uint16_t)p_val[HIRES_LOG_FIELD_PM10P0],
+            .ambient_humidity          = (int16_t)(p_val[HIRES_LOG_FIELD_HUMIDITY] + test_rand(p_fixture, -2, 2)),
+            .ambient_temperature       = (int16_t)(p_val[HIRES_LOG_FIELD_TEMPERATURE]
+                                       + ((0 == (timestamp % 4U)) ? test_rand(p_fixture, -1, 1) : 0)),
+            .voc_index                 = (int16_t)(p_val[HIRES_LOG_FIELD_VOC]
+                                       + ((0 == (timestamp % 10U)) ? test_rand(p_fixture, -1, 1) : 0)),
+            .nox_index                 = 10,
+            .co2                       = (uint16_t)(p_val[HIRES_LOG_FIELD_CO2]
+                                       + ((0 == (timestamp % 5U)) ? test_rand(p_fixture, -3, 4) : 0)),
+        },
+        .dps310_pressure   = (float32_t)(101325 + test_rand(p_fixture, -2, 2)),
+        .luminosity        = (0 == (timestamp % 30U)) ? (float32_t)test_rand(p_fixture, 300, 310)
+                                                      : (float32_t)p_val[HIRES_LOG_FIELD_LUMINOSITY],
+        .sound_inst_dba    = 45.0f + (float32_t)test_rand(p_fixture, -500, 500) / 100.0f,
+        .sound_avg_dba     = 45.0f + (float32_t)test_rand(p_fixture, -50, 50) / 100.0f,
+        .sound_peak_spl_db = 60.0f + (float32_t)test_rand(p_fixture, -800, 800) / 100.0f,
+    };
+    *p_sample = hires_log_conv_measurement(timestamp, &measurement);
+    *p_prev   = *p_sample;
+}
+
+static hires_log_sample_t
+test_initial_sample(void)
+{
+    hires_log_sample_t sample                  = { 0 };
+    sample.values[HIRES_LOG_FIELD_PM1P0]       = 50;
+    sample.values[HIRES_LOG_FIELD_PM2P5]       = 60;
+    sample.values[HIRES_LOG_FIELD_PM4P0]       = 65;
+    sample.values[HIRES_LOG_FIELD_PM10P0]      = 70;
+    sample.values[HIRES_LOG_FIELD_HUMIDITY]    = 8000;
+    sample.values[HIRES_LOG_FIELD_TEMPERATURE] = 4400;
+    sample.values[HIRES_LOG_FIELD_VOC]         = 1000;
+    sample.values[HIRES_LOG_FIELD_CO2]         = 600;
+    sample.values[HIRES_LOG_FIELD_LUMINOSITY]  = 300;
+    return sample;
+}
+
+static void
+test_check_sample(const hires_log_sample_t* const p_exp, const hires_log_sample_t* const p_act)
+{
+    ZASSERT_EQ_INT(p_exp->timestamp, p_act->timestamp);
+    for (uint32_t i = 0; i < HIRES_LOG_NUM_FIELDS; ++i)
+    {
+        ZASSERT_EQ_INT(p_exp->values[i], p_act->values[i]);
+    }
+}
+
+ZTEST_F(test_suite_hires_log, test_empty)
+{
+    uint32_t block_seq_first = 1;
+    uint32_t block_seq_end   = 1;
+    hires_log_get_block_range(&block_seq_first, &block_seq_end);
+    ZASSERT_EQ_INT(0, block_seq_first);
+    ZASSERT_EQ_INT(0, block_seq_end);
+
+    hires_log_block_t block = { 0 };
+    zassert_false(hires_log_read_block(0, &block));
+
+    const hires_log_stats_t stats = hires_log_get_stats();
+    ZASSERT_EQ_INT(0, stats.num_blocks);
+    ZASSERT_EQ_INT((uint32_t)(CONFIG_RUUVI_AIR_HIRES_LOG_SIZE / sizeof(hires_log_block_t)), stats.max_num_blocks);
+    ZASSERT_EQ_INT(0, stats.num_samples);
+}
+
+ZTEST_F(test_suite_hires_log, test_conv_measurement)
+{
+    const sensors_measurement_t measurement = {
+        .sen66 = {
+            .mass_concentration_pm1p0  = 106,
+            .mass_concentration_pm2p5  = 124,
+            .mass_concentration_pm4p0  = 136,
+            .mass_concentration_pm10p0 = 142,
+            .ambient_humidity          = 5588,
+            .ambient_temperature       = 5493,
+            .voc_index                 = 800,
+            .nox_index                 = 20,
+            .co2                       = 0xFFFFU,
+        },
+        .dps310_pressure   = 101325.4f,
+        .luminosity        = NAN,
+        .sound_inst_dba    = 45.27f,
+        .sound_avg_dba     = 44.0f,
+        .sound_peak_spl_db = 80.5f,
+    };
+    const hires_log_sample_t sample = hires_log_conv_measurement(TEST_TIMESTAMP_START, &measurement);
+    ZASSERT_EQ_INT(TEST_TIMESTAMP_START, sample.timestamp);
+    ZASSERT_EQ_INT(106, sample.values[HIRES_LOG_FIELD_PM1P0]);
+    ZASSERT_EQ_INT(124, sample.values[HIRES_LOG_FIELD_PM2P5]);
+    ZASSERT_EQ_INT(136, sample.values[HIRES_LOG_FIELD_PM4P0]);
+    ZASSERT_EQ_INT(142, sample.values[HIRES_LOG_FIELD_PM10P0]);
+    ZASSERT_EQ_INT(5588, sample.values[HIRES_LOG_FIELD_HUMIDITY]);
+    ZASSERT_EQ_INT(5493, sample.values[HIRES_LOG_FIELD_TEMPERATURE]);
+    ZASSERT_EQ_INT(800, sample.values[HIRES_LOG_FIELD_VOC]);
+    ZASSERT_EQ_INT(20, sample.values[HIRES_LOG_FIELD_NOX]);
+    ZASSERT_EQ_INT(0xFFFF, sample.values[HIRES_LOG_FIELD_CO2]);
+    ZASSERT_EQ_INT(101325, sample.values[HIRES_LOG_FIELD_PRESSURE]);
+    ZASSERT_EQ_INT(HIRES_LOG_INVALID_VALUE, sample.values[HIRES_LOG_FIELD_LUMINOSITY]);
+    ZASSERT_EQ_INT(453, sample.values[HIRES_LOG_FIELD_SOUND_INST_DBA]);
+    ZASSERT_EQ_INT(440, sample.values[HIRES_LOG_FIELD_SOUND_AVG_DBA]);
+    ZASSERT_EQ_INT(805, sample.values[HIRES_LOG_FIELD_SOUND_PEAK_SPL_DB]);
+}
+
+ZTEST_F(test_suite_hires_log, test_round_trip)
+{
+    static hires_log_sample_t samples[300];
+    hires_log_sample_t        prev      = test_initial_sample();
+    uint32_t                  timestamp = TEST_TIMESTAMP_START;
+    for (uint32_t i = 0; i < ARRAY_SIZE(samples); ++i)
+    {
+        test_gen_sample(fixture, timestamp, &prev, &samples[i]);
+        if (100 == i)
+        {
+            // Sensor error: the float values are NaN
+            samples[i].values[HIRES_LOG_FIELD_PRESSURE]   = HIRES_LOG_INVALID_VALUE;
+            samples[i].values[HIRES_LOG_FIELD_LUMINOSITY] = HIRES_LOG_INVALID_VALUE;
+        }
+        hires_log_append(&samples[i]);
+        // Gaps and clock adjustments in both directions
+        timestamp += (50 == i) ? 7U : 1U;
+        if (200 == i)
+        {
+            timestamp -= 20U;
+        }
+    }
+
+    uint32_t block_seq_first = 0;
+    uint32_t block_seq_end   = 0;
+    hires_log_get_block_range(&block_seq_first, &block_seq_end);
+    ZASSERT_EQ_INT(0, block_seq_first);
+    zassert_true(block_seq_end > 1);
+
+    uint32_t sample_idx = 0;
+    for (uint32_t block_seq = block_seq_first; block_seq < block_seq_end; ++block_seq)
+    {
+        hires_log_block_t block = { 0 };
+        zassert_true(hires_log_read_block(block_seq, &block));
+        zassert_true(block.len <= HIRES_LOG_BLOCK_SIZE);
+        ZASSERT_EQ_INT(samples[sample_idx].timestamp, block.timestamp_first);
+        hires_log_decoder_t decoder = { 0 };
+        hires_log_decoder_init(&decoder, &block);
+        hires_log_sample_t sample = { 0 };
+        while (hires_log_decoder_next(&decoder, &sample))
+        {
+            zassert_true(sample_idx < ARRAY_SIZE(samples));
+            test_check_sample(&samples[sample_idx], &sample);
+            sample_idx += 1;
+        }
+        ZASSERT_EQ_INT(block.len, decoder.offset);
+    }
+    ZASSERT_EQ_INT((uint32_t)ARRAY_SIZE(samples), sample_idx);
+    zassert_false(hires_log_read_block(block_seq_end, &(hires_log_block_t) { 0 }));
+
+    const hires_log_stats_t stats = hires_log_get_stats();
+    ZASSERT_EQ_INT(block_seq_end, stats.num_blocks);
+    ZASSERT_EQ_INT((uint32_t)ARRAY_SIZE(samples), stats.num_samples);
+}
+
+ZTEST_F(test_suite_hires_log, test_wrap_around)
+{
+    hires_log_sample_t prev      = test_initial_sample();
+    hires_log_sample_t sample    = { 0 };
+    const uint32_t     num_hours = 4;
+    for (uint32_t i = 0; i < (num_hours * 3600U); ++i)
+    {
+        test_gen_sample(fixture, TEST_TIMESTAMP_START + i, &prev, &sample);
+        hires_log_append(&sample);
+    }
+    const hires_log_stats_t stats = hires_log_get_stats();
+    ZASSERT_EQ_INT(stats.max_num_blocks, stats.num_blocks);
+
+    uint32_t block_seq_first = 0;
+    uint32_t block_seq_end   = 0;
+    hires_log_get_block_range(&block_seq_first, &block_seq_end);
+    ZASSERT_EQ_INT(stats.max_num_blocks, block_seq_end - block_seq_first);
+    zassert_true(block_seq_first > 0);
+
+    hires_log_block_t block = { 0 };
+    zassert_false(hires_log_read_block(block_seq_first - 1U, &block));
+    zassert_true(hires_log_read_block(block_seq_first, &block));
+
+    // The samples of the remaining blocks are contiguous up to the last appended one
+    uint32_t exp_timestamp = block.timestamp_first;
+    for (uint32_t block_seq = block_seq_first; block_seq < block_seq_end; ++block_seq)
+    {
+        zassert_true(hires_log_read_block(block_seq, &block));
+        ZASSERT_EQ_INT(exp_timestamp, block.timestamp_first);
+        hires_log_decoder_t decoder = { 0 };
+        hires_log_decoder_init(&decoder, &block);
+        while (hires_log_decoder_next(&decoder, &sample))
+        {
+            ZASSERT_EQ_INT(exp_timestamp, sample.timestamp);
+            exp_timestamp += 1;
+        }
+    }
+    ZASSERT_EQ_INT(TEST_TIMESTAMP_START + (num_hours * 3600U), exp_timestamp);
+    test_check_sample(&prev, &sample);
+
+    // Search by the timestamp
+    ZASSERT_EQ_INT(block_seq_first, hires_log_find_block(0));
+    ZASSERT_EQ_INT(block_seq_end - 1U, hires_log_find_block(UINT32_MAX));
+    const uint32_t mid_block_seq = block_seq_first + ((block_seq_end - block_seq_first) / 2U);
+    zassert_true(hires_log_read_block(mid_block_seq, &block));
+    ZASSERT_EQ_INT(mid_block_seq, hires_log_find_block(block.timestamp_first));
+    ZASSERT_EQ_INT(mid_block_seq, hires_log_find_block(block.timestamp_first + 1U));
+    ZASSERT_EQ_INT(mid_block_seq - 1U, hires_log_find_block(block.timestamp_first - 1U));
+}
+
+ZTEST_F(test_suite_hires_log, test_density_and_throughput)
+{
+    hires_log_sample_t prev        = test_initial_sample();
+    hires_log_sample_t sample      = { 0 };
+    const uint32_t     num_samples = 3600;
+    for (uint32_t i = 0; i < num_samples; ++i)
+    {
+        test_gen_sample(fixture, TEST_TIMESTAMP_START + i, &prev, &sample);
+        hires_log_append(&sample);
+    }
+    const hires_log_stats_t stats = hires_log_get_stats();
+    ZASSERT_EQ_INT(stats.num_blocks, stats.max_num_blocks);
+
+    const float bytes_per_sample   = (float)stats.num_bytes / (float)stats.num_samples;
+    const float samples_per_block  = (float)stats.num_samples / (float)stats.num_blocks;
+    const float retention_min      = (float)stats.num_samples / 60.0f;
+    const float raw_bytes_per_smpl = (float)sizeof(hires_log_sample_t);
+
+    // Walk over the buffer the same way the NUS request does it
+    uint32_t block_seq_first = 0;
+    uint32_t block_seq_end   = 0;
+    hires_log_get_block_range(&block_seq_first, &block_seq_end);
+    uint32_t num_packets  = 0;
+    uint32_t num_tx_bytes = 0;
+    uint32_t num_decoded  = 0;
+    for (uint32_t block_seq = block_seq_first; block_seq < block_seq_end; ++block_seq)
+    {
+        hires_log_block_t block = { 0 };
+        zassert_true(hires_log_read_block(block_seq, &block));
+        num_packets += 1;
+        num_tx_bytes += TEST_NUS_PACKET_OVERHEAD + block.len;
+        hires_log_decoder_t decoder = { 0 };
+        hires_log_decoder_init(&decoder, &block);
+        while (hires_log_decoder_next(&decoder, &sample))
+        {
+            num_decoded += 1;
+        }
+    }
+    ZASSERT_EQ_INT(stats.num_samples, num_decoded);
+    zassert_true((TEST_NUS_PACKET_OVERHEAD + HIRES_LOG_BLOCK_SIZE) <= 244U);
+
+    printf("hires_log: %.2f bytes per sample (raw %u bytes), %.1f samples per block\n",
+           (double)bytes_per_sample,
+           (unsigned)raw_bytes_per_smpl,
+           (double)samples_per_block);
+    printf("hires_log: %u bytes of RAM keep %.1f minutes of 1-second samples\n",
+           (unsigned)CONFIG_RUUVI_AIR_HIRES_LOG_SIZE,
+           (double)retention_min);
+    printf("hires_log: %u samples are streamed in %u packets (%u bytes), %.1f packets per hour of history\n",
+           (unsigned)num_decoded,
+           (unsigned)num_packets,
+           (unsigned)num_tx_bytes,
+           (double)(3600.0f / samples_per_block));
+
+    // The typical indoor trace must be packed at least 4 times denser than the raw samples,
+    // so that the default budget keeps at least 30 minutes and a packet carries at least 20 seconds of it
+    zassert_true(bytes_per_sample < (raw_bytes_per_smpl / 4.0f));
+    zassert_true(retention_min >= 30.0f);
+    zassert_true(samples_per_block >= 20.0f);
+}
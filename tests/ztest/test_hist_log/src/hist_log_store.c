@@ -0,0 +1,398 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include "hist_log_store.h"
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/sys/crc.h>
+#include "tlog.h"
+#include "sys_utils.h"
+
+LOG_MODULE_REGISTER(hist_log_store, LOG_LEVEL_INF);
+
+#define HIST_LOG_STORE_CRC16_INITIAL_VALUE (0xFFFFU)
+#define HIST_LOG_STORE_ERASED_VALUE        (0xFFU)
+#define HIST_LOG_STORE_NUM_RECORDS_ERASED  (UINT32_MAX)
+#define HIST_LOG_STORE_SEQ_INITIAL         (1U) // Sequence number 0 means "no record", as in hist_log
+// The header is written at once and num_records is written separately, so the write block must not be larger
+#define HIST_LOG_STORE_MAX_WRITE_BLOCK_SIZE (sizeof(uint32_t))
+
+#define HIST_LOG_STORE_SLOT_OFS_TIMESTAMP (0U)
+#define HIST_LOG_STORE_SLOT_OFS_DATA      (HIST_LOG_STORE_SLOT_OFS_TIMESTAMP + sizeof(uint32_t))
+#define HIST_LOG_STORE_SLOT_OFS_CRC       (HIST_LOG_STORE_SLOT_OFS_DATA + sizeof(hist_log_record_data_t))
+
+_Static_assert(
+    (HIST_LOG_STORE_SLOT_SIZE % HIST_LOG_STORE_MAX_WRITE_BLOCK_SIZE) == 0,
+    "The slots must be aligned to the write block size");
+_Static_assert(
+    (sizeof(hist_log_store_sector_hdr_t) % HIST_LOG_STORE_MAX_WRITE_BLOCK_SIZE) == 0,
+    "The sector header must be aligned to the write block size");
+
+static off_t
+hist_log_store_get_sector_off(const hist_log_store_t* const p_store, const uint32_t sector_idx)
+{
+    return p_store->offset + (off_t)(sector_idx * HIST_LOG_STORE_SECTOR_SIZE);
+}
+
+static off_t
+hist_log_store_get_slot_off(const hist_log_store_t* const p_store, const uint32_t sector_idx, const uint32_t slot_idx)
+{
+    return hist_log_store_get_sector_off(p_store, sector_idx) + (off_t)sizeof(hist_log_store_sector_hdr_t)
+           + (off_t)(slot_idx * HIST_LOG_STORE_SLOT_SIZE);
+}
+
+static uint32_t
+hist_log_store_next_sector(const hist_log_store_t* const p_store, const uint32_t sector_idx)
+{
+    return (sector_idx + 1U) % p_store->num_sectors;
+}
+
+static uint32_t
+hist_log_store_prev_sector(const hist_log_store_t* const p_store, const uint32_t sector_idx)
+{
+    return (sector_idx + p_store->num_sectors - 1U) % p_store->num_sectors;
+}
+
+static bool
+hist_log_store_is_erased(const uint8_t* const p_buf, const size_t len)
+{
+    for (size_t i = 0; i < len; ++i)
+    {
+        if (HIST_LOG_STORE_ERASED_VALUE != p_buf[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @return false if the header can't be read or it is not valid (e.g. the sector is erased).
+ */
+static bool
+hist_log_store_read_hdr(
+    const hist_log_store_t* const      p_store,
+    const uint32_t                     sector_idx,
+    hist_log_store_sector_hdr_t* const p_hdr)
+{
+    const int rc = flash_area_read(
+        p_store->p_fa,
+        hist_log_store_get_sector_off(p_store, sector_idx),
+        p_hdr,
+        sizeof(*p_hdr));
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_read failed, sector %u, rc=%d", (unsigned)sector_idx, rc);
+        return false;
+    }
+    return (HIST_LOG_STORE_MAGIC == p_hdr->magic) && (HIST_LOG_STORE_SLOT_SIZE == p_hdr->slot_size)
+           && (0 != p_hdr->seq_first);
+}
+
+/**
+ * @brief Find the number of the used slots in the sector by the binary search.
+ * @details The slots are written in order, so all the slots after the first erased one are also erased.
+ * The slot which was partially written on power loss is not erased, so it is counted as used.
+ */
+static uint32_t
+hist_log_store_find_num_used(const hist_log_store_t* const p_store, const uint32_t sector_idx)
+{
+    uint32_t lo = 0;
+    uint32_t hi = HIST_LOG_STORE_SLOTS_PER_SECTOR;
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + ((hi - lo) / 2U);
+        uint8_t        slot[HIST_LOG_STORE_SLOT_SIZE];
+        const int      rc = flash_area_read(
+            p_store->p_fa,
+            hist_log_store_get_slot_off(p_store, sector_idx, mid),
+            slot,
+            sizeof(slot));
+        if ((0 == rc) && hist_log_store_is_erased(slot, sizeof(slot)))
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = mid + 1U;
+        }
+    }
+    return lo;
+}
+
+static void
+hist_log_store_reset(hist_log_store_t* const p_store)
+{
+    p_store->sector_oldest = 0;
+    p_store->sector_active = 0;
+    p_store->num_used      = 0;
+    p_store->is_empty      = true;
+    p_store->seq_first     = HIST_LOG_STORE_SEQ_INITIAL;
+    p_store->seq_next      = HIST_LOG_STORE_SEQ_INITIAL;
+}
+
+bool
+hist_log_store_init(
+    hist_log_store_t* const p_store,
+    const uint8_t           flash_area_id,
+    const off_t             offset,
+    const uint32_t          num_sectors)
+{
+    memset(p_store, 0, sizeof(*p_store));
+    if ((num_sectors < 2U) || (0 != (offset % HIST_LOG_STORE_SECTOR_SIZE)))
+    {
+        TLOG_ERR("Invalid layout: offset=0x%x, num_sectors=%u", (unsigned)offset, (unsigned)num_sectors);
+        return false;
+    }
+    const int rc = flash_area_open(flash_area_id, &p_store->p_fa);
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_open failed, rc=%d", rc);
+        return false;
+    }
+    if (flash_area_align(p_store->p_fa) > HIST_LOG_STORE_MAX_WRITE_BLOCK_SIZE)
+    {
+        TLOG_ERR("Write block size %u is not supported", (unsigned)flash_area_align(p_store->p_fa));
+        return false;
+    }
+    p_store->offset      = offset;
+    p_store->num_sectors = num_sectors;
+    hist_log_store_reset(p_store);
+
+    // The active sector is the one with the newest records
+    hist_log_store_sector_hdr_t hdr_active = { 0 };
+    for (uint32_t i = 0; i < num_sectors; ++i)
+    {
+        hist_log_store_sector_hdr_t hdr = { 0 };
+        if (hist_log_store_read_hdr(p_store, i, &hdr) && (p_store->is_empty || (hdr.seq_first > hdr_active.seq_first)))
+        {
+            p_store->is_empty      = false;
+            p_store->sector_active = i;
+            hdr_active             = hdr;
+        }
+    }
+    if (p_store->is_empty)
+    {
+        TLOG_INF("Store is empty");
+        return true;
+    }
+
+    // The sectors before the active one contain the consecutive records, every one of them is full
+    hist_log_store_sector_hdr_t hdr_oldest = hdr_active;
+    p_store->sector_oldest                 = p_store->sector_active;
+    while (true)
+    {
+        const uint32_t              sector_prev = hist_log_store_prev_sector(p_store, p_store->sector_oldest);
+        hist_log_store_sector_hdr_t hdr_prev    = { 0 };
+        if ((sector_prev == p_store->sector_active) || (!hist_log_store_read_hdr(p_store, sector_prev, &hdr_prev))
+            || ((hdr_prev.seq_first + HIST_LOG_STORE_SLOTS_PER_SECTOR) != hdr_oldest.seq_first))
+        {
+            break;
+        }
+        p_store->sector_oldest = sector_prev;
+        hdr_oldest             = hdr_prev;
+    }
+
+    if (HIST_LOG_STORE_NUM_RECORDS_ERASED != hdr_active.num_records)
+    {
+        p_store->num_used = HIST_LOG_STORE_SLOTS_PER_SECTOR;
+    }
+    else
+    {
+        p_store->num_used = hist_log_store_find_num_used(p_store, p_store->sector_active);
+    }
+    p_store->seq_first = hdr_oldest.seq_first;
+    p_store->seq_next  = hdr_active.seq_first + p_store->num_used;
+    TLOG_INF(
+        "Store: sectors %u..%u, records %u..%u",
+        (unsigned)p_store->sector_oldest,
+        (unsigned)p_store->sector_active,
+        (unsigned)p_store->seq_first,
+        (unsigned)(p_store->seq_next - 1U));
+    return true;
+}
+
+bool
+hist_log_store_erase(hist_log_store_t* const p_store)
+{
+    hist_log_store_reset(p_store);
+    const int rc = flash_area_erase(
+        p_store->p_fa,
+        p_store->offset,
+        (size_t)p_store->num_sectors * HIST_LOG_STORE_SECTOR_SIZE);
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_erase failed, rc=%d", rc);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Erase the next sector and write its header, the oldest sector is dropped if the ring is full.
+ */
+static bool
+hist_log_store_open_sector(hist_log_store_t* const p_store, const uint32_t timestamp)
+{
+    uint32_t sector_idx = p_store->sector_active;
+    if (!p_store->is_empty)
+    {
+        sector_idx = hist_log_store_next_sector(p_store, p_store->sector_active);
+        if (sector_idx == p_store->sector_oldest)
+        {
+            p_store->sector_oldest = hist_log_store_next_sector(p_store, p_store->sector_oldest);
+            p_store->seq_first += HIST_LOG_STORE_SLOTS_PER_SECTOR;
+        }
+    }
+    const off_t off = hist_log_store_get_sector_off(p_store, sector_idx);
+    int         rc  = flash_area_erase(p_store->p_fa, off, HIST_LOG_STORE_SECTOR_SIZE);
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_erase failed, sector %u, rc=%d", (unsigned)sector_idx, rc);
+        return false;
+    }
+    const hist_log_store_sector_hdr_t hdr = {
+        .magic          = HIST_LOG_STORE_MAGIC,
+        .slot_size      = HIST_LOG_STORE_SLOT_SIZE,
+        .seq_first      = p_store->seq_next,
+        .timestamp_base = timestamp,
+        .num_records    = HIST_LOG_STORE_NUM_RECORDS_ERASED,
+    };
+    rc = flash_area_write(p_store->p_fa, off, &hdr, sizeof(hdr));
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_write failed, sector %u, rc=%d", (unsigned)sector_idx, rc);
+        return false;
+    }
+    if (p_store->is_empty)
+    {
+        p_store->seq_first = p_store->seq_next;
+        p_store->is_empty  = false;
+    }
+    p_store->sector_active = sector_idx;
+    p_store->num_used      = 0;
+    return true;
+}
+
+static void
+hist_log_store_close_sector(const hist_log_store_t* const p_store)
+{
+    const uint32_t num_records = HIST_LOG_STORE_SLOTS_PER_SECTOR;
+    const int      rc          = flash_area_write(
+        p_store->p_fa,
+        hist_log_store_get_sector_off(p_store, p_store->sector_active)
+            + (off_t)offsetof(hist_log_store_sector_hdr_t, num_records),
+        &num_records,
+        sizeof(num_records));
+    if (0 != rc)
+    {
+        // The number of records is found by the binary search on the next boot
+        TLOG_WRN("flash_area_write failed, sector %u, rc=%d", (unsigned)p_store->sector_active, rc);
+    }
+}
+
+bool
+hist_log_store_append(
+    hist_log_store_t* const             p_store,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data)
+{
+    if (UINT32_MAX == timestamp)
+    {
+        return false;
+    }
+    if ((p_store->is_empty || (HIST_LOG_STORE_SLOTS_PER_SECTOR == p_store->num_used))
+        && (!hist_log_store_open_sector(p_store, timestamp)))
+    {
+        return false;
+    }
+    uint8_t slot[HIST_LOG_STORE_SLOT_SIZE];
+    memcpy(&slot[HIST_LOG_STORE_SLOT_OFS_TIMESTAMP], &timestamp, sizeof(timestamp));
+    memcpy(&slot[HIST_LOG_STORE_SLOT_OFS_DATA], p_data, sizeof(*p_data));
+    const uint16_t crc16 = crc16_ccitt(HIST_LOG_STORE_CRC16_INITIAL_VALUE, slot, HIST_LOG_STORE_SLOT_OFS_CRC);
+    slot[HIST_LOG_STORE_SLOT_OFS_CRC]      = crc16 & BYTE_MASK;
+    slot[HIST_LOG_STORE_SLOT_OFS_CRC + 1U] = (crc16 >> BYTE_SHIFT_1) & BYTE_MASK;
+
+    const int rc = flash_area_write(
+        p_store->p_fa,
+        hist_log_store_get_slot_off(p_store, p_store->sector_active, p_store->num_used),
+        slot,
+        sizeof(slot));
+    // The slot is used even if writing failed, it may be partially written and can't be written again
+    p_store->num_used += 1;
+    p_store->seq_next += 1;
+    if (HIST_LOG_STORE_SLOTS_PER_SECTOR == p_store->num_used)
+    {
+        hist_log_store_close_sector(p_store);
+    }
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_write failed, seq %u, rc=%d", (unsigned)(p_store->seq_next - 1U), rc);
+        return false;
+    }
+    return true;
+}
+
+hist_log_store_status_e
+hist_log_store_read(
+    const hist_log_store_t* const p_store,
+    const uint32_t                seq,
+    uint32_t* const               p_timestamp,
+    hist_log_record_data_t* const p_data)
+{
+    if ((seq < p_store->seq_first) || (seq >= p_store->seq_next))
+    {
+        return HIST_LOG_STORE_STATUS_NOT_FOUND;
+    }
+    const uint32_t idx        = seq - p_store->seq_first;
+    const uint32_t sector_idx = (p_store->sector_oldest + (idx / HIST_LOG_STORE_SLOTS_PER_SECTOR))
+                                % p_store->num_sectors;
+    uint8_t   slot[HIST_LOG_STORE_SLOT_SIZE];
+    const int rc = flash_area_read(
+        p_store->p_fa,
+        hist_log_store_get_slot_off(p_store, sector_idx, idx % HIST_LOG_STORE_SLOTS_PER_SECTOR),
+        slot,
+        sizeof(slot));
+    if (0 != rc)
+    {
+        TLOG_ERR("flash_area_read failed, seq %u, rc=%d", (unsigned)seq, rc);
+        return HIST_LOG_STORE_STATUS_ERROR;
+    }
+    // CRC of the data followed by its CRC is 0
+    if (0 != crc16_ccitt(HIST_LOG_STORE_CRC16_INITIAL_VALUE, slot, sizeof(slot)))
+    {
+        return HIST_LOG_STORE_STATUS_CORRUPTED;
+    }
+    memcpy(p_timestamp, &slot[HIST_LOG_STORE_SLOT_OFS_TIMESTAMP], sizeof(*p_timestamp));
+    memcpy(p_data, &slot[HIST_LOG_STORE_SLOT_OFS_DATA], sizeof(*p_data));
+    return HIST_LOG_STORE_STATUS_OK;
+}
+
+uint32_t
+hist_log_store_find(const hist_log_store_t* const p_store, const uint32_t timestamp_start)
+{
+    uint32_t lo = p_store->seq_first;
+    uint32_t hi = p_store->seq_next;
+    while (lo < hi)
+    {
+        const uint32_t mid = lo + ((hi - lo) / 2U);
+        // The corrupted records are skipped, the search continues with the next valid record in the range
+        uint32_t               seq       = mid;
+        uint32_t               timestamp = 0;
+        hist_log_record_data_t data      = { 0 };
+        while ((seq < hi) && (HIST_LOG_STORE_STATUS_OK != hist_log_store_read(p_store, seq, &timestamp, &data)))
+        {
+            seq += 1;
+        }
+        if ((seq == hi) || (timestamp >= timestamp_start))
+        {
+            hi = mid;
+        }
+        else
+        {
+            lo = seq + 1U;
+        }
+    }
+    return lo;
+}
@@ -0,0 +1,136 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ * @brief Prototype of a fixed-slot storage of the history records.
+ * @details It is benchmarked against hist_log by test_hist_log.c and is not used by the firmware:
+ * the fixed slots keep about half as many records per sector as the delta-encoded batches of hist_log.
+ */
+
+#ifndef HIST_LOG_STORE_H
+#define HIST_LOG_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <zephyr/storage/flash_map.h>
+#include "hist_log.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIST_LOG_STORE_MAGIC (0x5253U) // "RS"
+
+#define HIST_LOG_STORE_SECTOR_SIZE (4U * 1024U)
+
+/**
+ * @brief Header at the beginning of every sector.
+ * @details The header is written when the sector is opened, except num_records, which stays erased
+ * until the sector is full. The record with sequence number seq_first + i is stored in slot i,
+ * so the record is found by its sequence number without reading flash.
+ */
+typedef struct hist_log_store_sector_hdr_t
+{
+    uint16_t magic;          //!< HIST_LOG_STORE_MAGIC
+    uint16_t slot_size;      //!< HIST_LOG_STORE_SLOT_SIZE, it is changed when the format of the slots is changed
+    uint32_t seq_first;      //!< Sequence number of the record in the first slot
+    uint32_t timestamp_base; //!< Timestamp of the record in the first slot
+    uint32_t num_records;    //!< Number of the records, it is written when the sector is closed
+} hist_log_store_sector_hdr_t;
+
+// Timestamp, record data and CRC16 of both
+#define HIST_LOG_STORE_SLOT_SIZE (sizeof(uint32_t) + sizeof(hist_log_record_data_t) + sizeof(uint16_t))
+#define HIST_LOG_STORE_SLOTS_PER_SECTOR \
+    ((HIST_LOG_STORE_SECTOR_SIZE - sizeof(hist_log_store_sector_hdr_t)) / HIST_LOG_STORE_SLOT_SIZE)
+
+typedef enum hist_log_store_status_e
+{
+    HIST_LOG_STORE_STATUS_OK        = 0,
+    HIST_LOG_STORE_STATUS_NOT_FOUND = 1, //!< The record was rotated out or it is not written yet
+    HIST_LOG_STORE_STATUS_CORRUPTED = 2, //!< CRC mismatch, e.g. the power was lost while the record was written
+    HIST_LOG_STORE_STATUS_ERROR     = 3, //!< Flash read error
+} hist_log_store_status_e;
+
+/**
+ * @brief Log of fixed-size records in a ring of flash sectors.
+ * @details The oldest sector is erased when the ring is full and a new sector is needed (erase-on-rotate).
+ * The store is not thread-safe, the caller must serialize the access.
+ */
+typedef struct hist_log_store_t
+{
+    const struct flash_area* p_fa;
+    off_t                    offset;        //!< Offset of the first sector in the flash area
+    uint32_t                 num_sectors;   //!< Number of sectors in the ring
+    uint32_t                 sector_oldest; //!< Index of the oldest sector with records
+    uint32_t                 sector_active; //!< Index of the sector which is being filled
+    uint32_t                 num_used;      //!< Number of the used slots in the active sector
+    bool                     is_empty;      //!< No sector is opened yet
+    uint32_t                 seq_first;     //!< Sequence number of the oldest record
+    uint32_t                 seq_next;      //!< Sequence number of the next record
+} hist_log_store_t;
+
+/**
+ * @brief Open the store and find the oldest and the newest records.
+ * @details Only the sector headers are read, the end of the active sector is found by the binary search
+ * over its slots. The sectors without a valid header are treated as erased.
+ * @param flash_area_id ID of the flash area.
+ * @param offset Offset of the first sector in the flash area, it must be aligned to the sector size.
+ * @param num_sectors Number of sectors, at least 2.
+ * @return false if the flash area can't be opened or read.
+ */
+bool
+hist_log_store_init(
+    hist_log_store_t* const p_store,
+    const uint8_t           flash_area_id,
+    const off_t             offset,
+    const uint32_t          num_sectors);
+
+/**
+ * @brief Erase all the sectors of the store.
+ */
+bool
+hist_log_store_erase(hist_log_store_t* const p_store);
+
+/**
+ * @brief Append the record, if the ring is full, the oldest sector is erased.
+ * @param timestamp Timestamp of the record, it must not decrease, UINT32_MAX is not allowed.
+ */
+bool
+hist_log_store_append(
+    hist_log_store_t* const             p_store,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data);
+
+/**
+ * @brief Read the record by its sequence number with a single flash read.
+ */
+hist_log_store_status_e
+hist_log_store_read(
+    const hist_log_store_t* const p_store,
+    const uint32_t                seq,
+    uint32_t* const               p_timestamp,
+    hist_log_record_data_t* const p_data);
+
+/**
+ * @brief Find the oldest record with the timestamp >= timestamp_start by the binary search.
+ * @return Sequence number of the record, or seq_next if all the records are older.
+ * It may be the sequence number of a corrupted record, which precedes the found one.
+ */
+uint32_t
+hist_log_store_find(const hist_log_store_t* const p_store, const uint32_t timestamp_start);
+
+static inline uint32_t
+hist_log_store_get_seq_first(const hist_log_store_t* const p_store)
+{
+    return p_store->seq_first;
+}
+
+static inline uint32_t
+hist_log_store_get_seq_next(const hist_log_store_t* const p_store)
+{
+    return p_store->seq_next;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HIST_LOG_STORE_H
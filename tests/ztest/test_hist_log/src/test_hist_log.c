@@ -0,0 +1,2151 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/settings/settings.h>
+#include "hist_log.h"
+#include "hist_log_rollup.h"
+#include "hist_log_store.h"
+#include "ruuvi_endpoint_e1.h"
+#include "zassert.h"
+
+#define TEST_HIST_LOG_BASE_TIMESTAMP   (1735689600U) // 2025-01-01 00:00:00 UTC
+#define TEST_HIST_LOG_MIN_UNIX_TIME    (1577836800U) // 2020-01-01 00:00:00 UTC, the clock restarts from it
+#define TEST_HIST_LOG_PERIOD_SECONDS   (5U * 60U)
+#define TEST_HIST_LOG_ONE_HOUR         (60U * 60U)
+#define TEST_HIST_LOG_ONE_DAY          (24U * TEST_HIST_LOG_ONE_HOUR)
+#define TEST_HIST_LOG_NUM_FILL_RECORDS (30000U) // More than fits into the 192 KiB partition
+
+#define TEST_HIST_LOG_NUM_SECTORS (48U)
+// The 5-minute records are stored in the sectors which are not used by the rollup tiers
+#define TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS \
+    (TEST_HIST_LOG_NUM_SECTORS - CONFIG_RUUVI_AIR_HIST_LOG_TIER_1HOUR_NUM_SECTORS \
+     - CONFIG_RUUVI_AIR_HIST_LOG_TIER_1DAY_NUM_SECTORS)
+// Format v1: 40-byte record + 1-byte length + 1-byte end marker per FCB entry, 8-byte FCB sector header
+#define TEST_HIST_LOG_V1_RECORDS_PER_SECTOR ((4096U - 8U) / (40U + 2U))
+// Capacity of format v1 in the same number of sectors, one sector is kept erased by FCB (f_scratch_cnt=1)
+#define TEST_HIST_LOG_V1_MAX_NUM_RECORDS \
+    (TEST_HIST_LOG_V1_RECORDS_PER_SECTOR * (TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS - 1U))
+
+#define TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS (CONFIG_RUUVI_AIR_HIST_LOG_WRITE_BACK_NUM_RECORDS)
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD)
+#define TEST_HIST_LOG_READ_AHEAD_SIZE (CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD_SIZE)
+#else
+#define TEST_HIST_LOG_READ_AHEAD_SIZE (1U)
+#endif
+// FCB writes the length field, the data and the end marker of every entry
+#define TEST_HIST_LOG_FCB_PROGRAM_OPS_PER_ENTRY (3U)
+
+extern int
+__real_flash_area_write(const struct flash_area* p_fa, off_t off, const void* p_src, size_t len);
+
+extern int
+__real_flash_area_read(const struct flash_area* p_fa, off_t off, void* p_dst, size_t len);
+
+extern void*
+__real_flash_simulator_get_memory(const struct device* p_dev, size_t* p_mock_size);
+
+static uint32_t g_test_hist_log_flash_write_cnt;
+static uint32_t g_test_hist_log_flash_read_cnt;
+static uint32_t g_test_hist_log_flash_read_bytes;
+static bool     g_test_hist_log_is_flash_unmapped;
+
+int
+__wrap_flash_area_write(const struct flash_area* p_fa, off_t off, const void* p_src, size_t len)
+{
+    g_test_hist_log_flash_write_cnt += 1;
+    return __real_flash_area_write(p_fa, off, p_src, len);
+}
+
+int
+__wrap_flash_area_read(const struct flash_area* p_fa, off_t off, void* p_dst, size_t len)
+{
+    g_test_hist_log_flash_read_cnt += 1;
+    g_test_hist_log_flash_read_bytes += len;
+    return __real_flash_area_read(p_fa, off, p_dst, len);
+}
+
+// The reads from the memory-mapped flash are not counted, so the flash can be hidden from hist_log
+void*
+__wrap_flash_simulator_get_memory(const struct device* p_dev, size_t* p_mock_size)
+{
+    if (g_test_hist_log_is_flash_unmapped)
+    {
+        *p_mock_size = 0;
+        return NULL;
+    }
+    return __real_flash_simulator_get_memory(p_dev, p_mock_size);
+}
+
+static void*
+test_setup(void);
+
+static void
+test_suite_before(void* f);
+
+static void
+test_suite_after(void* f);
+
+static void
+test_teardown(void* f);
+
+ZTEST_SUITE(test_suite_hist_log, NULL, &test_setup, &test_suite_before, &test_suite_after, &test_teardown);
+
+typedef struct test_suite_hist_log_fixture
+{
+    uint32_t timestamp_last;
+} test_suite_hist_log_fixture_t;
+
+typedef struct test_hist_log_query_t
+{
+    uint32_t timestamp_start;
+    uint32_t num_records;
+    uint32_t timestamp_first;
+    uint32_t timestamp_prev;
+    bool     flag_wrong_order;
+    bool     flag_too_old;
+    uint32_t time_us;
+} test_hist_log_query_t;
+
+static void*
+test_setup(void)
+{
+    test_suite_hist_log_fixture_t* p_fixture = calloc(1, sizeof(*p_fixture));
+    assert(NULL != p_fixture);
+    // The checkpoint of the sector directory is saved to settings
+    const int rc = settings_subsys_init();
+    assert(0 == rc);
+    return p_fixture;
+}
+
+static void
+test_suite_before(void* f)
+{
+    test_suite_hist_log_fixture_t* p_fixture = f;
+    memset(p_fixture, 0, sizeof(*p_fixture));
+    g_test_hist_log_is_flash_unmapped = false;
+    // Every test starts with the empty storage
+    zassert_true(hist_log_erase());
+}
+
+static void
+test_suite_after(void* f)
+{
+}
+
+static void
+test_teardown(void* f)
+{
+    if (NULL != f)
+    {
+        free(f);
+    }
+}
+
+/**
+ * @brief Read hist_storage via flash_area_read(), so that the flash reads are counted.
+ */
+static void
+test_hist_log_unmap_flash(void)
+{
+    zassert_true(hist_log_flush());
+    g_test_hist_log_is_flash_unmapped = true;
+    zassert_true(hist_log_init(true));
+}
+
+static uint32_t g_test_hist_log_rand_state;
+
+static float
+test_hist_log_rand_noise(const float amplitude)
+{
+    // Deterministic LCG, so that the results are the same on all platforms
+    g_test_hist_log_rand_state = (g_test_hist_log_rand_state * 1664525U) + 1013904223U;
+    return amplitude * (((float)(g_test_hist_log_rand_state >> 8U) / (float)(1U << 24U)) - 0.5f);
+}
+
+/**
+ * @brief Generate a realistic 5-minute average of the indoor measurements with daily cycles.
+ */
+static hist_log_record_data_t
+test_hist_log_gen_record_data(const uint32_t idx)
+{
+    if (0 == idx)
+    {
+        g_test_hist_log_rand_state = 1;
+    }
+    const uint32_t time_of_day = (idx * TEST_HIST_LOG_PERIOD_SECONDS) % TEST_HIST_LOG_ONE_DAY;
+    const float    day_phase   = (2.0f * (float)M_PI * (float)time_of_day) / (float)TEST_HIST_LOG_ONE_DAY;
+    const float    daylight    = fmaxf(0.0f, -cosf(day_phase));
+    const float    occupancy   = fmaxf(0.0f, sinf(day_phase - 0.5f));
+
+    re_e1_data_t e1_data      = re_e1_data_invalid(idx * TEST_HIST_LOG_PERIOD_SECONDS, 0);
+    e1_data.temperature_c     = 21.5f + (1.5f * occupancy) - (1.0f * daylight) + test_hist_log_rand_noise(0.1f);
+    e1_data.humidity_rh       = 38.0f + (4.0f * occupancy) + test_hist_log_rand_noise(0.4f);
+    e1_data.pressure_pa       = 100800.0f + (300.0f * sinf(day_phase / 7.0f)) + test_hist_log_rand_noise(4.0f);
+    e1_data.pm1p0_ppm         = 2.0f + occupancy + test_hist_log_rand_noise(0.4f);
+    e1_data.pm2p5_ppm         = 2.8f + (1.5f * occupancy) + test_hist_log_rand_noise(0.6f);
+    e1_data.pm4p0_ppm         = 3.2f + (1.6f * occupancy) + test_hist_log_rand_noise(0.6f);
+    e1_data.pm10p0_ppm        = 3.4f + (1.7f * occupancy) + test_hist_log_rand_noise(0.6f);
+    e1_data.co2               = 450.0f + (600.0f * occupancy) + test_hist_log_rand_noise(10.0f);
+    e1_data.voc               = 100.0f + (40.0f * occupancy) + test_hist_log_rand_noise(2.0f);
+    e1_data.nox               = 1.0f;
+    e1_data.luminosity        = 5.0f + (300.0f * daylight);
+    e1_data.sound_inst_dba    = 32.0f + (12.0f * occupancy) + test_hist_log_rand_noise(4.0f);
+    e1_data.sound_avg_dba     = 34.0f + (10.0f * occupancy) + test_hist_log_rand_noise(1.0f);
+    e1_data.sound_peak_spl_db = 50.0f + (15.0f * occupancy) + test_hist_log_rand_noise(6.0f);
+
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, &e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+static uint32_t
+test_hist_log_fill(const uint32_t timestamp_base, const uint32_t num_records)
+{
+    uint32_t timestamp = timestamp_base;
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        timestamp                         = timestamp_base + (i * TEST_HIST_LOG_PERIOD_SECONDS);
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(i);
+        zassert_true(hist_log_append_record(timestamp, &data, false));
+    }
+    return timestamp;
+}
+
+static bool
+test_hist_log_query_cb(const uint32_t timestamp, const hist_log_record_data_t* const p_data, void* p_user_data)
+{
+    test_hist_log_query_t* const p_query = p_user_data;
+    if (0 == p_query->num_records)
+    {
+        p_query->timestamp_first = timestamp;
+    }
+    else if (timestamp < p_query->timestamp_prev)
+    {
+        p_query->flag_wrong_order = true;
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+    if (timestamp < p_query->timestamp_start)
+    {
+        p_query->flag_too_old = true;
+    }
+    p_query->timestamp_prev = timestamp;
+    p_query->num_records += 1;
+    return true;
+}
+
+static test_hist_log_query_t
+test_hist_log_query(const uint32_t timestamp_start)
+{
+    test_hist_log_query_t query = {
+        .timestamp_start = timestamp_start,
+    };
+    const int64_t ticks_start = k_uptime_ticks();
+    zassert_true(hist_log_read_records(&test_hist_log_query_cb, &query, timestamp_start));
+    query.time_us = (uint32_t)k_ticks_to_us_near64(k_uptime_ticks() - ticks_start);
+    return query;
+}
+
+ZTEST_F(test_suite_hist_log, test_query_last_hour_vs_full_scan)
+{
+    test_hist_log_unmap_flash();
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    const test_hist_log_query_t query_full = test_hist_log_query(0);
+    zassert_true(query_full.num_records > TEST_HIST_LOG_V1_MAX_NUM_RECORDS);
+    zassert_true(query_full.num_records < TEST_HIST_LOG_NUM_FILL_RECORDS);
+    zassert_false(query_full.flag_wrong_order);
+    ZASSERT_EQ_INT(timestamp_last, query_full.timestamp_prev);
+
+    const test_hist_log_query_t query_hour = test_hist_log_query(timestamp_last - TEST_HIST_LOG_ONE_HOUR);
+    ZASSERT_EQ_INT((TEST_HIST_LOG_ONE_HOUR / TEST_HIST_LOG_PERIOD_SECONDS) + 1, query_hour.num_records);
+    ZASSERT_EQ_INT(timestamp_last - TEST_HIST_LOG_ONE_HOUR, query_hour.timestamp_first);
+    zassert_false(query_hour.flag_wrong_order);
+    zassert_false(query_hour.flag_too_old);
+
+    printf(
+        "hist_log benchmark: full scan: %u records, %u us; last hour: %u records, %u us\n",
+        query_full.num_records,
+        query_full.time_us,
+        query_hour.num_records,
+        query_hour.time_us);
+
+    // The last hour is in the last one or two sectors, so only a small fraction of the partition is read.
+    zassert_true((query_hour.time_us * 10) < query_full.time_us);
+}
+
+ZTEST_F(test_suite_hist_log, test_read_ahead_full_scan)
+{
+    test_hist_log_unmap_flash();
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    g_test_hist_log_flash_read_cnt   = 0;
+    g_test_hist_log_flash_read_bytes = 0;
+    const test_hist_log_query_t query_full = test_hist_log_query(0);
+    printf(
+        "hist_log read-ahead benchmark: read-ahead buffer: %u bytes, full scan: %u records, %u flash reads, "
+        "%u bytes, %u us\n",
+        (unsigned)(IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD) ? TEST_HIST_LOG_READ_AHEAD_SIZE : 0),
+        (unsigned)query_full.num_records,
+        (unsigned)g_test_hist_log_flash_read_cnt,
+        (unsigned)g_test_hist_log_flash_read_bytes,
+        (unsigned)query_full.time_us);
+
+    if (IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_READ_AHEAD))
+    {
+        // Every chunk is read once, the entries are not split between chunks, so there can be one more chunk
+        // per sector, and the chunk of the active sector is reloaded to check for new entries.
+        const uint32_t num_chunks = (TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS * 4096U) / TEST_HIST_LOG_READ_AHEAD_SIZE;
+        zassert_true(g_test_hist_log_flash_read_cnt <= (num_chunks + TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS + 2U));
+    }
+    else
+    {
+        // The length field, the data and the end marker of every entry are read separately
+        zassert_true(g_test_hist_log_flash_read_cnt > (3U * TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS));
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_mapped_read_full_scan)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_MAPPED_READ);
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    g_test_hist_log_flash_read_cnt           = 0;
+    const test_hist_log_query_t query_mapped = test_hist_log_query(0);
+    const uint32_t              num_reads    = g_test_hist_log_flash_read_cnt;
+
+    test_hist_log_unmap_flash();
+    g_test_hist_log_flash_read_cnt             = 0;
+    g_test_hist_log_flash_read_bytes           = 0;
+    const test_hist_log_query_t query_buffered = test_hist_log_query(0);
+    printf(
+        "hist_log mapped-read benchmark: full scan: %u records, mapped flash: %u flash reads, %u us; "
+        "flash_area_read: %u flash reads, %u bytes, %u us\n",
+        (unsigned)query_mapped.num_records,
+        (unsigned)num_reads,
+        (unsigned)query_mapped.time_us,
+        (unsigned)g_test_hist_log_flash_read_cnt,
+        (unsigned)g_test_hist_log_flash_read_bytes,
+        (unsigned)query_buffered.time_us);
+
+    ZASSERT_EQ_INT(query_buffered.num_records, query_mapped.num_records);
+    ZASSERT_EQ_INT(query_buffered.timestamp_first, query_mapped.timestamp_first);
+    ZASSERT_EQ_INT(query_buffered.timestamp_prev, query_mapped.timestamp_prev);
+    zassert_false(query_mapped.flag_wrong_order);
+    // Only fcb_getnext() reads flash to check if the write-back buffer was written after the last entry
+    zassert_true((num_reads * 10U) < g_test_hist_log_flash_read_cnt);
+    zassert_true(query_mapped.time_us < query_buffered.time_us);
+}
+
+ZTEST_F(test_suite_hist_log, test_query_random_start_time)
+{
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    const test_hist_log_query_t query_full = test_hist_log_query(0);
+    const uint32_t              ts_oldest  = query_full.timestamp_first;
+
+    for (uint32_t ts_start = ts_oldest - TEST_HIST_LOG_PERIOD_SECONDS; ts_start <= (timestamp_last + 1);
+         ts_start += (37U * TEST_HIST_LOG_PERIOD_SECONDS) + 1)
+    {
+        const uint32_t expected_num_records = (ts_start <= ts_oldest)
+                                                  ? query_full.num_records
+                                                  : (((timestamp_last - ts_start) / TEST_HIST_LOG_PERIOD_SECONDS) + 1);
+        const test_hist_log_query_t query   = test_hist_log_query(ts_start);
+        zassert_false(query.flag_too_old);
+        zassert_false(query.flag_wrong_order);
+        zassert_equal(
+            (ts_start > timestamp_last) ? 0 : expected_num_records,
+            query.num_records,
+            "ts_start=%u, expected=%u, actual=%u",
+            ts_start,
+            expected_num_records,
+            query.num_records);
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_query_after_reinit)
+{
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    const test_hist_log_query_t query_full1 = test_hist_log_query(0);
+    const test_hist_log_query_t query_hour1 = test_hist_log_query(timestamp_last - TEST_HIST_LOG_ONE_HOUR);
+
+    // Reboot: the buffered records are written to flash,
+    // RTC is valid - the sector directory is rebuilt from the flash
+    zassert_true(hist_log_flush());
+    zassert_true(hist_log_init(true));
+
+    const test_hist_log_query_t query_full2 = test_hist_log_query(0);
+    const test_hist_log_query_t query_hour2 = test_hist_log_query(timestamp_last - TEST_HIST_LOG_ONE_HOUR);
+
+    ZASSERT_EQ_INT(query_full1.num_records, query_full2.num_records);
+    ZASSERT_EQ_INT(query_hour1.num_records, query_hour2.num_records);
+    ZASSERT_EQ_INT(query_hour1.timestamp_first, query_hour2.timestamp_first);
+}
+
+ZTEST_F(test_suite_hist_log, test_query_clock_set_back)
+{
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+
+    // The clock was set back by one day: the records are out of order, so the sector directory can't be used
+    const uint32_t timestamp_new_base = timestamp_last - (24U * TEST_HIST_LOG_ONE_HOUR);
+    const uint32_t timestamp_new_last = test_hist_log_fill(timestamp_new_base, 100);
+
+    const test_hist_log_query_t query = test_hist_log_query(timestamp_new_base);
+    zassert_false(query.flag_too_old);
+    const uint32_t num_records_before_clock_change = ((timestamp_last - timestamp_new_base)
+                                                      / TEST_HIST_LOG_PERIOD_SECONDS)
+                                                     + 1;
+    ZASSERT_EQ_INT(num_records_before_clock_change + 100, query.num_records);
+    ZASSERT_EQ_INT(timestamp_new_last, query.timestamp_prev);
+}
+
+typedef struct test_hist_log_verify_ctx_t
+{
+    uint32_t timestamp_base;
+    uint32_t num_generated;
+    uint32_t num_records;
+    uint32_t num_mismatches;
+} test_hist_log_verify_ctx_t;
+
+static bool
+test_hist_log_verify_cb(const uint32_t timestamp, const hist_log_record_data_t* const p_data, void* p_user_data)
+{
+    test_hist_log_verify_ctx_t* const p_ctx = p_user_data;
+    const uint32_t                    idx   = (timestamp - p_ctx->timestamp_base) / TEST_HIST_LOG_PERIOD_SECONDS;
+    hist_log_record_data_t            data  = { 0 };
+    // The generator is sequential, so generate and skip the records which were rotated out
+    while (p_ctx->num_generated <= idx)
+    {
+        data = test_hist_log_gen_record_data(p_ctx->num_generated);
+        p_ctx->num_generated += 1;
+    }
+    if ((p_ctx->num_generated != (idx + 1)) || (0 != memcmp(&data, p_data, sizeof(data))))
+    {
+        p_ctx->num_mismatches += 1;
+    }
+    p_ctx->num_records += 1;
+    return true;
+}
+
+ZTEST_F(test_suite_hist_log, test_retention_with_realistic_data)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    zassert_true(hist_log_read_records(&test_hist_log_verify_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    // The newest record was read last
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS, ctx.num_generated);
+
+    const uint32_t retention_v1_s = TEST_HIST_LOG_V1_MAX_NUM_RECORDS * TEST_HIST_LOG_PERIOD_SECONDS;
+    const uint32_t retention_v2_s = ctx.num_records * TEST_HIST_LOG_PERIOD_SECONDS;
+    const uint32_t ratio_x100     = (ctx.num_records * 100U) / TEST_HIST_LOG_V1_MAX_NUM_RECORDS;
+    printf(
+        "hist_log retention: format v1: %u records (%u hours), format v2: %u records (%u hours), ratio: %u.%02u\n",
+        (unsigned)TEST_HIST_LOG_V1_MAX_NUM_RECORDS,
+        (unsigned)(retention_v1_s / TEST_HIST_LOG_ONE_HOUR),
+        (unsigned)ctx.num_records,
+        (unsigned)(retention_v2_s / TEST_HIST_LOG_ONE_HOUR),
+        (unsigned)(ratio_x100 / 100U),
+        (unsigned)(ratio_x100 % 100U));
+
+    zassert_true(ctx.num_records >= (2U * TEST_HIST_LOG_V1_MAX_NUM_RECORDS));
+}
+
+ZTEST_F(test_suite_hist_log, test_append_after_reinit)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+
+    // Delta encoding continues from the last record in the active sector which is restored from the flash
+    zassert_true(hist_log_flush());
+    zassert_true(hist_log_init(true));
+    for (uint32_t i = 1000; i < 1010; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(i);
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_PERIOD_SECONDS),
+            &data,
+            false));
+    }
+
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    zassert_true(hist_log_read_records(&test_hist_log_verify_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(1010, ctx.num_records);
+}
+
+ZTEST_F(test_suite_hist_log, test_write_back_program_ops)
+{
+    // The partition is not filled, so that the sector erasing does not affect the result
+    const uint32_t num_records = 2000;
+
+    g_test_hist_log_flash_write_cnt = 0;
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, num_records);
+    zassert_true(hist_log_flush());
+    const uint32_t num_program_ops = g_test_hist_log_flash_write_cnt;
+
+    const uint32_t ops_per_record_x100 = (num_program_ops * 100U) / num_records;
+    printf(
+        "hist_log write-back: %u records per entry: %u program operations for %u records, %u.%02u per record\n",
+        (unsigned)TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS,
+        (unsigned)num_program_ops,
+        (unsigned)num_records,
+        (unsigned)(ops_per_record_x100 / 100U),
+        (unsigned)(ops_per_record_x100 % 100U));
+
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    zassert_true(hist_log_read_records(&test_hist_log_verify_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(num_records, ctx.num_records);
+
+    if (1 == TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS)
+    {
+        zassert_true(num_program_ops >= (TEST_HIST_LOG_FCB_PROGRAM_OPS_PER_ENTRY * num_records));
+    }
+    else
+    {
+        zassert_true(num_program_ops < num_records);
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_read_buffered_records)
+{
+    const uint32_t num_records = 1000 + (TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS / 2);
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, num_records);
+
+    // The records which are not yet written to flash are also read
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    zassert_true(hist_log_read_records(&test_hist_log_verify_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(num_records, ctx.num_records);
+
+    const test_hist_log_query_t query_last = test_hist_log_query(
+        TEST_HIST_LOG_BASE_TIMESTAMP + ((num_records - 1) * TEST_HIST_LOG_PERIOD_SECONDS));
+    ZASSERT_EQ_INT(1, query_last.num_records);
+}
+
+// The write-back buffer is written to flash at least once while the records are being read
+#define TEST_HIST_LOG_NUM_APPENDED_DURING_READ ((2U * TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS) + 1U)
+
+typedef struct test_hist_log_append_during_read_ctx_t
+{
+    test_hist_log_verify_ctx_t verify;
+    uint32_t                   num_appended;
+    hist_log_record_data_t     records[TEST_HIST_LOG_NUM_APPENDED_DURING_READ];
+} test_hist_log_append_during_read_ctx_t;
+
+static bool
+test_hist_log_append_during_read_cb(
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data,
+    void*                               p_user_data)
+{
+    test_hist_log_append_during_read_ctx_t* const p_ctx = p_user_data;
+    // The new records are appended by the main thread while the history is being sent over NUS
+    if (p_ctx->num_appended < TEST_HIST_LOG_NUM_APPENDED_DURING_READ)
+    {
+        const uint32_t idx = 1000 + p_ctx->num_appended;
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + (idx * TEST_HIST_LOG_PERIOD_SECONDS),
+            &p_ctx->records[p_ctx->num_appended],
+            false));
+        p_ctx->num_appended += 1;
+    }
+    return test_hist_log_verify_cb(timestamp, p_data, &p_ctx->verify);
+}
+
+ZTEST_F(test_suite_hist_log, test_read_records_appended_during_read)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+
+    static test_hist_log_append_during_read_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.verify.timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP;
+    // The generator is sequential, so the records are generated before they are read back
+    for (uint32_t i = 0; i < TEST_HIST_LOG_NUM_APPENDED_DURING_READ; ++i)
+    {
+        ctx.records[i] = test_hist_log_gen_record_data(1000 + i);
+    }
+    zassert_true(hist_log_read_records(&test_hist_log_append_during_read_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.verify.num_mismatches);
+    ZASSERT_EQ_INT(1000 + TEST_HIST_LOG_NUM_APPENDED_DURING_READ, ctx.verify.num_records);
+}
+
+#define TEST_HIST_LOG_CURSOR_NUM_RECORDS (1000U + (TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS / 2))
+#define TEST_HIST_LOG_CURSOR_NUM_TOTAL \
+    (TEST_HIST_LOG_CURSOR_NUM_RECORDS + TEST_HIST_LOG_NUM_APPENDED_DURING_READ + 1U)
+
+static uint32_t
+test_hist_log_cursor_read(hist_log_cursor_t* const p_cursor, test_hist_log_verify_ctx_t* const p_ctx, uint32_t num)
+{
+    uint32_t cnt = 0;
+    while (cnt < num)
+    {
+        uint32_t                 timestamp = 0;
+        uint32_t                 seq       = 0;
+        hist_log_rollup_record_t record    = { 0 };
+        if (HIST_LOG_CURSOR_STATUS_OK != hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+        {
+            break;
+        }
+        (void)test_hist_log_verify_cb(timestamp, &record.mean, p_ctx);
+        cnt += 1;
+    }
+    return cnt;
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_pause_and_resume)
+{
+    static hist_log_record_data_t records[TEST_HIST_LOG_CURSOR_NUM_TOTAL];
+    for (uint32_t i = 0; i < TEST_HIST_LOG_CURSOR_NUM_TOTAL; ++i)
+    {
+        records[i] = test_hist_log_gen_record_data(i);
+    }
+    uint32_t num_appended = 0;
+    for (; num_appended < TEST_HIST_LOG_CURSOR_NUM_RECORDS; ++num_appended)
+    {
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + (num_appended * TEST_HIST_LOG_PERIOD_SECONDS),
+            &records[num_appended],
+            false));
+    }
+
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+    };
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor);
+    ZASSERT_EQ_INT(500, test_hist_log_cursor_read(p_cursor, &ctx, 500));
+
+    // The reading is paused, meanwhile the write-back buffer is written to flash
+    for (; num_appended < (TEST_HIST_LOG_CURSOR_NUM_TOTAL - 1U); ++num_appended)
+    {
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + (num_appended * TEST_HIST_LOG_PERIOD_SECONDS),
+            &records[num_appended],
+            false));
+    }
+    (void)test_hist_log_cursor_read(p_cursor, &ctx, UINT32_MAX);
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(num_appended, ctx.num_records);
+
+    // The buffered record is read once, it is not read again after it is written to flash
+    zassert_true(hist_log_append_record(
+        TEST_HIST_LOG_BASE_TIMESTAMP + (num_appended * TEST_HIST_LOG_PERIOD_SECONDS),
+        &records[num_appended],
+        false));
+    num_appended += 1;
+    ZASSERT_EQ_INT(1, test_hist_log_cursor_read(p_cursor, &ctx, UINT32_MAX));
+    zassert_true(hist_log_flush());
+    ZASSERT_EQ_INT(0, test_hist_log_cursor_read(p_cursor, &ctx, UINT32_MAX));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_CURSOR_NUM_TOTAL, ctx.num_records);
+    hist_log_cursor_close(p_cursor);
+}
+
+#if IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_CACHE)
+#define TEST_HIST_LOG_CACHE_NUM_RECORDS (CONFIG_RUUVI_AIR_HIST_LOG_CACHE_NUM_RECORDS)
+#else
+#define TEST_HIST_LOG_CACHE_NUM_RECORDS (1U)
+#endif
+
+typedef struct test_hist_log_cache_bench_t
+{
+    uint32_t num_records;
+    uint32_t num_flash_reads;
+    uint32_t time_us;
+} test_hist_log_cache_bench_t;
+
+/**
+ * @brief Read the given number of records starting from the timestamp.
+ * @param p_ctx The records are checked if it is not NULL (which takes longer than reading them).
+ */
+static test_hist_log_cache_bench_t
+test_hist_log_cache_bench(
+    const uint32_t                    timestamp_start,
+    const uint32_t                    num_records,
+    test_hist_log_verify_ctx_t* const p_ctx)
+{
+    test_hist_log_cache_bench_t bench = { 0 };
+
+    g_test_hist_log_flash_read_cnt       = 0;
+    const int64_t            ticks_start = k_uptime_ticks();
+    hist_log_cursor_t* const p_cursor    = hist_log_cursor_open(HIST_LOG_TIER_5MIN, timestamp_start);
+    zassert_not_null(p_cursor);
+    while (bench.num_records < num_records)
+    {
+        uint32_t                 timestamp = 0;
+        uint32_t                 seq       = 0;
+        hist_log_rollup_record_t record    = { 0 };
+        if (HIST_LOG_CURSOR_STATUS_OK != hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+        {
+            break;
+        }
+        if (NULL != p_ctx)
+        {
+            (void)test_hist_log_verify_cb(timestamp, &record.mean, p_ctx);
+        }
+        bench.num_records += 1;
+    }
+    hist_log_cursor_close(p_cursor);
+    bench.time_us         = (uint32_t)k_ticks_to_us_near64(k_uptime_ticks() - ticks_start);
+    bench.num_flash_reads = g_test_hist_log_flash_read_cnt;
+    return bench;
+}
+
+ZTEST_F(test_suite_hist_log, test_cache_query_vs_flash)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_CACHE);
+    test_hist_log_unmap_flash();
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+    const uint32_t num_records    = TEST_HIST_LOG_CACHE_NUM_RECORDS / 2U;
+    // The oldest cached record is not used as the start: the records before it may be missing from the cache
+    const uint32_t timestamp_cached = timestamp_last - (num_records * TEST_HIST_LOG_PERIOD_SECONDS);
+    const uint32_t timestamp_flash
+        = timestamp_last - (3U * TEST_HIST_LOG_CACHE_NUM_RECORDS * TEST_HIST_LOG_PERIOD_SECONDS);
+
+    hist_log_reset_stats();
+    const test_hist_log_cache_bench_t bench_flash  = test_hist_log_cache_bench(timestamp_flash, num_records, NULL);
+    const test_hist_log_cache_bench_t bench_cached = test_hist_log_cache_bench(timestamp_cached, num_records, NULL);
+    hist_log_stats_t                  stats        = { 0 };
+    hist_log_get_stats(&stats);
+    printf(
+        "hist_log cache benchmark: %u records: flash: %u us (%u flash reads), cache: %u us (%u flash reads)\n",
+        (unsigned)num_records,
+        (unsigned)bench_flash.time_us,
+        (unsigned)bench_flash.num_flash_reads,
+        (unsigned)bench_cached.time_us,
+        (unsigned)bench_cached.num_flash_reads);
+    ZASSERT_EQ_INT(num_records, bench_flash.num_records);
+    ZASSERT_EQ_INT(num_records, bench_cached.num_records);
+    ZASSERT_EQ_INT(1, stats.num_cache_hits);
+    ZASSERT_EQ_INT(1, stats.num_cache_misses);
+    zassert_true(0 != bench_flash.num_flash_reads);
+    ZASSERT_EQ_INT(0, bench_cached.num_flash_reads);
+    zassert_true(bench_cached.time_us < bench_flash.time_us);
+
+    // The cache is filled from flash on boot
+    zassert_true(hist_log_flush());
+    zassert_true(hist_log_init(true));
+    hist_log_reset_stats();
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    const test_hist_log_cache_bench_t bench_boot = test_hist_log_cache_bench(timestamp_cached, UINT32_MAX, &ctx);
+    hist_log_get_stats(&stats);
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(num_records + 1U, bench_boot.num_records);
+    ZASSERT_EQ_INT(0, bench_boot.num_flash_reads);
+    ZASSERT_EQ_INT(1, stats.num_cache_hits);
+}
+
+ZTEST_F(test_suite_hist_log, test_cache_reader_falls_back_to_flash)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_CACHE);
+    test_hist_log_unmap_flash();
+    const uint32_t num_records = 1000U;
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, num_records);
+    // The generator is sequential, so the records are generated before the verification restarts it
+    static hist_log_record_data_t records[2U * TEST_HIST_LOG_CACHE_NUM_RECORDS];
+    for (uint32_t i = 0; i < (2U * TEST_HIST_LOG_CACHE_NUM_RECORDS); ++i)
+    {
+        records[i] = test_hist_log_gen_record_data(num_records + i);
+    }
+
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    const uint32_t timestamp_start
+        = TEST_HIST_LOG_BASE_TIMESTAMP + ((num_records - 10U) * TEST_HIST_LOG_PERIOD_SECONDS);
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open(HIST_LOG_TIER_5MIN, timestamp_start);
+    zassert_not_null(p_cursor);
+    ZASSERT_EQ_INT(5, test_hist_log_cursor_read(p_cursor, &ctx, 5));
+
+    // The reading is paused until the next record of the cursor is dropped from the cache
+    for (uint32_t i = 0; i < (2U * TEST_HIST_LOG_CACHE_NUM_RECORDS); ++i)
+    {
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + ((num_records + i) * TEST_HIST_LOG_PERIOD_SECONDS),
+            &records[i],
+            false));
+    }
+    g_test_hist_log_flash_read_cnt = 0;
+    (void)test_hist_log_cursor_read(p_cursor, &ctx, UINT32_MAX);
+    hist_log_cursor_close(p_cursor);
+    zassert_true(0 != g_test_hist_log_flash_read_cnt);
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(10U + (2U * TEST_HIST_LOG_CACHE_NUM_RECORDS), ctx.num_records);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_invalidated_by_rotate)
+{
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor);
+    uint32_t                 timestamp = 0;
+    uint32_t                 seq       = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_OK, hist_log_cursor_next(p_cursor, &timestamp, &seq, &record));
+    const uint32_t timestamp_oldest = timestamp;
+
+    // The oldest sector, which the cursor points into, is erased while the reading is paused
+    const uint32_t num_appended = 2000;
+    for (uint32_t i = 1; i <= num_appended; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(TEST_HIST_LOG_NUM_FILL_RECORDS + i - 1U);
+        zassert_true(hist_log_append_record(timestamp_last + (i * TEST_HIST_LOG_PERIOD_SECONDS), &data, false));
+    }
+    // The rest of the entry which was already copied to RAM is still read
+    uint32_t                 num_read_from_ram = 0;
+    hist_log_cursor_status_e status            = hist_log_cursor_next(p_cursor, &timestamp, &seq, &record);
+    while (HIST_LOG_CURSOR_STATUS_OK == status)
+    {
+        num_read_from_ram += 1;
+        status = hist_log_cursor_next(p_cursor, &timestamp, &seq, &record);
+    }
+    ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_INVALIDATED, status);
+    zassert_true(num_read_from_ram < TEST_HIST_LOG_WRITE_BACK_NUM_RECORDS);
+
+    // The cursor continues from the oldest record which is left
+    uint32_t num_records = 0;
+    uint32_t num_gaps    = 0;
+    uint32_t ts_prev     = 0;
+    uint32_t seq_prev    = 0;
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+    {
+        if ((0 != num_records)
+            && ((timestamp != (ts_prev + TEST_HIST_LOG_PERIOD_SECONDS)) || (seq != (seq_prev + 1U))))
+        {
+            num_gaps += 1;
+        }
+        else if (0 == num_records)
+        {
+            zassert_true(timestamp > timestamp_oldest);
+        }
+        else
+        {
+            // MISRA: "if ... else if" constructs should end with "else" clauses
+        }
+        ts_prev  = timestamp;
+        seq_prev = seq;
+        num_records += 1;
+    }
+    hist_log_cursor_close(p_cursor);
+    ZASSERT_EQ_INT(0, num_gaps);
+    ZASSERT_EQ_INT(timestamp_last + (num_appended * TEST_HIST_LOG_PERIOD_SECONDS), ts_prev);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS + num_appended, seq_prev);
+
+    const test_hist_log_query_t query_full = test_hist_log_query(0);
+    ZASSERT_EQ_INT(query_full.num_records, num_records);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_rollup_tier)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open(HIST_LOG_TIER_1HOUR, 0);
+    zassert_not_null(p_cursor);
+    uint32_t                 timestamp   = 0;
+    uint32_t                 seq         = 0;
+    hist_log_rollup_record_t record      = { 0 };
+    uint32_t                 num_records = 0;
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+    {
+        ZASSERT_EQ_INT(TEST_HIST_LOG_BASE_TIMESTAMP + (num_records * TEST_HIST_LOG_ONE_HOUR), timestamp);
+        // The rollup tiers have their own sequence numbers
+        ZASSERT_EQ_INT(num_records + 1U, seq);
+        num_records += 1;
+    }
+    hist_log_cursor_close(p_cursor);
+    // The last hour is still being aggregated
+    ZASSERT_EQ_INT((1000U * TEST_HIST_LOG_PERIOD_SECONDS) / TEST_HIST_LOG_ONE_HOUR, num_records);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_open_max)
+{
+    hist_log_cursor_t* cursors[CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS] = { 0 };
+    for (uint32_t i = 0; i < CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS; ++i)
+    {
+        cursors[i] = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+        zassert_not_null(cursors[i]);
+    }
+    zassert_is_null(hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0));
+    hist_log_cursor_close(cursors[0]);
+    cursors[0] = hist_log_cursor_open(HIST_LOG_TIER_1DAY, 0);
+    zassert_not_null(cursors[0]);
+    for (uint32_t i = 0; i < CONFIG_RUUVI_AIR_HIST_LOG_NUM_CURSORS; ++i)
+    {
+        hist_log_cursor_close(cursors[i]);
+    }
+}
+
+/**
+ * @brief Read all the records after the sequence number, check that the sequence numbers are contiguous.
+ * @return Number of the records read.
+ */
+static uint32_t
+test_hist_log_read_after_seq(const uint32_t after_seq, uint32_t* const p_seq_first, uint32_t* const p_seq_last)
+{
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open_after_seq(HIST_LOG_TIER_5MIN, after_seq);
+    zassert_not_null(p_cursor);
+    uint32_t                 timestamp   = 0;
+    uint32_t                 seq         = 0;
+    hist_log_rollup_record_t record      = { 0 };
+    uint32_t                 num_records = 0;
+    *p_seq_first                         = 0;
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+    {
+        if (0 == num_records)
+        {
+            *p_seq_first = seq;
+        }
+        else
+        {
+            ZASSERT_EQ_INT(*p_seq_first + num_records, seq);
+        }
+        num_records += 1;
+    }
+    *p_seq_last = hist_log_cursor_get_seq_last(p_cursor);
+    hist_log_cursor_close(p_cursor);
+    return num_records;
+}
+
+ZTEST_F(test_suite_hist_log, test_seq_after_reinit)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+    zassert_true(hist_log_flush());
+    zassert_true(hist_log_init(true));
+    for (uint32_t i = 1000; i < 1010; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(i);
+        zassert_true(hist_log_append_record(
+            TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_PERIOD_SECONDS),
+            &data,
+            false));
+    }
+
+    // The sequence numbers continue after reboot, 0 means reading all the records
+    uint32_t seq_first = 0;
+    uint32_t seq_last  = 0;
+    ZASSERT_EQ_INT(1010, test_hist_log_read_after_seq(0, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(1, seq_first);
+    ZASSERT_EQ_INT(1010, seq_last);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_after_seq)
+{
+    // The clock was set back: the timestamps are repeated, but the sequence numbers are unique
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 600);
+    (void)test_hist_log_fill(timestamp_last - TEST_HIST_LOG_ONE_DAY, 600);
+
+    uint32_t seq_first = 0;
+    uint32_t seq_last  = 0;
+    ZASSERT_EQ_INT(500, test_hist_log_read_after_seq(700, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(701, seq_first);
+    ZASSERT_EQ_INT(1200, seq_last);
+
+    // Nothing new after the last record, the client is told to resume from the same point
+    ZASSERT_EQ_INT(0, test_hist_log_read_after_seq(seq_last, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(1200, seq_last);
+
+    const hist_log_record_data_t data = test_hist_log_gen_record_data(0);
+    zassert_true(hist_log_append_record(timestamp_last, &data, false));
+    ZASSERT_EQ_INT(1, test_hist_log_read_after_seq(seq_last, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(1201, seq_first);
+    ZASSERT_EQ_INT(1201, seq_last);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_after_seq_skips_sectors)
+{
+    test_hist_log_unmap_flash();
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    uint32_t seq_first = 0;
+    uint32_t seq_last  = 0;
+
+    g_test_hist_log_flash_read_bytes = 0;
+    const uint32_t num_records       = test_hist_log_read_after_seq(0, &seq_first, &seq_last);
+    const uint32_t read_bytes_full   = g_test_hist_log_flash_read_bytes;
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS - num_records + 1U, seq_first);
+
+    g_test_hist_log_flash_read_bytes = 0;
+    ZASSERT_EQ_INT(100, test_hist_log_read_after_seq(TEST_HIST_LOG_NUM_FILL_RECORDS - 100U, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS - 99U, seq_first);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS, seq_last);
+    // The sectors with the older records are skipped using the sector directory
+    zassert_true((g_test_hist_log_flash_read_bytes * 10U) < read_bytes_full);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_after_seq_storage_reset)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 100);
+
+    // The client remembers the sequence number from before the storage was erased, all the records are sent
+    uint32_t seq_first = 0;
+    uint32_t seq_last  = 0;
+    ZASSERT_EQ_INT(100, test_hist_log_read_after_seq(5000, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(1, seq_first);
+    ZASSERT_EQ_INT(100, seq_last);
+
+    // Nothing was sent: seq_last=0 means that the next request reads all the records
+    zassert_true(hist_log_erase());
+    ZASSERT_EQ_INT(0, test_hist_log_read_after_seq(5000, &seq_first, &seq_last));
+    ZASSERT_EQ_INT(0, seq_last);
+}
+
+typedef struct test_hist_log_newest_first_t
+{
+    uint32_t num_records;
+    uint32_t seq_first; //!< Sequence number of the first record returned, i.e. the newest one
+    uint32_t timestamp_first;
+    uint32_t seq_last;
+    uint32_t first_record_read_bytes; //!< Bytes read from flash until the first record was returned
+    bool     flag_wrong_order;
+} test_hist_log_newest_first_t;
+
+static test_hist_log_newest_first_t
+test_hist_log_read_newest_first(const uint32_t num_records_max)
+{
+    test_hist_log_newest_first_t result = { 0 };
+    g_test_hist_log_flash_read_bytes    = 0;
+    hist_log_cursor_t* const p_cursor   = hist_log_cursor_open_newest_first(HIST_LOG_TIER_5MIN, num_records_max);
+    zassert_not_null(p_cursor);
+    uint32_t                 timestamp = 0;
+    uint32_t                 seq       = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+    {
+        if (0 == result.num_records)
+        {
+            result.seq_first               = seq;
+            result.timestamp_first         = timestamp;
+            result.first_record_read_bytes = g_test_hist_log_flash_read_bytes;
+        }
+        else if ((seq != (result.seq_first - result.num_records))
+                 || (timestamp != (result.timestamp_first - (result.num_records * TEST_HIST_LOG_PERIOD_SECONDS))))
+        {
+            result.flag_wrong_order = true;
+        }
+        else
+        {
+            // MISRA: "if ... else if" constructs should end with "else" clauses
+        }
+        result.num_records += 1;
+    }
+    result.seq_last = hist_log_cursor_get_seq_last(p_cursor);
+    hist_log_cursor_close(p_cursor);
+    return result;
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_newest_first)
+{
+    test_hist_log_unmap_flash();
+    ZASSERT_EQ_INT(0, test_hist_log_read_newest_first(0).num_records);
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    g_test_hist_log_flash_read_bytes            = 0;
+    const test_hist_log_query_t query_full      = test_hist_log_query(0);
+    const uint32_t              read_bytes_full = g_test_hist_log_flash_read_bytes;
+
+    // The newest records, including the ones buffered in RAM, are returned first
+    const test_hist_log_newest_first_t last_n = test_hist_log_read_newest_first(100);
+    ZASSERT_EQ_INT(100, last_n.num_records);
+    zassert_false(last_n.flag_wrong_order);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS, last_n.seq_first);
+    ZASSERT_EQ_INT(timestamp_last, last_n.timestamp_first);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_FILL_RECORDS - 99U, last_n.seq_last);
+    printf(
+        "hist_log time to the newest record: forward reading: %u bytes, newest first: %u bytes\n",
+        (unsigned)read_bytes_full,
+        (unsigned)last_n.first_record_read_bytes);
+    zassert_true((last_n.first_record_read_bytes * 10U) < read_bytes_full);
+
+    // All the records are returned in reverse order
+    const test_hist_log_newest_first_t all = test_hist_log_read_newest_first(0);
+    ZASSERT_EQ_INT(query_full.num_records, all.num_records);
+    zassert_false(all.flag_wrong_order);
+    ZASSERT_EQ_INT(timestamp_last - query_full.timestamp_first, (all.num_records - 1U) * TEST_HIST_LOG_PERIOD_SECONDS);
+}
+
+// Short episodes of bad air near the end of the history, the realistic CO2 stays below 1100 ppm and PM2.5 below 6
+#define TEST_HIST_LOG_FILTER_CO2_IDX       (TEST_HIST_LOG_NUM_FILL_RECORDS - 3000U)
+#define TEST_HIST_LOG_FILTER_CO2_NUM       (6U)
+#define TEST_HIST_LOG_FILTER_PM_IDX        (TEST_HIST_LOG_NUM_FILL_RECORDS - 500U)
+#define TEST_HIST_LOG_FILTER_PM_NUM        (3U)
+#define TEST_HIST_LOG_FILTER_NUM_MATCHING  (TEST_HIST_LOG_FILTER_CO2_NUM + TEST_HIST_LOG_FILTER_PM_NUM)
+#define TEST_HIST_LOG_FILTER_CO2_THRESHOLD (1500.0f)
+#define TEST_HIST_LOG_FILTER_PM_THRESHOLD  (35.0f)
+
+static bool
+test_hist_log_filter_is_event(const uint32_t idx)
+{
+    const bool is_co2 = (idx >= TEST_HIST_LOG_FILTER_CO2_IDX)
+                        && (idx < (TEST_HIST_LOG_FILTER_CO2_IDX + TEST_HIST_LOG_FILTER_CO2_NUM));
+    const bool is_pm = (idx >= TEST_HIST_LOG_FILTER_PM_IDX)
+                       && (idx < (TEST_HIST_LOG_FILTER_PM_IDX + TEST_HIST_LOG_FILTER_PM_NUM));
+    return is_co2 || is_pm;
+}
+
+static hist_log_record_data_t
+test_hist_log_filter_gen_record_data(const uint32_t idx)
+{
+    hist_log_record_data_t data = test_hist_log_gen_record_data(idx);
+    if (!test_hist_log_filter_is_event(idx))
+    {
+        return data;
+    }
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, data.buf, sizeof(data.buf));
+    re_e1_data_t e1_data = { 0 };
+    (void)re_e1_decode(buffer, &e1_data);
+    if (idx < TEST_HIST_LOG_FILTER_PM_IDX)
+    {
+        e1_data.co2 = 1800.0f;
+    }
+    else
+    {
+        e1_data.pm2p5_ppm = 48.5f;
+    }
+    (void)re_e1_encode(buffer, &e1_data);
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+typedef struct test_hist_log_filter_result_t
+{
+    uint32_t num_records;
+    uint32_t num_wrong; //!< Records which do not belong to the episodes
+    uint32_t num_sectors_skipped;
+    uint32_t read_bytes;
+} test_hist_log_filter_result_t;
+
+static test_hist_log_filter_result_t
+test_hist_log_read_filtered(const hist_log_tier_e tier, const hist_log_filter_t* const p_filter)
+{
+    test_hist_log_filter_result_t result = { 0 };
+    g_test_hist_log_flash_read_bytes     = 0;
+    hist_log_cursor_t* const p_cursor    = hist_log_cursor_open(tier, 0);
+    zassert_not_null(p_cursor);
+    zassert_true(hist_log_cursor_set_filter(p_cursor, p_filter));
+    uint32_t                 timestamp = 0;
+    uint32_t                 seq       = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &timestamp, &seq, &record))
+    {
+        // The 5-minute records are generated with seq_cnt = idx * period
+        uint8_t buffer[RE_E1_DATA_LENGTH];
+        memset(buffer, 0xFF, sizeof(buffer));
+        memcpy(buffer, record.max.buf, sizeof(record.max.buf));
+        re_e1_data_t e1_data = { 0 };
+        (void)re_e1_decode(buffer, &e1_data);
+        const uint32_t idx = e1_data.seq_cnt / TEST_HIST_LOG_PERIOD_SECONDS;
+        if ((HIST_LOG_TIER_5MIN == tier) && (!test_hist_log_filter_is_event(idx)))
+        {
+            result.num_wrong += 1;
+        }
+        result.num_records += 1;
+    }
+    result.num_sectors_skipped = hist_log_cursor_get_num_sectors_skipped(p_cursor);
+    result.read_bytes          = g_test_hist_log_flash_read_bytes;
+    hist_log_cursor_close(p_cursor);
+    return result;
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_filter_skips_sectors)
+{
+    test_hist_log_unmap_flash();
+    for (uint32_t i = 0; i < TEST_HIST_LOG_NUM_FILL_RECORDS; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_filter_gen_record_data(i);
+        zassert_true(
+            hist_log_append_record(TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_PERIOD_SECONDS), &data, false));
+    }
+    g_test_hist_log_flash_read_bytes            = 0;
+    const test_hist_log_query_t query_full      = test_hist_log_query(0);
+    const uint32_t              read_bytes_full = g_test_hist_log_flash_read_bytes;
+    zassert_true(query_full.num_records > 3000U);
+
+    // "When did CO2 exceed 1500 ppm or PM2.5 exceed 35 ug/m3?"
+    const hist_log_filter_t filter = {
+        .num_conds = 2,
+        .conds     = {
+            {
+                .field     = HIST_LOG_FIELD_CO2,
+                .op        = HIST_LOG_FILTER_OP_GT,
+                .threshold = TEST_HIST_LOG_FILTER_CO2_THRESHOLD,
+            },
+            {
+                .field     = HIST_LOG_FIELD_PM2P5,
+                .op        = HIST_LOG_FILTER_OP_GT,
+                .threshold = TEST_HIST_LOG_FILTER_PM_THRESHOLD,
+            },
+        },
+    };
+    const test_hist_log_filter_result_t result = test_hist_log_read_filtered(HIST_LOG_TIER_5MIN, &filter);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_FILTER_NUM_MATCHING, result.num_records);
+    ZASSERT_EQ_INT(0, result.num_wrong);
+    printf(
+        "hist_log filtered read: %u matching records, %u sectors skipped, %u bytes read (full scan: %u bytes)\n",
+        (unsigned)result.num_records,
+        (unsigned)result.num_sectors_skipped,
+        (unsigned)result.read_bytes,
+        (unsigned)read_bytes_full);
+    // Only the sectors with the episodes and the active sector are read
+    zassert_true((result.read_bytes * 5U) < read_bytes_full);
+
+    // The rollup tiers keep the max of the time bucket, so the hours with the episodes are found as well
+    const test_hist_log_filter_result_t result_1hour = test_hist_log_read_filtered(HIST_LOG_TIER_1HOUR, &filter);
+    zassert_true(result_1hour.num_records >= 2U);
+    zassert_true(result_1hour.num_records <= 4U);
+
+    // The zone maps are restored on boot
+    zassert_true(hist_log_flush());
+    zassert_true(hist_log_init(true));
+    const test_hist_log_filter_result_t result_boot = test_hist_log_read_filtered(HIST_LOG_TIER_5MIN, &filter);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_FILTER_NUM_MATCHING, result_boot.num_records);
+    ZASSERT_EQ_INT(result.num_sectors_skipped, result_boot.num_sectors_skipped);
+
+    // Nothing matches, no sector except the active one is read
+    const hist_log_filter_t filter_none = {
+        .num_conds = 1,
+        .conds     = {
+            { .field = HIST_LOG_FIELD_TEMPERATURE, .op = HIST_LOG_FILTER_OP_LT, .threshold = 5.0f },
+        },
+    };
+    const test_hist_log_filter_result_t result_none = test_hist_log_read_filtered(HIST_LOG_TIER_5MIN, &filter_none);
+    ZASSERT_EQ_INT(0, result_none.num_records);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS - 2U, result_none.num_sectors_skipped);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_filter_invalid)
+{
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open_newest_first(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor);
+    hist_log_filter_t filter = {
+        .num_conds = 1,
+        .conds     = {
+            { .field = HIST_LOG_FIELD_CO2, .op = HIST_LOG_FILTER_OP_GT, .threshold = 1000.0f },
+        },
+    };
+    // The newest-first cursor does not support filters
+    zassert_false(hist_log_cursor_set_filter(p_cursor, &filter));
+    hist_log_cursor_close(p_cursor);
+
+    hist_log_cursor_t* const p_cursor2 = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor2);
+    zassert_true(hist_log_cursor_set_filter(p_cursor2, &filter));
+    filter.conds[0].field = (hist_log_field_e)HIST_LOG_NUM_FIELDS;
+    zassert_false(hist_log_cursor_set_filter(p_cursor2, &filter));
+    filter.num_conds = 0;
+    zassert_false(hist_log_cursor_set_filter(p_cursor2, &filter));
+    zassert_true(hist_log_cursor_set_filter(p_cursor2, NULL));
+    hist_log_cursor_close(p_cursor2);
+}
+
+#define TEST_HIST_LOG_AGGREGATED_MAX_RECORDS (100U)
+
+typedef struct test_hist_log_aggregated_t
+{
+    uint32_t                 num_records;
+    uint32_t                 timestamps[TEST_HIST_LOG_AGGREGATED_MAX_RECORDS];
+    uint32_t                 seqs[TEST_HIST_LOG_AGGREGATED_MAX_RECORDS];
+    hist_log_rollup_record_t records[TEST_HIST_LOG_AGGREGATED_MAX_RECORDS];
+} test_hist_log_aggregated_t;
+
+static void
+test_hist_log_read_aggregated(
+    const hist_log_tier_e             tier,
+    const uint32_t                    period_s,
+    test_hist_log_aggregated_t* const p_result)
+{
+    memset(p_result, 0, sizeof(*p_result));
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open(tier, 0);
+    zassert_not_null(p_cursor);
+    zassert_true(hist_log_cursor_set_aggregation(p_cursor, period_s));
+    while (p_result->num_records < TEST_HIST_LOG_AGGREGATED_MAX_RECORDS)
+    {
+        const uint32_t                 idx    = p_result->num_records;
+        const hist_log_cursor_status_e status = hist_log_cursor_next(
+            p_cursor,
+            &p_result->timestamps[idx],
+            &p_result->seqs[idx],
+            &p_result->records[idx]);
+        if (HIST_LOG_CURSOR_STATUS_OK != status)
+        {
+            ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_END, status);
+            break;
+        }
+        p_result->num_records += 1;
+    }
+    hist_log_cursor_close(p_cursor);
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_aggregated)
+{
+    const uint32_t num_records = 1000;
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, num_records);
+
+    static test_hist_log_aggregated_t aggregated;
+    static test_hist_log_aggregated_t hours;
+    test_hist_log_read_aggregated(HIST_LOG_TIER_5MIN, TEST_HIST_LOG_ONE_HOUR, &aggregated);
+    // Aggregating the hourly rollups by one hour returns them as is
+    test_hist_log_read_aggregated(HIST_LOG_TIER_1HOUR, TEST_HIST_LOG_ONE_HOUR, &hours);
+
+    const uint32_t num_records_per_hour = TEST_HIST_LOG_ONE_HOUR / TEST_HIST_LOG_PERIOD_SECONDS;
+    // The last hour, which is not completed yet, is returned as well
+    ZASSERT_EQ_INT((num_records + num_records_per_hour - 1U) / num_records_per_hour, aggregated.num_records);
+    ZASSERT_EQ_INT(aggregated.num_records - 1U, hours.num_records);
+    for (uint32_t i = 0; i < aggregated.num_records; ++i)
+    {
+        ZASSERT_EQ_INT(TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_ONE_HOUR), aggregated.timestamps[i]);
+        // The sequence number of the bucket is the one of its last record
+        ZASSERT_EQ_INT(MIN((i + 1U) * num_records_per_hour, num_records), aggregated.seqs[i]);
+    }
+    // The buckets are aggregated in the same way as the hourly tier
+    for (uint32_t i = 0; i < hours.num_records; ++i)
+    {
+        ZASSERT_EQ_INT(hours.timestamps[i], aggregated.timestamps[i]);
+        zassert_mem_equal(&hours.records[i], &aggregated.records[i], sizeof(hours.records[i]));
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_cursor_aggregated_invalid)
+{
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 10);
+
+    hist_log_cursor_t* const p_cursor = hist_log_cursor_open_newest_first(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor);
+    // The newest-first cursor does not support aggregation
+    zassert_false(hist_log_cursor_set_aggregation(p_cursor, TEST_HIST_LOG_ONE_HOUR));
+    hist_log_cursor_close(p_cursor);
+
+    hist_log_cursor_t* const p_cursor2 = hist_log_cursor_open(HIST_LOG_TIER_1HOUR, 0);
+    zassert_not_null(p_cursor2);
+    // The period must be a multiple of the period of the tier
+    zassert_false(hist_log_cursor_set_aggregation(p_cursor2, TEST_HIST_LOG_PERIOD_SECONDS));
+    zassert_false(hist_log_cursor_set_aggregation(p_cursor2, TEST_HIST_LOG_ONE_HOUR + TEST_HIST_LOG_PERIOD_SECONDS));
+    zassert_true(hist_log_cursor_set_aggregation(p_cursor2, 6U * TEST_HIST_LOG_ONE_HOUR));
+    zassert_true(hist_log_cursor_set_aggregation(p_cursor2, 0));
+    hist_log_cursor_close(p_cursor2);
+
+    hist_log_cursor_t* const p_cursor3 = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor3);
+    zassert_true(hist_log_cursor_set_aggregation(p_cursor3, TEST_HIST_LOG_ONE_DAY));
+    uint32_t                 timestamp = 0;
+    uint32_t                 seq       = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    // All the records are in the bucket which is not completed yet
+    ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_OK, hist_log_cursor_next(p_cursor3, &timestamp, &seq, &record));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_BASE_TIMESTAMP, timestamp);
+    ZASSERT_EQ_INT(10, seq);
+    ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_END, hist_log_cursor_next(p_cursor3, &timestamp, &seq, &record));
+    hist_log_cursor_close(p_cursor3);
+}
+
+typedef struct test_hist_log_rollup_ctx_t
+{
+    uint32_t period_s;
+    uint32_t num_records;
+    uint32_t timestamp_first;
+    uint32_t timestamp_prev;
+    uint32_t num_gaps;
+    uint32_t num_out_of_range;
+} test_hist_log_rollup_ctx_t;
+
+static bool
+test_hist_log_rollup_is_in_range(const float value, const float min, const float max)
+{
+    return (value >= min) && (value <= max);
+}
+
+static bool
+test_hist_log_rollup_cb(const uint32_t timestamp, const hist_log_rollup_record_t* const p_record, void* p_user_data)
+{
+    test_hist_log_rollup_ctx_t* const p_ctx = p_user_data;
+    if (0 == p_ctx->num_records)
+    {
+        p_ctx->timestamp_first = timestamp;
+    }
+    else if (timestamp != (p_ctx->timestamp_prev + p_ctx->period_s))
+    {
+        p_ctx->num_gaps += 1;
+    }
+    else
+    {
+        // MISRA: "if ... else if" constructs should end with "else" clauses
+    }
+    p_ctx->timestamp_prev = timestamp;
+    p_ctx->num_records += 1;
+
+    uint8_t      buffer[RE_E1_DATA_LENGTH];
+    re_e1_data_t mean = { 0 };
+    re_e1_data_t min  = { 0 };
+    re_e1_data_t max  = { 0 };
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, p_record->mean.buf, sizeof(p_record->mean.buf));
+    (void)re_e1_decode(buffer, &mean);
+    memcpy(buffer, p_record->min.buf, sizeof(p_record->min.buf));
+    (void)re_e1_decode(buffer, &min);
+    memcpy(buffer, p_record->max.buf, sizeof(p_record->max.buf));
+    (void)re_e1_decode(buffer, &max);
+    if ((0 != (timestamp % p_ctx->period_s))
+        || (!test_hist_log_rollup_is_in_range(mean.temperature_c, min.temperature_c, max.temperature_c))
+        || (!test_hist_log_rollup_is_in_range(mean.co2, min.co2, max.co2))
+        || (!test_hist_log_rollup_is_in_range(mean.luminosity, min.luminosity, max.luminosity))
+        || (min.co2 >= max.co2))
+    {
+        p_ctx->num_out_of_range += 1;
+    }
+    return true;
+}
+
+static test_hist_log_rollup_ctx_t
+test_hist_log_read_rollup(const hist_log_tier_e tier, const uint32_t period_s)
+{
+    test_hist_log_rollup_ctx_t ctx = {
+        .period_s = period_s,
+    };
+    zassert_true(hist_log_read_rollup_records(tier, &test_hist_log_rollup_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_gaps);
+    ZASSERT_EQ_INT(0, ctx.num_out_of_range);
+    return ctx;
+}
+
+ZTEST_F(test_suite_hist_log, test_rollup_tiers_retention)
+{
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+
+    const test_hist_log_rollup_ctx_t hours = test_hist_log_read_rollup(HIST_LOG_TIER_1HOUR, TEST_HIST_LOG_ONE_HOUR);
+    const test_hist_log_rollup_ctx_t days  = test_hist_log_read_rollup(HIST_LOG_TIER_1DAY, TEST_HIST_LOG_ONE_DAY);
+    printf(
+        "hist_log retention: 1hour: %u records (%u days), 1day: %u records (%u days)\n",
+        (unsigned)hours.num_records,
+        (unsigned)(hours.num_records / 24U),
+        (unsigned)days.num_records,
+        (unsigned)days.num_records);
+
+    // The time bucket which contains the last record is not completed yet
+    const uint32_t hour_last = timestamp_last - (timestamp_last % TEST_HIST_LOG_ONE_HOUR);
+    const uint32_t day_last  = timestamp_last - (timestamp_last % TEST_HIST_LOG_ONE_DAY);
+    ZASSERT_EQ_INT(hour_last - TEST_HIST_LOG_ONE_HOUR, hours.timestamp_prev);
+    ZASSERT_EQ_INT(day_last - TEST_HIST_LOG_ONE_DAY, days.timestamp_prev);
+
+    // The rollup tiers keep the history much longer than the 5-minute tier
+    const test_hist_log_query_t query = test_hist_log_query(0);
+    zassert_true(hours.timestamp_first < query.timestamp_first);
+    zassert_true(days.timestamp_first < hours.timestamp_first);
+    // All the days since the beginning are still kept (~104 days)
+    ZASSERT_EQ_INT(TEST_HIST_LOG_BASE_TIMESTAMP, days.timestamp_first);
+}
+
+typedef struct test_hist_log_rollup_compare_ctx_t
+{
+    uint32_t                 num_expected;
+    uint32_t                 timestamps[TEST_HIST_LOG_ONE_DAY / TEST_HIST_LOG_ONE_HOUR];
+    hist_log_rollup_record_t records[TEST_HIST_LOG_ONE_DAY / TEST_HIST_LOG_ONE_HOUR];
+    uint32_t                 num_records;
+    uint32_t                 num_mismatches;
+} test_hist_log_rollup_compare_ctx_t;
+
+static bool
+test_hist_log_rollup_compare_cb(
+    const uint32_t                        timestamp,
+    const hist_log_rollup_record_t* const p_record,
+    void*                                 p_user_data)
+{
+    test_hist_log_rollup_compare_ctx_t* const p_ctx = p_user_data;
+    if ((p_ctx->num_records >= p_ctx->num_expected) || (timestamp != p_ctx->timestamps[p_ctx->num_records])
+        || (0 != memcmp(p_record, &p_ctx->records[p_ctx->num_records], sizeof(*p_record))))
+    {
+        p_ctx->num_mismatches += 1;
+    }
+    p_ctx->num_records += 1;
+    return true;
+}
+
+static void
+test_hist_log_check_rollup_after_reinit(const uint32_t num_records_before_reinit, const uint32_t num_records)
+{
+    // Only the last hours are compared, they fit into the context
+    const uint32_t num_records_per_day = TEST_HIST_LOG_ONE_DAY / TEST_HIST_LOG_PERIOD_SECONDS;
+    const uint32_t timestamp_check     = (num_records > num_records_per_day)
+                                             ? (TEST_HIST_LOG_BASE_TIMESTAMP
+                                            + ((num_records - num_records_per_day) * TEST_HIST_LOG_PERIOD_SECONDS))
+                                             : 0;
+
+    static test_hist_log_rollup_compare_ctx_t ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    hist_log_rollup_t rollup = { 0 };
+    hist_log_rollup_init(&rollup, TEST_HIST_LOG_ONE_HOUR);
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        if (num_records_before_reinit == i)
+        {
+            zassert_true(hist_log_flush());
+            zassert_true(hist_log_init(true));
+        }
+        const uint32_t                 timestamp = TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_PERIOD_SECONDS);
+        const hist_log_record_data_t   data      = test_hist_log_gen_record_data(i);
+        const hist_log_rollup_record_t record    = {
+               .mean = data,
+               .min  = data,
+               .max  = data,
+        };
+        zassert_true(hist_log_append_record(timestamp, &data, false));
+        // Independent accumulator, which is not affected by the reboot
+        if (hist_log_rollup_add(
+                &rollup,
+                timestamp,
+                &record,
+                &ctx.timestamps[ctx.num_expected],
+                &ctx.records[ctx.num_expected])
+            && (ctx.timestamps[ctx.num_expected] >= timestamp_check))
+        {
+            ctx.num_expected += 1;
+        }
+    }
+    zassert_true(ctx.num_expected > 0);
+
+    zassert_true(hist_log_read_rollup_records(
+        HIST_LOG_TIER_1HOUR,
+        &test_hist_log_rollup_compare_cb,
+        &ctx,
+        timestamp_check));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(ctx.num_expected, ctx.num_records);
+}
+
+ZTEST_F(test_suite_hist_log, test_rollup_restored_after_reinit)
+{
+    // The reboot happens in the middle of the hour, the accumulated records are restored from the 5-minute tier
+    test_hist_log_check_rollup_after_reinit(100, 200);
+}
+
+ZTEST_F(test_suite_hist_log, test_rollup_restored_after_reinit_with_checkpoint)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_CHECKPOINT);
+    // Several sectors are restored from the checkpoint, but the records of the current hour are still decoded
+    test_hist_log_check_rollup_after_reinit(3950, 4000);
+}
+
+static uint8_t g_test_hist_log_checkpoint_buf[4096];
+static size_t  g_test_hist_log_checkpoint_len;
+
+static int
+test_hist_log_checkpoint_load_cb(const char* key, size_t len, settings_read_cb read_cb, void* cb_arg, void* param)
+{
+    zassert_true(len <= sizeof(g_test_hist_log_checkpoint_buf));
+    g_test_hist_log_checkpoint_len = (size_t)read_cb(cb_arg, g_test_hist_log_checkpoint_buf, len);
+    return 0;
+}
+
+/**
+ * @brief Take a copy of the saved checkpoint, so that it can be written back to simulate a stale checkpoint.
+ */
+static void
+test_hist_log_checkpoint_copy(void)
+{
+    g_test_hist_log_checkpoint_len = 0;
+    ZASSERT_EQ_INT(
+        0,
+        settings_load_subtree_direct(HIST_LOG_CHECKPOINT_SETTINGS_KEY, &test_hist_log_checkpoint_load_cb, NULL));
+    zassert_true(g_test_hist_log_checkpoint_len > 0);
+}
+
+static void
+test_hist_log_checkpoint_restore_copy(void)
+{
+    ZASSERT_EQ_INT(
+        0,
+        settings_save_one(
+            HIST_LOG_CHECKPOINT_SETTINGS_KEY,
+            g_test_hist_log_checkpoint_buf,
+            g_test_hist_log_checkpoint_len));
+}
+
+typedef struct test_hist_log_boot_result_t
+{
+    uint32_t              num_flash_reads;
+    uint32_t              flash_read_bytes;
+    uint32_t              time_us;
+    test_hist_log_query_t query_full;
+    test_hist_log_query_t query_hour;
+    uint32_t              seq_last;
+} test_hist_log_boot_result_t;
+
+/**
+ * @brief Simulate reboot and check that the records are the same as before it.
+ */
+static test_hist_log_boot_result_t
+test_hist_log_boot(const uint32_t timestamp_last, const uint32_t num_records_total)
+{
+    test_hist_log_boot_result_t res = { 0 };
+
+    zassert_true(hist_log_flush());
+    g_test_hist_log_flash_read_cnt   = 0;
+    g_test_hist_log_flash_read_bytes = 0;
+    const int64_t ticks_start        = k_uptime_ticks();
+    zassert_true(hist_log_init(true));
+    res.time_us          = (uint32_t)k_ticks_to_us_near64(k_uptime_ticks() - ticks_start);
+    res.num_flash_reads  = g_test_hist_log_flash_read_cnt;
+    res.flash_read_bytes = g_test_hist_log_flash_read_bytes;
+
+    res.query_full = test_hist_log_query(0);
+    res.query_hour = test_hist_log_query(timestamp_last - TEST_HIST_LOG_ONE_HOUR);
+    ZASSERT_EQ_INT(timestamp_last, res.query_full.timestamp_prev);
+    ZASSERT_EQ_INT((TEST_HIST_LOG_ONE_HOUR / TEST_HIST_LOG_PERIOD_SECONDS) + 1, res.query_hour.num_records);
+
+    // The sequence numbers continue from the newest record
+    const hist_log_record_data_t data = test_hist_log_gen_record_data(0);
+    zassert_true(hist_log_append_record(timestamp_last + TEST_HIST_LOG_PERIOD_SECONDS, &data, false));
+    uint32_t seq_first = 0;
+    ZASSERT_EQ_INT(1, test_hist_log_read_after_seq(num_records_total, &seq_first, &res.seq_last));
+    ZASSERT_EQ_INT(num_records_total + 1U, res.seq_last);
+    return res;
+}
+
+ZTEST_F(test_suite_hist_log, test_boot_with_checkpoint)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_CHECKPOINT);
+    test_hist_log_unmap_flash();
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+    const test_hist_log_query_t query_full = test_hist_log_query(0);
+
+    // Normal boot: only the active sector is decoded, the other sectors are restored from the checkpoint
+    const test_hist_log_boot_result_t boot_checkpoint
+        = test_hist_log_boot(timestamp_last, TEST_HIST_LOG_NUM_FILL_RECORDS);
+    ZASSERT_EQ_INT(query_full.num_records, boot_checkpoint.query_full.num_records);
+    ZASSERT_EQ_INT(query_full.timestamp_first, boot_checkpoint.query_full.timestamp_first);
+
+    // The checkpoint is lost: all the records are decoded
+    ZASSERT_EQ_INT(0, settings_delete(HIST_LOG_CHECKPOINT_SETTINGS_KEY));
+    const test_hist_log_boot_result_t boot_full_scan
+        = test_hist_log_boot(timestamp_last + TEST_HIST_LOG_PERIOD_SECONDS, TEST_HIST_LOG_NUM_FILL_RECORDS + 1U);
+    ZASSERT_EQ_INT(query_full.num_records + 1U, boot_full_scan.query_full.num_records);
+    ZASSERT_EQ_INT(query_full.timestamp_first, boot_full_scan.query_full.timestamp_first);
+
+    printf(
+        "hist_log boot benchmark: full scan: %u flash reads, %u bytes, %u us; "
+        "checkpoint: %u flash reads, %u bytes, %u us\n",
+        (unsigned)boot_full_scan.num_flash_reads,
+        (unsigned)boot_full_scan.flash_read_bytes,
+        (unsigned)boot_full_scan.time_us,
+        (unsigned)boot_checkpoint.num_flash_reads,
+        (unsigned)boot_checkpoint.flash_read_bytes,
+        (unsigned)boot_checkpoint.time_us);
+    // fcb_init() still reads the sector headers and walks the active sector, but the closed sectors are not decoded,
+    // except the newest ones which are read to fill the RAM cache
+    zassert_true((boot_checkpoint.flash_read_bytes * (IS_ENABLED(CONFIG_RUUVI_AIR_HIST_LOG_CACHE) ? 4U : 5U))
+                 < boot_full_scan.flash_read_bytes);
+    zassert_true(boot_checkpoint.time_us < boot_full_scan.time_us);
+}
+
+ZTEST_F(test_suite_hist_log, test_boot_with_stale_checkpoint)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_CHECKPOINT);
+    uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 2000);
+    test_hist_log_checkpoint_copy();
+
+    // The checkpoint is older than the last sectors (e.g. saving it failed): the sectors after it are decoded
+    timestamp_last = test_hist_log_fill(timestamp_last + TEST_HIST_LOG_PERIOD_SECONDS, 3000);
+    test_hist_log_checkpoint_restore_copy();
+    test_hist_log_query_t       query_full = test_hist_log_query(0);
+    test_hist_log_boot_result_t boot       = test_hist_log_boot(timestamp_last, 5000);
+    ZASSERT_EQ_INT(query_full.num_records, boot.query_full.num_records);
+
+    // The active sector of the checkpoint was erased and reused: the checkpoint is ignored
+    test_hist_log_checkpoint_copy();
+    timestamp_last = test_hist_log_fill(
+        timestamp_last + (2U * TEST_HIST_LOG_PERIOD_SECONDS),
+        TEST_HIST_LOG_NUM_FILL_RECORDS);
+    test_hist_log_checkpoint_restore_copy();
+    query_full = test_hist_log_query(0);
+    boot       = test_hist_log_boot(timestamp_last, 5001U + TEST_HIST_LOG_NUM_FILL_RECORDS);
+    ZASSERT_EQ_INT(query_full.num_records, boot.query_full.num_records);
+    ZASSERT_EQ_INT(query_full.timestamp_first, boot.query_full.timestamp_first);
+}
+
+ZTEST_F(test_suite_hist_log, test_keep_history_on_rtc_loss)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS);
+    const uint32_t timestamp_last = test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 1000);
+    zassert_true(hist_log_flush());
+
+    // The RTC time was lost: the history is kept and the clock restarts from RUUVI_AIR_MIN_UNIX_TIME
+    zassert_true(hist_log_init(false));
+    ZASSERT_EQ_INT(1000, test_hist_log_query(0).num_records);
+    for (uint32_t i = 0; i < 100; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(1000U + i);
+        zassert_true(
+            hist_log_append_record(TEST_HIST_LOG_MIN_UNIX_TIME + (i * TEST_HIST_LOG_PERIOD_SECONDS), &data, false));
+    }
+    // Until the real time is known, the records of the new epoch are read with the timestamps of the local clock
+    const test_hist_log_query_t query_local = test_hist_log_query(0);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_MIN_UNIX_TIME + (99U * TEST_HIST_LOG_PERIOD_SECONDS), query_local.timestamp_prev);
+
+    // The client sends the current time: the new epoch started at the beginning of the hour after the last record
+    const uint32_t timestamp_new_base = (timestamp_last - (timestamp_last % TEST_HIST_LOG_ONE_HOUR))
+                                        + TEST_HIST_LOG_ONE_HOUR;
+    const uint32_t timestamp_new_last = timestamp_new_base + (99U * TEST_HIST_LOG_PERIOD_SECONDS);
+    ZASSERT_EQ_INT(0, hist_log_get_time_offset());
+    hist_log_rebase_time((int32_t)(timestamp_new_base - TEST_HIST_LOG_MIN_UNIX_TIME));
+    // The clock of the next client differs: the time offset of the epoch is already known and it is kept
+    hist_log_rebase_time((int32_t)(timestamp_new_base - TEST_HIST_LOG_MIN_UNIX_TIME) + TEST_HIST_LOG_ONE_HOUR);
+    ZASSERT_EQ_INT(timestamp_new_base - TEST_HIST_LOG_MIN_UNIX_TIME, hist_log_get_time_offset());
+
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const test_hist_log_query_t query_full = test_hist_log_query(0);
+        ZASSERT_EQ_INT(1100, query_full.num_records);
+        zassert_false(query_full.flag_wrong_order);
+        ZASSERT_EQ_INT(TEST_HIST_LOG_BASE_TIMESTAMP, query_full.timestamp_first);
+        ZASSERT_EQ_INT(timestamp_new_last, query_full.timestamp_prev);
+
+        const test_hist_log_query_t query_hour = test_hist_log_query(timestamp_new_last - TEST_HIST_LOG_ONE_HOUR);
+        ZASSERT_EQ_INT((TEST_HIST_LOG_ONE_HOUR / TEST_HIST_LOG_PERIOD_SECONDS) + 1U, query_hour.num_records);
+        ZASSERT_EQ_INT(timestamp_new_last - TEST_HIST_LOG_ONE_HOUR, query_hour.timestamp_first);
+        zassert_false(query_hour.flag_too_old);
+
+        // The unfinished hour of the previous epoch was completed when the new epoch started,
+        // so the hourly records continue without gaps (checked by test_hist_log_read_rollup)
+        const test_hist_log_rollup_ctx_t hours = test_hist_log_read_rollup(HIST_LOG_TIER_1HOUR, TEST_HIST_LOG_ONE_HOUR);
+        ZASSERT_EQ_INT((timestamp_new_last - TEST_HIST_LOG_BASE_TIMESTAMP) / TEST_HIST_LOG_ONE_HOUR, hours.num_records);
+
+        // The time offset of the epoch is kept after reboot
+        zassert_true(hist_log_flush());
+        zassert_true(hist_log_init(true));
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_erase_history_on_rtc_loss)
+{
+    Z_TEST_SKIP_IFDEF(CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS);
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, 100);
+    zassert_true(hist_log_flush());
+
+    zassert_true(hist_log_init(false));
+    ZASSERT_EQ_INT(0, test_hist_log_query(0).num_records);
+}
+
+// Erase time of the simulated flash, see CONFIG_FLASH_SIMULATOR_MIN_ERASE_TIME_US in prj.conf
+#define TEST_HIST_LOG_ERASE_TIME_US (45000U)
+// Idle time after writing an entry, the low-priority work queue erases the sector during it
+#define TEST_HIST_LOG_IDLE_TIME_MS   (50U)
+#define TEST_HIST_LOG_NUM_PRE_ERASES (3U)
+
+/**
+ * @brief Append the next generated record, the application is idle after the record is written to flash.
+ */
+static void
+test_hist_log_append_and_idle(const uint32_t idx, const bool flag_idle)
+{
+    const uint32_t               flash_write_cnt = g_test_hist_log_flash_write_cnt;
+    const hist_log_record_data_t data            = test_hist_log_gen_record_data(idx);
+    zassert_true(
+        hist_log_append_record(TEST_HIST_LOG_BASE_TIMESTAMP + (idx * TEST_HIST_LOG_PERIOD_SECONDS), &data, false));
+    if (flag_idle && (flash_write_cnt != g_test_hist_log_flash_write_cnt))
+    {
+        k_msleep(TEST_HIST_LOG_IDLE_TIME_MS);
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_append_latency_with_pre_erase)
+{
+    Z_TEST_SKIP_IFNDEF(CONFIG_RUUVI_AIR_HIST_LOG_PRE_ERASE);
+    // The storage is filled without idle time, so the first rotation erases the sector in the append path
+    hist_log_reset_stats();
+    hist_log_stats_t stats_inline = { 0 };
+    uint32_t         idx          = 0;
+    while ((0 == stats_inline.num_inline_erases) && (idx < TEST_HIST_LOG_NUM_FILL_RECORDS))
+    {
+        test_hist_log_append_and_idle(idx, false);
+        idx += 1;
+        hist_log_get_stats(&stats_inline);
+    }
+    ZASSERT_EQ_INT(1, stats_inline.num_inline_erases);
+
+    // The next sectors are erased in advance while the application is idle
+    hist_log_reset_stats();
+    hist_log_stats_t stats = { 0 };
+    while ((stats.num_pre_erases < TEST_HIST_LOG_NUM_PRE_ERASES) && (idx < TEST_HIST_LOG_NUM_FILL_RECORDS))
+    {
+        test_hist_log_append_and_idle(idx, true);
+        idx += 1;
+        hist_log_get_stats(&stats);
+    }
+    printf(
+        "hist_log append latency: inline erase: %u us, pre-erase: %u us (%u sectors erased in advance)\n",
+        (unsigned)stats_inline.append_time_max_us,
+        (unsigned)stats.append_time_max_us,
+        (unsigned)stats.num_pre_erases);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_NUM_PRE_ERASES, stats.num_pre_erases);
+    ZASSERT_EQ_INT(0, stats.num_inline_erases);
+    zassert_true(stats_inline.append_time_max_us >= TEST_HIST_LOG_ERASE_TIME_US);
+    zassert_true(stats.append_time_max_us < TEST_HIST_LOG_ERASE_TIME_US);
+
+    // Only the records of the erased sectors are lost
+    test_hist_log_verify_ctx_t ctx = {
+        .timestamp_base = TEST_HIST_LOG_BASE_TIMESTAMP,
+        .num_generated  = 0,
+        .num_records    = 0,
+        .num_mismatches = 0,
+    };
+    zassert_true(hist_log_read_records(&test_hist_log_verify_cb, &ctx, 0));
+    ZASSERT_EQ_INT(0, ctx.num_mismatches);
+    ZASSERT_EQ_INT(idx, ctx.num_generated);
+}
+
+#define TEST_HIST_LOG_STRESS_NUM_APPENDS       (3000U)
+#define TEST_HIST_LOG_STRESS_WRITER_IDLE_CNT   (64U) // The writer sleeps after every 64 records
+#define TEST_HIST_LOG_STRESS_READER_IDLE_CNT   (8U)  // The reader waits for the BLE TX buffers after every 8 records
+#define TEST_HIST_LOG_STRESS_READER_STACK_SIZE (4096U)
+
+K_THREAD_STACK_DEFINE(g_test_hist_log_reader_stack, TEST_HIST_LOG_STRESS_READER_STACK_SIZE);
+static struct k_thread g_test_hist_log_reader_thread;
+
+typedef struct test_hist_log_stress_reader_t
+{
+    atomic_t is_writer_done;
+    uint32_t num_passes;
+    uint32_t num_records;
+    uint32_t num_invalidated;
+    uint32_t num_gaps;
+    uint32_t num_mismatches;
+    uint32_t seq_last;
+} test_hist_log_stress_reader_t;
+
+/**
+ * @brief Generate a record which depends only on its index, so that the reader can check it without the writer.
+ */
+static hist_log_record_data_t
+test_hist_log_stress_gen_record_data(const uint32_t idx)
+{
+    // Knuth's multiplicative hash gives noisy values, so that the records are long and the sectors are rotated often
+    const uint32_t hash    = idx * 2654435761U;
+    re_e1_data_t   e1_data = re_e1_data_invalid(idx, 0);
+    e1_data.temperature_c  = 20.0f + (0.01f * (float)(hash % 1000U));
+    e1_data.humidity_rh    = 40.0f + (0.01f * (float)((hash >> 10U) % 1000U));
+    e1_data.co2            = 500.0f + (float)((hash >> 20U) % 1000U);
+
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, &e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+static void
+test_hist_log_stress_append(const uint32_t idx)
+{
+    const hist_log_record_data_t data = test_hist_log_stress_gen_record_data(idx);
+    zassert_true(
+        hist_log_append_record(TEST_HIST_LOG_BASE_TIMESTAMP + (idx * TEST_HIST_LOG_PERIOD_SECONDS), &data, false));
+}
+
+/**
+ * @brief Read the whole tier with the cursor over and over until the writer is done and the newest record is read.
+ * @details The records must be consecutive, except after the cursor reported that its sector was erased.
+ */
+static void
+test_hist_log_stress_reader(void* p1, void* p2, void* p3)
+{
+    test_hist_log_stress_reader_t* const p_reader     = p1;
+    bool                                 is_last_pass = false;
+    while (!is_last_pass)
+    {
+        // The pass which starts after the writer finished reads up to the newest record
+        is_last_pass                      = (0 != atomic_get(&p_reader->is_writer_done));
+        hist_log_cursor_t* const p_cursor = hist_log_cursor_open_after_seq(HIST_LOG_TIER_5MIN, 0);
+        if (NULL == p_cursor)
+        {
+            p_reader->num_mismatches += 1;
+            return;
+        }
+        uint32_t                 seq_prev  = 0;
+        uint32_t                 timestamp = 0;
+        uint32_t                 seq       = 0;
+        hist_log_rollup_record_t record    = { 0 };
+        while (true)
+        {
+            const hist_log_cursor_status_e status = hist_log_cursor_next(p_cursor, &timestamp, &seq, &record);
+            if (HIST_LOG_CURSOR_STATUS_END == status)
+            {
+                break;
+            }
+            if (HIST_LOG_CURSOR_STATUS_INVALIDATED == status)
+            {
+                // The rotation is reported, the reading continues from the oldest record
+                p_reader->num_invalidated += 1;
+                seq_prev = 0;
+                continue;
+            }
+            if ((0 != seq_prev) && (seq != (seq_prev + 1U)))
+            {
+                p_reader->num_gaps += 1;
+            }
+            // Sequence numbers start from 1 after the storage is erased
+            const hist_log_record_data_t data = test_hist_log_stress_gen_record_data(seq - 1U);
+            if ((timestamp != (TEST_HIST_LOG_BASE_TIMESTAMP + ((seq - 1U) * TEST_HIST_LOG_PERIOD_SECONDS)))
+                || (0 != memcmp(&data, &record.mean, sizeof(data))))
+            {
+                p_reader->num_mismatches += 1;
+            }
+            seq_prev = seq;
+            p_reader->num_records += 1;
+            if (0 == (p_reader->num_records % TEST_HIST_LOG_STRESS_READER_IDLE_CNT))
+            {
+                k_msleep(1);
+            }
+            else
+            {
+                k_yield();
+            }
+        }
+        hist_log_cursor_close(p_cursor);
+        p_reader->seq_last = seq_prev;
+        p_reader->num_passes += 1;
+        k_yield();
+    }
+}
+
+ZTEST_F(test_suite_hist_log, test_stress_reader_and_writer)
+{
+    // The storage is filled, so that the sectors are rotated while the reader is inside them
+    hist_log_reset_stats();
+    uint32_t idx = 0;
+    while (idx < TEST_HIST_LOG_NUM_FILL_RECORDS)
+    {
+        test_hist_log_stress_append(idx);
+        idx += 1;
+        hist_log_stats_t stats = { 0 };
+        hist_log_get_stats(&stats);
+        if (0 != stats.num_inline_erases)
+        {
+            break;
+        }
+    }
+    hist_log_reset_stats();
+
+    static test_hist_log_stress_reader_t reader;
+    memset(&reader, 0, sizeof(reader));
+    (void)k_thread_create(
+        &g_test_hist_log_reader_thread,
+        g_test_hist_log_reader_stack,
+        K_THREAD_STACK_SIZEOF(g_test_hist_log_reader_stack),
+        &test_hist_log_stress_reader,
+        &reader,
+        NULL,
+        NULL,
+        k_thread_priority_get(k_current_get()),
+        0,
+        K_NO_WAIT);
+
+    // The writer appends records at a much higher rate than the reader can read them
+    const uint32_t idx_end = idx + TEST_HIST_LOG_STRESS_NUM_APPENDS;
+    while (idx < idx_end)
+    {
+        test_hist_log_stress_append(idx);
+        idx += 1;
+        if (0 == (idx % TEST_HIST_LOG_STRESS_WRITER_IDLE_CNT))
+        {
+            k_msleep(1);
+        }
+        else
+        {
+            k_yield();
+        }
+    }
+    zassert_true(hist_log_flush());
+    atomic_set(&reader.is_writer_done, 1);
+    ZASSERT_EQ_INT(0, k_thread_join(&g_test_hist_log_reader_thread, K_FOREVER));
+
+    hist_log_stats_t stats = { 0 };
+    hist_log_get_stats(&stats);
+    printf(
+        "hist_log stress: %u appends, reader: %u passes, %u records, %u invalidated; "
+        "pre-erases: %u (%u deferred), inline erases: %u, max append time: %u us\n",
+        (unsigned)TEST_HIST_LOG_STRESS_NUM_APPENDS,
+        (unsigned)reader.num_passes,
+        (unsigned)reader.num_records,
+        (unsigned)reader.num_invalidated,
+        (unsigned)stats.num_pre_erases,
+        (unsigned)stats.num_pre_erases_deferred,
+        (unsigned)stats.num_inline_erases,
+        (unsigned)stats.append_time_max_us);
+    ZASSERT_EQ_INT(0, reader.num_mismatches);
+    ZASSERT_EQ_INT(0, reader.num_gaps);
+    zassert_true(reader.num_passes >= 2U);
+    // The last pass started after the writer finished, so it read up to the newest record
+    ZASSERT_EQ_INT(idx, reader.seq_last);
+}
+
+// The fixed-slot prototype is benchmarked in its own partition, see boards/native_sim.overlay
+#define TEST_HIST_LOG_STORE_AREA_ID          FIXED_PARTITION_ID(hist_store_test)
+#define TEST_HIST_LOG_STORE_NUM_SECTORS      (16U)
+#define TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR ((uint32_t)HIST_LOG_STORE_SLOTS_PER_SECTOR)
+
+typedef struct test_hist_log_store_bench_t
+{
+    uint32_t num_records;        //!< Records kept after the ring was filled
+    uint32_t records_per_sector; //!< Records kept per sector of the ring, except the one which is erased
+    uint32_t append_time_us;     //!< Time to append TEST_HIST_LOG_NUM_FILL_RECORDS records
+    uint32_t scan_time_us;       //!< Time to read all the kept records
+    uint32_t seek_time_us;       //!< Time to find the middle record by its timestamp and read it
+} test_hist_log_store_bench_t;
+
+static uint32_t
+test_hist_log_get_elapsed_us(const int64_t ticks_start)
+{
+    return (uint32_t)k_ticks_to_us_near64(k_uptime_ticks() - ticks_start);
+}
+
+static test_hist_log_store_bench_t
+test_hist_log_bench_hist_log(void)
+{
+    test_hist_log_store_bench_t bench = { 0 };
+
+    int64_t ticks_start = k_uptime_ticks();
+    (void)test_hist_log_fill(TEST_HIST_LOG_BASE_TIMESTAMP, TEST_HIST_LOG_NUM_FILL_RECORDS);
+    zassert_true(hist_log_flush());
+    bench.append_time_us = test_hist_log_get_elapsed_us(ticks_start);
+
+    uint32_t                 ts_first = 0;
+    uint32_t                 ts       = 0;
+    uint32_t                 seq      = 0;
+    hist_log_rollup_record_t record   = { 0 };
+
+    ticks_start                 = k_uptime_ticks();
+    hist_log_cursor_t* p_cursor = hist_log_cursor_open(HIST_LOG_TIER_5MIN, 0);
+    zassert_not_null(p_cursor);
+    while (HIST_LOG_CURSOR_STATUS_OK == hist_log_cursor_next(p_cursor, &ts, &seq, &record))
+    {
+        if (0 == bench.num_records)
+        {
+            ts_first = ts;
+        }
+        bench.num_records += 1;
+    }
+    hist_log_cursor_close(p_cursor);
+    bench.scan_time_us       = test_hist_log_get_elapsed_us(ticks_start);
+    bench.records_per_sector = bench.num_records / (TEST_HIST_LOG_TIER_5MIN_NUM_SECTORS - 1U);
+
+    const uint32_t ts_middle = ts_first + ((bench.num_records / 2U) * TEST_HIST_LOG_PERIOD_SECONDS);
+    ticks_start              = k_uptime_ticks();
+    p_cursor                 = hist_log_cursor_open(HIST_LOG_TIER_5MIN, ts_middle);
+    zassert_not_null(p_cursor);
+    ZASSERT_EQ_INT(HIST_LOG_CURSOR_STATUS_OK, hist_log_cursor_next(p_cursor, &ts, &seq, &record));
+    hist_log_cursor_close(p_cursor);
+    bench.seek_time_us = test_hist_log_get_elapsed_us(ticks_start);
+    ZASSERT_EQ_INT(ts_middle, ts);
+    return bench;
+}
+
+static test_hist_log_store_bench_t
+test_hist_log_bench_store(void)
+{
+    test_hist_log_store_bench_t bench = { 0 };
+    hist_log_store_t            store = { 0 };
+    zassert_true(hist_log_store_init(&store, TEST_HIST_LOG_STORE_AREA_ID, 0, TEST_HIST_LOG_STORE_NUM_SECTORS));
+    zassert_true(hist_log_store_erase(&store));
+
+    int64_t ticks_start = k_uptime_ticks();
+    for (uint32_t i = 0; i < TEST_HIST_LOG_NUM_FILL_RECORDS; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_gen_record_data(i);
+        zassert_true(
+            hist_log_store_append(&store, TEST_HIST_LOG_BASE_TIMESTAMP + (i * TEST_HIST_LOG_PERIOD_SECONDS), &data));
+    }
+    bench.append_time_us = test_hist_log_get_elapsed_us(ticks_start);
+
+    uint32_t               ts   = 0;
+    hist_log_record_data_t data = { 0 };
+
+    ticks_start = k_uptime_ticks();
+    for (uint32_t seq = hist_log_store_get_seq_first(&store); seq < hist_log_store_get_seq_next(&store); ++seq)
+    {
+        ZASSERT_EQ_INT(HIST_LOG_STORE_STATUS_OK, hist_log_store_read(&store, seq, &ts, &data));
+        bench.num_records += 1;
+    }
+    bench.scan_time_us       = test_hist_log_get_elapsed_us(ticks_start);
+    bench.records_per_sector = bench.num_records / (TEST_HIST_LOG_STORE_NUM_SECTORS - 1U);
+
+    const uint32_t ts_middle = ts - (((bench.num_records - 1U) / 2U) * TEST_HIST_LOG_PERIOD_SECONDS);
+    ticks_start              = k_uptime_ticks();
+    const uint32_t seq       = hist_log_store_find(&store, ts_middle);
+    ZASSERT_EQ_INT(HIST_LOG_STORE_STATUS_OK, hist_log_store_read(&store, seq, &ts, &data));
+    bench.seek_time_us = test_hist_log_get_elapsed_us(ticks_start);
+    ZASSERT_EQ_INT(ts_middle, ts);
+    return bench;
+}
+
+ZTEST_F(test_suite_hist_log, test_benchmark_vs_fixed_slot_store)
+{
+    const test_hist_log_store_bench_t bench_hist_log = test_hist_log_bench_hist_log();
+    const test_hist_log_store_bench_t bench_store    = test_hist_log_bench_store();
+
+    printf(
+        "hist_log vs fixed-slot store: %u appends: hist_log: append %u us, scan %u records %u us, seek %u us, "
+        "%u records/sector; store: append %u us, scan %u records %u us, seek %u us, %u records/sector\n",
+        (unsigned)TEST_HIST_LOG_NUM_FILL_RECORDS,
+        (unsigned)bench_hist_log.append_time_us,
+        (unsigned)bench_hist_log.num_records,
+        (unsigned)bench_hist_log.scan_time_us,
+        (unsigned)bench_hist_log.seek_time_us,
+        (unsigned)bench_hist_log.records_per_sector,
+        (unsigned)bench_store.append_time_us,
+        (unsigned)bench_store.num_records,
+        (unsigned)bench_store.scan_time_us,
+        (unsigned)bench_store.seek_time_us,
+        (unsigned)bench_store.records_per_sector);
+
+    // The delta-encoded batches of hist_log keep about twice as many records per sector as the fixed slots
+    ZASSERT_EQ_INT(
+        ((TEST_HIST_LOG_STORE_NUM_SECTORS - 1U) * TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR)
+            + (TEST_HIST_LOG_NUM_FILL_RECORDS % TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR),
+        bench_store.num_records);
+    zassert_true(bench_hist_log.records_per_sector > (3U * bench_store.records_per_sector / 2U));
+}
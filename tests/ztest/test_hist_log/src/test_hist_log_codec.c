@@ -0,0 +1,223 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "hist_log_codec.h"
+#include "zassert.h"
+
+ZTEST_SUITE(test_suite_hist_log_codec, NULL, NULL, NULL, NULL, NULL);
+
+static hist_log_record_data_t
+test_hist_log_codec_gen_data(const uint32_t idx)
+{
+    hist_log_record_data_t data = { 0 };
+    memset(data.buf, 0xFF, sizeof(data.buf));
+    data.buf[0] = 0xE1;
+    // Temperature: slowly changing signed value crossing zero
+    const int16_t temperature = (int16_t)((int32_t)(idx % 40U) * 10 - 200);
+    data.buf[1]               = (uint8_t)((uint16_t)temperature >> 8U);
+    data.buf[2]               = (uint8_t)((uint16_t)temperature & 0xFFU);
+    // CO2: wraps around the field size
+    const uint16_t co2 = (uint16_t)(0xFFF0U + (idx * 3U));
+    data.buf[15]       = (uint8_t)(co2 >> 8U);
+    data.buf[16]       = (uint8_t)(co2 & 0xFFU);
+    // Sequence counter: incremented by a constant step
+    const uint32_t seq = idx * 300U;
+    data.buf[25]       = (uint8_t)(seq >> 16U);
+    data.buf[26]       = (uint8_t)(seq >> 8U);
+    data.buf[27]       = (uint8_t)seq;
+    return data;
+}
+
+ZTEST(test_suite_hist_log_codec, test_round_trip)
+{
+    hist_log_codec_state_t enc_state = { 0 };
+    hist_log_codec_state_t dec_state = { 0 };
+    hist_log_codec_reset(&enc_state);
+    hist_log_codec_reset(&dec_state);
+
+    uint32_t timestamp = 1735689600U;
+    size_t   total_len = 0;
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        // Irregular time interval sometimes, the clock can also be set back
+        timestamp += (0 == (i % 97)) ? 17U : 300U;
+        if (500 == i)
+        {
+            timestamp -= 3600U;
+        }
+        const hist_log_record_data_t data = test_hist_log_codec_gen_data(i);
+
+        uint8_t      buf[HIST_LOG_CODEC_MAX_FRAME_LEN];
+        const size_t len = hist_log_codec_encode(&enc_state, timestamp, i, &data, 0 == (i % 200), buf);
+        zassert_true(len <= HIST_LOG_CODEC_MAX_FRAME_LEN);
+        if (0 == (i % 200))
+        {
+            ZASSERT_EQ_INT((int)HIST_LOG_CODEC_KEY_FRAME_LEN, (int)len);
+        }
+        total_len += len;
+
+        uint32_t               dec_timestamp = 0;
+        uint32_t               dec_seq       = 0;
+        hist_log_record_data_t dec_data      = { 0 };
+        zassert_true(hist_log_codec_decode(&dec_state, buf, len, &dec_timestamp, &dec_seq, &dec_data));
+        ZASSERT_EQ_INT(timestamp, dec_timestamp);
+        ZASSERT_EQ_INT(i, dec_seq);
+        zassert_mem_equal(&data, &dec_data, sizeof(data));
+    }
+    printf("hist_log_codec: average frame length: %u bytes\n", (unsigned)(total_len / 1000));
+    zassert_true(total_len < (1000 * 10));
+}
+
+ZTEST(test_suite_hist_log_codec, test_concatenated_frames)
+{
+    hist_log_codec_state_t enc_state = { 0 };
+    hist_log_codec_state_t dec_state = { 0 };
+    hist_log_codec_reset(&enc_state);
+    hist_log_codec_reset(&dec_state);
+
+    // Frames are stored back to back, the decoder must find the frame boundaries itself
+    uint8_t buf[16 * HIST_LOG_CODEC_MAX_FRAME_LEN];
+    size_t  len = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_codec_gen_data(i);
+        len += hist_log_codec_encode(&enc_state, 1000 + (i * 300), i, &data, 8 == i, &buf[len]);
+    }
+
+    size_t pos = 0;
+    for (uint32_t i = 0; i < 16; ++i)
+    {
+        const hist_log_record_data_t data          = test_hist_log_codec_gen_data(i);
+        uint32_t                     dec_timestamp = 0;
+        uint32_t                     dec_seq       = 0;
+        hist_log_record_data_t       dec_data      = { 0 };
+        const size_t                 frame_len
+            = hist_log_codec_decode(&dec_state, &buf[pos], len - pos, &dec_timestamp, &dec_seq, &dec_data);
+        zassert_true(0 != frame_len);
+        ZASSERT_EQ_INT(1000 + (i * 300), dec_timestamp);
+        ZASSERT_EQ_INT(i, dec_seq);
+        zassert_mem_equal(&data, &dec_data, sizeof(data));
+        pos += frame_len;
+    }
+    ZASSERT_EQ_INT((int)len, (int)pos);
+
+    // Truncated key frame
+    uint32_t               dec_timestamp = 0;
+    uint32_t               dec_seq       = 0;
+    hist_log_record_data_t dec_data      = { 0 };
+    zassert_false(
+        hist_log_codec_decode(&dec_state, buf, HIST_LOG_CODEC_KEY_FRAME_LEN - 1, &dec_timestamp, &dec_seq, &dec_data));
+}
+
+ZTEST(test_suite_hist_log_codec, test_fallback_to_key_frame)
+{
+    hist_log_codec_state_t enc_state = { 0 };
+    hist_log_codec_reset(&enc_state);
+
+    hist_log_record_data_t data = test_hist_log_codec_gen_data(0);
+    uint8_t                buf[HIST_LOG_CODEC_MAX_FRAME_LEN];
+
+    // The first record is always a key frame
+    ZASSERT_EQ_INT(
+        (int)HIST_LOG_CODEC_KEY_FRAME_LEN,
+        (int)hist_log_codec_encode(&enc_state, 1000, 0, &data, false, buf));
+
+    // All the fields are changed a lot - a delta frame would be longer than a key frame
+    for (uint32_t i = 0; i < sizeof(data.buf); ++i)
+    {
+        data.buf[i] ^= 0x55U;
+    }
+    const size_t len = hist_log_codec_encode(&enc_state, 0x80001000U, 1, &data, false, buf);
+    ZASSERT_EQ_INT((int)HIST_LOG_CODEC_KEY_FRAME_LEN, (int)len);
+
+    hist_log_codec_state_t dec_state = { 0 };
+    hist_log_codec_reset(&dec_state);
+    uint32_t               dec_timestamp = 0;
+    uint32_t               dec_seq       = 0;
+    hist_log_record_data_t dec_data      = { 0 };
+    zassert_true(
+        hist_log_codec_decode(&dec_state, buf, HIST_LOG_CODEC_KEY_FRAME_LEN, &dec_timestamp, &dec_seq, &dec_data));
+    ZASSERT_EQ_INT(0x80001000U, dec_timestamp);
+    ZASSERT_EQ_INT(1, dec_seq);
+    zassert_mem_equal(&data, &dec_data, sizeof(data));
+}
+
+ZTEST(test_suite_hist_log_codec, test_corrupted_frame)
+{
+    hist_log_codec_state_t enc_state = { 0 };
+    hist_log_codec_state_t dec_state = { 0 };
+    hist_log_codec_reset(&enc_state);
+    hist_log_codec_reset(&dec_state);
+
+    uint8_t                frames[4][HIST_LOG_CODEC_MAX_FRAME_LEN];
+    size_t                 lens[4]       = { 0 };
+    uint32_t               dec_timestamp = 0;
+    uint32_t               dec_seq       = 0;
+    hist_log_record_data_t dec_data      = { 0 };
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_codec_gen_data(i);
+
+        lens[i] = hist_log_codec_encode(&enc_state, 1000 + (i * 300), i, &data, 3 == i, frames[i]);
+    }
+    ZASSERT_EQ_INT((int)HIST_LOG_CODEC_KEY_FRAME_LEN, (int)lens[0]);
+    zassert_true(lens[1] < HIST_LOG_CODEC_KEY_FRAME_LEN);
+    zassert_true(lens[2] < HIST_LOG_CODEC_KEY_FRAME_LEN);
+    ZASSERT_EQ_INT((int)HIST_LOG_CODEC_KEY_FRAME_LEN, (int)lens[3]);
+
+    // A delta frame can't be decoded without the preceding key frame
+    zassert_false(hist_log_codec_decode(&dec_state, frames[1], lens[1], &dec_timestamp, &dec_seq, &dec_data));
+
+    zassert_true(hist_log_codec_decode(&dec_state, frames[0], lens[0], &dec_timestamp, &dec_seq, &dec_data));
+    frames[1][0] ^= 0x01U;
+    zassert_false(hist_log_codec_decode(&dec_state, frames[1], lens[1], &dec_timestamp, &dec_seq, &dec_data));
+    zassert_false(dec_state.is_valid);
+    // The next delta frame is rejected, since the previous record is lost
+    zassert_false(hist_log_codec_decode(&dec_state, frames[2], lens[2], &dec_timestamp, &dec_seq, &dec_data));
+    // Decoding is resumed from the next key frame
+    zassert_true(hist_log_codec_decode(&dec_state, frames[3], lens[3], &dec_timestamp, &dec_seq, &dec_data));
+    ZASSERT_EQ_INT(1000 + (3 * 300), dec_timestamp);
+
+    // Erased flash
+    uint8_t erased[HIST_LOG_CODEC_KEY_FRAME_LEN];
+    memset(erased, 0xFF, sizeof(erased));
+    zassert_false(hist_log_codec_decode(&dec_state, erased, sizeof(erased), &dec_timestamp, &dec_seq, &dec_data));
+}
+
+ZTEST(test_suite_hist_log_codec, test_seq_gap)
+{
+    hist_log_codec_state_t enc_state = { 0 };
+    hist_log_codec_state_t dec_state = { 0 };
+    hist_log_codec_reset(&enc_state);
+    hist_log_codec_reset(&dec_state);
+
+    // The sequence number of a delta frame is implied, so a gap in the sequence forces a key frame
+    const uint32_t seqs[] = { 100, 101, 102, 110, 111 };
+    for (uint32_t i = 0; i < (sizeof(seqs) / sizeof(seqs[0])); ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_codec_gen_data(i);
+        uint8_t                      buf[HIST_LOG_CODEC_MAX_FRAME_LEN];
+        const size_t                 len
+            = hist_log_codec_encode(&enc_state, 1000 + (i * 300), seqs[i], &data, false, buf);
+        if ((0 == i) || (3 == i))
+        {
+            ZASSERT_EQ_INT((int)HIST_LOG_CODEC_KEY_FRAME_LEN, (int)len);
+        }
+        else
+        {
+            zassert_true(len < HIST_LOG_CODEC_KEY_FRAME_LEN);
+        }
+
+        uint32_t               dec_timestamp = 0;
+        uint32_t               dec_seq       = 0;
+        hist_log_record_data_t dec_data      = { 0 };
+        zassert_true(hist_log_codec_decode(&dec_state, buf, len, &dec_timestamp, &dec_seq, &dec_data));
+        ZASSERT_EQ_INT(seqs[i], dec_seq);
+        zassert_mem_equal(&data, &dec_data, sizeof(data));
+    }
+}
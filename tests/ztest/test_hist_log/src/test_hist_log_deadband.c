@@ -0,0 +1,446 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "hist_log_deadband.h"
+#include "hist_log_codec.h"
+#include "hist_log_zone_map.h"
+#include "ruuvi_endpoint_e1.h"
+#include "zassert.h"
+
+#define TEST_DEADBAND_SHORT_WINDOW_S    (20U)
+#define TEST_DEADBAND_WINDOW_S          (300U)
+#define TEST_DEADBAND_SHORTS_PER_WINDOW (TEST_DEADBAND_WINDOW_S / TEST_DEADBAND_SHORT_WINDOW_S)
+#define TEST_DEADBAND_TRACE_S           (24U * 60U * 60U)
+#define TEST_DEADBAND_NUM_SAMPLES       (TEST_DEADBAND_TRACE_S / TEST_DEADBAND_SHORT_WINDOW_S)
+#define TEST_DEADBAND_TIMESTAMP_START   (1735689600U) // 2025-01-01 00:00:00
+#define TEST_DEADBAND_MAX_INTERVAL_S    (1800U)
+
+#define TEST_DEADBAND_PI (3.14159265f)
+
+ZTEST_SUITE(test_suite_hist_log_deadband, NULL, NULL, NULL, NULL, NULL);
+
+static const hist_log_deadband_cfg_t g_test_deadband_cfg = {
+    .tolerance = {
+        [HIST_LOG_FIELD_TEMPERATURE] = 0.5f,
+        [HIST_LOG_FIELD_HUMIDITY]    = 3.0f,
+        [HIST_LOG_FIELD_PM2P5]       = 5.0f,
+        [HIST_LOG_FIELD_CO2]         = 100.0f,
+        [HIST_LOG_FIELD_VOC]         = 25.0f,
+        [HIST_LOG_FIELD_NOX]         = 10.0f,
+        [HIST_LOG_FIELD_SOUND_AVG]   = 6.0f,
+    },
+    .max_interval_s = TEST_DEADBAND_MAX_INTERVAL_S,
+};
+
+static hist_log_record_data_t
+test_deadband_encode(const float32_t* const p_values)
+{
+    re_e1_data_t e1_data  = re_e1_data_invalid(0, 0);
+    e1_data.temperature_c = p_values[HIST_LOG_FIELD_TEMPERATURE];
+    e1_data.humidity_rh   = p_values[HIST_LOG_FIELD_HUMIDITY];
+    e1_data.pm2p5_ppm     = p_values[HIST_LOG_FIELD_PM2P5];
+    e1_data.co2           = p_values[HIST_LOG_FIELD_CO2];
+    e1_data.voc           = p_values[HIST_LOG_FIELD_VOC];
+    e1_data.nox           = p_values[HIST_LOG_FIELD_NOX];
+    e1_data.sound_avg_dba = p_values[HIST_LOG_FIELD_SOUND_AVG];
+
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, &e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+static hist_log_record_data_t
+test_deadband_gen_record(const float32_t temperature_c, const float32_t co2)
+{
+    const float32_t values[HIST_LOG_NUM_FIELDS] = {
+        [HIST_LOG_FIELD_TEMPERATURE] = temperature_c,
+        [HIST_LOG_FIELD_HUMIDITY]    = 40.0f,
+        [HIST_LOG_FIELD_PM2P5]       = 3.0f,
+        [HIST_LOG_FIELD_CO2]         = co2,
+        [HIST_LOG_FIELD_VOC]         = 100.0f,
+        [HIST_LOG_FIELD_NOX]         = 1.0f,
+        [HIST_LOG_FIELD_SOUND_AVG]   = 35.0f,
+    };
+    return test_deadband_encode(values);
+}
+
+ZTEST(test_suite_hist_log_deadband, test_first_point_and_max_interval)
+{
+    hist_log_deadband_t deadband = { 0 };
+    hist_log_deadband_init(&deadband, &g_test_deadband_cfg);
+
+    const hist_log_record_data_t record = test_deadband_gen_record(21.0f, 450.0f);
+    uint32_t                     ts     = TEST_DEADBAND_TIMESTAMP_START;
+    // The first point is logged at the end of the full window
+    zassert_false(hist_log_deadband_check_event(&deadband, ts, &record));
+    zassert_true(hist_log_deadband_check_window(&deadband, ts, &record));
+
+    // The stable values are logged only once per max interval
+    for (uint32_t i = 1; i < (TEST_DEADBAND_MAX_INTERVAL_S / TEST_DEADBAND_WINDOW_S); ++i)
+    {
+        ts += TEST_DEADBAND_WINDOW_S;
+        zassert_false(hist_log_deadband_check_event(&deadband, ts, &record));
+        zassert_false(hist_log_deadband_check_window(&deadband, ts, &record));
+    }
+    ts += TEST_DEADBAND_WINDOW_S;
+    zassert_true(hist_log_deadband_check_window(&deadband, ts, &record));
+
+    // If the clock is moved back, the record is logged
+    zassert_true(hist_log_deadband_check_window(&deadband, ts - TEST_DEADBAND_WINDOW_S, &record));
+}
+
+ZTEST(test_suite_hist_log_deadband, test_event)
+{
+    hist_log_deadband_t deadband = { 0 };
+    hist_log_deadband_init(&deadband, &g_test_deadband_cfg);
+
+    uint32_t               ts     = TEST_DEADBAND_TIMESTAMP_START;
+    uint32_t               ts_ref = ts;
+    hist_log_record_data_t record = test_deadband_gen_record(21.0f, 450.0f);
+    zassert_true(hist_log_deadband_check_window(&deadband, ts, &record));
+
+    // Within the tolerance band
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    record = test_deadband_gen_record(21.4f, 549.0f);
+    zassert_false(hist_log_deadband_check_event(&deadband, ts, &record));
+
+    // CO2 leaves the band, the point becomes the new reference
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    record = test_deadband_gen_record(21.0f, 1200.0f);
+    zassert_true(hist_log_deadband_check_event(&deadband, ts, &record));
+    zassert_false(hist_log_deadband_check_event(&deadband, ts + TEST_DEADBAND_SHORT_WINDOW_S, &record));
+    ZASSERT_EQ_INT(ts, deadband.timestamp_ref);
+    ts_ref = ts;
+
+    // The temperature drops below the band
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    record = test_deadband_gen_record(20.4f, 1200.0f);
+    zassert_true(hist_log_deadband_check_event(&deadband, ts, &record));
+    zassert_not_equal(ts_ref, deadband.timestamp_ref);
+}
+
+ZTEST(test_suite_hist_log_deadband, test_invalid_values)
+{
+    hist_log_deadband_t deadband = { 0 };
+    hist_log_deadband_init(&deadband, &g_test_deadband_cfg);
+
+    uint32_t               ts     = TEST_DEADBAND_TIMESTAMP_START;
+    hist_log_record_data_t record = test_deadband_gen_record(NAN, 450.0f);
+    zassert_true(hist_log_deadband_check_window(&deadband, ts, &record));
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    zassert_false(hist_log_deadband_check_event(&deadband, ts, &record));
+
+    // The sensor becomes valid
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    record = test_deadband_gen_record(21.0f, 450.0f);
+    zassert_true(hist_log_deadband_check_event(&deadband, ts, &record));
+
+    // The field with zero tolerance is ignored
+    hist_log_deadband_cfg_t cfg       = g_test_deadband_cfg;
+    cfg.tolerance[HIST_LOG_FIELD_CO2] = 0.0f;
+    hist_log_deadband_init(&deadband, &cfg);
+    zassert_true(hist_log_deadband_check_window(&deadband, ts, &record));
+    ts += TEST_DEADBAND_SHORT_WINDOW_S;
+    record = test_deadband_gen_record(21.0f, 5000.0f);
+    zassert_false(hist_log_deadband_check_event(&deadband, ts, &record));
+}
+
+/* ---------------------------------------------------------------------------------------------------------------- */
+/* Evaluation of the deadband logging on traces of the 20-second averages                                           */
+/* ---------------------------------------------------------------------------------------------------------------- */
+
+typedef void (*test_deadband_trace_gen_t)(const uint32_t time_s, uint32_t* const p_rand, float32_t* const p_values);
+
+typedef struct test_deadband_trace_t
+{
+    const char*               p_name;
+    test_deadband_trace_gen_t gen;
+} test_deadband_trace_t;
+
+typedef struct test_deadband_log_t
+{
+    uint32_t               num_points;
+    size_t                 num_bytes;
+    hist_log_codec_state_t codec_state;
+    uint32_t               timestamps[TEST_DEADBAND_NUM_SAMPLES];
+    float32_t              values[TEST_DEADBAND_NUM_SAMPLES][HIST_LOG_NUM_FIELDS];
+} test_deadband_log_t;
+
+typedef struct test_deadband_error_t
+{
+    float32_t rms[HIST_LOG_NUM_FIELDS];
+    float32_t max[HIST_LOG_NUM_FIELDS];
+} test_deadband_error_t;
+
+static uint32_t               g_test_deadband_timestamps[TEST_DEADBAND_NUM_SAMPLES];
+static float32_t              g_test_deadband_samples[TEST_DEADBAND_NUM_SAMPLES][HIST_LOG_NUM_FIELDS];
+static test_deadband_log_t    g_test_deadband_log_fixed;
+static test_deadband_log_t    g_test_deadband_log_deadband;
+static hist_log_record_data_t g_test_deadband_records[TEST_DEADBAND_NUM_SAMPLES];
+
+static float32_t
+test_deadband_noise(uint32_t* const p_rand, const float32_t amplitude)
+{
+    *p_rand = (*p_rand * 1103515245U) + 12345U;
+    return amplitude * (((float32_t)((*p_rand >> 16U) & 0x7FFFU) / 16383.5f) - 1.0f);
+}
+
+static float32_t
+test_deadband_daily_wave(const uint32_t time_s)
+{
+    return sinf((2.0f * TEST_DEADBAND_PI * (float32_t)time_s) / (float32_t)TEST_DEADBAND_TRACE_S);
+}
+
+/**
+ * @brief Night in an empty room: all the values are stable, only the sensor noise is present.
+ */
+static void
+test_deadband_trace_stable(const uint32_t time_s, uint32_t* const p_rand, float32_t* const p_values)
+{
+    p_values[HIST_LOG_FIELD_TEMPERATURE] = 21.5f + (0.2f * test_deadband_daily_wave(time_s))
+                                           + test_deadband_noise(p_rand, 0.05f);
+    p_values[HIST_LOG_FIELD_HUMIDITY]  = 40.0f + test_deadband_noise(p_rand, 0.5f);
+    p_values[HIST_LOG_FIELD_PM2P5]     = 3.0f + test_deadband_noise(p_rand, 0.5f);
+    p_values[HIST_LOG_FIELD_CO2]       = 450.0f + test_deadband_noise(p_rand, 10.0f);
+    p_values[HIST_LOG_FIELD_VOC]       = 100.0f + test_deadband_noise(p_rand, 3.0f);
+    p_values[HIST_LOG_FIELD_NOX]       = 1.0f;
+    p_values[HIST_LOG_FIELD_SOUND_AVG] = 32.0f + test_deadband_noise(p_rand, 1.0f);
+}
+
+/**
+ * @brief Office day: CO2 rises during the working hours, a door is opened for 2 minutes at 10:00,
+ * and PM2.5 rises for 10 minutes at 12:00 when the lunch is cooked.
+ */
+static void
+test_deadband_trace_office(const uint32_t time_s, uint32_t* const p_rand, float32_t* const p_values)
+{
+    const uint32_t hour_s    = 60U * 60U;
+    const bool     is_occupy = (time_s >= (8U * hour_s)) && (time_s < (17U * hour_s));
+    const float32_t occupancy = is_occupy ? (1.0f - expf(-(float32_t)(time_s - (8U * hour_s)) / (float32_t)hour_s))
+                                          : 0.0f;
+
+    float32_t co2 = 450.0f + (650.0f * occupancy) + test_deadband_noise(p_rand, 10.0f);
+    if ((time_s >= (10U * hour_s)) && (time_s < ((10U * hour_s) + 120U)))
+    {
+        co2 += 700.0f;
+    }
+    float32_t pm2p5 = 4.0f + test_deadband_noise(p_rand, 0.5f);
+    if ((time_s >= (12U * hour_s)) && (time_s < ((12U * hour_s) + 600U)))
+    {
+        pm2p5 += 40.0f;
+    }
+    p_values[HIST_LOG_FIELD_TEMPERATURE] = 21.0f + (1.5f * occupancy) + test_deadband_noise(p_rand, 0.05f);
+    p_values[HIST_LOG_FIELD_HUMIDITY]    = 38.0f + (6.0f * occupancy) + test_deadband_noise(p_rand, 0.5f);
+    p_values[HIST_LOG_FIELD_PM2P5]       = pm2p5;
+    p_values[HIST_LOG_FIELD_CO2]         = co2;
+    p_values[HIST_LOG_FIELD_VOC]         = 100.0f + (80.0f * occupancy) + test_deadband_noise(p_rand, 3.0f);
+    p_values[HIST_LOG_FIELD_NOX]         = 1.0f;
+    p_values[HIST_LOG_FIELD_SOUND_AVG]   = 32.0f + (20.0f * occupancy) + test_deadband_noise(p_rand, 1.0f);
+}
+
+static void
+test_deadband_gen_trace(const test_deadband_trace_t* const p_trace)
+{
+    uint32_t rand = 1;
+    for (uint32_t i = 0; i < TEST_DEADBAND_NUM_SAMPLES; ++i)
+    {
+        const uint32_t time_s = (i + 1U) * TEST_DEADBAND_SHORT_WINDOW_S;
+        float32_t      values[HIST_LOG_NUM_FIELDS];
+        p_trace->gen(time_s, &rand, values);
+        g_test_deadband_timestamps[i] = TEST_DEADBAND_TIMESTAMP_START + time_s;
+        g_test_deadband_records[i]    = test_deadband_encode(values);
+        // The reference values are quantized in the same way as the logged records
+        hist_log_fields_decode(&g_test_deadband_records[i], g_test_deadband_samples[i]);
+    }
+}
+
+static void
+test_deadband_log_init(test_deadband_log_t* const p_log)
+{
+    p_log->num_points = 0;
+    p_log->num_bytes  = 0;
+    hist_log_codec_reset(&p_log->codec_state);
+}
+
+static void
+test_deadband_log_append(
+    test_deadband_log_t* const          p_log,
+    const uint32_t                      timestamp,
+    const hist_log_record_data_t* const p_data)
+{
+    // Every FCB entry of the hist_log starts with a key frame
+    const bool flag_key_frame = (0 == (p_log->num_points % CONFIG_RUUVI_AIR_HIST_LOG_WRITE_BACK_NUM_RECORDS));
+    uint8_t    buf[HIST_LOG_CODEC_MAX_FRAME_LEN];
+    p_log->num_bytes += hist_log_codec_encode(
+        &p_log->codec_state,
+        timestamp,
+        p_log->num_points,
+        p_data,
+        flag_key_frame,
+        buf);
+    p_log->timestamps[p_log->num_points] = timestamp;
+    hist_log_fields_decode(p_data, p_log->values[p_log->num_points]);
+    p_log->num_points += 1;
+}
+
+static hist_log_record_data_t
+test_deadband_calc_window_avg(const uint32_t idx_last)
+{
+    float32_t sum[HIST_LOG_NUM_FIELDS] = { 0 };
+    for (uint32_t i = (idx_last + 1U) - TEST_DEADBAND_SHORTS_PER_WINDOW; i <= idx_last; ++i)
+    {
+        for (uint32_t j = 0; j < HIST_LOG_NUM_FIELDS; ++j)
+        {
+            sum[j] += g_test_deadband_samples[i][j];
+        }
+    }
+    for (uint32_t j = 0; j < HIST_LOG_NUM_FIELDS; ++j)
+    {
+        sum[j] /= (float32_t)TEST_DEADBAND_SHORTS_PER_WINDOW;
+    }
+    return test_deadband_encode(sum);
+}
+
+/**
+ * @brief Feed the trace the same way as main.c does: the 20-second averages are checked for the events,
+ * the 5-minute averages are logged unconditionally (fixed logging) or via the deadband.
+ */
+static void
+test_deadband_simulate(void)
+{
+    hist_log_deadband_t deadband = { 0 };
+    hist_log_deadband_init(&deadband, &g_test_deadband_cfg);
+    test_deadband_log_init(&g_test_deadband_log_fixed);
+    test_deadband_log_init(&g_test_deadband_log_deadband);
+
+    for (uint32_t i = 0; i < TEST_DEADBAND_NUM_SAMPLES; ++i)
+    {
+        const uint32_t ts                  = g_test_deadband_timestamps[i];
+        const bool     is_window_completed = (0 == ((i + 1U) % TEST_DEADBAND_SHORTS_PER_WINDOW));
+        if (hist_log_deadband_check_event(&deadband, ts, &g_test_deadband_records[i]))
+        {
+            test_deadband_log_append(&g_test_deadband_log_deadband, ts, &g_test_deadband_records[i]);
+            if (is_window_completed)
+            {
+                const hist_log_record_data_t avg = test_deadband_calc_window_avg(i);
+                test_deadband_log_append(&g_test_deadband_log_fixed, ts, &avg);
+            }
+            continue;
+        }
+        if (is_window_completed)
+        {
+            const hist_log_record_data_t avg = test_deadband_calc_window_avg(i);
+            test_deadband_log_append(&g_test_deadband_log_fixed, ts, &avg);
+            if (hist_log_deadband_check_window(&deadband, ts, &avg))
+            {
+                test_deadband_log_append(&g_test_deadband_log_deadband, ts, &avg);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Calculate the error of the reconstructed values against the 20-second averages.
+ * @param flag_hold true to hold the value of the logged point until the next one (the deadband logging),
+ * false to interpolate linearly between the points (the fixed interval logging).
+ */
+static test_deadband_error_t
+test_deadband_calc_error(const test_deadband_log_t* const p_log, const bool flag_hold)
+{
+    test_deadband_error_t err     = { 0 };
+    uint32_t              idx_log = 0;
+    for (uint32_t i = 0; i < TEST_DEADBAND_NUM_SAMPLES; ++i)
+    {
+        const uint32_t ts = g_test_deadband_timestamps[i];
+        while (((idx_log + 1U) < p_log->num_points) && (p_log->timestamps[idx_log + 1U] <= ts))
+        {
+            idx_log += 1;
+        }
+        for (uint32_t j = 0; j < HIST_LOG_NUM_FIELDS; ++j)
+        {
+            float32_t val = p_log->values[idx_log][j];
+            if ((!flag_hold) && (ts > p_log->timestamps[idx_log]) && ((idx_log + 1U) < p_log->num_points))
+            {
+                const float32_t frac = (float32_t)(ts - p_log->timestamps[idx_log])
+                                       / (float32_t)(p_log->timestamps[idx_log + 1U] - p_log->timestamps[idx_log]);
+                val += frac * (p_log->values[idx_log + 1U][j] - val);
+            }
+            const float32_t delta = fabsf(val - g_test_deadband_samples[i][j]);
+            err.rms[j] += delta * delta;
+            if (delta > err.max[j])
+            {
+                err.max[j] = delta;
+            }
+        }
+    }
+    for (uint32_t j = 0; j < HIST_LOG_NUM_FIELDS; ++j)
+    {
+        err.rms[j] = sqrtf(err.rms[j] / (float32_t)TEST_DEADBAND_NUM_SAMPLES);
+    }
+    return err;
+}
+
+static void
+test_deadband_print_report(
+    const char* const                  p_name,
+    const char* const                  p_mode,
+    const test_deadband_log_t* const   p_log,
+    const test_deadband_error_t* const p_err)
+{
+    printf(
+        "%-8s %-9s points=%4u bytes=%6u | CO2 rms=%6.1f max=%6.1f | PM2.5 rms=%5.2f max=%5.2f | "
+        "T rms=%5.3f max=%5.3f\n",
+        p_name,
+        p_mode,
+        (unsigned)p_log->num_points,
+        (unsigned)p_log->num_bytes,
+        (double)p_err->rms[HIST_LOG_FIELD_CO2],
+        (double)p_err->max[HIST_LOG_FIELD_CO2],
+        (double)p_err->rms[HIST_LOG_FIELD_PM2P5],
+        (double)p_err->max[HIST_LOG_FIELD_PM2P5],
+        (double)p_err->rms[HIST_LOG_FIELD_TEMPERATURE],
+        (double)p_err->max[HIST_LOG_FIELD_TEMPERATURE]);
+}
+
+ZTEST(test_suite_hist_log_deadband, test_eval_traces)
+{
+    static const test_deadband_trace_t traces[] = {
+        { .p_name = "stable", .gen = &test_deadband_trace_stable },
+        { .p_name = "office", .gen = &test_deadband_trace_office },
+    };
+    test_deadband_error_t err_fixed[ARRAY_SIZE(traces)];
+    test_deadband_error_t err_deadband[ARRAY_SIZE(traces)];
+    size_t                bytes_fixed[ARRAY_SIZE(traces)];
+    size_t                bytes_deadband[ARRAY_SIZE(traces)];
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(traces); ++i)
+    {
+        test_deadband_gen_trace(&traces[i]);
+        test_deadband_simulate();
+        err_fixed[i]      = test_deadband_calc_error(&g_test_deadband_log_fixed, false);
+        err_deadband[i]   = test_deadband_calc_error(&g_test_deadband_log_deadband, true);
+        bytes_fixed[i]    = g_test_deadband_log_fixed.num_bytes;
+        bytes_deadband[i] = g_test_deadband_log_deadband.num_bytes;
+        test_deadband_print_report(traces[i].p_name, "fixed", &g_test_deadband_log_fixed, &err_fixed[i]);
+        test_deadband_print_report(traces[i].p_name, "deadband", &g_test_deadband_log_deadband, &err_deadband[i]);
+    }
+
+    // Stable values: the storage is reduced by the ratio of the max interval to the window
+    zassert_true(bytes_deadband[0] < (bytes_fixed[0] / 4U));
+    // The error stays within the tolerance band
+    zassert_true(err_deadband[0].max[HIST_LOG_FIELD_CO2] <= g_test_deadband_cfg.tolerance[HIST_LOG_FIELD_CO2]);
+
+    // Office day: the 2-minute CO2 spike and the PM2.5 event are preserved, while less storage is used
+    zassert_true(bytes_deadband[1] < bytes_fixed[1]);
+    zassert_true(err_deadband[1].max[HIST_LOG_FIELD_CO2] <= g_test_deadband_cfg.tolerance[HIST_LOG_FIELD_CO2]);
+    zassert_true(err_deadband[1].max[HIST_LOG_FIELD_CO2] < (err_fixed[1].max[HIST_LOG_FIELD_CO2] / 2.0f));
+    zassert_true(err_deadband[1].max[HIST_LOG_FIELD_PM2P5] < err_fixed[1].max[HIST_LOG_FIELD_PM2P5]);
+}
@@ -0,0 +1,198 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "hist_log_rollup.h"
+#include "ruuvi_endpoint_e1.h"
+#include "zassert.h"
+
+#define TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP (1735689600U) // 2025-01-01 00:00:00 UTC
+#define TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS (60U * 60U)
+#define TEST_HIST_LOG_ROLLUP_NUM_RECORDS    (12U)
+
+ZTEST_SUITE(test_suite_hist_log_rollup, NULL, NULL, NULL, NULL, NULL);
+
+static hist_log_rollup_record_t
+test_hist_log_rollup_gen_record(const uint32_t idx)
+{
+    re_e1_data_t e1_data  = re_e1_data_invalid(idx, 0);
+    e1_data.temperature_c = 20.0f + (0.5f * (float)idx);
+    e1_data.co2           = 400.0f + (10.0f * (float)idx);
+    e1_data.pressure_pa   = 100800.0f - (float)idx;
+    // Humidity is invalid in one of the records
+    e1_data.humidity_rh = (3 == idx) ? NAN : (40.0f + (float)idx);
+
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, &e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return (hist_log_rollup_record_t) {
+        .mean = data,
+        .min  = data,
+        .max  = data,
+    };
+}
+
+static re_e1_data_t
+test_hist_log_rollup_decode(const hist_log_record_data_t* const p_data)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, p_data->buf, sizeof(p_data->buf));
+    re_e1_data_t e1_data = { 0 };
+    (void)re_e1_decode(buffer, &e1_data);
+    return e1_data;
+}
+
+ZTEST(test_suite_hist_log_rollup, test_mean_min_max)
+{
+    hist_log_rollup_t rollup = { 0 };
+    hist_log_rollup_init(&rollup, TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS);
+
+    uint32_t                 timestamp = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    for (uint32_t i = 0; i < TEST_HIST_LOG_ROLLUP_NUM_RECORDS; ++i)
+    {
+        const hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(i);
+        zassert_false(hist_log_rollup_add(
+            &rollup,
+            TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + (i * 300U),
+            &input,
+            &timestamp,
+            &record));
+    }
+    // The first record of the next hour completes the previous one
+    const hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(TEST_HIST_LOG_ROLLUP_NUM_RECORDS);
+    zassert_true(hist_log_rollup_add(
+        &rollup,
+        TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS + 10U,
+        &input,
+        &timestamp,
+        &record));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP, timestamp);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS, rollup.timestamp_start);
+    ZASSERT_EQ_INT(1, rollup.num_records);
+
+    const re_e1_data_t mean = test_hist_log_rollup_decode(&record.mean);
+    const re_e1_data_t min  = test_hist_log_rollup_decode(&record.min);
+    const re_e1_data_t max  = test_hist_log_rollup_decode(&record.max);
+
+    ZASSERT_EQ_FLOAT_WITHIN(22.75f, mean.temperature_c, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(20.0f, min.temperature_c, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(25.5f, max.temperature_c, 0.01f);
+
+    ZASSERT_EQ_FLOAT_WITHIN(455.0f, mean.co2, 1.0f);
+    ZASSERT_EQ_FLOAT_WITHIN(400.0f, min.co2, 1.0f);
+    ZASSERT_EQ_FLOAT_WITHIN(510.0f, max.co2, 1.0f);
+
+    ZASSERT_EQ_FLOAT_WITHIN(100794.5f, mean.pressure_pa, 1.0f);
+    ZASSERT_EQ_FLOAT_WITHIN(100789.0f, min.pressure_pa, 1.0f);
+    ZASSERT_EQ_FLOAT_WITHIN(100800.0f, max.pressure_pa, 1.0f);
+
+    // The invalid value is skipped: (0 + 1 + 2 + 4 + ... + 11) / 11 = 63 / 11
+    ZASSERT_EQ_FLOAT_WITHIN(40.0f + (63.0f / 11.0f), mean.humidity_rh, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(40.0f, min.humidity_rh, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(51.0f, max.humidity_rh, 0.01f);
+
+    // The sequence counter is taken from the last record
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_NUM_RECORDS - 1, mean.seq_cnt);
+}
+
+ZTEST(test_suite_hist_log_rollup, test_aggregate_rollup_records)
+{
+    // The daily tier aggregates the hourly mean/min/max records
+    hist_log_rollup_t rollup = { 0 };
+    hist_log_rollup_init(&rollup, 24U * TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS);
+
+    uint32_t                 timestamp = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(10U * i);
+        input.min                      = test_hist_log_rollup_gen_record((10U * i) + 1U).mean;
+        input.max                      = test_hist_log_rollup_gen_record((10U * i) + 2U).mean;
+        zassert_false(hist_log_rollup_add(
+            &rollup,
+            TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + (i * TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS),
+            &input,
+            &timestamp,
+            &record));
+    }
+    const hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(0);
+    zassert_true(hist_log_rollup_add(
+        &rollup,
+        TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + (24U * TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS),
+        &input,
+        &timestamp,
+        &record));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP, timestamp);
+
+    const re_e1_data_t mean = test_hist_log_rollup_decode(&record.mean);
+    const re_e1_data_t min  = test_hist_log_rollup_decode(&record.min);
+    const re_e1_data_t max  = test_hist_log_rollup_decode(&record.max);
+    ZASSERT_EQ_FLOAT_WITHIN(22.5f, mean.temperature_c, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(20.5f, min.temperature_c, 0.01f);
+    ZASSERT_EQ_FLOAT_WITHIN(26.0f, max.temperature_c, 0.01f);
+}
+
+ZTEST(test_suite_hist_log_rollup, test_clock_set_back)
+{
+    hist_log_rollup_t rollup = { 0 };
+    hist_log_rollup_init(&rollup, TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS);
+
+    uint32_t                       timestamp = 0;
+    hist_log_rollup_record_t       record    = { 0 };
+    const hist_log_rollup_record_t input     = test_hist_log_rollup_gen_record(0);
+    zassert_false(hist_log_rollup_add(
+        &rollup,
+        TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS,
+        &input,
+        &timestamp,
+        &record));
+    // The record from the previous hour completes the current bucket
+    zassert_true(hist_log_rollup_add(&rollup, TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP, &input, &timestamp, &record));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS, timestamp);
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP, rollup.timestamp_start);
+    const re_e1_data_t mean = test_hist_log_rollup_decode(&record.mean);
+    ZASSERT_EQ_FLOAT_WITHIN(20.0f, mean.temperature_c, 0.01f);
+    ZASSERT_EQ_INT(0, mean.seq_cnt);
+}
+
+ZTEST(test_suite_hist_log_rollup, test_flush)
+{
+    hist_log_rollup_t rollup = { 0 };
+    hist_log_rollup_init(&rollup, TEST_HIST_LOG_ROLLUP_PERIOD_SECONDS);
+
+    uint32_t                 timestamp = 0;
+    hist_log_rollup_record_t record    = { 0 };
+    zassert_false(hist_log_rollup_flush(&rollup, &timestamp, &record));
+    for (uint32_t i = 0; i < 2; ++i)
+    {
+        const hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(i);
+        zassert_false(hist_log_rollup_add(
+            &rollup,
+            TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + (i * 300U),
+            &input,
+            &timestamp,
+            &record));
+    }
+    // The unfinished time bucket is completed
+    zassert_true(hist_log_rollup_flush(&rollup, &timestamp, &record));
+    ZASSERT_EQ_INT(TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP, timestamp);
+    ZASSERT_EQ_FLOAT_WITHIN(20.25f, test_hist_log_rollup_decode(&record.mean).temperature_c, 0.01f);
+    ZASSERT_EQ_INT(0, rollup.num_records);
+
+    // The next record of the same time bucket starts a new accumulation instead of completing an empty one
+    const hist_log_rollup_record_t input = test_hist_log_rollup_gen_record(2);
+    zassert_false(hist_log_rollup_add(
+        &rollup,
+        TEST_HIST_LOG_ROLLUP_BASE_TIMESTAMP + 600U,
+        &input,
+        &timestamp,
+        &record));
+    ZASSERT_EQ_INT(1, rollup.num_records);
+}
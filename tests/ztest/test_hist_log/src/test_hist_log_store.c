@@ -0,0 +1,193 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include "hist_log_store.h"
+#include "zassert.h"
+
+#define TEST_HIST_LOG_STORE_AREA_ID          FIXED_PARTITION_ID(hist_store_test)
+#define TEST_HIST_LOG_STORE_NUM_SECTORS      (16U)
+#define TEST_HIST_LOG_STORE_BASE_TIMESTAMP   (1735689600U) // 2025-01-01 00:00:00 UTC
+#define TEST_HIST_LOG_STORE_PERIOD_SECONDS   (5U * 60U)
+#define TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR ((uint32_t)HIST_LOG_STORE_SLOTS_PER_SECTOR)
+
+static void
+test_suite_before(void* f)
+{
+    const struct flash_area* p_fa = NULL;
+    zassert_true(0 == flash_area_open(TEST_HIST_LOG_STORE_AREA_ID, &p_fa));
+    zassert_true(0 == flash_area_erase(p_fa, 0, TEST_HIST_LOG_STORE_NUM_SECTORS * HIST_LOG_STORE_SECTOR_SIZE));
+    flash_area_close(p_fa);
+}
+
+ZTEST_SUITE(test_suite_hist_log_store, NULL, NULL, &test_suite_before, NULL, NULL);
+
+static hist_log_record_data_t
+test_hist_log_store_gen_record_data(const uint32_t idx)
+{
+    hist_log_record_data_t data = { 0 };
+    for (uint32_t i = 0; i < sizeof(data.buf); ++i)
+    {
+        data.buf[i] = (uint8_t)((idx * 31U) + i);
+    }
+    return data;
+}
+
+static uint32_t
+test_hist_log_store_gen_timestamp(const uint32_t idx)
+{
+    return TEST_HIST_LOG_STORE_BASE_TIMESTAMP + (idx * TEST_HIST_LOG_STORE_PERIOD_SECONDS);
+}
+
+static void
+test_hist_log_store_init(hist_log_store_t* const p_store)
+{
+    zassert_true(hist_log_store_init(p_store, TEST_HIST_LOG_STORE_AREA_ID, 0, TEST_HIST_LOG_STORE_NUM_SECTORS));
+}
+
+static void
+test_hist_log_store_fill(hist_log_store_t* const p_store, const uint32_t idx_first, const uint32_t num_records)
+{
+    for (uint32_t i = idx_first; i < (idx_first + num_records); ++i)
+    {
+        const hist_log_record_data_t data = test_hist_log_store_gen_record_data(i);
+        zassert_true(hist_log_store_append(p_store, test_hist_log_store_gen_timestamp(i), &data));
+    }
+}
+
+/**
+ * @brief Check all the records in the store, the record with sequence number seq has index seq - 1.
+ * @return Number of the mismatched records.
+ */
+static uint32_t
+test_hist_log_store_verify(const hist_log_store_t* const p_store)
+{
+    uint32_t num_mismatches = 0;
+    for (uint32_t seq = hist_log_store_get_seq_first(p_store); seq < hist_log_store_get_seq_next(p_store); ++seq)
+    {
+        uint32_t                     timestamp = 0;
+        hist_log_record_data_t       data      = { 0 };
+        const hist_log_record_data_t expected  = test_hist_log_store_gen_record_data(seq - 1U);
+        if ((HIST_LOG_STORE_STATUS_OK != hist_log_store_read(p_store, seq, &timestamp, &data))
+            || (test_hist_log_store_gen_timestamp(seq - 1U) != timestamp)
+            || (0 != memcmp(&expected, &data, sizeof(data))))
+        {
+            num_mismatches += 1;
+        }
+    }
+    return num_mismatches;
+}
+
+ZTEST(test_suite_hist_log_store, test_empty)
+{
+    hist_log_store_t store = { 0 };
+    test_hist_log_store_init(&store);
+    ZASSERT_EQ_INT(1, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(1, hist_log_store_get_seq_next(&store));
+    uint32_t               timestamp = 0;
+    hist_log_record_data_t data      = { 0 };
+    ZASSERT_EQ_INT(HIST_LOG_STORE_STATUS_NOT_FOUND, hist_log_store_read(&store, 1, &timestamp, &data));
+    ZASSERT_EQ_INT(1, hist_log_store_find(&store, 0));
+}
+
+ZTEST(test_suite_hist_log_store, test_append_read_find)
+{
+    hist_log_store_t store = { 0 };
+    test_hist_log_store_init(&store);
+    const uint32_t num_records = (3U * TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR) + 5U;
+    test_hist_log_store_fill(&store, 0, num_records);
+    ZASSERT_EQ_INT(1, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(num_records + 1U, hist_log_store_get_seq_next(&store));
+    ZASSERT_EQ_INT(0, test_hist_log_store_verify(&store));
+
+    ZASSERT_EQ_INT(1, hist_log_store_find(&store, 0));
+    ZASSERT_EQ_INT(1, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(0)));
+    ZASSERT_EQ_INT(101, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(100)));
+    ZASSERT_EQ_INT(102, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(100) + 1U));
+    ZASSERT_EQ_INT(num_records, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(num_records - 1U)));
+    ZASSERT_EQ_INT(num_records + 1U, hist_log_store_find(&store, UINT32_MAX));
+}
+
+ZTEST(test_suite_hist_log_store, test_reinit)
+{
+    hist_log_store_t store = { 0 };
+    test_hist_log_store_init(&store);
+    const uint32_t num_records = TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR + 7U;
+    test_hist_log_store_fill(&store, 0, num_records);
+
+    // The end of the active sector is found on boot, the appending continues after it
+    test_hist_log_store_init(&store);
+    ZASSERT_EQ_INT(1, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(num_records + 1U, hist_log_store_get_seq_next(&store));
+    test_hist_log_store_fill(&store, num_records, TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR);
+    ZASSERT_EQ_INT(0, test_hist_log_store_verify(&store));
+
+    // The active sector is full and closed, the next record is written to the next sector
+    const uint32_t num_full = 3U * TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR;
+    test_hist_log_store_fill(
+        &store,
+        hist_log_store_get_seq_next(&store) - 1U,
+        num_full + 1U - hist_log_store_get_seq_next(&store));
+    ZASSERT_EQ_INT(num_full + 1U, hist_log_store_get_seq_next(&store));
+    test_hist_log_store_init(&store);
+    ZASSERT_EQ_INT(num_full + 1U, hist_log_store_get_seq_next(&store));
+    test_hist_log_store_fill(&store, num_full, 1);
+    ZASSERT_EQ_INT(1, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(0, test_hist_log_store_verify(&store));
+}
+
+ZTEST(test_suite_hist_log_store, test_rotate)
+{
+    hist_log_store_t store = { 0 };
+    test_hist_log_store_init(&store);
+    const uint32_t num_records = (2U * TEST_HIST_LOG_STORE_NUM_SECTORS * TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR) + 10U;
+    test_hist_log_store_fill(&store, 0, num_records);
+
+    // The oldest sector is erased when the new one is needed, all the others are full
+    const uint32_t num_kept = ((TEST_HIST_LOG_STORE_NUM_SECTORS - 1U) * TEST_HIST_LOG_STORE_SLOTS_PER_SECTOR) + 10U;
+    ZASSERT_EQ_INT(num_records + 1U, hist_log_store_get_seq_next(&store));
+    ZASSERT_EQ_INT(num_records + 1U - num_kept, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(0, test_hist_log_store_verify(&store));
+
+    uint32_t               timestamp = 0;
+    hist_log_record_data_t data      = { 0 };
+    ZASSERT_EQ_INT(
+        HIST_LOG_STORE_STATUS_NOT_FOUND,
+        hist_log_store_read(&store, hist_log_store_get_seq_first(&store) - 1U, &timestamp, &data));
+    ZASSERT_EQ_INT(hist_log_store_get_seq_first(&store), hist_log_store_find(&store, 0));
+
+    test_hist_log_store_init(&store);
+    ZASSERT_EQ_INT(num_records + 1U, hist_log_store_get_seq_next(&store));
+    ZASSERT_EQ_INT(num_records + 1U - num_kept, hist_log_store_get_seq_first(&store));
+    ZASSERT_EQ_INT(0, test_hist_log_store_verify(&store));
+}
+
+ZTEST(test_suite_hist_log_store, test_power_loss)
+{
+    hist_log_store_t store = { 0 };
+    test_hist_log_store_init(&store);
+    test_hist_log_store_fill(&store, 0, 10);
+
+    // The power was lost after the timestamp of the next record was written
+    const uint32_t timestamp = test_hist_log_store_gen_timestamp(10);
+    const off_t    off       = sizeof(hist_log_store_sector_hdr_t) + (10U * HIST_LOG_STORE_SLOT_SIZE);
+    zassert_true(0 == flash_area_write(store.p_fa, off, &timestamp, sizeof(timestamp)));
+
+    // The partially written slot is skipped
+    test_hist_log_store_init(&store);
+    ZASSERT_EQ_INT(12, hist_log_store_get_seq_next(&store));
+    uint32_t               timestamp_read = 0;
+    hist_log_record_data_t data           = { 0 };
+    ZASSERT_EQ_INT(HIST_LOG_STORE_STATUS_CORRUPTED, hist_log_store_read(&store, 11, &timestamp_read, &data));
+    test_hist_log_store_fill(&store, 11, 5);
+    ZASSERT_EQ_INT(HIST_LOG_STORE_STATUS_OK, hist_log_store_read(&store, 12, &timestamp_read, &data));
+    ZASSERT_EQ_INT(test_hist_log_store_gen_timestamp(11), timestamp_read);
+    // The corrupted record may be returned, it is skipped by the reader
+    ZASSERT_EQ_INT(11, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(10)));
+    ZASSERT_EQ_INT(13, hist_log_store_find(&store, test_hist_log_store_gen_timestamp(12)));
+}
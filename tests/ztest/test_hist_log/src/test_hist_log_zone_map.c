@@ -0,0 +1,157 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "hist_log_zone_map.h"
+#include "ruuvi_endpoint_e1.h"
+#include "zassert.h"
+
+ZTEST_SUITE(test_suite_hist_log_zone_map, NULL, NULL, NULL, NULL, NULL);
+
+static hist_log_record_data_t
+test_hist_log_zone_map_encode(const re_e1_data_t* const p_e1_data)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, p_e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+static hist_log_rollup_record_t
+test_hist_log_zone_map_gen_record(const float temperature_c, const float co2)
+{
+    re_e1_data_t e1_data  = re_e1_data_invalid(0, 0);
+    e1_data.temperature_c = temperature_c;
+    e1_data.co2           = co2;
+    e1_data.pm2p5_ppm     = 3.0f;
+
+    const hist_log_record_data_t data = test_hist_log_zone_map_encode(&e1_data);
+    return (hist_log_rollup_record_t) {
+        .mean = data,
+        .min  = data,
+        .max  = data,
+    };
+}
+
+static hist_log_filter_t
+test_hist_log_zone_map_filter(const hist_log_field_e field, const hist_log_filter_op_e op, const float threshold)
+{
+    return (hist_log_filter_t) {
+        .num_conds = 1,
+        .conds     = {
+            { .field = field, .op = op, .threshold = threshold },
+        },
+    };
+}
+
+ZTEST(test_suite_hist_log_zone_map, test_can_match)
+{
+    hist_log_zone_map_t zone_map = { 0 };
+    hist_log_zone_map_clear(&zone_map);
+    // The empty zone map does not match anything
+    hist_log_filter_t filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 0.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+        const hist_log_rollup_record_t record
+            = test_hist_log_zone_map_gen_record(20.0f + (0.25f * (float)i), 500.0f + (100.0f * (float)i));
+        hist_log_zone_map_add(&zone_map, &record);
+    }
+    // CO2: 500..1400 ppm
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 1399.0f);
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 1500.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_LT, 501.0f);
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_LT, 400.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+
+    // Temperature: 20.0..22.25 °C, the range is kept with 0.01 °C resolution
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_GT, 22.2f);
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_GT, 22.3f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_LT, -10.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+
+    // The humidity is invalid in all the records
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_HUMIDITY, HIST_LOG_FILTER_OP_GT, 0.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map, &filter));
+
+    // Any of the conditions can match
+    filter.num_conds = 2;
+    filter.conds[1]  = (hist_log_filter_cond_t) {
+        .field     = HIST_LOG_FIELD_PM2P5,
+        .op        = HIST_LOG_FILTER_OP_LT,
+        .threshold = 5.0f,
+    };
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+}
+
+ZTEST(test_suite_hist_log_zone_map, test_saturation)
+{
+    // CO2 above the range of int16_t is saturated, the sector must not be skipped
+    hist_log_zone_map_t zone_map = { 0 };
+    hist_log_zone_map_clear(&zone_map);
+    const hist_log_rollup_record_t record = test_hist_log_zone_map_gen_record(-40.0f, 40000.0f);
+    hist_log_zone_map_add(&zone_map, &record);
+    hist_log_filter_t filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 35000.0f);
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+    zassert_true(hist_log_filter_match(&filter, &record));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_LT, -39.0f);
+    zassert_true(hist_log_zone_map_can_match(&zone_map, &filter));
+}
+
+ZTEST(test_suite_hist_log_zone_map, test_merge)
+{
+    hist_log_zone_map_t zone_map_a = { 0 };
+    hist_log_zone_map_t zone_map_b = { 0 };
+    hist_log_zone_map_clear(&zone_map_a);
+    hist_log_zone_map_clear(&zone_map_b);
+    const hist_log_rollup_record_t record = test_hist_log_zone_map_gen_record(21.0f, 2000.0f);
+    hist_log_zone_map_add(&zone_map_b, &record);
+
+    const hist_log_filter_t filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 1500.0f);
+    zassert_false(hist_log_zone_map_can_match(&zone_map_a, &filter));
+    hist_log_zone_map_merge(&zone_map_a, &zone_map_b);
+    zassert_true(hist_log_zone_map_can_match(&zone_map_a, &filter));
+}
+
+ZTEST(test_suite_hist_log_zone_map, test_filter_match_rollup_record)
+{
+    // The rollup record matches "greater than" by its max and "less than" by its min
+    hist_log_rollup_record_t record = test_hist_log_zone_map_gen_record(21.0f, 800.0f);
+    record.min                      = test_hist_log_zone_map_gen_record(18.0f, 450.0f).mean;
+    record.max                      = test_hist_log_zone_map_gen_record(24.0f, 1600.0f).mean;
+
+    hist_log_filter_t filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 1500.0f);
+    zassert_true(hist_log_filter_match(&filter, &record));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_CO2, HIST_LOG_FILTER_OP_GT, 1600.0f);
+    zassert_false(hist_log_filter_match(&filter, &record));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_LT, 19.0f);
+    zassert_true(hist_log_filter_match(&filter, &record));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_TEMPERATURE, HIST_LOG_FILTER_OP_LT, 18.0f);
+    zassert_false(hist_log_filter_match(&filter, &record));
+    // Invalid values never match
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_VOC, HIST_LOG_FILTER_OP_LT, 1000.0f);
+    zassert_false(hist_log_filter_match(&filter, &record));
+}
+
+ZTEST(test_suite_hist_log_zone_map, test_filter_is_valid)
+{
+    hist_log_filter_t filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_SOUND_AVG, HIST_LOG_FILTER_OP_GT, 70.0f);
+    zassert_true(hist_log_filter_is_valid(&filter));
+    filter.conds[0].op = (hist_log_filter_op_e)2;
+    zassert_false(hist_log_filter_is_valid(&filter));
+    filter = test_hist_log_zone_map_filter(HIST_LOG_FIELD_SOUND_AVG, HIST_LOG_FILTER_OP_GT, NAN);
+    zassert_false(hist_log_filter_is_valid(&filter));
+    filter.num_conds = HIST_LOG_FILTER_MAX_CONDS + 1U;
+    zassert_false(hist_log_filter_is_valid(&filter));
+}
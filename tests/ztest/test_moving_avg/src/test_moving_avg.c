@@ -259,3 +259,62 @@ ZTEST_F(test_suite_moving_avg, test_2)
     ZASSERT_EQ_INT(measurement_cnt, e1_data.seq_cnt);
     zassert_equal(radio_mac, e1_data.address);
 }
+
+ZTEST_F(test_suite_moving_avg, test_short_window)
+{
+    sensors_measurement_t measurement = {
+        .sen66 = {
+            .mass_concentration_pm1p0 = 106,
+            .mass_concentration_pm2p5 = 124,
+            .mass_concentration_pm4p0 = 136,
+            .mass_concentration_pm10p0 = 142,
+            .ambient_humidity = 5588,
+            .ambient_temperature = 5493,
+            .voc_index = 800,
+            .nox_index = 20,
+            .co2 = 549,
+        },
+        .dps310_temperature = 28.576f,
+        .dps310_pressure = 100746.855f,
+        .shtc3_temperature = 27.511f,
+        .shtc3_humidity = 57.351f,
+        .luminosity = 88.0f,
+        .sound_inst_dba = 71.0f,
+        .sound_avg_dba = 64.0f,
+        .sound_peak_spl_db = 81.0f,
+    };
+    const measurement_cnt_t measurement_cnt = 0x123456;
+    const radio_mac_t       radio_mac       = 0x112233445566;
+    const sensors_flags_t   flags           = {
+                    .flag_calibration_in_progress = false,
+                    .flag_button_pressed          = false,
+                    .flag_rtc_running_on_boot     = true,
+    };
+
+    // The short window is completed after every 20 measurements
+    for (int i = 0; i < 19; ++i)
+    {
+        zassert_false(moving_avg_append(&measurement));
+        zassert_false(moving_avg_is_short_window_completed());
+    }
+    zassert_false(moving_avg_append(&measurement));
+    zassert_true(moving_avg_is_short_window_completed());
+
+    hist_log_record_data_t record  = moving_avg_get_short_accum(measurement_cnt, radio_mac, flags);
+    re_e1_data_t           e1_data = convert_record_to_e1_data(&record, radio_mac);
+    ZASSERT_EQ_FLOAT((float)measurement.sen66.co2, e1_data.co2);
+
+    // The average of the next short window contains only its own measurements
+    measurement.sen66.co2 = 1850;
+    for (int i = 0; i < 20; ++i)
+    {
+        zassert_false(moving_avg_append(&measurement));
+    }
+    zassert_true(moving_avg_is_short_window_completed());
+    record  = moving_avg_get_short_accum(measurement_cnt, radio_mac, flags);
+    e1_data = convert_record_to_e1_data(&record, radio_mac);
+    ZASSERT_EQ_FLOAT(1850.0f, e1_data.co2);
+
+    zassert_false(moving_avg_append(&measurement));
+    zassert_false(moving_avg_is_short_window_completed());
+}
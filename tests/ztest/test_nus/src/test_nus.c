@@ -0,0 +1,1782 @@
+/**
+ * @copyright Ruuvi Innovations Ltd, license BSD-3-Clause.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <zephyr/bluetooth/services/nus.h>
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+#include <zephyr/bluetooth/l2cap.h>
+#endif
+#include "nus.h"
+#include "nus_req.h"
+#include "nus_hist_decoder.h"
+#include "hist_log.h"
+#include "ruuvi_endpoints.h"
+#include "ruuvi_endpoint_e1.h"
+#include "sys_utils.h"
+#include "zassert.h"
+
+#define TEST_NUS_BASE_TIMESTAMP (1735689600U) // 2025-01-01 00:00:00 UTC
+#define TEST_NUS_PERIOD_SECONDS (5U * 60U)
+#define TEST_NUS_ONE_HOUR       (60U * 60U)
+#define TEST_NUS_ONE_DAY        (24U * TEST_NUS_ONE_HOUR)
+#define TEST_NUS_NUM_DAYS       (14U)
+#define TEST_NUS_NUM_RECORDS    ((TEST_NUS_NUM_DAYS * TEST_NUS_ONE_DAY) / TEST_NUS_PERIOD_SECONDS)
+#define TEST_NUS_MIN_UNIX_TIME  (1577836800U) // 2020-01-01 00:00:00 UTC, the clock restarts from it
+
+#define TEST_NUS_REQ_CURRENT_TIME_IDX (RE_STANDARD_PAYLOAD_START_INDEX)
+#define TEST_NUS_REQ_START_TIME_IDX   (RE_STANDARD_PAYLOAD_START_INDEX + 4U)
+#define TEST_NUS_REQ_PERIOD_IDX       (RE_STANDARD_MESSAGE_LENGTH)
+#define TEST_NUS_REQ_MAX_LEN          (RE_STANDARD_MESSAGE_LENGTH + 4U)
+
+// Record prefixed with the sequence number
+#define TEST_NUS_SEQ_SIZE       (4U)
+#define TEST_NUS_SEQ_RECORD_LEN (TEST_NUS_SEQ_SIZE + RE_LOG_WRITE_AIRQ_RECORD_LEN)
+
+// Aggregated record: the E1 record with the mean values followed by the E1 payloads with the min and max values
+#define TEST_NUS_AGGREGATED_RECORD_LEN (RE_LOG_WRITE_AIRQ_RECORD_LEN + (2U * (uint32_t)sizeof(hist_log_record_data_t)))
+#define TEST_NUS_AGGREGATED_MIN_OFS    (RE_LOG_WRITE_AIRQ_RECORD_LEN)
+#define TEST_NUS_AGGREGATED_MAX_OFS    (TEST_NUS_AGGREGATED_MIN_OFS + sizeof(hist_log_record_data_t))
+
+// Filter of NUS_REQ_OP_LOG_MULTI_READ_FILTERED after the standard message, the threshold is in units of 0.01
+#define TEST_NUS_REQ_FILTER_MODE_IDX      (RE_STANDARD_MESSAGE_LENGTH)
+#define TEST_NUS_REQ_FILTER_NUM_CONDS_IDX (RE_STANDARD_MESSAGE_LENGTH + 1U)
+#define TEST_NUS_REQ_FILTER_CONDS_IDX     (RE_STANDARD_MESSAGE_LENGTH + 2U)
+#define TEST_NUS_REQ_FILTER_COND_LEN      (6U)
+#define TEST_NUS_REQ_FILTER_FIELD_OFS     (0U)
+#define TEST_NUS_REQ_FILTER_OP_OFS        (1U)
+#define TEST_NUS_REQ_FILTER_THRESHOLD_OFS (2U)
+#define TEST_NUS_REQ_FILTER_MAX_LEN \
+    (TEST_NUS_REQ_FILTER_CONDS_IDX + (HIST_LOG_FILTER_MAX_CONDS * TEST_NUS_REQ_FILTER_COND_LEN))
+#define TEST_NUS_FILTER_CO2_THRESHOLD     (70050) // The CO2 values of the records are integers
+#define TEST_NUS_FILTER_CO2_THRESHOLD_PPM (700.5f)
+
+// Interval of the matching records: timestamps of the first and the last record, the number of records
+#define TEST_NUS_INTERVAL_TIMESTAMP_FIRST_OFS (0U)
+#define TEST_NUS_INTERVAL_TIMESTAMP_LAST_OFS  (4U)
+#define TEST_NUS_INTERVAL_NUM_RECORDS_OFS     (8U)
+#define TEST_NUS_INTERVAL_LEN                 (10U)
+
+/*
+ * Model of the BLE link (LE 2M PHY with the data length extension): every notification is sent in one LL PDU
+ * with the preamble (2), access address (4), LL header (2), L2CAP header (4), ATT header (3) and CRC (3),
+ * it is acknowledged by the empty PDU of the central, the PDUs are separated by T_IFS.
+ * The queued notifications are sent at the connection events, the event can take the whole connection interval.
+ * The Bluetooth stack has a limited number of the TX buffers, the notification is rejected with -ENOMEM
+ * if all of them are used, the buffer is freed (and the sent callback is called) when the PDU is acknowledged.
+ */
+#define TEST_NUS_PDU_OVERHEAD_BYTES (2U + 4U + 2U + 4U + 3U + 3U)
+#define TEST_NUS_EMPTY_PDU_BYTES    (2U + 4U + 2U + 3U)
+#define TEST_NUS_US_PER_BYTE        (4U)
+#define TEST_NUS_T_IFS_US           (150U)
+
+#define TEST_NUS_NUM_CONNS              (2U)
+#define TEST_NUS_CONN_INTERVAL_US       (7500U)
+#define TEST_NUS_LINK_NUM_TX_BUFS       (10U) // CONFIG_BT_L2CAP_TX_BUF_COUNT in prj_common.conf
+#define TEST_NUS_LINK_MAX_TX_BUFS       (16U)
+#define TEST_NUS_LINK_THREAD_PRIORITY   (5)
+#define TEST_NUS_LINK_THREAD_STACK_SIZE (1024)
+#define TEST_NUS_MAX_PACKET_LEN         (244U) // RUUVI_AIR_NUS_MAX_PACKET_LENGTH
+#define TEST_NUS_ATT_NOTIFY_HEADER_SIZE (3U)
+#define TEST_NUS_ATT_MTU_MIN            (23U)
+#define TEST_NUS_ATT_MTU_MAX            (TEST_NUS_MAX_PACKET_LEN + TEST_NUS_ATT_NOTIFY_HEADER_SIZE)
+
+/*
+ * Model of the L2CAP connection-oriented channel: the SDU is prefixed with the 2-byte SDU length
+ * and segmented into the PDUs of up to MPS bytes, every PDU consumes one credit and one TX buffer.
+ * The PDU has the same headers as the notification except the ATT header.
+ * The central returns the credits of the received PDUs after the connection event.
+ */
+#define TEST_NUS_L2CAP_SDU_HEADER_SIZE   (2U)
+#define TEST_NUS_L2CAP_PDU_OVERHEAD_BYTES (2U + 4U + 2U + 4U + 3U)
+#define TEST_NUS_L2CAP_MPS               (247U) // LL payload of 251 bytes without the L2CAP header
+#define TEST_NUS_L2CAP_MTU               (CONFIG_RUUVI_AIR_NUS_L2CAP_SDU_LEN)
+#define TEST_NUS_L2CAP_CREDITS           (10U)
+#define TEST_NUS_L2CAP_MAX_SDUS          (16U)
+
+#define TEST_NUS_EOF_TIMEOUT_MS (60U * 1000U)
+// The connection is dropped in the middle of the transfer of the whole history, which takes about 1 s
+#define TEST_NUS_DISCONNECT_DELAY_MS (100)
+
+typedef struct test_nus_stats_t
+{
+    uint32_t num_packets;
+    uint32_t num_records;
+    uint32_t record_len;
+    uint32_t num_bytes;        //!< NUS payload of the notifications
+    uint32_t num_bytes_on_air; //!< Notifications with the headers of all the layers and the empty PDUs of the central
+    uint32_t air_time_us;
+    uint32_t timestamp_first;
+    uint32_t timestamp_last;
+    uint32_t num_not_in_range; //!< Aggregated records with CO2 mean not in [min, max]
+    uint32_t num_interval_records; //!< Records merged into the intervals of NUS_REQ_OP_LOG_MULTI_READ_FILTERED
+    uint32_t num_wrong_intervals;  //!< Intervals whose duration does not match the number of their records
+    uint32_t num_rejected;     //!< Notifications rejected with -ENOMEM because all the TX buffers were used
+    uint32_t num_conn_events;  //!< Connection events with at least one notification
+    uint32_t num_chunks;        //!< Chunks of NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, including the lost ones
+    uint32_t num_decode_errors; //!< Chunks of NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED which failed to decode
+    uint32_t packet_len_max;
+    uint32_t time_ms;          //!< From the request to the acknowledgement of the end-of-data message
+} test_nus_stats_t;
+
+typedef struct test_nus_link_pdu_t
+{
+    uint32_t                air_time_us;
+    bool                    is_eof;
+    bt_gatt_complete_func_t func;
+    void*                   p_user_data;
+    bool                    is_l2cap;
+    struct net_buf*         p_sdu; //!< SDU which is freed when its last PDU is sent
+} test_nus_link_pdu_t;
+
+/**
+ * @brief Mock connection, the pointer to it is used as struct bt_conn*.
+ */
+typedef struct test_nus_conn_t
+{
+    test_nus_stats_t           stats;
+    nus_hist_decoder_record_t* p_captured; //!< Records received by the client, only for the first connection
+    struct k_sem               sem_eof;
+    int64_t                    time_start;
+    uint32_t                   idx_first;
+    uint32_t                   num_queued;
+    test_nus_link_pdu_t        queue[TEST_NUS_LINK_MAX_TX_BUFS];
+    atomic_t                   num_refs; //!< References taken with bt_conn_ref()
+    bool                       is_disconnected;
+} test_nus_conn_t;
+
+/**
+ * @brief The connections have the same interval, their connection events follow each other evenly,
+ * so every event can take the interval divided by the number of the connections.
+ * The TX buffers of the Bluetooth stack are shared by all the connections.
+ */
+typedef struct test_nus_link_t
+{
+    uint32_t conn_interval_us;
+    uint32_t num_tx_bufs;
+    uint32_t num_conns; //!< Connections which have the connection events
+    uint32_t conn_idx_next;
+    uint16_t att_mtu;
+    uint16_t att_mtu_peer; //!< ATT MTU of the central, it is applied by the MTU exchange
+    uint32_t num_mtu_exchanges;
+    uint32_t num_data_len_updates;
+    uint32_t num_queued; //!< Used TX buffers
+} test_nus_link_t;
+
+#define TEST_NUS_CONN(idx_) ((struct bt_conn*)&g_test_nus_conns[(idx_)])
+
+static struct bt_nus_cb*   g_test_nus_p_cb;
+static void*               g_test_nus_p_cb_ctx;
+static test_nus_conn_t     g_test_nus_conns[TEST_NUS_NUM_CONNS];
+static test_nus_link_t     g_test_nus_link = {
+    .conn_interval_us = TEST_NUS_CONN_INTERVAL_US,
+    .num_tx_bufs      = TEST_NUS_LINK_NUM_TX_BUFS,
+    .num_conns        = 1U,
+    .att_mtu          = TEST_NUS_ATT_MTU_MAX,
+    .att_mtu_peer     = TEST_NUS_ATT_MTU_MAX,
+};
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+typedef struct test_nus_l2cap_t
+{
+    struct bt_l2cap_server* p_server;
+    struct bt_l2cap_chan*   p_chan;
+    uint32_t                mps;
+    uint32_t                credits;
+    uint32_t                sdu_ofs;  //!< Bytes of the first SDU (with the SDU length) which are already segmented
+    uint32_t                idx_first;
+    uint32_t                num_queued;
+    struct net_buf*         sdu_queue[TEST_NUS_L2CAP_MAX_SDUS];
+} test_nus_l2cap_t;
+
+static test_nus_l2cap_t g_test_nus_l2cap;
+#endif
+
+static struct k_spinlock   g_test_nus_link_lock;
+static struct bt_gatt_attr g_test_nus_tx_attr;
+
+// Records with the sequence numbers received by the client, to compare the compressed and uncompressed responses
+static nus_hist_decoder_record_t g_test_nus_captured[TEST_NUS_NUM_RECORDS];
+static nus_hist_decoder_record_t g_test_nus_chunk[NUS_HIST_DECODER_MAX_RECORDS_IN_CHUNK];
+static nus_hist_decoder_record_t g_test_nus_expected[TEST_NUS_NUM_RECORDS];
+static uint32_t                  g_test_nus_lost_chunk_idx = UINT32_MAX; //!< Chunk which is lost by the client
+
+int
+bt_nus_inst_cb_register(struct bt_nus_inst* p_inst, struct bt_nus_cb* p_cb, void* p_ctx)
+{
+    ARG_UNUSED(p_inst);
+    g_test_nus_p_cb     = p_cb;
+    g_test_nus_p_cb_ctx = p_ctx;
+    return 0;
+}
+
+static uint32_t
+test_nus_unpack_uint32(const uint8_t* const p_buf)
+{
+    return ((uint32_t)p_buf[BYTE_IDX_0] << BYTE_SHIFT_3) | ((uint32_t)p_buf[BYTE_IDX_1] << BYTE_SHIFT_2)
+           | ((uint32_t)p_buf[BYTE_IDX_2] << BYTE_SHIFT_1) | ((uint32_t)p_buf[BYTE_IDX_3] << BYTE_SHIFT_0);
+}
+
+static void
+test_nus_pack_uint32(uint8_t* const p_buf, const uint32_t val)
+{
+    p_buf[BYTE_IDX_0] = (uint8_t)((val >> BYTE_SHIFT_3) & BYTE_MASK);
+    p_buf[BYTE_IDX_1] = (uint8_t)((val >> BYTE_SHIFT_2) & BYTE_MASK);
+    p_buf[BYTE_IDX_2] = (uint8_t)((val >> BYTE_SHIFT_1) & BYTE_MASK);
+    p_buf[BYTE_IDX_3] = (uint8_t)((val >> BYTE_SHIFT_0) & BYTE_MASK);
+}
+
+static float
+test_nus_decode_co2(const uint8_t* const p_payload)
+{
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    memset(buffer, 0xFF, sizeof(buffer));
+    memcpy(buffer, p_payload, sizeof(hist_log_record_data_t));
+    re_e1_data_t e1_data = { 0 };
+    (void)re_e1_decode(buffer, &e1_data);
+    return e1_data.co2;
+}
+
+static test_nus_conn_t*
+test_nus_get_conn(struct bt_conn* const p_conn)
+{
+    return (test_nus_conn_t*)(void*)p_conn;
+}
+
+static void
+test_nus_check_aggregated_record(test_nus_stats_t* const p_stats, const uint8_t* const p_record)
+{
+    const float mean = test_nus_decode_co2(&p_record[RE_LOG_WRITE_AIRQ_PAYLOAD_OFS]);
+    const float min  = test_nus_decode_co2(&p_record[TEST_NUS_AGGREGATED_MIN_OFS]);
+    const float max  = test_nus_decode_co2(&p_record[TEST_NUS_AGGREGATED_MAX_OFS]);
+    if ((mean < min) || (mean > max))
+    {
+        p_stats->num_not_in_range += 1;
+    }
+}
+
+static void
+test_nus_account_interval(test_nus_stats_t* const p_stats, const uint8_t* const p_record)
+{
+    const uint32_t timestamp_first = test_nus_unpack_uint32(&p_record[TEST_NUS_INTERVAL_TIMESTAMP_FIRST_OFS]);
+    const uint32_t timestamp_last  = test_nus_unpack_uint32(&p_record[TEST_NUS_INTERVAL_TIMESTAMP_LAST_OFS]);
+    const uint32_t num_records     = ((uint32_t)p_record[TEST_NUS_INTERVAL_NUM_RECORDS_OFS] << BYTE_SHIFT_1)
+                                     | p_record[TEST_NUS_INTERVAL_NUM_RECORDS_OFS + 1U];
+    if (0 == p_stats->num_records)
+    {
+        p_stats->timestamp_first = timestamp_first;
+    }
+    p_stats->timestamp_last = timestamp_last;
+    p_stats->num_records += 1;
+    p_stats->num_interval_records += num_records;
+    // The interval contains only the consecutive records
+    if ((0 == num_records) || ((timestamp_last - timestamp_first) != ((num_records - 1U) * TEST_NUS_PERIOD_SECONDS)))
+    {
+        p_stats->num_wrong_intervals += 1;
+    }
+}
+
+static uint32_t
+test_nus_get_air_time_us(const uint32_t len)
+{
+    return ((len + TEST_NUS_PDU_OVERHEAD_BYTES + TEST_NUS_EMPTY_PDU_BYTES) * TEST_NUS_US_PER_BYTE)
+           + (2U * TEST_NUS_T_IFS_US);
+}
+
+static void
+test_nus_capture_record(test_nus_conn_t* const p_conn, const nus_hist_decoder_record_t* const p_record)
+{
+    test_nus_stats_t* const p_stats = &p_conn->stats;
+    if (0 == p_stats->num_records)
+    {
+        p_stats->timestamp_first = p_record->timestamp;
+    }
+    p_stats->timestamp_last = p_record->timestamp;
+    if ((NULL != p_conn->p_captured) && (p_stats->num_records < ARRAY_SIZE(g_test_nus_captured)))
+    {
+        p_conn->p_captured[p_stats->num_records] = *p_record;
+    }
+    p_stats->num_records += 1;
+}
+
+static void
+test_nus_account_compressed(test_nus_conn_t* const p_conn, const uint8_t* const p_msg, const uint16_t len)
+{
+    test_nus_stats_t* const p_stats = &p_conn->stats;
+    if (0 != p_msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX])
+    {
+        p_stats->num_chunks += 1;
+        if (g_test_nus_lost_chunk_idx == (p_stats->num_chunks - 1U))
+        {
+            return;
+        }
+    }
+    uint32_t                        num_records = 0;
+    uint32_t                        seq_last    = 0;
+    const nus_hist_decoder_status_e status
+        = nus_hist_decoder_decode(p_msg, len, g_test_nus_chunk, &num_records, &seq_last);
+    if (NUS_HIST_DECODER_STATUS_ERROR == status)
+    {
+        p_stats->num_decode_errors += 1;
+        return;
+    }
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        test_nus_capture_record(p_conn, &g_test_nus_chunk[i]);
+    }
+}
+
+static void
+test_nus_account_packet(test_nus_conn_t* const p_conn, const uint8_t* const p_msg, const uint16_t len)
+{
+    test_nus_stats_t* const p_stats = &p_conn->stats;
+
+    p_stats->num_packets += 1;
+    p_stats->num_bytes += len;
+    p_stats->packet_len_max = MAX(p_stats->packet_len_max, len);
+
+    if (NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED == p_msg[RE_STANDARD_OPERATION_INDEX])
+    {
+        test_nus_account_compressed(p_conn, p_msg, len);
+        return;
+    }
+    const uint32_t num_records = p_msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX];
+    const uint32_t record_len  = p_msg[RE_LOG_WRITE_MULTI_RECORD_LEN_IDX];
+    p_stats->record_len        = record_len;
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        const uint8_t* const p_record = &p_msg[RE_LOG_WRITE_MULTI_PAYLOAD_IDX + (i * record_len)];
+        if (TEST_NUS_SEQ_RECORD_LEN == record_len)
+        {
+            nus_hist_decoder_record_t record = {
+                .seq       = test_nus_unpack_uint32(p_record),
+                .timestamp = test_nus_unpack_uint32(&p_record[TEST_NUS_SEQ_SIZE + RE_LOG_WRITE_AIRQ_TIMESTAMP_MSB_OFS]),
+            };
+            memcpy(
+                record.data.buf,
+                &p_record[TEST_NUS_SEQ_SIZE + RE_LOG_WRITE_AIRQ_PAYLOAD_OFS],
+                sizeof(record.data.buf));
+            test_nus_capture_record(p_conn, &record);
+            continue;
+        }
+        if (TEST_NUS_INTERVAL_LEN == record_len)
+        {
+            test_nus_account_interval(p_stats, p_record);
+            continue;
+        }
+        const uint32_t timestamp = test_nus_unpack_uint32(&p_record[RE_LOG_WRITE_AIRQ_TIMESTAMP_MSB_OFS]);
+        if (0 == p_stats->num_records)
+        {
+            p_stats->timestamp_first = timestamp;
+        }
+        p_stats->timestamp_last = timestamp;
+        p_stats->num_records += 1;
+        if (TEST_NUS_AGGREGATED_RECORD_LEN == record_len)
+        {
+            test_nus_check_aggregated_record(p_stats, p_record);
+        }
+    }
+}
+
+/**
+ * @brief Put the PDU into a free TX buffer, the lock must be held.
+ * @param len_on_air The PDU with the headers of all the layers and the empty PDU of the central.
+ */
+static void
+test_nus_link_push(test_nus_conn_t* const p_conn, const test_nus_link_pdu_t* const p_pdu, const uint32_t len_on_air)
+{
+    const uint32_t idx = (p_conn->idx_first + p_conn->num_queued) % TEST_NUS_LINK_MAX_TX_BUFS;
+
+    p_conn->queue[idx] = *p_pdu;
+    p_conn->num_queued += 1;
+    g_test_nus_link.num_queued += 1;
+    p_conn->stats.num_bytes_on_air += len_on_air;
+    p_conn->stats.air_time_us += p_pdu->air_time_us;
+}
+
+/**
+ * @brief Put the notification into a free TX buffer, it is sent at the next connection event.
+ */
+static int
+test_nus_link_enqueue(
+    test_nus_conn_t* const        p_conn,
+    const uint8_t* const          p_msg,
+    const uint16_t                len,
+    const bt_gatt_complete_func_t func,
+    void* const                   p_user_data)
+{
+    k_spinlock_key_t key = k_spin_lock(&g_test_nus_link_lock);
+    if (p_conn->is_disconnected)
+    {
+        k_spin_unlock(&g_test_nus_link_lock, key);
+        return -ENOTCONN;
+    }
+    if (g_test_nus_link.num_queued >= g_test_nus_link.num_tx_bufs)
+    {
+        p_conn->stats.num_rejected += 1;
+        k_spin_unlock(&g_test_nus_link_lock, key);
+        return -ENOMEM;
+    }
+    // The notification which does not fit into the ATT MTU is rejected by the stack
+    if ((len + TEST_NUS_ATT_NOTIFY_HEADER_SIZE) > g_test_nus_link.att_mtu)
+    {
+        k_spin_unlock(&g_test_nus_link_lock, key);
+        return -EMSGSIZE;
+    }
+    test_nus_link_push(
+        p_conn,
+        &(test_nus_link_pdu_t) {
+            .air_time_us = test_nus_get_air_time_us(len),
+            .is_eof      = (0 == p_msg[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX]),
+            .func        = func,
+            .p_user_data = p_user_data,
+        },
+        len + TEST_NUS_PDU_OVERHEAD_BYTES + TEST_NUS_EMPTY_PDU_BYTES);
+    test_nus_account_packet(p_conn, p_msg, len);
+    k_spin_unlock(&g_test_nus_link_lock, key);
+    return 0;
+}
+
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+/**
+ * @brief Segment the queued SDUs into the free TX buffers while the central has credits, the lock must be held.
+ */
+static void
+test_nus_l2cap_segment(void)
+{
+    test_nus_l2cap_t* const p_l2cap = &g_test_nus_l2cap;
+    while ((0 != p_l2cap->num_queued) && (0 != p_l2cap->credits)
+           && (g_test_nus_link.num_queued < g_test_nus_link.num_tx_bufs))
+    {
+        struct net_buf* const p_sdu   = p_l2cap->sdu_queue[p_l2cap->idx_first];
+        const uint32_t        sdu_len = TEST_NUS_L2CAP_SDU_HEADER_SIZE + p_sdu->len;
+        const uint32_t        seg_len = MIN(p_l2cap->mps, sdu_len - p_l2cap->sdu_ofs);
+        const uint32_t        pdu_len = seg_len + TEST_NUS_L2CAP_PDU_OVERHEAD_BYTES + TEST_NUS_EMPTY_PDU_BYTES;
+        p_l2cap->sdu_ofs += seg_len;
+        p_l2cap->credits -= 1;
+        const bool is_last = (p_l2cap->sdu_ofs == sdu_len);
+        test_nus_link_push(
+            test_nus_get_conn(p_l2cap->p_chan->conn),
+            &(test_nus_link_pdu_t) {
+                .air_time_us = (pdu_len * TEST_NUS_US_PER_BYTE) + (2U * TEST_NUS_T_IFS_US),
+                .is_eof      = is_last && (0 == p_sdu->data[RE_LOG_WRITE_MULTI_NUM_RECORDS_IDX]),
+                .is_l2cap    = true,
+                .p_sdu       = is_last ? p_sdu : NULL,
+            },
+            pdu_len);
+        if (is_last)
+        {
+            p_l2cap->sdu_ofs   = 0;
+            p_l2cap->idx_first = (p_l2cap->idx_first + 1U) % TEST_NUS_L2CAP_MAX_SDUS;
+            p_l2cap->num_queued -= 1;
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Send the queued notifications which fit into the connection event and free their TX buffers.
+ */
+static void
+test_nus_link_conn_event(test_nus_conn_t* const p_conn, const uint32_t event_len_us)
+{
+    uint32_t air_time_left_us = event_len_us;
+    uint32_t num_sent         = 0;
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+    uint32_t num_l2cap_pdus = 0;
+#endif
+    while (true)
+    {
+        k_spinlock_key_t key = k_spin_lock(&g_test_nus_link_lock);
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+        test_nus_l2cap_segment();
+#endif
+        if (0 == p_conn->num_queued)
+        {
+            k_spin_unlock(&g_test_nus_link_lock, key);
+            break;
+        }
+        const test_nus_link_pdu_t pdu = p_conn->queue[p_conn->idx_first];
+        if (pdu.air_time_us > air_time_left_us)
+        {
+            k_spin_unlock(&g_test_nus_link_lock, key);
+            break;
+        }
+        air_time_left_us -= pdu.air_time_us;
+        p_conn->idx_first = (p_conn->idx_first + 1U) % TEST_NUS_LINK_MAX_TX_BUFS;
+        p_conn->num_queued -= 1;
+        g_test_nus_link.num_queued -= 1;
+        k_spin_unlock(&g_test_nus_link_lock, key);
+
+        num_sent += 1;
+        if (NULL != pdu.func)
+        {
+            pdu.func((struct bt_conn*)p_conn, pdu.p_user_data);
+        }
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+        if (pdu.is_l2cap)
+        {
+            num_l2cap_pdus += 1;
+        }
+        if (NULL != pdu.p_sdu)
+        {
+            net_buf_unref(pdu.p_sdu);
+        }
+#endif
+        if (pdu.is_eof)
+        {
+            k_sem_give(&p_conn->sem_eof);
+        }
+    }
+    if (0 != num_sent)
+    {
+        p_conn->stats.num_conn_events += 1;
+    }
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+    k_spinlock_key_t key = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_l2cap.credits += num_l2cap_pdus;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+#endif
+}
+
+static void
+test_nus_link_thread(void* p1, void* p2, void* p3)
+{
+    ARG_UNUSED(p1);
+    ARG_UNUSED(p2);
+    ARG_UNUSED(p3);
+
+    while (true)
+    {
+        const uint32_t event_len_us = g_test_nus_link.conn_interval_us / g_test_nus_link.num_conns;
+        k_sleep(K_USEC(event_len_us));
+        const uint32_t conn_idx       = g_test_nus_link.conn_idx_next % g_test_nus_link.num_conns;
+        g_test_nus_link.conn_idx_next = conn_idx + 1U;
+        test_nus_link_conn_event(&g_test_nus_conns[conn_idx], event_len_us);
+    }
+}
+
+K_THREAD_DEFINE(
+    test_nus_link_tid,
+    TEST_NUS_LINK_THREAD_STACK_SIZE,
+    &test_nus_link_thread,
+    NULL,
+    NULL,
+    NULL,
+    TEST_NUS_LINK_THREAD_PRIORITY,
+    0,
+    0);
+
+static void
+test_nus_link_configure(const uint32_t conn_interval_us, const uint32_t num_tx_bufs)
+{
+    k_spinlock_key_t key             = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_link.conn_interval_us = conn_interval_us;
+    g_test_nus_link.num_tx_bufs      = num_tx_bufs;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+}
+
+static void
+test_nus_link_set_num_conns(const uint32_t num_conns)
+{
+    k_spinlock_key_t key          = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_link.num_conns     = num_conns;
+    g_test_nus_link.conn_idx_next = 0;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+}
+
+static void
+test_nus_link_set_mtu(const uint16_t att_mtu, const uint16_t att_mtu_peer)
+{
+    k_spinlock_key_t key                 = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_link.att_mtu              = att_mtu;
+    g_test_nus_link.att_mtu_peer         = att_mtu_peer;
+    g_test_nus_link.num_mtu_exchanges    = 0;
+    g_test_nus_link.num_data_len_updates = 0;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+}
+
+struct bt_conn*
+bt_conn_ref(struct bt_conn* p_conn)
+{
+    (void)atomic_inc(&test_nus_get_conn(p_conn)->num_refs);
+    return p_conn;
+}
+
+void
+bt_conn_unref(struct bt_conn* p_conn)
+{
+    zassert_true(atomic_dec(&test_nus_get_conn(p_conn)->num_refs) > 0);
+}
+
+int
+bt_conn_get_info(const struct bt_conn* p_conn, struct bt_conn_info* p_info)
+{
+    const test_nus_conn_t* const p_test_conn = (const test_nus_conn_t*)(const void*)p_conn;
+    memset(p_info, 0, sizeof(*p_info));
+    p_info->state = p_test_conn->is_disconnected ? BT_CONN_STATE_DISCONNECTED : BT_CONN_STATE_CONNECTED;
+    return 0;
+}
+
+uint16_t
+bt_gatt_get_mtu(struct bt_conn* p_conn)
+{
+    ARG_UNUSED(p_conn);
+    return g_test_nus_link.att_mtu;
+}
+
+int
+bt_gatt_exchange_mtu(struct bt_conn* p_conn, struct bt_gatt_exchange_params* p_params)
+{
+    g_test_nus_link.num_mtu_exchanges += 1;
+    g_test_nus_link.att_mtu = MIN(TEST_NUS_ATT_MTU_MAX, g_test_nus_link.att_mtu_peer);
+    p_params->func(p_conn, 0, p_params);
+    return 0;
+}
+
+int
+bt_conn_le_data_len_update(struct bt_conn* p_conn, const struct bt_conn_le_data_len_param* p_param)
+{
+    ARG_UNUSED(p_conn);
+    ARG_UNUSED(p_param);
+    g_test_nus_link.num_data_len_updates += 1;
+    return 0;
+}
+
+int
+bt_nus_inst_send(struct bt_conn* p_conn, struct bt_nus_inst* p_inst, const void* p_data, uint16_t len)
+{
+    ARG_UNUSED(p_inst);
+    return test_nus_link_enqueue(test_nus_get_conn(p_conn), p_data, len, NULL, NULL);
+}
+
+struct bt_gatt_attr*
+bt_gatt_find_by_uuid(const struct bt_gatt_attr* p_attr, uint16_t attr_count, const struct bt_uuid* p_uuid)
+{
+    ARG_UNUSED(p_attr);
+    ARG_UNUSED(attr_count);
+    static const struct bt_uuid_128 nus_tx_char_uuid = BT_UUID_INIT_128(BT_UUID_NUS_TX_CHAR_VAL);
+    if ((BT_UUID_TYPE_128 != p_uuid->type)
+        || (0 != memcmp(BT_UUID_128(p_uuid)->val, nus_tx_char_uuid.val, sizeof(nus_tx_char_uuid.val))))
+    {
+        return NULL;
+    }
+    return &g_test_nus_tx_attr;
+}
+
+int
+bt_gatt_notify_cb(struct bt_conn* p_conn, struct bt_gatt_notify_params* p_params)
+{
+    if (&g_test_nus_tx_attr != p_params->attr)
+    {
+        return -EINVAL;
+    }
+    return test_nus_link_enqueue(
+        test_nus_get_conn(p_conn),
+        p_params->data,
+        p_params->len,
+        p_params->func,
+        p_params->user_data);
+}
+
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+int
+bt_l2cap_server_register(struct bt_l2cap_server* p_server)
+{
+    g_test_nus_l2cap.p_server = p_server;
+    return 0;
+}
+
+/**
+ * @brief Queue the SDU, it is segmented into the TX buffers at the connection events.
+ */
+int
+bt_l2cap_chan_send(struct bt_l2cap_chan* p_chan, struct net_buf* p_buf)
+{
+    if (p_chan != g_test_nus_l2cap.p_chan)
+    {
+        return -ENOTCONN;
+    }
+    if (p_buf->len > BT_L2CAP_LE_CHAN(p_chan)->tx.mtu)
+    {
+        return -EMSGSIZE;
+    }
+    k_spinlock_key_t key = k_spin_lock(&g_test_nus_link_lock);
+    if (g_test_nus_l2cap.num_queued >= TEST_NUS_L2CAP_MAX_SDUS)
+    {
+        k_spin_unlock(&g_test_nus_link_lock, key);
+        return -ENOMEM;
+    }
+    const uint32_t idx = (g_test_nus_l2cap.idx_first + g_test_nus_l2cap.num_queued) % TEST_NUS_L2CAP_MAX_SDUS;
+
+    g_test_nus_l2cap.sdu_queue[idx] = p_buf;
+    g_test_nus_l2cap.num_queued += 1;
+    test_nus_account_packet(test_nus_get_conn(p_chan->conn), p_buf->data, p_buf->len);
+    k_spin_unlock(&g_test_nus_link_lock, key);
+    return 0;
+}
+
+/**
+ * @brief Open the channel to the server of the NUS module as the central does.
+ */
+static void
+test_nus_l2cap_connect(const uint16_t mtu, const uint16_t mps, const uint32_t credits)
+{
+    zassert_not_null(g_test_nus_l2cap.p_server);
+    struct bt_l2cap_chan* p_chan = NULL;
+    ZASSERT_EQ_INT(0, g_test_nus_l2cap.p_server->accept(NULL, g_test_nus_l2cap.p_server, &p_chan));
+    zassert_not_null(p_chan);
+    // The stack binds the channel to the connection after it is accepted
+    p_chan->conn                     = TEST_NUS_CONN(0);
+    BT_L2CAP_LE_CHAN(p_chan)->tx.mtu = mtu;
+    BT_L2CAP_LE_CHAN(p_chan)->tx.mps = mps;
+
+    k_spinlock_key_t key     = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_l2cap.p_chan  = p_chan;
+    g_test_nus_l2cap.mps     = mps;
+    g_test_nus_l2cap.credits = credits;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+    p_chan->ops->connected(p_chan);
+}
+
+static void
+test_nus_l2cap_disconnect(void)
+{
+    struct bt_l2cap_chan* const p_chan = g_test_nus_l2cap.p_chan;
+    if (NULL == p_chan)
+    {
+        return;
+    }
+    k_spinlock_key_t key    = k_spin_lock(&g_test_nus_link_lock);
+    g_test_nus_l2cap.p_chan = NULL;
+    k_spin_unlock(&g_test_nus_link_lock, key);
+    p_chan->ops->disconnected(p_chan);
+}
+#endif
+
+static void*
+test_setup(void);
+
+static void
+test_suite_before(void* f);
+
+static void
+test_suite_after(void* f);
+
+static void
+test_teardown(void* f);
+
+ZTEST_SUITE(test_suite_nus, NULL, &test_setup, &test_suite_before, &test_suite_after, &test_teardown);
+
+typedef struct test_suite_nus_fixture
+{
+    uint32_t timestamp_last;
+} test_suite_nus_fixture_t;
+
+/**
+ * @brief Generate the 5-minute averages of the indoor measurements with daily cycles.
+ */
+static hist_log_record_data_t
+test_nus_gen_record_data(const uint32_t idx)
+{
+    const uint32_t time_of_day = (idx * TEST_NUS_PERIOD_SECONDS) % TEST_NUS_ONE_DAY;
+    const float    day_phase   = (2.0f * (float)M_PI * (float)time_of_day) / (float)TEST_NUS_ONE_DAY;
+    const float    daylight    = fmaxf(0.0f, -cosf(day_phase));
+    const float    occupancy   = fmaxf(0.0f, sinf(day_phase - 0.5f));
+
+    re_e1_data_t e1_data      = re_e1_data_invalid(idx * TEST_NUS_PERIOD_SECONDS, 0);
+    e1_data.temperature_c     = 21.5f + (1.5f * occupancy) - (1.0f * daylight);
+    e1_data.humidity_rh       = 38.0f + (4.0f * occupancy);
+    e1_data.pressure_pa       = 100800.0f + (300.0f * sinf(day_phase / 7.0f));
+    e1_data.pm1p0_ppm         = 2.0f + occupancy;
+    e1_data.pm2p5_ppm         = 2.8f + (1.5f * occupancy);
+    e1_data.pm4p0_ppm         = 3.2f + (1.6f * occupancy);
+    e1_data.pm10p0_ppm        = 3.4f + (1.7f * occupancy);
+    e1_data.co2               = 450.0f + (600.0f * occupancy) + (float)(idx % 7U);
+    e1_data.voc               = 100.0f + (40.0f * occupancy);
+    e1_data.nox               = 1.0f;
+    e1_data.luminosity        = 5.0f + (300.0f * daylight);
+    e1_data.sound_inst_dba    = 32.0f + (12.0f * occupancy);
+    e1_data.sound_avg_dba     = 34.0f + (10.0f * occupancy);
+    e1_data.sound_peak_spl_db = 50.0f + (15.0f * occupancy);
+
+    uint8_t buffer[RE_E1_DATA_LENGTH];
+    (void)re_e1_encode(buffer, &e1_data);
+    hist_log_record_data_t data = { 0 };
+    memcpy(data.buf, buffer, sizeof(data.buf));
+    return data;
+}
+
+/**
+ * @brief Wait until the requests of the mock connection are handled and their references to it are released.
+ */
+static void
+test_nus_wait_released(const uint32_t conn_idx)
+{
+    const test_nus_conn_t* const p_conn   = &g_test_nus_conns[conn_idx];
+    const int64_t                deadline = k_uptime_get() + TEST_NUS_EOF_TIMEOUT_MS;
+    while ((0 != atomic_get(&p_conn->num_refs)) && (k_uptime_get() < deadline))
+    {
+        k_msleep(1);
+    }
+    ZASSERT_EQ_INT(0, (int32_t)atomic_get(&p_conn->num_refs));
+}
+
+static void*
+test_setup(void)
+{
+    test_suite_nus_fixture_t* p_fixture = calloc(1, sizeof(*p_fixture));
+    assert(NULL != p_fixture);
+    // The checkpoint of the sector directory is saved to settings
+    int rc = settings_subsys_init();
+    assert(0 == rc);
+    // The records are written with the timestamps of the local clock, which is the same as the client's time
+    const struct timespec ts = {
+        .tv_sec  = TEST_NUS_BASE_TIMESTAMP + (TEST_NUS_NUM_DAYS * TEST_NUS_ONE_DAY),
+        .tv_nsec = 0,
+    };
+    rc = clock_settime(CLOCK_REALTIME, &ts);
+    assert(0 == rc);
+    for (uint32_t i = 0; i < TEST_NUS_NUM_CONNS; ++i)
+    {
+        k_sem_init(&g_test_nus_conns[i].sem_eof, 0, 1);
+    }
+    g_test_nus_conns[0].p_captured = g_test_nus_captured;
+    const bool res                 = nus_init();
+    assert(res);
+    return p_fixture;
+}
+
+static void
+test_suite_before(void* f)
+{
+    test_suite_nus_fixture_t* p_fixture = f;
+    memset(p_fixture, 0, sizeof(*p_fixture));
+    // Every test starts with the empty storage
+    zassert_true(hist_log_erase());
+    for (uint32_t i = 0; i < TEST_NUS_NUM_CONNS; ++i)
+    {
+        k_sem_reset(&g_test_nus_conns[i].sem_eof);
+        g_test_nus_conns[i].is_disconnected = false;
+    }
+    test_nus_link_configure(TEST_NUS_CONN_INTERVAL_US, TEST_NUS_LINK_NUM_TX_BUFS);
+    test_nus_link_set_num_conns(1U);
+    test_nus_link_set_mtu(TEST_NUS_ATT_MTU_MAX, TEST_NUS_ATT_MTU_MAX);
+    g_test_nus_lost_chunk_idx = UINT32_MAX;
+}
+
+static void
+test_suite_after(void* f)
+{
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+    test_nus_l2cap_disconnect();
+#endif
+    // Every request releases its reference to the connection
+    for (uint32_t i = 0; i < TEST_NUS_NUM_CONNS; ++i)
+    {
+        test_nus_wait_released(i);
+    }
+}
+
+static void
+test_teardown(void* f)
+{
+    if (NULL != f)
+    {
+        free(f);
+    }
+}
+
+static void
+test_nus_fill(test_suite_nus_fixture_t* const p_fixture, const uint32_t num_records)
+{
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        p_fixture->timestamp_last         = TEST_NUS_BASE_TIMESTAMP + (i * TEST_NUS_PERIOD_SECONDS);
+        const hist_log_record_data_t data = test_nus_gen_record_data(i);
+        zassert_true(hist_log_append_record(p_fixture->timestamp_last, &data, false));
+    }
+}
+
+/**
+ * @brief Send the request to the NUS service over the mock connection.
+ */
+static void
+test_nus_start_request(const uint32_t conn_idx, const uint8_t* const p_msg, const uint16_t len)
+{
+    test_nus_conn_t* const p_conn = &g_test_nus_conns[conn_idx];
+    memset(&p_conn->stats, 0, sizeof(p_conn->stats));
+    zassert_not_null(g_test_nus_p_cb);
+    p_conn->time_start = k_uptime_get();
+    g_test_nus_p_cb->received(TEST_NUS_CONN(conn_idx), p_msg, len, g_test_nus_p_cb_ctx);
+}
+
+/**
+ * @brief Wait until the end-of-data message is acknowledged on the mock connection.
+ */
+static test_nus_stats_t
+test_nus_wait_eof(const uint32_t conn_idx)
+{
+    test_nus_conn_t* const p_conn = &g_test_nus_conns[conn_idx];
+    ZASSERT_EQ_INT(0, k_sem_take(&p_conn->sem_eof, K_MSEC(TEST_NUS_EOF_TIMEOUT_MS)));
+    p_conn->stats.time_ms = (uint32_t)(k_uptime_get() - p_conn->time_start);
+    return p_conn->stats;
+}
+
+/**
+ * @brief Send the request to the NUS service and wait until the end-of-data message is acknowledged.
+ */
+static test_nus_stats_t
+test_nus_send_request(const uint8_t* const p_msg, const uint16_t len)
+{
+    test_nus_start_request(0, p_msg, len);
+    return test_nus_wait_eof(0);
+}
+
+/**
+ * @brief Send the history request to the NUS service and wait until the end-of-data message is acknowledged.
+ * @param period_s Aggregation period, 0 means RE_STANDARD_LOG_MULTI_READ.
+ */
+static test_nus_stats_t
+test_nus_read_history(const uint32_t start_time_s, const uint32_t period_s)
+{
+    uint8_t msg[TEST_NUS_REQ_MAX_LEN] = {
+        [RE_STANDARD_DESTINATION_INDEX] = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_OPERATION_INDEX]   = (0 != period_s) ? NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED
+                                                          : RE_STANDARD_LOG_MULTI_READ,
+    };
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_CURRENT_TIME_IDX], (uint32_t)time(NULL));
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_START_TIME_IDX], start_time_s);
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_PERIOD_IDX], period_s);
+    const uint16_t len = (0 != period_s) ? TEST_NUS_REQ_MAX_LEN : RE_STANDARD_MESSAGE_LENGTH;
+    return test_nus_send_request(msg, len);
+}
+
+/**
+ * @brief Pack the request with the standard layout.
+ * @param start Start time, or the sequence number for NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ
+ * and NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED.
+ */
+static void
+test_nus_pack_req(uint8_t* const p_msg, const uint8_t op, const uint32_t start)
+{
+    memset(p_msg, 0, RE_STANDARD_MESSAGE_LENGTH);
+    p_msg[RE_STANDARD_DESTINATION_INDEX] = RE_STANDARD_DESTINATION_AIRQ;
+    p_msg[RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ;
+    p_msg[RE_STANDARD_OPERATION_INDEX]   = op;
+    test_nus_pack_uint32(&p_msg[TEST_NUS_REQ_CURRENT_TIME_IDX], (uint32_t)time(NULL));
+    test_nus_pack_uint32(&p_msg[TEST_NUS_REQ_START_TIME_IDX], start);
+}
+
+/**
+ * @brief Send the request with the standard layout, where the start time field contains the sequence number.
+ * @param op NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ or NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED.
+ */
+static test_nus_stats_t
+test_nus_read_after_seq(const uint8_t op, const uint32_t after_seq)
+{
+    uint8_t msg[RE_STANDARD_MESSAGE_LENGTH];
+    test_nus_pack_req(msg, op, after_seq);
+    return test_nus_send_request(msg, sizeof(msg));
+}
+
+static void
+test_nus_print_stats(const char* const p_name, const test_nus_stats_t* const p_stats)
+{
+    printf(
+        "NUS history %-6s: %5u records, %4u packets, %6u bytes, %6u bytes on air, air time %5u ms, total %5u ms\n",
+        p_name,
+        (unsigned)p_stats->num_records,
+        (unsigned)p_stats->num_packets,
+        (unsigned)p_stats->num_bytes,
+        (unsigned)p_stats->num_bytes_on_air,
+        (unsigned)(p_stats->air_time_us / 1000U),
+        (unsigned)p_stats->time_ms);
+}
+
+ZTEST_F(test_suite_nus, test_tx_throughput)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    static const struct
+    {
+        uint32_t conn_interval_us;
+        uint32_t num_tx_bufs;
+    } links[] = {
+        { 7500U, 4U },
+        { 7500U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 15000U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 30000U, TEST_NUS_LINK_NUM_TX_BUFS },
+    };
+    for (uint32_t i = 0; i < ARRAY_SIZE(links); ++i)
+    {
+        test_nus_link_configure(links[i].conn_interval_us, links[i].num_tx_bufs);
+        nus_reset_stats();
+        const test_nus_stats_t stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+        ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, stats.num_records);
+        ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, stats.timestamp_first);
+        ZASSERT_EQ_INT(fixture->timestamp_last, stats.timestamp_last);
+        nus_stats_t nus_stats = { 0 };
+        nus_get_stats(&nus_stats);
+        printf(
+            "NUS TX %s: conn interval %5u us, %2u TX buffers: %5u records/s, %4u packets in %4u connection events, "
+            "%5u rejected, %5u retries after sleep\n",
+            IS_ENABLED(CONFIG_RUUVI_AIR_NUS_TX_PIPELINE) ? "pipeline" : "sleep-and-retry",
+            (unsigned)links[i].conn_interval_us,
+            (unsigned)links[i].num_tx_bufs,
+            (unsigned)((stats.num_records * 1000U) / stats.time_ms),
+            (unsigned)stats.num_packets,
+            (unsigned)stats.num_conn_events,
+            (unsigned)stats.num_rejected,
+            (unsigned)nus_stats.num_tx_sleeps);
+        ZASSERT_EQ_INT(stats.num_rejected, nus_stats.num_tx_retries);
+
+#if defined(CONFIG_RUUVI_AIR_NUS_TX_PIPELINE)
+        // The next packet is queued as soon as one of the notifications is sent, so every connection event
+        // is filled up to the number of the notifications in flight, the TX buffers or the air time of the event
+        const uint32_t packets_per_event = MIN(
+            MIN(links[i].num_tx_bufs, CONFIG_RUUVI_AIR_NUS_TX_NUM_IN_FLIGHT),
+            links[i].conn_interval_us / test_nus_get_air_time_us(TEST_NUS_MAX_PACKET_LEN));
+        const uint32_t num_events_min = (stats.num_packets + packets_per_event - 1U) / packets_per_event;
+        const uint32_t time_min_ms    = ((num_events_min + 1U) * links[i].conn_interval_us) / 1000U;
+        zassert_true(stats.time_ms <= (time_min_ms + (time_min_ms / 10U)));
+        // The TX buffers are used only by the notifications of the transfer, so every retry waits for a sent callback
+        ZASSERT_EQ_INT(0, nus_stats.num_tx_sleeps);
+#else
+        ZASSERT_EQ_INT(nus_stats.num_tx_retries, nus_stats.num_tx_sleeps);
+#endif
+    }
+}
+
+/**
+ * @brief Two clients request the whole history at the same time over the connections which share the TX buffers.
+ */
+ZTEST_F(test_suite_nus, test_concurrent_transfers)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    static const struct
+    {
+        uint32_t conn_interval_us;
+        uint32_t num_tx_bufs;
+    } links[] = {
+        { 7500U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 15000U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 30000U, TEST_NUS_LINK_NUM_TX_BUFS },
+    };
+    uint8_t msg[RE_STANDARD_MESSAGE_LENGTH];
+    for (uint32_t i = 0; i < ARRAY_SIZE(links); ++i)
+    {
+        test_nus_link_configure(links[i].conn_interval_us, links[i].num_tx_bufs);
+        test_nus_link_set_num_conns(1U);
+        // The request contains the current time of the client, which is the same as the local time
+        test_nus_pack_req(msg, RE_STANDARD_LOG_MULTI_READ, TEST_NUS_BASE_TIMESTAMP);
+        const test_nus_stats_t single = test_nus_send_request(msg, sizeof(msg));
+        ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, single.num_records);
+
+        test_nus_link_set_num_conns(TEST_NUS_NUM_CONNS);
+        const int64_t time_start = k_uptime_get();
+        test_nus_pack_req(msg, RE_STANDARD_LOG_MULTI_READ, TEST_NUS_BASE_TIMESTAMP);
+        for (uint32_t j = 0; j < TEST_NUS_NUM_CONNS; ++j)
+        {
+            test_nus_start_request(j, msg, sizeof(msg));
+        }
+        test_nus_stats_t stats[TEST_NUS_NUM_CONNS] = { 0 };
+        uint32_t         time_min_ms               = UINT32_MAX;
+        uint32_t         time_max_ms               = 0;
+        for (uint32_t j = 0; j < TEST_NUS_NUM_CONNS; ++j)
+        {
+            stats[j] = test_nus_wait_eof(j);
+            ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, stats[j].num_records);
+            ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, stats[j].timestamp_first);
+            ZASSERT_EQ_INT(fixture->timestamp_last, stats[j].timestamp_last);
+            time_min_ms = MIN(time_min_ms, stats[j].time_ms);
+            time_max_ms = MAX(time_max_ms, stats[j].time_ms);
+        }
+        const uint32_t time_ms       = (uint32_t)(k_uptime_get() - time_start);
+        const uint32_t records_per_s = (TEST_NUS_NUM_CONNS * TEST_NUS_NUM_RECORDS * 1000U) / time_ms;
+        printf(
+            "NUS TX %s: conn interval %5u us: one client %5u records/s, %u clients %5u records/s "
+            "(finished in %5u and %5u ms)\n",
+            IS_ENABLED(CONFIG_RUUVI_AIR_NUS_TX_PIPELINE) ? "pipeline" : "sleep-and-retry",
+            (unsigned)links[i].conn_interval_us,
+            (unsigned)((single.num_records * 1000U) / single.time_ms),
+            (unsigned)TEST_NUS_NUM_CONNS,
+            (unsigned)records_per_s,
+            (unsigned)stats[0].time_ms,
+            (unsigned)stats[1].time_ms);
+
+#if defined(CONFIG_RUUVI_AIR_NUS_TX_PIPELINE) && (CONFIG_RUUVI_AIR_NUS_NUM_TRANSFERS >= TEST_NUS_NUM_CONNS)
+        // Without the sent callbacks there is nothing to share the TX buffers by,
+        // so with sleep-and-retry (or a single transfer context) only the completeness of both transfers is checked.
+
+        // The transfers run concurrently, so the second client does not wait for the first one to finish
+        zassert_true(time_min_ms > (time_max_ms / 2U));
+        // The air time and the TX buffers are shared, the shorter connection events fit fewer packets
+        zassert_true((records_per_s * 4U) >= ((single.num_records * 1000U * 3U) / single.time_ms));
+        // Every transfer gets an equal share of the TX buffers, so both finish at about the same time
+        zassert_true((time_max_ms - time_min_ms) <= (time_max_ms / 10U));
+#endif
+    }
+}
+
+ZTEST_F(test_suite_nus, test_disconnect_during_transfer)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    // The second request of the connection waits in the queue of its transfer context
+    uint8_t msg[RE_STANDARD_MESSAGE_LENGTH];
+    test_nus_pack_req(msg, RE_STANDARD_LOG_MULTI_READ, 0);
+    test_nus_start_request(0, msg, sizeof(msg));
+    test_nus_start_request(0, msg, sizeof(msg));
+    k_msleep(TEST_NUS_DISCONNECT_DELAY_MS);
+    g_test_nus_conns[0].is_disconnected = true;
+
+    // The transfer stops, the queued request is dropped, and the connection object is released
+    test_nus_wait_released(0);
+    zassert_false(nus_is_reading_hist_in_progress());
+    zassert_true(g_test_nus_conns[0].stats.num_records < TEST_NUS_NUM_RECORDS);
+    zassert_not_equal(0, k_sem_take(&g_test_nus_conns[0].sem_eof, K_NO_WAIT));
+
+    // The next client gets the same connection object and a transfer of its own
+    g_test_nus_conns[0].is_disconnected = false;
+    test_nus_pack_req(msg, RE_STANDARD_LOG_MULTI_READ, 0);
+    const test_nus_stats_t stats = test_nus_send_request(msg, sizeof(msg));
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, stats.num_records);
+    ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, stats.timestamp_first);
+}
+
+static void
+test_nus_set_clock(const uint32_t time_s)
+{
+    const struct timespec ts = {
+        .tv_sec  = time_s,
+        .tv_nsec = 0,
+    };
+    ZASSERT_EQ_INT(0, clock_settime(CLOCK_REALTIME, &ts));
+}
+
+/**
+ * @brief Two clients with different clocks read the whole history at the same time.
+ * @details Every client gets the timestamps in its own time. If the RTC time was lost, the first client
+ * which sends the valid time sets the time offset of the new epoch, but the transfer which is in progress
+ * keeps the offset with which it was started.
+ */
+ZTEST_F(test_suite_nus, test_clients_with_different_clocks)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+    test_nus_link_set_num_conns(TEST_NUS_NUM_CONNS);
+
+    static const int32_t clock_offsets_s[TEST_NUS_NUM_CONNS] = {
+        (int32_t)TEST_NUS_ONE_HOUR,
+        -2 * (int32_t)TEST_NUS_ONE_HOUR,
+    };
+    uint8_t msg[TEST_NUS_NUM_CONNS][RE_STANDARD_MESSAGE_LENGTH];
+    for (uint32_t i = 0; i < TEST_NUS_NUM_CONNS; ++i)
+    {
+        test_nus_pack_req(msg[i], RE_STANDARD_LOG_MULTI_READ, TEST_NUS_BASE_TIMESTAMP + clock_offsets_s[i]);
+        test_nus_pack_uint32(&msg[i][TEST_NUS_REQ_CURRENT_TIME_IDX], (uint32_t)time(NULL) + clock_offsets_s[i]);
+        test_nus_start_request(i, msg[i], sizeof(msg[i]));
+    }
+    for (uint32_t i = 0; i < TEST_NUS_NUM_CONNS; ++i)
+    {
+        const test_nus_stats_t stats = test_nus_wait_eof(i);
+        ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, stats.num_records);
+        ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP + clock_offsets_s[i], stats.timestamp_first);
+        ZASSERT_EQ_INT(fixture->timestamp_last + clock_offsets_s[i], stats.timestamp_last);
+    }
+
+#if defined(CONFIG_RUUVI_AIR_HIST_LOG_KEEP_ON_RTC_LOSS)
+    // The RTC time was lost: the clock restarts from RUUVI_AIR_MIN_UNIX_TIME and a new time epoch is started,
+    // its records continue the history after the last record of the previous epoch
+    const uint32_t time_real     = (uint32_t)time(NULL);
+    const uint32_t time_offset_s = (fixture->timestamp_last + TEST_NUS_PERIOD_SECONDS) - TEST_NUS_MIN_UNIX_TIME;
+    test_nus_set_clock(TEST_NUS_MIN_UNIX_TIME + TEST_NUS_ONE_DAY);
+    zassert_true(hist_log_init(false));
+    const uint32_t num_records_new = TEST_NUS_ONE_DAY / TEST_NUS_PERIOD_SECONDS;
+    for (uint32_t i = 0; i < num_records_new; ++i)
+    {
+        const hist_log_record_data_t data = test_nus_gen_record_data(i);
+        zassert_true(hist_log_append_record(TEST_NUS_MIN_UNIX_TIME + (i * TEST_NUS_PERIOD_SECONDS), &data, false));
+    }
+    const uint32_t timestamp_local_last = TEST_NUS_MIN_UNIX_TIME + ((num_records_new - 1U) * TEST_NUS_PERIOD_SECONDS);
+
+    // The clock of the first client is not set, it gets the timestamps of the local clock of the new epoch
+    test_nus_pack_req(msg[0], RE_STANDARD_LOG_MULTI_READ, 0);
+    test_nus_pack_uint32(&msg[0][TEST_NUS_REQ_CURRENT_TIME_IDX], TEST_NUS_ONE_DAY);
+    test_nus_start_request(0, msg[0], sizeof(msg[0]));
+    const int64_t deadline = k_uptime_get() + TEST_NUS_EOF_TIMEOUT_MS;
+    while ((0 == g_test_nus_conns[0].stats.num_records) && (k_uptime_get() < deadline))
+    {
+        k_msleep(1);
+    }
+    zassert_true(0 != g_test_nus_conns[0].stats.num_records);
+    // The second client sets the time offset of the new epoch while the first one is reading the history
+    test_nus_pack_req(msg[1], RE_STANDARD_LOG_MULTI_READ, 0);
+    test_nus_pack_uint32(&msg[1][TEST_NUS_REQ_CURRENT_TIME_IDX], (uint32_t)time(NULL) + time_offset_s);
+    test_nus_start_request(1, msg[1], sizeof(msg[1]));
+
+    const test_nus_stats_t stats_local = test_nus_wait_eof(0);
+    const test_nus_stats_t stats_real  = test_nus_wait_eof(1);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS + num_records_new, stats_local.num_records);
+    ZASSERT_EQ_INT(timestamp_local_last, stats_local.timestamp_last);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS + num_records_new, stats_real.num_records);
+    ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, stats_real.timestamp_first);
+    // The local clock may tick between sending the request and handling it
+    zassert_within(stats_real.timestamp_last, timestamp_local_last + time_offset_s, 1);
+    test_nus_set_clock(time_real);
+#endif
+}
+
+ZTEST_F(test_suite_nus, test_aggregated_bytes_on_air)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    const test_nus_stats_t raw = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+    test_nus_print_stats("raw", &raw);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, raw.num_records);
+    ZASSERT_EQ_INT(RE_LOG_WRITE_AIRQ_RECORD_LEN, raw.record_len);
+    ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, raw.timestamp_first);
+    ZASSERT_EQ_INT(fixture->timestamp_last, raw.timestamp_last);
+
+    static const struct
+    {
+        const char* p_name;
+        uint32_t    period_s;
+    } buckets[] = {
+        { "1h", TEST_NUS_ONE_HOUR },
+        { "6h", 6U * TEST_NUS_ONE_HOUR },
+        { "1day", TEST_NUS_ONE_DAY },
+    };
+    test_nus_stats_t prev = raw;
+    for (uint32_t i = 0; i < ARRAY_SIZE(buckets); ++i)
+    {
+        const uint32_t         period_s   = buckets[i].period_s;
+        const test_nus_stats_t aggregated = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, period_s);
+        test_nus_print_stats(buckets[i].p_name, &aggregated);
+
+        ZASSERT_EQ_INT((TEST_NUS_NUM_DAYS * TEST_NUS_ONE_DAY) / period_s, aggregated.num_records);
+        ZASSERT_EQ_INT(TEST_NUS_AGGREGATED_RECORD_LEN, aggregated.record_len);
+        ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, aggregated.timestamp_first);
+        // The last bucket, which is still being filled, is sent as well
+        ZASSERT_EQ_INT(fixture->timestamp_last - (fixture->timestamp_last % period_s), aggregated.timestamp_last);
+        ZASSERT_EQ_INT(0, aggregated.num_not_in_range);
+
+        // Every aggregated record is 2.8 times longer than the raw one, but it replaces 12 or more raw records
+        zassert_true((aggregated.num_bytes_on_air * 4U) < raw.num_bytes_on_air);
+        zassert_true(aggregated.num_bytes_on_air < prev.num_bytes_on_air);
+        zassert_true(aggregated.time_ms <= prev.time_ms);
+        prev = aggregated;
+    }
+}
+
+ZTEST_F(test_suite_nus, test_aggregated_from_start_time)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    // The last day is requested, the first bucket starts at the start time
+    const uint32_t         start_time = fixture->timestamp_last + TEST_NUS_PERIOD_SECONDS - TEST_NUS_ONE_DAY;
+    const test_nus_stats_t stats      = test_nus_read_history(start_time, TEST_NUS_ONE_HOUR);
+    ZASSERT_EQ_INT(TEST_NUS_ONE_DAY / TEST_NUS_ONE_HOUR, stats.num_records);
+    ZASSERT_EQ_INT(start_time, stats.timestamp_first);
+}
+
+ZTEST(test_suite_nus, test_req_parse_aggregated)
+{
+    uint8_t msg[TEST_NUS_REQ_MAX_LEN] = {
+        [RE_STANDARD_DESTINATION_INDEX] = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_OPERATION_INDEX]   = NUS_REQ_OP_LOG_MULTI_READ_AGGREGATED,
+    };
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_CURRENT_TIME_IDX], TEST_NUS_BASE_TIMESTAMP);
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_START_TIME_IDX], TEST_NUS_BASE_TIMESTAMP - TEST_NUS_ONE_DAY);
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_PERIOD_IDX], TEST_NUS_ONE_HOUR);
+
+    nus_req_t req = { 0 };
+    zassert_true(nus_req_parse(msg, sizeof(msg), &req));
+    ZASSERT_EQ_INT(RE_LOG_R_MULTI, req.req_re_op);
+    zassert_true(req.is_aggregated);
+    ZASSERT_EQ_INT(TEST_NUS_ONE_HOUR, req.aggregation_period_s);
+    ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP - TEST_NUS_ONE_DAY, req.start_time_s);
+    zassert_false(req.is_filtered);
+
+    // The aggregation period is required
+    zassert_false(nus_req_parse(msg, RE_STANDARD_MESSAGE_LENGTH, &req));
+
+    static const uint32_t invalid_periods[] = {
+        0,
+        TEST_NUS_PERIOD_SECONDS - 1U,
+        TEST_NUS_ONE_HOUR + 1U,
+        NUS_REQ_AGGREGATION_PERIOD_MAX_S + TEST_NUS_PERIOD_SECONDS,
+    };
+    for (uint32_t i = 0; i < ARRAY_SIZE(invalid_periods); ++i)
+    {
+        test_nus_pack_uint32(&msg[TEST_NUS_REQ_PERIOD_IDX], invalid_periods[i]);
+        zassert_false(nus_req_parse(msg, sizeof(msg), &req));
+    }
+
+    // The standard request does not use aggregation
+    msg[RE_STANDARD_OPERATION_INDEX] = RE_STANDARD_LOG_MULTI_READ;
+    zassert_true(nus_req_parse(msg, RE_STANDARD_MESSAGE_LENGTH, &req));
+    zassert_false(req.is_aggregated);
+    zassert_false(nus_req_parse(msg, sizeof(msg), &req));
+}
+
+/**
+ * @brief Pack NUS_REQ_OP_LOG_MULTI_READ_FILTERED for the whole history with one CO2 condition.
+ * @return Length of the message.
+ */
+static uint16_t
+test_nus_pack_req_filtered(uint8_t* const p_msg, const uint8_t mode, const hist_log_filter_op_e op)
+{
+    test_nus_pack_req(p_msg, NUS_REQ_OP_LOG_MULTI_READ_FILTERED, 0);
+    p_msg[TEST_NUS_REQ_FILTER_MODE_IDX]      = mode;
+    p_msg[TEST_NUS_REQ_FILTER_NUM_CONDS_IDX] = 1U;
+    uint8_t* const p_cond                    = &p_msg[TEST_NUS_REQ_FILTER_CONDS_IDX];
+    p_cond[TEST_NUS_REQ_FILTER_FIELD_OFS]    = (uint8_t)HIST_LOG_FIELD_CO2;
+    p_cond[TEST_NUS_REQ_FILTER_OP_OFS]       = (uint8_t)op;
+    test_nus_pack_uint32(&p_cond[TEST_NUS_REQ_FILTER_THRESHOLD_OFS], (uint32_t)TEST_NUS_FILTER_CO2_THRESHOLD);
+    return TEST_NUS_REQ_FILTER_CONDS_IDX + TEST_NUS_REQ_FILTER_COND_LEN;
+}
+
+/**
+ * @brief Send NUS_REQ_OP_LOG_MULTI_READ_FILTERED and wait until the end-of-data message is acknowledged.
+ */
+static test_nus_stats_t
+test_nus_read_filtered(const uint8_t mode, const hist_log_filter_op_e op)
+{
+    uint8_t        msg[TEST_NUS_REQ_FILTER_MAX_LEN] = { 0 };
+    const uint16_t len                              = test_nus_pack_req_filtered(msg, mode, op);
+    return test_nus_send_request(msg, len);
+}
+
+/**
+ * @brief Count the generated records whose CO2 is above the threshold and the runs of the consecutive ones.
+ */
+static void
+test_nus_count_co2_above(const uint32_t num_records, uint32_t* const p_num_matching, uint32_t* const p_num_runs)
+{
+    *p_num_matching = 0;
+    *p_num_runs     = 0;
+    bool is_prev_matching = false;
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        const hist_log_record_data_t data        = test_nus_gen_record_data(i);
+        const bool                   is_matching = test_nus_decode_co2(data.buf) > TEST_NUS_FILTER_CO2_THRESHOLD_PPM;
+        if (is_matching)
+        {
+            *p_num_matching += 1;
+            *p_num_runs += is_prev_matching ? 0U : 1U;
+        }
+        is_prev_matching = is_matching;
+    }
+}
+
+ZTEST(test_suite_nus, test_req_parse_filtered)
+{
+    uint8_t        msg[TEST_NUS_REQ_FILTER_MAX_LEN] = { 0 };
+    const uint16_t len = test_nus_pack_req_filtered(msg, NUS_REQ_FILTER_MODE_INTERVALS, HIST_LOG_FILTER_OP_LT);
+
+    nus_req_t req = { 0 };
+    zassert_true(nus_req_parse(msg, len, &req));
+    ZASSERT_EQ_INT(RE_LOG_R_MULTI, req.req_re_op);
+    zassert_true(req.is_filtered);
+    zassert_true(req.is_intervals);
+    ZASSERT_EQ_INT(1, req.filter.num_conds);
+    ZASSERT_EQ_INT(HIST_LOG_FIELD_CO2, req.filter.conds[0].field);
+    ZASSERT_EQ_INT(HIST_LOG_FILTER_OP_LT, req.filter.conds[0].op);
+    zassert_within(req.filter.conds[0].threshold, TEST_NUS_FILTER_CO2_THRESHOLD_PPM, 0.001f);
+    zassert_false(req.is_aggregated);
+
+    // The message is too short for the standard fields or for the header of the filter
+    for (uint16_t short_len = RE_STANDARD_OPERATION_INDEX + 1U; short_len < TEST_NUS_REQ_FILTER_CONDS_IDX; ++short_len)
+    {
+        zassert_false(nus_req_parse(msg, short_len, &req));
+    }
+
+    // The number of the conditions does not match the length of the message
+    static const uint8_t invalid_num_conds[] = { 0, 2U, HIST_LOG_FILTER_MAX_CONDS + 1U };
+    for (uint32_t i = 0; i < ARRAY_SIZE(invalid_num_conds); ++i)
+    {
+        msg[TEST_NUS_REQ_FILTER_NUM_CONDS_IDX] = invalid_num_conds[i];
+        zassert_false(nus_req_parse(msg, len, &req));
+    }
+    msg[TEST_NUS_REQ_FILTER_NUM_CONDS_IDX] = 1U;
+    zassert_false(nus_req_parse(msg, len - 1U, &req));
+    zassert_false(nus_req_parse(msg, len + TEST_NUS_REQ_FILTER_COND_LEN, &req));
+
+    // Unknown mode, field or operation
+    msg[TEST_NUS_REQ_FILTER_MODE_IDX] = NUS_REQ_FILTER_MODE_INTERVALS + 1U;
+    zassert_false(nus_req_parse(msg, len, &req));
+    msg[TEST_NUS_REQ_FILTER_MODE_IDX]                                  = NUS_REQ_FILTER_MODE_RECORDS;
+    msg[TEST_NUS_REQ_FILTER_CONDS_IDX + TEST_NUS_REQ_FILTER_FIELD_OFS] = (uint8_t)HIST_LOG_NUM_FIELDS;
+    zassert_false(nus_req_parse(msg, len, &req));
+    msg[TEST_NUS_REQ_FILTER_CONDS_IDX + TEST_NUS_REQ_FILTER_FIELD_OFS] = (uint8_t)HIST_LOG_FIELD_CO2;
+    msg[TEST_NUS_REQ_FILTER_CONDS_IDX + TEST_NUS_REQ_FILTER_OP_OFS]    = (uint8_t)HIST_LOG_FILTER_OP_LT + 1U;
+    zassert_false(nus_req_parse(msg, len, &req));
+
+    msg[TEST_NUS_REQ_FILTER_CONDS_IDX + TEST_NUS_REQ_FILTER_OP_OFS] = (uint8_t)HIST_LOG_FILTER_OP_GT;
+    zassert_true(nus_req_parse(msg, len, &req));
+    zassert_false(req.is_intervals);
+    ZASSERT_EQ_INT(HIST_LOG_FILTER_OP_GT, req.filter.conds[0].op);
+}
+
+/**
+ * @brief The matching records are sent prefixed with their sequence numbers, or merged into intervals.
+ */
+ZTEST_F(test_suite_nus, test_filtered_records_and_intervals)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+    uint32_t num_matching = 0;
+    uint32_t num_runs     = 0;
+    test_nus_count_co2_above(TEST_NUS_NUM_RECORDS, &num_matching, &num_runs);
+    // Every day has one period of the high CO2
+    ZASSERT_EQ_INT(TEST_NUS_NUM_DAYS, num_runs);
+
+    const test_nus_stats_t records = test_nus_read_filtered(NUS_REQ_FILTER_MODE_RECORDS, HIST_LOG_FILTER_OP_GT);
+    test_nus_print_stats("filter", &records);
+    ZASSERT_EQ_INT(num_matching, records.num_records);
+    ZASSERT_EQ_INT(TEST_NUS_SEQ_RECORD_LEN, records.record_len);
+    for (uint32_t i = 0; i < records.num_records; ++i)
+    {
+        // The sequence numbers start from 1
+        const nus_hist_decoder_record_t* const p_record = &g_test_nus_captured[i];
+        ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP + ((p_record->seq - 1U) * TEST_NUS_PERIOD_SECONDS), p_record->timestamp);
+        zassert_true(test_nus_decode_co2(p_record->data.buf) > TEST_NUS_FILTER_CO2_THRESHOLD_PPM);
+        zassert_true((0 == i) || (p_record->seq > g_test_nus_captured[i - 1U].seq));
+    }
+
+    // The consecutive matching records are merged, the interval is closed by the first non-matching record
+    const test_nus_stats_t intervals = test_nus_read_filtered(NUS_REQ_FILTER_MODE_INTERVALS, HIST_LOG_FILTER_OP_GT);
+    test_nus_print_stats("intrvl", &intervals);
+    ZASSERT_EQ_INT(num_runs, intervals.num_records);
+    ZASSERT_EQ_INT(num_matching, intervals.num_interval_records);
+    ZASSERT_EQ_INT(0, intervals.num_wrong_intervals);
+    ZASSERT_EQ_INT(TEST_NUS_INTERVAL_LEN, intervals.record_len);
+    ZASSERT_EQ_INT(g_test_nus_captured[0].timestamp, intervals.timestamp_first);
+    ZASSERT_EQ_INT(g_test_nus_captured[records.num_records - 1U].timestamp, intervals.timestamp_last);
+    zassert_true((intervals.num_bytes_on_air * 10U) < records.num_bytes_on_air);
+
+    // The low CO2 continues until the last record: the open interval is closed at the end of the history
+    const test_nus_stats_t remaining = test_nus_read_filtered(NUS_REQ_FILTER_MODE_INTERVALS, HIST_LOG_FILTER_OP_LT);
+    ZASSERT_EQ_INT(num_runs + 1U, remaining.num_records);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS - num_matching, remaining.num_interval_records);
+    ZASSERT_EQ_INT(0, remaining.num_wrong_intervals);
+    ZASSERT_EQ_INT(TEST_NUS_BASE_TIMESTAMP, remaining.timestamp_first);
+    ZASSERT_EQ_INT(fixture->timestamp_last, remaining.timestamp_last);
+}
+
+ZTEST(test_suite_nus, test_packet_len_for_mtu)
+{
+    static const uint32_t record_lens[] = {
+        10U,                                             // Interval of the matching records
+        RE_LOG_WRITE_AIRQ_RECORD_LEN,                    // Record
+        sizeof(uint32_t) + RE_LOG_WRITE_AIRQ_RECORD_LEN, // Record prefixed with the sequence number
+        TEST_NUS_AGGREGATED_RECORD_LEN,                  // Aggregated record
+    };
+    ZASSERT_EQ_INT(0, nus_get_packet_len_max(0));
+    ZASSERT_EQ_INT(0, nus_get_packet_len_max(TEST_NUS_ATT_NOTIFY_HEADER_SIZE));
+    for (uint32_t att_mtu = TEST_NUS_ATT_MTU_MIN; att_mtu <= (TEST_NUS_ATT_MTU_MAX + 10U); ++att_mtu)
+    {
+        const uint32_t packet_len_max = nus_get_packet_len_max((uint16_t)att_mtu);
+        ZASSERT_EQ_INT(MIN(att_mtu - TEST_NUS_ATT_NOTIFY_HEADER_SIZE, TEST_NUS_MAX_PACKET_LEN), packet_len_max);
+        for (uint32_t i = 0; i < ARRAY_SIZE(record_lens); ++i)
+        {
+            const uint32_t num_records = nus_get_max_num_records_in_packet(packet_len_max, record_lens[i]);
+            // The records fill the packet, one more record does not fit
+            zassert_true((RE_LOG_WRITE_MULTI_PAYLOAD_IDX + (num_records * record_lens[i])) <= packet_len_max);
+            zassert_true((RE_LOG_WRITE_MULTI_PAYLOAD_IDX + ((num_records + 1U) * record_lens[i])) > packet_len_max);
+        }
+    }
+    // The default MTU of LE fits only the intervals
+    ZASSERT_EQ_INT(1, nus_get_max_num_records_in_packet(nus_get_packet_len_max(TEST_NUS_ATT_MTU_MIN), 10U));
+    ZASSERT_EQ_INT(
+        0,
+        nus_get_max_num_records_in_packet(nus_get_packet_len_max(TEST_NUS_ATT_MTU_MIN), RE_LOG_WRITE_AIRQ_RECORD_LEN));
+    ZASSERT_EQ_INT(
+        6,
+        nus_get_max_num_records_in_packet(nus_get_packet_len_max(TEST_NUS_ATT_MTU_MAX), RE_LOG_WRITE_AIRQ_RECORD_LEN));
+    ZASSERT_EQ_INT(0, nus_get_max_num_records_in_packet(TEST_NUS_MAX_PACKET_LEN, 0));
+}
+
+ZTEST_F(test_suite_nus, test_packing_across_mtu)
+{
+    const uint32_t num_records = 100U;
+    test_nus_fill(fixture, num_records);
+
+    for (uint32_t att_mtu = TEST_NUS_ATT_MTU_MIN; att_mtu <= TEST_NUS_ATT_MTU_MAX; ++att_mtu)
+    {
+        // The central does not accept a larger MTU
+        test_nus_link_set_mtu((uint16_t)att_mtu, (uint16_t)att_mtu);
+        const test_nus_stats_t stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+
+        const uint32_t packet_len_max     = att_mtu - TEST_NUS_ATT_NOTIFY_HEADER_SIZE;
+        const uint32_t num_records_in_pkt = (packet_len_max >= (RE_LOG_WRITE_MULTI_PAYLOAD_IDX
+                                                                + RE_LOG_WRITE_AIRQ_RECORD_LEN))
+                                                ? ((packet_len_max - RE_LOG_WRITE_MULTI_PAYLOAD_IDX)
+                                                   / RE_LOG_WRITE_AIRQ_RECORD_LEN)
+                                                : 0;
+        zassert_true(stats.packet_len_max <= packet_len_max);
+        if (0 == num_records_in_pkt)
+        {
+            // The records do not fit, only the end-of-data message is sent
+            ZASSERT_EQ_INT(0, stats.num_records);
+            ZASSERT_EQ_INT(1, stats.num_packets);
+            continue;
+        }
+        ZASSERT_EQ_INT(num_records, stats.num_records);
+        ZASSERT_EQ_INT(fixture->timestamp_last, stats.timestamp_last);
+        // All the packets except the last one are full, plus the end-of-data message
+        ZASSERT_EQ_INT(((num_records + num_records_in_pkt - 1U) / num_records_in_pkt) + 1U, stats.num_packets);
+        ZASSERT_EQ_INT(
+            RE_LOG_WRITE_MULTI_PAYLOAD_IDX + (MIN(num_records, num_records_in_pkt) * RE_LOG_WRITE_AIRQ_RECORD_LEN),
+            stats.packet_len_max);
+    }
+}
+
+#if defined(CONFIG_RUUVI_AIR_NUS_REQUEST_MTU_AND_DLE)
+ZTEST_F(test_suite_nus, test_mtu_exchange_on_request)
+{
+    test_nus_fill(fixture, 100U);
+
+    // The central did not start the MTU exchange, the peripheral starts it when the history is requested
+    test_nus_link_set_mtu(TEST_NUS_ATT_MTU_MIN, TEST_NUS_ATT_MTU_MAX);
+    test_nus_stats_t stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+    ZASSERT_EQ_INT(1, g_test_nus_link.num_mtu_exchanges);
+    ZASSERT_EQ_INT(1, g_test_nus_link.num_data_len_updates);
+    ZASSERT_EQ_INT(100, stats.num_records);
+    ZASSERT_EQ_INT(
+        RE_LOG_WRITE_MULTI_PAYLOAD_IDX
+            + (((TEST_NUS_MAX_PACKET_LEN - RE_LOG_WRITE_MULTI_PAYLOAD_IDX) / RE_LOG_WRITE_AIRQ_RECORD_LEN)
+               * RE_LOG_WRITE_AIRQ_RECORD_LEN),
+        stats.packet_len_max);
+
+    // The MTU is not exchanged again if it is already the max
+    stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+    ZASSERT_EQ_INT(1, g_test_nus_link.num_mtu_exchanges);
+    ZASSERT_EQ_INT(2, g_test_nus_link.num_data_len_updates);
+    ZASSERT_EQ_INT(100, stats.num_records);
+
+    // The central supports only a smaller MTU (e.g. 185 bytes of iOS)
+    test_nus_link_set_mtu(TEST_NUS_ATT_MTU_MIN, 185U);
+    stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+    ZASSERT_EQ_INT(1, g_test_nus_link.num_mtu_exchanges);
+    ZASSERT_EQ_INT(185U, g_test_nus_link.att_mtu);
+    ZASSERT_EQ_INT(100, stats.num_records);
+    zassert_true(stats.packet_len_max <= (185U - TEST_NUS_ATT_NOTIFY_HEADER_SIZE));
+}
+#endif
+
+static void
+test_nus_check_records(
+    const nus_hist_decoder_record_t* const p_expected,
+    const nus_hist_decoder_record_t* const p_actual,
+    const uint32_t                         num_records)
+{
+    for (uint32_t i = 0; i < num_records; ++i)
+    {
+        ZASSERT_EQ_INT(p_expected[i].seq, p_actual[i].seq);
+        ZASSERT_EQ_INT(p_expected[i].timestamp, p_actual[i].timestamp);
+        zassert_mem_equal(p_expected[i].data.buf, p_actual[i].data.buf, sizeof(p_actual[i].data.buf));
+    }
+}
+
+ZTEST(test_suite_nus, test_req_parse_compressed)
+{
+    uint8_t msg[RE_STANDARD_MESSAGE_LENGTH] = {
+        [RE_STANDARD_DESTINATION_INDEX] = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_SOURCE_INDEX]      = RE_STANDARD_DESTINATION_AIRQ,
+        [RE_STANDARD_OPERATION_INDEX]   = NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED,
+    };
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_CURRENT_TIME_IDX], TEST_NUS_BASE_TIMESTAMP);
+    test_nus_pack_uint32(&msg[TEST_NUS_REQ_START_TIME_IDX], 1234U);
+
+    nus_req_t req = { 0 };
+    zassert_true(nus_req_parse(msg, sizeof(msg), &req));
+    ZASSERT_EQ_INT(RE_LOG_R_MULTI, req.req_re_op);
+    zassert_true(req.is_compressed);
+    zassert_true(req.is_after_seq);
+    ZASSERT_EQ_INT(1234U, req.after_seq);
+    ZASSERT_EQ_INT(0, req.start_time_s);
+
+    msg[RE_STANDARD_OPERATION_INDEX] = NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ;
+    zassert_true(nus_req_parse(msg, sizeof(msg), &req));
+    zassert_false(req.is_compressed);
+    zassert_true(req.is_after_seq);
+}
+
+ZTEST_F(test_suite_nus, test_compressed_round_trip)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    const test_nus_stats_t raw = test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ, 0);
+    test_nus_print_stats("raw", &raw);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, raw.num_records);
+    ZASSERT_EQ_INT(TEST_NUS_SEQ_RECORD_LEN, raw.record_len);
+    memcpy(g_test_nus_expected, g_test_nus_captured, sizeof(g_test_nus_expected));
+
+    const test_nus_stats_t compressed = test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, 0);
+    test_nus_print_stats("compr", &compressed);
+    ZASSERT_EQ_INT(0, compressed.num_decode_errors);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, compressed.num_records);
+    ZASSERT_EQ_INT(compressed.num_packets - 1U, compressed.num_chunks);
+    test_nus_check_records(g_test_nus_expected, g_test_nus_captured, TEST_NUS_NUM_RECORDS);
+    zassert_true(compressed.packet_len_max <= TEST_NUS_MAX_PACKET_LEN);
+
+    // The transfer time is proportional to the number of packets if the link is the bottleneck
+    printf(
+        "NUS history compression ratio %u.%02u, %u.%02u records per packet (%u.%02u raw), "
+        "transfer time reduced by %u%% (%u ms -> %u ms, air time %u ms -> %u ms)\n",
+        (unsigned)(raw.num_bytes / compressed.num_bytes),
+        (unsigned)(((raw.num_bytes * 100U) / compressed.num_bytes) % 100U),
+        (unsigned)(compressed.num_records / compressed.num_chunks),
+        (unsigned)(((compressed.num_records * 100U) / compressed.num_chunks) % 100U),
+        (unsigned)(raw.num_records / (raw.num_packets - 1U)),
+        (unsigned)(((raw.num_records * 100U) / (raw.num_packets - 1U)) % 100U),
+        (unsigned)(100U - ((compressed.time_ms * 100U) / raw.time_ms)),
+        (unsigned)raw.time_ms,
+        (unsigned)compressed.time_ms,
+        (unsigned)(raw.air_time_us / 1000U),
+        (unsigned)(compressed.air_time_us / 1000U));
+    zassert_true((compressed.num_bytes * 3U) < raw.num_bytes);
+    zassert_true((compressed.time_ms * 2U) < raw.time_ms);
+
+    // Resume after the middle record
+    const uint32_t         after_seq = g_test_nus_expected[TEST_NUS_NUM_RECORDS / 2U].seq;
+    const test_nus_stats_t resumed   = test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, after_seq);
+    ZASSERT_EQ_INT(0, resumed.num_decode_errors);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS - (TEST_NUS_NUM_RECORDS / 2U) - 1U, resumed.num_records);
+    test_nus_check_records(
+        &g_test_nus_expected[(TEST_NUS_NUM_RECORDS / 2U) + 1U],
+        g_test_nus_captured,
+        resumed.num_records);
+}
+
+ZTEST_F(test_suite_nus, test_compressed_lost_chunk)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    (void)test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_AFTER_SEQ, 0);
+    memcpy(g_test_nus_expected, g_test_nus_captured, sizeof(g_test_nus_expected));
+    const test_nus_stats_t all = test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, 0);
+    zassert_true(all.num_chunks > 3U);
+
+    // The client does not receive the second chunk, the following chunks are decoded without it
+    g_test_nus_lost_chunk_idx = 1U;
+    const test_nus_stats_t stats = test_nus_read_after_seq(NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED, 0);
+    ZASSERT_EQ_INT(0, stats.num_decode_errors);
+    ZASSERT_EQ_INT(all.num_chunks, stats.num_chunks);
+    zassert_true(stats.num_records < all.num_records);
+
+    // The records before and after the lost chunk are the same as the uncompressed ones
+    const uint32_t num_lost = all.num_records - stats.num_records;
+    uint32_t idx_gap = 0;
+    while ((idx_gap + 1U) < stats.num_records)
+    {
+        if ((g_test_nus_captured[idx_gap].seq + 1U) != g_test_nus_captured[idx_gap + 1U].seq)
+        {
+            break;
+        }
+        idx_gap += 1;
+    }
+    ZASSERT_EQ_INT(g_test_nus_captured[idx_gap].seq + num_lost + 1U, g_test_nus_captured[idx_gap + 1U].seq);
+    test_nus_check_records(g_test_nus_expected, g_test_nus_captured, idx_gap + 1U);
+    test_nus_check_records(
+        &g_test_nus_expected[idx_gap + 1U + num_lost],
+        &g_test_nus_captured[idx_gap + 1U],
+        stats.num_records - idx_gap - 1U);
+}
+
+#if defined(CONFIG_RUUVI_AIR_NUS_L2CAP)
+ZTEST_F(test_suite_nus, test_l2cap_sdu_len_for_mtu)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS / TEST_NUS_NUM_DAYS);
+    const uint16_t mtus[] = { 100U, TEST_NUS_MAX_PACKET_LEN, TEST_NUS_L2CAP_MTU, TEST_NUS_L2CAP_MTU * 2U };
+    for (uint32_t i = 0; i < ARRAY_SIZE(mtus); ++i)
+    {
+        test_nus_l2cap_connect(mtus[i], TEST_NUS_L2CAP_MPS, TEST_NUS_L2CAP_CREDITS);
+        const test_nus_stats_t stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+        test_nus_l2cap_disconnect();
+        ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS / TEST_NUS_NUM_DAYS, stats.num_records);
+        ZASSERT_EQ_INT(fixture->timestamp_last, stats.timestamp_last);
+        const uint32_t sdu_len_max  = MIN(mtus[i], TEST_NUS_L2CAP_MTU);
+        const uint32_t num_in_sdu   = (sdu_len_max - RE_LOG_WRITE_MULTI_PAYLOAD_IDX) / RE_LOG_WRITE_AIRQ_RECORD_LEN;
+        const uint32_t num_sdus_min = (stats.num_records + num_in_sdu - 1U) / num_in_sdu;
+        zassert_true(stats.packet_len_max <= sdu_len_max);
+        ZASSERT_EQ_INT(num_sdus_min + 1U, stats.num_packets);
+    }
+    // The notifications are used again when the channel is closed
+    const test_nus_stats_t stats = test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0);
+    ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS / TEST_NUS_NUM_DAYS, stats.num_records);
+    zassert_true(stats.packet_len_max <= TEST_NUS_MAX_PACKET_LEN);
+}
+
+/**
+ * @brief Compare the history transfer over the L2CAP channel and over the NUS notifications on the same link.
+ */
+ZTEST_F(test_suite_nus, test_l2cap_throughput)
+{
+    test_nus_fill(fixture, TEST_NUS_NUM_RECORDS);
+
+    static const struct
+    {
+        uint32_t conn_interval_us;
+        uint32_t num_tx_bufs;
+    } links[] = {
+        { 7500U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 15000U, TEST_NUS_LINK_NUM_TX_BUFS },
+        { 30000U, TEST_NUS_LINK_NUM_TX_BUFS },
+    };
+    static const uint8_t ops[] = { RE_STANDARD_LOG_MULTI_READ, NUS_REQ_OP_LOG_MULTI_READ_COMPRESSED };
+    for (uint32_t i = 0; i < ARRAY_SIZE(links); ++i)
+    {
+        test_nus_link_configure(links[i].conn_interval_us, links[i].num_tx_bufs);
+        for (uint32_t j = 0; j < ARRAY_SIZE(ops); ++j)
+        {
+            test_nus_stats_t stats[2] = { 0 };
+            for (uint32_t k = 0; k < ARRAY_SIZE(stats); ++k)
+            {
+                const bool is_l2cap = (0 != k);
+                if (is_l2cap)
+                {
+                    test_nus_l2cap_connect(TEST_NUS_L2CAP_MTU, TEST_NUS_L2CAP_MPS, TEST_NUS_L2CAP_CREDITS);
+                }
+                stats[k] = (RE_STANDARD_LOG_MULTI_READ == ops[j])
+                               ? test_nus_read_history(TEST_NUS_BASE_TIMESTAMP, 0)
+                               : test_nus_read_after_seq(ops[j], 0);
+                test_nus_l2cap_disconnect();
+                ZASSERT_EQ_INT(TEST_NUS_NUM_RECORDS, stats[k].num_records);
+                ZASSERT_EQ_INT(fixture->timestamp_last, stats[k].timestamp_last);
+                ZASSERT_EQ_INT(0, stats[k].num_decode_errors);
+                printf(
+                    "%-13s %-10s: conn interval %5u us: %5u records/s, %4u messages, %6u bytes on air, "
+                    "air time %5u ms, total %5u ms\n",
+                    is_l2cap ? "L2CAP CoC" : "Notifications",
+                    (RE_STANDARD_LOG_MULTI_READ == ops[j]) ? "raw" : "compressed",
+                    (unsigned)links[i].conn_interval_us,
+                    (unsigned)((stats[k].num_records * 1000U) / stats[k].time_ms),
+                    (unsigned)stats[k].num_packets,
+                    (unsigned)stats[k].num_bytes_on_air,
+                    (unsigned)(stats[k].air_time_us / 1000U),
+                    (unsigned)stats[k].time_ms);
+            }
+            // The SDUs are twice as long as the notifications, so the headers of the response are sent less often
+            zassert_true((stats[1].num_packets * 3U) < (stats[0].num_packets * 2U));
+            zassert_true(stats[1].num_bytes_on_air < stats[0].num_bytes_on_air);
+            zassert_true(stats[1].time_ms <= (stats[0].time_ms + (stats[0].time_ms / 10U)));
+        }
+    }
+}
+#endif